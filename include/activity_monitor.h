@@ -6,6 +6,7 @@
 #include <set>
 #include <thread>
 #include <atomic>
+#include <mutex>
 #include <functional>
 
 struct ActivityEvent {
@@ -24,6 +25,12 @@ public:
     void stopMonitoring();
     void setCallback(std::function<void(const ActivityEvent&)> callback);
 
+    // Account owning the focused window's process, as of the last focus
+    // change; empty when it could not be resolved. Events carry the
+    // "current_user" placeholder, so this is how focus changes are attributed
+    // to the same account as the processes that account launches.
+    std::string focusedWindowUser() const;
+
 private:
     void monitorKeyboard();
     void monitorMouse();
@@ -31,6 +38,7 @@ private:
     void monitorApplications();
     std::string getActiveWindowTitle();
     std::string getActiveApplication();
+    std::string getActiveWindowUser();
     std::set<std::string> getRunningApplications();
 
     std::thread keyboard_thread_;
@@ -40,6 +48,9 @@ private:
 
     std::atomic<bool> running_;
     std::function<void(const ActivityEvent&)> callback_;
+
+    mutable std::mutex focus_mutex_;
+    std::string focused_window_user_;
 };
 
 #endif // ACTIVITY_MONITOR_H
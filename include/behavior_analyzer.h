@@ -4,29 +4,21 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
-#include <deque>
 #include <chrono>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include "correlation_engine.h"
+#include "feature_schema.h"
+#include "feature_baselines.h"
+#include "isolation_forest.h"
+#include "metric_store.h"
+#include "transition_model.h"
+#include "user_profile_store.h"
 
 // Forward declaration for LLM analyzer
 class LLMBehaviorAnalyzer;
 
-struct BehaviorPattern {
-    std::string user;
-    std::string pattern_type;  // "normal", "suspicious", "anomalous"
-    double confidence_score;   // 0.0 to 1.0
-    std::string description;
-    std::chrono::system_clock::time_point timestamp;
-};
-
-struct UserProfile {
-    std::string user_id;
-    std::unordered_map<std::string, double> baseline_metrics;
-    std::vector<BehaviorPattern> recent_patterns;
-    double risk_score;  // 0.0 to 1.0
-};
-
 class BehaviorAnalyzer {
 public:
     BehaviorAnalyzer();
@@ -37,34 +29,93 @@ public:
     void setLLMProvider(const std::string& provider);  // "openai", "anthropic", "local"
     void setLLMAPIKey(const std::string& provider, const std::string& api_key);
     void setLLMModel(const std::string& provider, const std::string& model);
+    void setLLMEndpoint(const std::string& provider, const std::string& url);
+    void setLLMMaxConcurrentRequests(const std::string& provider, size_t limit);
+    void setLLMRequestTimeout(std::chrono::seconds timeout);
+    void setLLMRateLimits(const std::string& provider, double requests_per_minute, double tokens_per_minute);
+    void setLLMBatchSize(size_t users);
 
     // Core analysis methods
     void analyzeActivity(const std::string& user, const std::string& activity_type,
                         const std::unordered_map<std::string, double>& metrics);
+    void analyzeActivity(const std::string& user, const std::string& activity_type,
+                        const FeatureVector& features);
+
+    // Producers register their features once, before analysis starts, and fill FeatureVectors by index
+    FeatureSchema& featureSchema() { return feature_schema_; }
     void updateUserProfile(const std::string& user, const UserProfile& profile);
+    // Full copy including baseline metrics; prefer the accessors below on hot paths
     UserProfile getUserProfile(const std::string& user);
+    double getRiskScore(const std::string& user) const;
+    size_t userCount() const { return profiles_.size(); }
+    // Runs visitor on the stored profile without copying it; false if the user is unknown.
+    // The visitor must not call back into the analyzer.
+    bool visitUserProfile(const std::string& user, const std::function<void(const UserProfile&)>& visitor) const;
+    // Newest first. Patterns the arena has since reused are no longer returned.
     std::vector<BehaviorPattern> getRecentPatterns(const std::string& user, int limit = 10);
+    void visitRecentPatterns(const std::string& user, size_t limit,
+                             const std::function<void(const BehaviorPattern&)>& visitor) const;
     void setAnomalyCallback(std::function<void(const BehaviorPattern&)> callback);
 
+    // Baselines, profiles and recent patterns survive restarts through snapshots.
+    // loadSnapshot restores all or nothing and is meant to run before analysis starts.
+    bool saveSnapshot(const std::string& path);
+    bool loadSnapshot(const std::string& path);
+
+    // Per-minute feature history, compressed in memory for long-horizon baselines and
+    // offline re-scoring without shipping raw data to the backend
+    std::vector<MetricPoint> getMetricHistory(const std::string& user, const std::string& metric,
+                                              std::chrono::system_clock::time_point from,
+                                              std::chrono::system_clock::time_point to) const;
+    std::vector<std::string> getMetricNames(const std::string& user) const;
+    size_t metricHistoryBytes() const { return metric_history_.bytes(); }
+    void pruneMetricHistory(std::chrono::system_clock::time_point now);
+
+    // Scores the next focused application ("app:<name>") or launched process
+    // ("exec:<name>") against the user's learned transitions. Only unusual
+    // sequences become patterns.
+    void analyzeTransition(const std::string& user, const std::string& token);
+
+    // Multi-step sequences found by the correlation engine are always suspicious
+    void recordCorrelatedSequence(const CorrelationMatch& match);
+
     // LLM-specific methods
     void startLLMAnalysis();
     void stopLLMAnalysis();
+    // Hands the user's current summary and risk score to the LLM scheduler, which
+    // decides when to analyze it within the provider's budget
     void requestLLMAnalysis(const std::string& user);
     void generateSecurityRecommendations(const std::string& user);
 
 private:
-    void detectAnomalies(const std::string& user, const std::unordered_map<std::string, double>& current_metrics);
-    void updateBaseline(const std::string& user, const std::unordered_map<std::string, double>& metrics);
-    double calculateRiskScore(const std::string& user);
-    bool isAnomalous(const std::unordered_map<std::string, double>& current,
-                    const std::unordered_map<std::string, double>& baseline, double threshold = 0.7);
+    double calculateRiskScore(const std::string& user) const;
+
+    // The baseline helpers expect baseline_mutex_ to be held
+    bool detectAnomalies(const std::string& user, const FeatureVector& current, size_t hour_of_week,
+                         BaselineScore& score);
+    void updateBaseline(const std::string& user, const FeatureVector& features, size_t hour_of_week);
+    bool isAnomalous(size_t baseline_row, const FeatureVector& current, size_t hour_of_week,
+                     BaselineScore& score, double threshold = 4.0);
+    size_t baselineRow(const std::string& user);
+    std::unordered_map<std::string, double> baselineMetrics(const std::string& user) const;
 
     // LLM callback handler
     void handleLLMInsight(const struct LLMBehaviorInsight& insight);
 
-    std::unordered_map<std::string, UserProfile> user_profiles_;
+    // Written by the analysis loop and the LLM thread
+    UserProfileStore profiles_;
     std::function<void(const BehaviorPattern&)> anomaly_callback_;
-    std::deque<BehaviorPattern> pattern_history_;
+
+    // Guards the schema names and baselines, which grow as users and features appear
+    mutable std::mutex baseline_mutex_;
+    FeatureSchema feature_schema_;
+    FeatureBaselines baselines_;
+    std::unordered_map<std::string, size_t> baseline_rows_;
+
+    // Multi-feature anomaly model per user, retrained in the background
+    UserForests forests_;
+    TransitionModel transitions_;
+    MetricStore metric_history_;
 
     // LLM components
     bool llm_enabled_;
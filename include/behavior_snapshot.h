@@ -0,0 +1,100 @@
+#ifndef BEHAVIOR_SNAPSHOT_H
+#define BEHAVIOR_SNAPSHOT_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// On-disk container for BehaviorAnalyzer state. A file is a fixed header
+// (magic, format version, payload size, CRC-32 of the payload) followed by
+// the payload. Values are stored in host byte order; a snapshot is only
+// meant to be restored by the agent on the machine that wrote it.
+constexpr uint32_t SNAPSHOT_FORMAT_VERSION = 3;
+
+uint32_t snapshotCrc32(const unsigned char* data, size_t size);
+
+// Writes header and payload to a temporary file, syncs it and renames it
+// over path, so readers see either the old snapshot or the new one.
+bool writeSnapshotFile(const std::string& path, const std::string& payload);
+
+// Appends fixed-size values and length-prefixed strings to a payload
+class SnapshotWriter {
+public:
+    template <typename T>
+    void put(T value) {
+        buffer_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void putString(const std::string& value) {
+        put<uint32_t>(static_cast<uint32_t>(value.size()));
+        buffer_.append(value);
+    }
+
+    std::string& buffer() { return buffer_; }
+
+private:
+    std::string buffer_;
+};
+
+// Reads a payload in place. Every read is bounds-checked; after the first
+// failed read ok() is false and further reads return zero values.
+class SnapshotReader {
+public:
+    SnapshotReader(const unsigned char* data, size_t size) : data_(data), size_(size), offset_(0), ok_(true) {}
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (const unsigned char* bytes = take(sizeof(T))) {
+            std::memcpy(&value, bytes, sizeof(T));
+        }
+        return value;
+    }
+    std::string getString() {
+        uint32_t length = get<uint32_t>();
+        const unsigned char* bytes = take(length);
+        return bytes ? std::string(reinterpret_cast<const char*>(bytes), length) : std::string();
+    }
+
+    // Returns a pointer to the next size bytes and skips them, or nullptr
+    const unsigned char* take(size_t size) {
+        if (!ok_ || size > size_ - offset_) {
+            ok_ = false;
+            return nullptr;
+        }
+        const unsigned char* bytes = data_ + offset_;
+        offset_ += size;
+        return bytes;
+    }
+
+    bool ok() const { return ok_; }
+
+private:
+    const unsigned char* data_;
+    size_t size_;
+    size_t offset_;
+    bool ok_;
+};
+
+// A snapshot file mapped read-only. valid() is true once the header and the
+// payload checksum have been verified.
+class MappedSnapshot {
+public:
+    explicit MappedSnapshot(const std::string& path);
+    ~MappedSnapshot();
+    MappedSnapshot(const MappedSnapshot&) = delete;
+    MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+    bool valid() const { return payload_ != nullptr; }
+    const std::string& error() const { return error_; }
+    SnapshotReader reader() const { return SnapshotReader(payload_, payload_size_); }
+
+private:
+    void* mapping_;
+    size_t mapping_size_;
+    const unsigned char* payload_;
+    size_t payload_size_;
+    std::string error_;
+};
+
+#endif // BEHAVIOR_SNAPSHOT_H
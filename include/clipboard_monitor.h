@@ -0,0 +1,49 @@
+#ifndef CLIPBOARD_MONITOR_H
+#define CLIPBOARD_MONITOR_H
+
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <atomic>
+#include <cstddef>
+
+struct ClipboardChange {
+    std::string selection;  // "CLIPBOARD" or "PRIMARY"
+    std::string backend;    // "wayland" or "x11"
+    std::string content;    // Text content, capped at the configured size
+    bool truncated;         // Content was larger than the cap
+};
+
+// Waits for selection ownership changes instead of polling the clipboard.
+// Wayland sessions use the ext-data-control protocol, X11 sessions use
+// XFixes SelectionNotify. Content identical to the last seen value of the
+// same selection is not reported again.
+class ClipboardMonitor {
+public:
+    ClipboardMonitor();
+    ~ClipboardMonitor();
+
+    void setCallback(std::function<void(const ClipboardChange&)> callback);
+    void setMaxContentSize(size_t bytes) { max_content_size_ = bytes; }
+
+    // Blocks until stop(). Returns false when no supported display is available.
+    bool run();
+    void stop();
+
+    static bool waylandSupported();
+    static bool x11Supported();
+
+private:
+    bool runWayland();
+    bool runX11();
+    void report(const std::string& selection, const std::string& backend, std::string content, bool truncated);
+    void forget(const std::string& selection) { last_hashes_.erase(selection); }
+
+    std::function<void(const ClipboardChange&)> callback_;
+    size_t max_content_size_;
+    std::atomic<bool> stopped_;
+    int wake_pipe_[2];
+    std::unordered_map<std::string, size_t> last_hashes_;
+};
+
+#endif // CLIPBOARD_MONITOR_H
@@ -0,0 +1,106 @@
+#ifndef CORRELATION_ENGINE_H
+#define CORRELATION_ENGINE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+
+// One observation fed to the engine. Types follow the producers: DLPEvent
+// types ("file_access", "network_transfer", ...) and "process_exec".
+struct CorrelationEvent {
+    std::string type;
+    std::string user;     // Empty when the producer could not attribute the event
+    int pid = 0;
+    std::string process;  // Command name or executable path
+    std::string path;     // File involved, if any
+    std::string destination;
+    std::string detail;   // Policy name, command line or other context
+    std::chrono::steady_clock::time_point time;
+};
+
+// A step matches an event when every non-empty list contains a match.
+struct CorrelationStep {
+    std::string label;
+    std::vector<std::string> event_types;
+    std::vector<std::string> processes;      // Basename of CorrelationEvent::process
+    std::vector<std::string> path_suffixes;  // Case-insensitive suffix of CorrelationEvent::path
+};
+
+// Steps must be observed in order for the same key, all within the window.
+struct CorrelationRule {
+    enum class KeyBy { User, Process };
+
+    std::string name;
+    std::string description;
+    std::vector<CorrelationStep> steps;
+    std::chrono::seconds window;
+    KeyBy key_by = KeyBy::User;
+    double confidence = 0.9;
+};
+
+struct CorrelationMatch {
+    std::string rule;
+    std::string description;
+    std::string key;  // User name or pid, depending on the rule
+    std::string user;
+    double confidence;
+    std::vector<CorrelationEvent> events;  // One per step, in rule order
+};
+
+// Windowed sequence matching over the event stream. For every rule and key
+// the engine keeps at most one partial match per step, the one that started
+// most recently, so state is bounded by rules x keys x steps regardless of
+// event volume. Keys idle for longer than the window are dropped, and the
+// number of keys per rule is capped.
+//
+// Events without a user (inotify file events carry no process) are tracked
+// under a host-wide key that any user's later steps may continue from.
+class CorrelationEngine {
+public:
+    CorrelationEngine();
+
+    void addRule(const CorrelationRule& rule);
+    void removeRule(const std::string& name);
+    void setMatchCallback(std::function<void(const CorrelationMatch&)> callback);
+    void setMaxKeysPerRule(size_t max_keys) { max_keys_per_rule_ = max_keys; }
+
+    void ingest(const CorrelationEvent& event);
+
+    // "sensitive file, then archive tool, then transfer tool within 5 minutes"
+    static CorrelationRule exfiltrationSequenceRule();
+
+private:
+    struct Partial {
+        bool active = false;
+        std::chrono::steady_clock::time_point started;
+        std::vector<CorrelationEvent> events;
+    };
+
+    struct KeyState {
+        std::vector<Partial> partials;  // partials[i] has matched steps 0..i
+        std::chrono::steady_clock::time_point last_seen;
+    };
+
+    struct RuleState {
+        CorrelationRule rule;
+        std::unordered_map<std::string, KeyState> keys;
+    };
+
+    static bool stepMatches(const CorrelationStep& step, const CorrelationEvent& event);
+    void advance(RuleState& state, const std::string& key, const CorrelationEvent& event,
+                 std::vector<CorrelationMatch>& matches);
+    KeyState& keyState(RuleState& state, const std::string& key, std::chrono::steady_clock::time_point now);
+    void expire(RuleState& state, std::chrono::steady_clock::time_point now);
+
+    std::mutex mutex_;
+    std::vector<RuleState> rules_;
+    std::function<void(const CorrelationMatch&)> callback_;
+    size_t max_keys_per_rule_;
+    std::chrono::steady_clock::time_point last_expiry_;
+};
+
+#endif // CORRELATION_ENGINE_H
@@ -0,0 +1,35 @@
+#ifndef COUNT_MIN_SKETCH_H
+#define COUNT_MIN_SKETCH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "hash_mix.h"
+
+// Approximate counts for an unbounded key space in fixed memory. Each key
+// increments one counter per row; the estimate is the smallest of them, so
+// it never undercounts and overcounts by at most total/width per row with
+// high probability. Counters saturate instead of wrapping.
+class CountMinSketch {
+public:
+    CountMinSketch(size_t width, size_t depth);
+
+    void add(uint64_t key, uint32_t count = 1);
+    uint32_t estimate(uint64_t key) const;
+    uint64_t total() const { return total_; }
+    void clear();
+
+    // Raw counters, row by row, for snapshots. restore fails on a size mismatch.
+    const std::vector<uint32_t>& counters() const { return counters_; }
+    bool restore(const std::vector<uint32_t>& counters, uint64_t total);
+
+private:
+    size_t slot(uint64_t key, size_t row) const;
+
+    size_t width_;
+    size_t depth_;
+    uint64_t total_;
+    std::vector<uint32_t> counters_;  // depth_ rows of width_
+};
+
+#endif // COUNT_MIN_SKETCH_H
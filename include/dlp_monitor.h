@@ -2,21 +2,36 @@
 #define DLP_MONITOR_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <regex>
 #include <unordered_set>
+#include <unordered_map>
+#include <deque>
 #include <functional>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <memory>
-
-
+#include <chrono>
+#include <cstdint>
+#include "process_attribution.h"
+#include "dns_observer.h"
+#include "packet_flow_monitor.h"
+#include "mount_monitor.h"
+#include "clipboard_monitor.h"
+#include "fanotify_enforcer.h"
+#include "print_spool_monitor.h"
+#include "rule_stats.h"
 
 struct DLPPolicy {
     std::string name;
     std::vector<std::string> file_extensions;
     std::vector<std::regex> content_patterns;
     std::vector<std::string> restricted_paths;
+    std::vector<std::string> restricted_domains;  // e.g. "*.dropbox.com"
     bool block_transfer;
+    bool removable_destination = false;  // Also evaluate writes to removable media and network shares
 };
 
 struct DLPEvent {
@@ -27,6 +42,18 @@ struct DLPEvent {
     std::string user;
     std::string policy_violated;
     bool blocked;
+    int pid = 0;               // Owning process, 0 when unknown
+    std::string process_path;  // Executable of the owning process
+    uint64_t bytes = 0;        // Bytes moved, for network transfers
+};
+
+// Every file event on a watched path and every outbound transfer, whether or
+// not it violates a policy, for behavioral features
+struct DataObservation {
+    std::string type;       // "file_access" or "network_transfer"
+    std::string file_path;  // Set for file events
+    std::string host;       // Resolved hostname or destination IP, without the port
+    uint64_t bytes = 0;     // Set for network transfers
 };
 
 class DLPMonitor {
@@ -39,27 +66,106 @@ public:
     void startMonitoring();
     void stopMonitoring();
     void setCallback(std::function<void(const DLPEvent&)> callback);
+    void setObservationCallback(std::function<void(const DataObservation&)> callback);
+    void setCaptureInterface(const std::string& interface);  // Enables packet flow accounting fallback
+    void setEnforcement(bool enabled, std::chrono::microseconds latency_budget = std::chrono::milliseconds(5));
+    FanotifyStats enforcementStats() const { return enforcer_.stats(); }
+    void setPrintSpoolDirectory(const std::string& directory);
+
+    // Per-policy and per-pattern evaluation counts, matches, bytes scanned and CPU time
+    std::vector<RuleStatsSnapshot> ruleStats() const { return rule_stats_.snapshot(); }
 
 private:
+    struct NetworkTransfer {
+        uint32_t saddr;  // Network byte order
+        uint32_t daddr;  // Network byte order
+        uint16_t dport;
+        uint64_t size;
+        int pid;
+        std::string comm;
+    };
+
+    struct PolicyRuleStats {
+        RuleCounters* policy;                 // Roll-up over the whole content scan
+        std::vector<RuleCounters*> patterns;  // Indexed like DLPPolicy::content_patterns
+        RuleCounters* keywords;               // Built-in keyword fallback
+    };
+
+    struct PrintVerdict {
+        uint64_t policy_version;
+        std::string policy;  // Empty when the document matched nothing
+    };
+
+    struct WatchTarget {
+        std::string path;
+        std::string mount_point;   // Set for watches below removable or network mounts
+        std::string mount_source;
+    };
+
     void monitorFileSystem();
+    void mountWalkLoop(int inotify_fd);
+    void addMountWatches(int inotify_fd, const MountInfo& mount);
+    void queueMountWalk(const MountInfo& mount);
+    void mergeWalkedWatches(std::unordered_map<int, WatchTarget>& watches);
+    void addDirectoryWatch(int inotify_fd, const std::string& directory, const WatchTarget& mount,
+                           std::unordered_map<int, WatchTarget>& watches);
+    void handleMountChanges(MountMonitor& mount_monitor);
+    void checkRemovableWrite(const std::string& file_path, const WatchTarget& mount);
     void monitorClipboard();
+    void checkClipboardContent(const ClipboardChange& change);
+    void monitorPrintSpool();
+    void checkPrintJob(const PrintJob& job);
+    void startEnforcement();
+    AccessVerdict classifyForEnforcement(int fd, const std::string& path);
+    void reportBlockedAccess(const AccessDenial& denial);
     void monitorNetworkTransfers();
     void fallbackNetworkMonitoring();
     void monitorNetworkConnections();
     void monitorSuspiciousProcesses();
     void monitorFileTransfers();
     void checkPortAgainstPolicies(int port);
-    void checkDestinationAgainstPolicies(const std::string& destination);
+    void checkDestinationAgainstPolicies(const std::string& destination, const ProcessInfo* process = nullptr);
+    void attachProcessInfo(DLPEvent& event, const ProcessInfo& process);
+    bool matchRestrictedDomain(const DLPPolicy& policy, const DnsResolution& resolution,
+                               std::string& matched_name);
     std::string hexToIp(const std::string& hex_addr);
     static void handleNetworkEvent(void* cb_cookie, void* data, int data_size);
     void checkNetworkTransfer(void* event_data);
+    void checkTransfer(const NetworkTransfer& transfer, bool check_policies = true);
+    void observeFile(const std::string& file_path);
+    void checkFlowRecords(const std::vector<FlowRecord>& flows);
     bool checkFileAgainstPolicies(const std::string& file_path);
-    bool checkContentAgainstPolicies(const std::string& content);
+    bool checkContentAgainstPolicies(const std::string& file_path);
+    const DLPPolicy* scanContent(const std::string& content, const std::string& source);
+    bool scanPolicy(size_t index, std::string_view content, const std::string& source,
+                    bool keyword_fallback, std::string& lower_content);
 
     std::vector<DLPPolicy> policies_;
+    std::vector<PolicyRuleStats> policy_rule_stats_;  // Parallel to policies_
+    RuleStatsRegistry rule_stats_;
     std::unordered_set<std::string> monitored_paths_;
     std::atomic<bool> running_;
     std::function<void(const DLPEvent&)> callback_;
+    std::function<void(const DataObservation&)> observation_callback_;
+    ProcessAttributionCache process_cache_;
+    DnsObserver dns_observer_;
+    PacketFlowMonitor flow_monitor_;
+    ClipboardMonitor clipboard_monitor_;
+    FanotifyEnforcer enforcer_;
+    bool enforcement_enabled_;
+    PrintSpoolMonitor print_monitor_;
+    std::atomic<uint64_t> policy_version_;
+    std::unordered_map<size_t, PrintVerdict> print_verdicts_;  // Keyed by document content hash
+    std::deque<size_t> print_verdict_order_;
+    std::string capture_interface_;
+    std::unordered_map<std::string, DomainSuffixMatcher> domain_matchers_;
+
+    // Mounts are walked off the inotify thread so a slow share cannot stall
+    // file events; the watches a walk adds are handed back under the lock
+    std::mutex mount_walk_mutex_;
+    std::condition_variable mount_walk_cv_;
+    std::deque<MountInfo> mount_walks_;
+    std::vector<std::pair<int, WatchTarget>> walked_watches_;
 };
 
 #endif // DLP_MONITOR_H
@@ -0,0 +1,93 @@
+#ifndef DNS_OBSERVER_H
+#define DNS_OBSERVER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+// Compiled hostname policy matcher. Patterns are either exact names
+// ("dropbox.com") or wildcard suffixes ("*.dropbox.com", subdomains only).
+// Matching costs one hash lookup per label of the queried name.
+class DomainSuffixMatcher {
+public:
+    DomainSuffixMatcher() = default;
+    explicit DomainSuffixMatcher(const std::vector<std::string>& patterns);
+    DomainSuffixMatcher(const DomainSuffixMatcher& other);
+    DomainSuffixMatcher& operator=(const DomainSuffixMatcher& other);
+
+    bool empty() const { return patterns_.empty(); }
+    bool match(const std::string& hostname, std::string* matched_pattern = nullptr) const;
+
+private:
+    void compile();
+
+    std::vector<std::string> patterns_;
+    std::vector<std::string> normalized_;
+    std::unordered_map<std::string_view, size_t> exact_;
+    std::unordered_map<std::string_view, size_t> suffixes_;
+};
+
+struct DnsResolution {
+    std::string hostname;        // Name the client asked for
+    std::string canonical_name;  // End of the CNAME chain, empty if none
+};
+
+// Bounded IP -> hostname cache with TTL expiry and LRU eviction.
+class DnsCache {
+public:
+    explicit DnsCache(size_t capacity = 8192);
+
+    void insert(const std::string& ip, const std::string& hostname,
+                const std::string& canonical_name, uint32_t ttl_seconds);
+    bool lookup(const std::string& ip, DnsResolution& resolution);
+    size_t size();
+
+private:
+    struct Entry {
+        std::string ip;
+        DnsResolution resolution;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    std::mutex mutex_;
+    size_t capacity_;
+    std::list<Entry> lru_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+// Learns IP -> hostname mappings by observing DNS responses on an AF_PACKET
+// socket. A classic BPF filter passes only UDP packets from port 53 so the
+// kernel drops everything else before it reaches user space.
+class DnsObserver {
+public:
+    DnsObserver();
+    ~DnsObserver();
+
+    bool start();
+    void stop();
+    bool isRunning() const { return running_; }
+
+    bool resolve(const std::string& ip, DnsResolution& resolution);
+
+    // Parses a raw DNS response payload and records its address answers
+    void processResponse(const uint8_t* data, size_t length);
+
+private:
+    void captureLoop();
+    bool attachFilter(int fd);
+
+    int socket_fd_;
+    std::thread capture_thread_;
+    std::atomic<bool> running_;
+    DnsCache cache_;
+};
+
+#endif // DNS_OBSERVER_H
@@ -0,0 +1,160 @@
+#ifndef FANOTIFY_ENFORCER_H
+#define FANOTIFY_ENFORCER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sys/types.h>
+#include <time.h>
+
+struct AccessVerdict {
+    bool sensitive;
+    std::string policy;  // Policy that classified the file as sensitive
+};
+
+struct AccessDenial {
+    int pid;
+    std::string comm;
+    std::string path;
+    std::string policy;
+};
+
+struct FanotifyStats {
+    uint64_t events;
+    uint64_t fast_allows;      // Own pid, or a process that is never denied
+    uint64_t cache_hits;
+    uint64_t classified;       // Decided by the classifier within the budget
+    uint64_t timeouts;         // Allowed because the budget ran out
+    uint64_t denials;
+    uint64_t unreported_denials;  // Dropped because the report queue was full
+    uint64_t ignore_marks;     // Non-sensitive files the kernel no longer reports
+    uint64_t total_latency_ns;
+    uint64_t max_latency_ns;
+    uint64_t latency_buckets[4];  // <10us, <100us, <1ms, >=1ms
+};
+
+// Enforces block_transfer policies with fanotify permission events. Opens
+// below the marked mounts are held until a verdict is written back (a denied
+// open also blocks every read, so reads are not intercepted), and every step
+// on the hot path is bounded:
+//   - the agent itself and processes outside the restricted set are allowed
+//     immediately, with the file queued once for background classification
+//   - verdicts are cached per inode and policy version; files classified as
+//     non-sensitive get a kernel ignore mark until they are next modified
+//   - a classification that does not finish within the latency budget is
+//     answered with allow (fail open) and its verdict is cached for next time
+//   - held opens are classified ahead of background jobs, and a full queue
+//     sheds background jobs to make room for them
+class FanotifyEnforcer {
+public:
+    using Classifier = std::function<AccessVerdict(int fd, const std::string& path)>;
+
+    FanotifyEnforcer();
+    ~FanotifyEnforcer();
+
+    bool start(const std::vector<std::string>& paths);
+    void stop();
+    bool isRunning() const { return running_; }
+
+    void setClassifier(Classifier classifier) { classifier_ = classifier; }
+    void setDenialCallback(std::function<void(const AccessDenial&)> callback) { denial_callback_ = callback; }
+    void setRestrictedProcesses(const std::vector<std::string>& comms);
+    void setLatencyBudget(std::chrono::microseconds budget) { latency_budget_ = budget; }
+
+    // Drops cached verdicts and ignore marks after policies change
+    void invalidate();
+    FanotifyStats stats() const;
+
+private:
+    struct FileKey {
+        dev_t dev;
+        ino_t ino;
+
+        bool operator==(const FileKey& other) const { return dev == other.dev && ino == other.ino; }
+    };
+
+    struct FileKeyHash {
+        size_t operator()(const FileKey& key) const {
+            return std::hash<uint64_t>{}(static_cast<uint64_t>(key.ino) * 31 + static_cast<uint64_t>(key.dev));
+        }
+    };
+
+    struct CachedVerdict {
+        uint64_t policy_version;
+        int64_t mtime_ns;
+        AccessVerdict verdict;
+    };
+
+    struct ClassifyJob {
+        uint64_t request_id;  // 0 when nobody is waiting for the verdict
+        int fd;               // Duplicate of the event fd, owned by the job
+        FileKey key;
+        int64_t mtime_ns;
+        uint64_t policy_version;
+        int pid;
+        std::string comm;
+    };
+
+    struct PendingResponse {
+        int fd;  // Event fd the response is written for
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::steady_clock::time_point received;
+    };
+
+    void eventLoop();
+    void classifierLoop();
+    void handleEvent(int fd, int pid, std::chrono::steady_clock::time_point received);
+    bool lookupVerdict(const FileKey& key, int64_t mtime_ns, AccessVerdict& verdict);
+    void storeVerdict(const ClassifyJob& job, const AccessVerdict& verdict);
+    bool enqueueJob(ClassifyJob job);
+    void queueDenial(AccessDenial denial);
+    void respond(int fd, bool allow, std::chrono::steady_clock::time_point received);
+    bool completePending(uint64_t request_id, bool allow);
+    void expirePending();
+    bool nextTimeout(struct timespec& timeout);
+    void countFastAllow();
+    void countCacheHit();
+    static bool readComm(int pid, std::string& comm);
+    static std::string fdPath(int fd);
+
+    int fanotify_fd_;
+    int wake_pipe_[2];
+    std::vector<std::string> marked_paths_;
+    std::atomic<bool> running_;
+    std::thread event_thread_;
+    std::thread classifier_thread_;
+    pid_t self_pid_;
+    std::chrono::microseconds latency_budget_;
+    std::unordered_set<std::string> restricted_processes_;
+    Classifier classifier_;
+    std::function<void(const AccessDenial&)> denial_callback_;
+
+    std::atomic<uint64_t> policy_version_;
+    std::mutex cache_mutex_;
+    std::unordered_map<FileKey, CachedVerdict, FileKeyHash> verdicts_;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<ClassifyJob> held_jobs_;        // An open is waiting on these; drained first
+    std::deque<ClassifyJob> background_jobs_;  // Cache warming for opens already allowed
+    std::unordered_set<FileKey, FileKeyHash> background_keys_;  // Queued or being classified
+    std::deque<AccessDenial> denials_;  // Reported off the event thread, bounded
+
+    std::mutex pending_mutex_;
+    std::unordered_map<uint64_t, PendingResponse> pending_;
+    uint64_t next_request_id_;
+
+    mutable std::mutex stats_mutex_;
+    FanotifyStats stats_;
+};
+
+#endif // FANOTIFY_ENFORCER_H
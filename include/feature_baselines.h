@@ -0,0 +1,89 @@
+#ifndef FEATURE_BASELINES_H
+#define FEATURE_BASELINES_H
+
+#include "feature_schema.h"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+struct BaselineScore {
+    double max_z;         // Largest robust z-score over compared features
+    double rms_z;         // Root mean square of the robust z-scores
+    FeatureId top_feature;
+    size_t compared;      // Features past warm-up that were observed
+};
+
+// Streaming per-user baselines for every schema feature. Each user owns one
+// row. Each statistic is its own contiguous array (structure of arrays), so
+// scoring a user walks a few dense arrays that the compiler can vectorize.
+//
+// Every feature keeps an overall mean, variance and mean absolute deviation.
+// It also keeps a mean and absolute deviation for each of the 168 hours of
+// the week, so a login burst at 09:00 on Monday is compared against earlier
+// Mondays at 09:00. Updates start as Welford running averages and turn into
+// EWMAs once a feature has 1/alpha samples. Each update is O(1), and memory
+// per user is fixed by the schema size: about 2 KiB per feature.
+//
+// Scores are robust z-scores, |x - expected| / (1.2533 * mean absolute
+// deviation), with a floor on the scale so constant or zero baselines stay
+// finite. Updates from warmed-up features are clipped to a few scales around
+// the mean, so a single outlier cannot drag the baseline.
+class FeatureBaselines {
+public:
+    static constexpr size_t HOURS_PER_WEEK = 168;
+
+    FeatureBaselines();
+
+    size_t addRow();
+    size_t rows() const { return rows_; }
+    size_t features() const { return features_; }
+
+    // Grows every row when the schema gains features
+    void ensureFeatures(size_t features);
+
+    void update(size_t row, const FeatureVector& observation, size_t hour_of_week, double alpha);
+    void set(size_t row, FeatureId id, double mean);
+
+    // Returns false while no observed feature is past warm-up
+    bool score(size_t row, const FeatureVector& observation, size_t hour_of_week, BaselineScore& result) const;
+
+    // Snapshot form of a row: count, mean, variance and deviation as doubles
+    // for each feature, then seasonal count, mean and deviation as floats for
+    // each hour and feature. Padding is dropped.
+    static size_t rowBytes(size_t features);
+    void exportRow(size_t row, std::string& out) const;
+    // Reads a row exported with ids.size() features; column i becomes feature ids[i]
+    void importRow(size_t row, const unsigned char* data, const std::vector<FeatureId>& ids);
+
+    const double* means(size_t row) const { return &mean_[row * stride_]; }
+    const double* variances(size_t row) const { return &variance_[row * stride_]; }
+    const double* counts(size_t row) const { return &count_[row * stride_]; }
+
+    // Local time, Monday 00:00 is hour 0
+    static size_t hourOfWeek(std::chrono::system_clock::time_point time);
+
+private:
+    void relayout(size_t stride);
+    size_t seasonalOffset(size_t row, size_t hour_of_week) const {
+        return (row * HOURS_PER_WEEK + hour_of_week) * stride_;
+    }
+
+    size_t rows_;
+    size_t features_;
+    size_t stride_;
+
+    // Overall statistics, indexed row * stride_ + feature
+    std::vector<double> count_;
+    std::vector<double> mean_;
+    std::vector<double> variance_;
+    std::vector<double> deviation_;  // Mean absolute deviation from the mean
+
+    // Hour-of-week statistics, indexed (row * 168 + hour) * stride_ + feature
+    std::vector<float> seasonal_count_;
+    std::vector<float> seasonal_mean_;
+    std::vector<float> seasonal_deviation_;
+};
+
+#endif // FEATURE_BASELINES_H
@@ -0,0 +1,97 @@
+#ifndef FEATURE_EXTRACTOR_H
+#define FEATURE_EXTRACTOR_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "feature_schema.h"
+#include "sliding_window.h"
+#include "hyperloglog.h"
+#include "space_saving.h"
+#include "activity_monitor.h"
+#include "dlp_monitor.h"
+#include "process_exec_monitor.h"
+
+// Turns the monitors' event streams into per-user behavioral feature vectors.
+// Every feature is computed over the same trailing window from constant-size
+// sliding counters and sketches (HyperLogLog for distinct counts,
+// Space-Saving for heavy hitters), so recording an event is O(1) and state
+// per user is fixed. Users idle for longer than the retention period are
+// dropped.
+class FeatureExtractor {
+public:
+    explicit FeatureExtractor(FeatureSchema& schema, std::chrono::seconds window = std::chrono::minutes(5));
+
+    // Working hours are local time, Monday to Friday; everything else is after hours
+    void setWorkingHours(int start_hour, int end_hour);
+
+    // Events are keyed by the user the caller resolved, not their own user
+    // field, so a session's input, file, process and network activity share
+    // one window even when the monitors attribute them differently
+    void recordActivity(const std::string& user, const ActivityEvent& event);
+    void recordDLPEvent(const std::string& user, const DLPEvent& event);
+    void recordDataObservation(const std::string& user, const DataObservation& observation);
+    void recordProcessExec(const std::string& user, const ProcessExec& exec);
+
+    // Users with activity within the retention period
+    std::vector<std::string> activeUsers(std::chrono::system_clock::time_point now);
+    FeatureVector extract(const std::string& user, std::chrono::system_clock::time_point now);
+
+    // Destinations that received the most outbound bytes in the last one to two windows, heaviest first
+    std::vector<std::pair<std::string, double>> topDestinations(const std::string& user,
+                                                                std::chrono::system_clock::time_point now, size_t k);
+
+    // Application named by a window focus event, or empty for any other event
+    static std::string focusedApplication(const ActivityEvent& event);
+
+private:
+    struct UserWindows {
+        explicit UserWindows(std::chrono::seconds window);
+
+        SlidingWindowCounter keystrokes;
+        SlidingWindowCounter mouse_events;
+        SlidingWindowCounter app_switches;
+        SlidingHyperLogLog focused_apps;
+        SlidingWindowCounter input_events;
+        SlidingWindowCounter after_hours_events;
+        SlidingWindowCounter dlp_events;
+        SlidingWindowCounter outbound_bytes;
+        SlidingWindowCounter new_processes;
+        SlidingHyperLogLog destinations;
+        SlidingHyperLogLog files;
+        SlidingHeavyHitters destination_bytes;
+        std::string focused_app;
+        std::chrono::system_clock::time_point last_seen;
+    };
+
+    UserWindows& windowsFor(const std::string& user, std::chrono::system_clock::time_point now);
+    bool isAfterHours(std::chrono::system_clock::time_point time);
+    void recordInput(UserWindows& windows, std::chrono::system_clock::time_point time);
+
+    std::chrono::seconds window_;
+    int work_start_hour_;
+    int work_end_hour_;
+    int64_t after_hours_minute_;
+    bool after_hours_;
+
+    FeatureId keystrokes_per_min_;
+    FeatureId mouse_events_per_min_;
+    FeatureId app_switches_per_min_;
+    FeatureId distinct_apps_;
+    FeatureId after_hours_ratio_;
+    FeatureId dlp_events_;
+    FeatureId outbound_bytes_;
+    FeatureId new_processes_;
+    FeatureId distinct_destinations_;
+    FeatureId distinct_files_;
+    FeatureId top_destination_share_;
+    size_t feature_count_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, UserWindows> users_;
+};
+
+#endif // FEATURE_EXTRACTOR_H
@@ -0,0 +1,51 @@
+#ifndef FEATURE_SCHEMA_H
+#define FEATURE_SCHEMA_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+using FeatureId = uint32_t;
+
+// Values for one observation, indexed by FeatureId. Features that were not
+// observed have presence 0, which lets scoring loops multiply instead of branch.
+struct FeatureVector {
+    std::vector<double> values;
+    std::vector<double> present;
+
+    explicit FeatureVector(size_t features = 0) : values(features, 0.0), present(features, 0.0) {}
+
+    void set(FeatureId id, double value) {
+        if (id >= values.size()) {
+            values.resize(id + 1, 0.0);
+            present.resize(id + 1, 0.0);
+        }
+        values[id] = value;
+        present[id] = 1.0;
+    }
+
+    size_t size() const { return values.size(); }
+};
+
+// Maps feature names to dense indices. Producers register their features once
+// and then fill FeatureVectors by index, so per-observation work never hashes
+// a string. Ids are never reused or removed.
+class FeatureSchema {
+public:
+    FeatureId registerFeature(const std::string& name);
+    bool lookup(const std::string& name, FeatureId& id) const;
+    const std::string& name(FeatureId id) const { return names_[id]; }
+    size_t size() const { return names_.size(); }
+
+    // Converts a name-keyed observation, registering names seen for the first time
+    FeatureVector vectorize(const std::unordered_map<std::string, double>& metrics);
+    std::unordered_map<std::string, double> toMap(const FeatureVector& vector) const;
+
+private:
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, FeatureId> index_;
+};
+
+#endif // FEATURE_SCHEMA_H
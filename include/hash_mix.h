@@ -0,0 +1,21 @@
+#ifndef HASH_MIX_H
+#define HASH_MIX_H
+
+#include <cstdint>
+
+// 64-bit finalizer used to derive independent hashes from one key
+inline uint64_t mixHash(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+// Order-dependent combination of two hashes
+inline uint64_t combineHash(uint64_t first, uint64_t second) {
+    return mixHash(first * 0x9e3779b97f4a7c15ULL + second);
+}
+
+#endif // HASH_MIX_H
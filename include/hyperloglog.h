@@ -0,0 +1,51 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Distinct count of an unbounded key stream in 2^precision bytes. Each key
+// hash picks a register by its top bits and records the longest run of
+// leading zeros in the rest; the harmonic mean of the registers estimates
+// cardinality with about 1.04 / sqrt(2^precision) relative error. Small
+// cardinalities use linear counting and are close to exact.
+class HyperLogLog {
+public:
+    explicit HyperLogLog(unsigned precision);
+
+    void add(uint64_t key_hash);
+    void merge(const HyperLogLog& other);
+    double estimate() const;
+    void clear();
+
+    // Estimate for a raw register array, used when merging without allocating
+    static double estimate(const uint8_t* registers, size_t count);
+
+    const std::vector<uint8_t>& registers() const { return registers_; }
+
+private:
+    unsigned precision_;
+    std::vector<uint8_t> registers_;
+};
+
+// HyperLogLog over a trailing window. The window is split into a few time
+// buckets with one sketch each; a query merges the buckets still inside the
+// window, so the window slides with bucket granularity in fixed memory.
+class SlidingHyperLogLog {
+public:
+    SlidingHyperLogLog(std::chrono::seconds window, size_t buckets, unsigned precision);
+
+    void add(std::chrono::system_clock::time_point time, uint64_t key_hash);
+    double count(std::chrono::system_clock::time_point now) const;
+
+private:
+    int64_t epochOf(std::chrono::system_clock::time_point time) const;
+
+    int64_t bucket_ms_;
+    std::vector<int64_t> epochs_;  // Absolute bucket number each sketch belongs to
+    std::vector<HyperLogLog> sketches_;
+};
+
+#endif // HYPERLOGLOG_H
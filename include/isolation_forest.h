@@ -0,0 +1,105 @@
+#ifndef ISOLATION_FOREST_H
+#define ISOLATION_FOREST_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include "feature_schema.h"
+
+// Isolation forest over dense feature vectors. Anomalies are isolated by
+// fewer random axis-aligned splits than normal points, so the mean path
+// length over many random trees gives a multi-feature anomaly score that
+// needs no distribution assumptions or feature scaling.
+//
+// Trees are stored flattened in implicit heap order (children of node i are
+// 2i+1 and 2i+2), one array for split features and one for thresholds, so
+// scoring a vector is a few dozen predictable array walks with no pointers.
+// Forests are immutable once trained and are shared between threads.
+class IsolationForest {
+public:
+    static constexpr size_t TREES = 64;
+    static constexpr size_t SUBSAMPLE = 64;
+    static constexpr size_t MAX_DEPTH = 6;  // log2(SUBSAMPLE)
+    static constexpr size_t NODES_PER_TREE = (size_t(1) << (MAX_DEPTH + 1)) - 1;
+
+    // samples holds sample_count rows of dims floats
+    IsolationForest(const std::vector<float>& samples, size_t dims, uint64_t seed);
+
+    // 2^(-E[path length] / c(SUBSAMPLE)): near 1 for anomalies, about 0.5 or below for normal points
+    double score(const FeatureVector& observation) const;
+    size_t dims() const { return dims_; }
+
+    // Scores above this are anomalous: a margin above nearly all training scores, never below 0.6
+    double threshold() const { return threshold_; }
+
+private:
+    static constexpr uint16_t LEAF = 0xFFFF;
+
+    // value_of(feature) returns the observation's value for a feature
+    template <typename ValueOf>
+    double scoreWith(ValueOf value_of) const;
+
+    // Average path length of an unsuccessful search in a binary search tree of n points
+    static double averagePathLength(size_t n);
+
+    size_t dims_;
+    double normalizer_;
+    double threshold_;
+    std::vector<uint16_t> split_feature_;  // LEAF marks a leaf
+    std::vector<float> split_value_;       // Threshold, or the path length estimate at a leaf
+};
+
+// Per-user training samples and forests. Each user keeps a ring of recent
+// vectors; a background thread retrains a user's forest once enough new
+// samples have arrived and swaps it in, so scoring never waits on training.
+// Users without a new sample for a day are dropped, like idle feature windows.
+class UserForests {
+public:
+    static constexpr size_t MAX_SAMPLES = 512;        // About eight hours of minute samples
+    static constexpr size_t MIN_TRAINING_SAMPLES = 64;
+    static constexpr size_t RETRAIN_AFTER = 32;       // New samples before a retrain
+
+    UserForests();
+    ~UserForests();
+
+    void addSample(const std::string& user, const FeatureVector& observation);
+
+    // Returns false while the user has no trained forest; threshold is that forest's calibrated threshold
+    bool score(const std::string& user, const FeatureVector& observation, double& result, double& threshold) const;
+
+    // Training rows per user, oldest first, for snapshots
+    std::unordered_map<std::string, std::vector<std::vector<float>>> samples() const;
+    // Replaces a user's rows; a forest is trained from them in the background
+    void restoreSamples(const std::string& user, std::vector<std::vector<float>> rows);
+
+private:
+    struct UserSamples {
+        std::vector<std::vector<float>> rows;  // Ring of MAX_SAMPLES
+        size_t next = 0;
+        size_t since_training = 0;
+        bool training = false;
+        std::shared_ptr<const IsolationForest> forest;
+        std::chrono::steady_clock::time_point last_seen;
+    };
+
+    UserSamples& samplesFor(const std::string& user);
+    void dropIdleUsers();
+
+    void trainingLoop();
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::unordered_map<std::string, UserSamples> users_;
+    bool stopping_;  // Guarded by mutex_ so the training thread cannot miss the wakeup
+    uint64_t seed_;
+    std::thread training_thread_;
+};
+
+#endif // ISOLATION_FOREST_H
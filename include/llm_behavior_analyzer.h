@@ -11,6 +11,11 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "ring_buffer.h"
+#include "llm_http_client.h"
+#include "rate_budget.h"
 
 struct LLMBehaviorInsight {
     std::string user;
@@ -31,21 +36,65 @@ struct UserBehaviorContext {
     std::chrono::system_clock::time_point last_analysis;
 };
 
+// What a context looked like when it was last analyzed: metrics rounded to two
+// significant digits, the activities a prompt shows with numbers masked, and
+// sorted risk indicators. Equal hashes mean a prompt would say the same thing.
+struct ContextFingerprint {
+    uint64_t hash = 0;
+    std::unordered_map<std::string, double> metrics;
+    std::vector<std::string> activities;
+    std::vector<std::string> risk_indicators;
+};
+
+// Ingestion only touches in-memory state under data_mutex_. A scheduler picks
+// which users to analyze, highest risk and stalest first, within each
+// provider's request and token budgets, and packs several users' compact
+// summaries into one prompt whose JSON response is keyed by user. A small
+// worker pool hands the prompts to the asynchronous HTTP client, so a slow or
+// unreachable API never blocks the threads feeding in behavior data, and many
+// users are analyzed concurrently.
 class LLMBehaviorAnalyzer {
 public:
+    static constexpr size_t MAX_ACTIVITIES = 100;  // Per user; the oldest are overwritten
+    static constexpr size_t MAX_INSIGHTS = 1000;
+    static constexpr size_t WORKER_THREADS = 2;
+    static constexpr size_t MAX_CACHED_INSIGHTS = 1024;
+    static constexpr int MAX_RESPONSE_TOKENS = 1000;
+    static constexpr size_t DEFAULT_BATCH_USERS = 8;
+    static constexpr size_t MAX_BATCH_PROMPT_TOKENS = 6000;
+    static constexpr int RESPONSE_TOKENS_PER_USER = 400;
+    static constexpr int MIN_ANALYSIS_INTERVAL = 60;  // seconds, for the riskiest users
+
     LLMBehaviorAnalyzer();
     ~LLMBehaviorAnalyzer();
 
     // Configuration
     void setAPIKey(const std::string& provider, const std::string& api_key);
     void setModel(const std::string& provider, const std::string& model);
+    void setProvider(const std::string& provider);  // "openai", "anthropic", "local"
+    void setEndpoint(const std::string& provider, const std::string& url);
+    void setMaxConcurrentRequests(const std::string& provider, size_t limit);
+    void setRequestTimeout(std::chrono::seconds timeout);
+    void setRateLimits(const std::string& provider, double requests_per_minute, double tokens_per_minute);
+    // Users at zero risk are re-analyzed this often; higher risk shortens it down to MIN_ANALYSIS_INTERVAL
     void setAnalysisInterval(int seconds);
+    // Risk analyses are skipped while a user's context differs from the last analyzed one by
+    // less than threshold (the largest relative metric change or share of changed activities)
+    void setChangeThreshold(double threshold);
+    void setInsightCacheTTL(std::chrono::seconds ttl);
+    // Users per risk analysis request; 1 sends one prompt per user
+    void setBatchSize(size_t users);
     void enableRealTimeAnalysis(bool enable);
 
-    // Analysis methods
+    // Analysis methods. These only mark work for the scheduler.
     void analyzeUserBehavior(const std::string& user_id,
                            const std::vector<std::string>& activities,
                            const std::unordered_map<std::string, double>& metrics);
+    // Replaces the user's recent activities and metrics with a fresh summary
+    void updateUserBehavior(const std::string& user_id,
+                            const std::vector<std::string>& activities,
+                            const std::unordered_map<std::string, double>& metrics,
+                            double risk_score);
     void analyzeRiskPatterns(const std::string& user_id);
     void generateSecurityRecommendations(const std::string& user_id);
 
@@ -63,10 +112,61 @@ public:
     void stopAnalysis();
     bool isRunning() const;
 
+    // One insight per user the response covers; users it left out get none
+    static std::vector<LLMBehaviorInsight> parseLLMResponse(const std::string& response,
+                                                            const std::vector<std::string>& user_ids);
+
 private:
+    enum class JobKind { RiskAnalysis, Recommendations };
+
+    // One provider request covering one or more users
+    struct AnalysisJob {
+        JobKind kind;
+        std::vector<UserBehaviorContext> contexts;  // Snapshots taken when the job was queued
+        std::vector<ContextFingerprint> fingerprints;
+        std::string prompt;
+        int max_tokens;
+    };
+
+    // A provider response, or insights from the cache, waiting for a worker to deliver
+    struct CompletedJob {
+        JobKind kind;
+        std::vector<std::string> user_ids;
+        std::string response;
+        std::vector<ContextFingerprint> fingerprints;
+        std::vector<LLMBehaviorInsight> cached;
+    };
+
+    struct CachedInsight {
+        LLMBehaviorInsight insight;
+        std::chrono::system_clock::time_point expires;
+    };
+
+    // Risk analyses collected by one scheduling pass until they fill a request
+    struct PendingBatch {
+        std::vector<UserBehaviorContext> contexts;
+        std::vector<ContextFingerprint> fingerprints;
+        std::vector<std::string> sections;  // Per-user prompt sections
+        size_t section_chars = 0;
+    };
+
+    struct UserState {
+        RingBuffer<std::string, MAX_ACTIVITIES> activities;
+        std::unordered_map<std::string, double> metrics;
+        std::vector<std::string> risk_indicators;
+        std::chrono::system_clock::time_point last_analysis;
+        double risk_score = 0.0;  // From BehaviorAnalyzer, drives scheduling
+        bool requested = false;   // Risk analysis asked for explicitly
+        bool recommendations_requested = false;
+        bool queued = false;      // A risk analysis job is waiting or running
+        bool analyzed = false;
+        ContextFingerprint fingerprint;  // Of the last successful risk analysis
+    };
+
     // LLM providers
-    std::string analyzeWithOpenAI(const std::string& prompt);
-    std::string analyzeWithAnthropic(const std::string& prompt);
+    HttpRequest openAIRequest(const std::string& prompt, int max_tokens) const;
+    HttpRequest anthropicRequest(const std::string& prompt, int max_tokens) const;
+    std::string responseText(const HttpResponse& response) const;
     std::string analyzeWithLocalModel(const std::string& prompt);
 
     // Analysis methods
@@ -77,17 +177,42 @@ private:
     void generateRecommendations(const std::string& user_id);
 
     // Helper methods
-    std::string buildAnalysisPrompt(const std::string& user_id);
-    std::string formatBehaviorData(const std::string& user_id);
-    LLMBehaviorInsight parseLLMResponse(const std::string& response, const std::string& user_id);
+    std::string buildAnalysisPrompt(const std::vector<std::string>& user_sections);
+    std::string buildRecommendationPrompt(const UserBehaviorContext& context);
+    std::string formatBehaviorData(const UserBehaviorContext& context);
     void storeInsight(const LLMBehaviorInsight& insight);
 
+    // Job queue; the *Locked helpers expect data_mutex_ to be held
+    UserState& stateLocked(const std::string& user_id);
+    UserBehaviorContext snapshotLocked(const std::string& user_id, const UserState& state) const;
+    // False when the provider budget ran out before the work could be queued
+    bool scheduleRiskAnalysisLocked(const std::string& user_id, UserState& state, RateBudget* budget,
+                                    std::chrono::steady_clock::time_point now, PendingBatch& batch);
+    void flushBatchLocked(PendingBatch& batch, RateBudget* budget, std::chrono::steady_clock::time_point now);
+    bool scheduleRecommendationsLocked(const std::string& user_id, UserState& state, RateBudget* budget,
+                                       std::chrono::steady_clock::time_point now);
+    size_t estimateRequestTokens(size_t prompt_chars, int max_tokens) const;
+    void requestScheduling();
+    void queueJob(AnalysisJob job);
+    void processJob(AnalysisJob&& job);
+    void completeJob(CompletedJob&& completed);
+    void cacheInsightLocked(uint64_t hash, const LLMBehaviorInsight& insight);
+
     // Threading and synchronization
     void analysisLoop();
+    void workerLoop();
     std::thread analysis_thread_;
+    std::vector<std::thread> workers_;
     std::atomic<bool> running_;
     std::atomic<bool> real_time_enabled_;
+
+    // Guards user_states_, insight_cache_ and budgets_; never held across a provider call
     std::mutex data_mutex_;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;     // Wakes workers
+    std::condition_variable schedule_cv_;  // Wakes the scheduler for requests and on stop
+    bool schedule_requested_ = false;      // Guarded by queue_mutex_
+    std::mutex insights_mutex_;
 
     // Configuration
     std::string llm_provider_;  // "openai", "anthropic", "local"
@@ -95,15 +220,30 @@ private:
     std::string anthropic_api_key_;
     std::string openai_model_;
     std::string anthropic_model_;
+    std::string openai_url_;
+    std::string anthropic_url_;
+    std::chrono::seconds request_timeout_;
     int analysis_interval_;  // seconds
+    double change_threshold_;
+    std::chrono::seconds cache_ttl_;
+    size_t batch_size_;
 
     // Data storage
-    std::unordered_map<std::string, UserBehaviorContext> user_contexts_;
+    std::unordered_map<std::string, UserState> user_states_;
+    // Insights by context hash, so a context that returns to an earlier state
+    // reuses that analysis instead of paying for another call
+    std::unordered_map<uint64_t, CachedInsight> insight_cache_;
+    std::unordered_map<std::string, RateBudget> budgets_;  // By provider
     std::deque<LLMBehaviorInsight> insights_history_;
     std::function<void(const LLMBehaviorInsight&)> insight_callback_;
 
-    // Analysis queue
-    std::vector<std::string> pending_analyses_;
+    // Analysis queue and finished requests, both drained by the workers. Insight
+    // callbacks may block, so they never run on the HTTP client's thread.
+    std::deque<AnalysisJob> jobs_;
+    std::deque<CompletedJob> completed_;
+
+    // Declared last so it stops before the state its completions touch is destroyed
+    LLMHttpClient http_client_;
 };
 
 #endif // LLM_BEHAVIOR_ANALYZER_H
@@ -0,0 +1,83 @@
+#ifndef LLM_HTTP_CLIENT_H
+#define LLM_HTTP_CLIENT_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+struct HttpRequest {
+    std::string pool;  // Concurrency limits apply per pool, e.g. the provider name
+    std::string url;
+    std::vector<std::string> headers;
+    std::string body;  // Sent as a POST
+    std::chrono::milliseconds timeout{60000};
+};
+
+struct HttpResponse {
+    long status = 0;    // 0 when the transfer itself failed
+    std::string body;
+    std::string error;  // Transfer error, empty on success
+    std::chrono::milliseconds elapsed{0};
+};
+
+// Runs every request on one curl multi handle driven by a single thread.
+// Connections stay in the multi handle's cache between requests, so TLS
+// handshakes are paid once per host, and HTTP/2 is negotiated where the server
+// supports it, letting concurrent requests share one connection. Requests past
+// a pool's concurrency limit wait in that pool's queue.
+class LLMHttpClient {
+public:
+    // Runs on the client thread and must not block
+    using Completion = std::function<void(HttpResponse&&)>;
+
+    static constexpr size_t DEFAULT_CONCURRENCY = 4;
+
+    LLMHttpClient();
+    ~LLMHttpClient();
+
+    void setConcurrencyLimit(const std::string& pool, size_t limit);
+    void setConnectTimeout(std::chrono::milliseconds timeout) { connect_timeout_ms_ = timeout.count(); }
+
+    void start();
+    // Requests still queued or in flight complete with an error
+    void stop();
+
+    void submit(HttpRequest request, Completion done);
+
+private:
+    struct Transfer;
+    struct Pool {
+        size_t limit = DEFAULT_CONCURRENCY;
+        size_t active = 0;
+        std::deque<std::unique_ptr<Transfer>> waiting;
+    };
+
+    void driverLoop();
+    void launchReady();
+    void finish(Transfer* transfer, int result);
+    void cancelAll();
+    void* takeEasyHandle();
+    void wakeUp();
+
+    void* multi_;  // CURLM*, kept opaque so users of this header don't need curl.h
+    std::vector<void*> idle_handles_;
+    long connect_timeout_ms_;
+
+    std::thread driver_;
+    std::atomic<bool> running_;
+
+    // Guards pools_ and submitted_; transfers in flight belong to the driver thread
+    std::mutex mutex_;
+    std::unordered_map<std::string, Pool> pools_;
+    std::vector<std::unique_ptr<Transfer>> submitted_;
+    std::unordered_map<void*, std::unique_ptr<Transfer>> in_flight_;
+};
+
+#endif // LLM_HTTP_CLIENT_H
@@ -0,0 +1,89 @@
+#ifndef METRIC_STORE_H
+#define METRIC_STORE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+struct MetricPoint {
+    int64_t timestamp;  // Seconds since the epoch
+    double value;
+};
+
+// One compressed run of points, Gorilla style. Timestamps are stored as
+// delta-of-deltas in variable-width buckets, so a regular per-minute series
+// costs one bit per timestamp. Values are XORed with their predecessor and
+// only the meaningful bits are kept, reusing the previous leading and
+// trailing zero window when it fits.
+class MetricChunk {
+public:
+    MetricChunk();
+
+    // Points must arrive in increasing timestamp order
+    void append(int64_t timestamp, double value);
+    void decode(std::vector<MetricPoint>& out, int64_t from, int64_t to) const;
+
+    size_t points() const { return points_; }
+    size_t bytes() const { return bits_.capacity(); }
+    int64_t firstTimestamp() const { return first_timestamp_; }
+    int64_t lastTimestamp() const { return last_timestamp_; }
+    void seal() { bits_.shrink_to_fit(); }
+
+private:
+    void writeBits(uint64_t value, unsigned count);
+
+    std::vector<uint8_t> bits_;
+    size_t bit_count_;
+    size_t points_;
+
+    int64_t first_timestamp_;
+    int64_t last_timestamp_;
+    int64_t last_delta_;
+    uint64_t last_value_;
+    unsigned last_leading_;
+    unsigned last_trailing_;
+};
+
+// Per-user, per-metric history of compressed chunks, kept locally so long
+// horizons can be inspected or re-scored without shipping raw data to the
+// backend. Chunks older than the retention period are dropped, and when the
+// store exceeds its byte budget the oldest sealed chunks go first.
+class MetricStore {
+public:
+    static constexpr size_t CHUNK_POINTS = 120;  // Two hours of minute samples
+
+    MetricStore(std::chrono::hours retention, size_t max_bytes);
+
+    void append(const std::string& user, const std::string& metric, std::chrono::system_clock::time_point time,
+                double value);
+
+    // Points with from <= timestamp <= to, oldest first
+    std::vector<MetricPoint> query(const std::string& user, const std::string& metric,
+                                   std::chrono::system_clock::time_point from,
+                                   std::chrono::system_clock::time_point to) const;
+    std::vector<std::string> metrics(const std::string& user) const;
+
+    void enforceRetention(std::chrono::system_clock::time_point now);
+    size_t bytes() const;
+
+private:
+    struct Series {
+        std::deque<MetricChunk> chunks;  // Oldest first; the last one is open
+    };
+
+    bool dropOldestChunk();
+
+    std::chrono::hours retention_;
+    size_t max_bytes_;
+    size_t sealed_bytes_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::unordered_map<std::string, Series>> users_;
+};
+
+#endif // METRIC_STORE_H
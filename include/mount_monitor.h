@@ -0,0 +1,44 @@
+#ifndef MOUNT_MONITOR_H
+#define MOUNT_MONITOR_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct MountInfo {
+    int mount_id;
+    std::string mount_point;
+    std::string fs_type;
+    std::string source;
+    bool removable;  // USB and other hot-pluggable block devices
+    bool network;    // NFS, SMB, SSHFS and similar
+};
+
+// Tracks the mount table through /proc/self/mountinfo. The kernel flags the
+// file with POLLPRI whenever the table changes, so callers poll fd() and call
+// refresh() only when something was actually mounted or unmounted.
+class MountMonitor {
+public:
+    MountMonitor();
+    ~MountMonitor();
+
+    bool open();
+    int fd() const { return fd_; }
+
+    // Re-reads the table and reports mounts added and removed since the last call
+    bool refresh(std::vector<MountInfo>& added, std::vector<MountInfo>& removed);
+    const std::unordered_map<int, MountInfo>& mounts() const { return mounts_; }
+
+    static bool isExternal(const MountInfo& mount) { return mount.removable || mount.network; }
+
+private:
+    bool readMountTable(std::unordered_map<int, MountInfo>& table);
+    static bool parseLine(const std::string& line, MountInfo& mount);
+    static bool isRemovableSource(const std::string& source);
+    static bool isNetworkFilesystem(const std::string& fs_type);
+
+    int fd_;
+    std::unordered_map<int, MountInfo> mounts_;
+};
+
+#endif // MOUNT_MONITOR_H
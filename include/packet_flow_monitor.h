@@ -0,0 +1,94 @@
+#ifndef PACKET_FLOW_MONITOR_H
+#define PACKET_FLOW_MONITOR_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+struct tpacket_block_desc;
+
+struct FlowKey {
+    uint32_t saddr;  // Network byte order
+    uint32_t daddr;  // Network byte order
+    uint16_t sport;
+    uint16_t dport;
+    uint8_t protocol;
+
+    bool operator==(const FlowKey& other) const {
+        return saddr == other.saddr && daddr == other.daddr && sport == other.sport &&
+               dport == other.dport && protocol == other.protocol;
+    }
+};
+
+struct FlowRecord {
+    FlowKey key;
+    uint64_t bytes;
+    uint64_t packets;
+};
+
+// Fixed-size open-addressing table of per 5-tuple byte counters. Memory is
+// allocated once; when probing fails the packet is counted as dropped.
+class FlowTable {
+public:
+    explicit FlowTable(size_t capacity = 16384);
+
+    bool account(const FlowKey& key, uint32_t bytes);
+    void drain(std::vector<FlowRecord>& flows);
+    uint64_t droppedPackets() const { return dropped_packets_; }
+
+private:
+    struct Slot {
+        FlowRecord record;
+        bool used;
+    };
+
+    size_t slotFor(const FlowKey& key) const;
+
+    std::vector<Slot> slots_;
+    size_t mask_;
+    size_t used_count_;
+    uint64_t dropped_packets_;
+};
+
+// Outbound TCP/UDP flow accounting from a memory-mapped TPACKET_V3 ring.
+// A classic BPF filter keeps outgoing IPv4 packets only and truncates each
+// capture to its IP and transport headers, so payload never leaves the kernel.
+class PacketFlowMonitor {
+public:
+    PacketFlowMonitor();
+    ~PacketFlowMonitor();
+
+    bool start(const std::string& interface);  // "any" or empty captures all interfaces
+    void stop();
+    bool isRunning() const { return running_; }
+
+    void setFlushInterval(std::chrono::seconds interval) { flush_interval_ = interval; }
+    void setCallback(std::function<void(const std::vector<FlowRecord>&)> callback);
+
+private:
+    bool attachFilter();
+    bool setupRing();
+    void captureLoop();
+    void processBlock(struct tpacket_block_desc* block);
+    void flush();
+
+    int socket_fd_;
+    uint8_t* ring_;
+    size_t ring_size_;
+    unsigned int block_size_;
+    unsigned int block_count_;
+
+    std::thread capture_thread_;
+    std::atomic<bool> running_;
+    std::chrono::seconds flush_interval_;
+    FlowTable flow_table_;
+    std::vector<FlowRecord> drained_flows_;
+    std::function<void(const std::vector<FlowRecord>&)> callback_;
+};
+
+#endif // PACKET_FLOW_MONITOR_H
@@ -0,0 +1,53 @@
+#ifndef PRINT_SPOOL_MONITOR_H
+#define PRINT_SPOOL_MONITOR_H
+
+#include <string>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+struct PrintJob {
+    int job_id;
+    std::string data_path;  // Spooled document, e.g. /var/spool/cups/d00042-001
+    std::string job_name;   // Usually the document's file name
+    std::string user;
+    std::string printer;
+    std::string format;     // "pdf", "postscript" or "raw"
+    std::string text;       // Text recovered from the document, capped
+    uint64_t size;
+    size_t content_hash;    // Hash of the spooled bytes
+};
+
+// Watches the CUPS spool directory with inotify. Each document file that is
+// closed after writing is read once, its text is recovered from PostScript
+// string literals or PDF content streams, and the job attributes come from
+// the matching IPP control file (c<job-id>).
+class PrintSpoolMonitor {
+public:
+    PrintSpoolMonitor();
+    ~PrintSpoolMonitor();
+
+    void setSpoolDirectory(const std::string& directory) { spool_directory_ = directory; }
+    const std::string& spoolDirectory() const { return spool_directory_; }
+    void setCallback(std::function<void(const PrintJob&)> callback);
+    void setMaxDocumentSize(size_t bytes) { max_document_size_ = bytes; }
+
+    // Blocks until stop(). Returns false when the spool directory cannot be watched.
+    bool run();
+    void stop();
+
+    static std::string extractText(const std::string& data, std::string& format, size_t max_text);
+    static bool parseControlFile(const std::string& path, PrintJob& job);
+
+private:
+    bool loadJob(const std::string& file_name, PrintJob& job);
+
+    std::string spool_directory_;
+    size_t max_document_size_;
+    std::function<void(const PrintJob&)> callback_;
+    std::atomic<bool> stopped_;
+    int wake_pipe_[2];
+};
+
+#endif // PRINT_SPOOL_MONITOR_H
@@ -0,0 +1,60 @@
+#ifndef PROCESS_ATTRIBUTION_H
+#define PROCESS_ATTRIBUTION_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+#include <sys/types.h>
+
+struct ProcessInfo {
+    int pid;
+    uid_t uid;
+    std::string comm;
+    std::string exe_path;
+    std::string user;
+};
+
+// Shared /proc helpers for every component that attributes activity to a process.
+// parseProcPid accepts /proc directory names; readProcessInfo fills owner uid and
+// account name, comm and exe of a live pid (exe stays empty without ptrace access);
+// userName caches uid lookups and falls back to the numeric uid.
+bool parseProcPid(const char* name, int& pid);
+bool readProcessInfo(int pid, ProcessInfo& info);
+std::string userName(uid_t uid);
+
+// Maps socket inodes to the processes that own them by walking /proc/<pid>/fd.
+// Walks are incremental: a lookup miss first scans only pids that appeared since
+// the previous walk, and a full rescan of known pids is rate limited, so the
+// cost stays bounded on hosts with thousands of open descriptors.
+class ProcessAttributionCache {
+public:
+    ProcessAttributionCache();
+
+    bool lookupSocket(uint64_t inode, ProcessInfo& info);
+    bool lookupProcess(int pid, ProcessInfo& info, const std::string& comm_hint = "");
+    void setRescanInterval(std::chrono::milliseconds interval);
+
+private:
+    struct PidEntry {
+        ProcessInfo info;
+        std::vector<uint64_t> sockets;
+        bool sockets_scanned = false;
+    };
+
+    void refreshPidList(bool rescan_known);
+    void scanPidSockets(int pid, PidEntry& entry);
+    void forgetPid(int pid);
+
+    std::mutex mutex_;
+    std::unordered_map<int, PidEntry> pids_;
+    std::unordered_map<uint64_t, int> socket_owners_;
+    std::unordered_set<uint64_t> unresolved_sockets_;
+    std::chrono::steady_clock::time_point last_full_scan_;
+    std::chrono::milliseconds rescan_interval_;
+};
+
+#endif // PROCESS_ATTRIBUTION_H
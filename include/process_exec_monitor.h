@@ -0,0 +1,47 @@
+#ifndef PROCESS_EXEC_MONITOR_H
+#define PROCESS_EXEC_MONITOR_H
+
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <sys/types.h>
+
+struct ProcessExec {
+    int pid;
+    int ppid;
+    uid_t uid;
+    std::string user;
+    std::string comm;
+    std::string exe_path;
+    std::string cmdline;  // Arguments joined with spaces, capped
+    std::chrono::steady_clock::time_point time;
+};
+
+// Reports every execve on the host. The kernel process connector (netlink,
+// needs CAP_NET_ADMIN) delivers exec events as they happen; without it /proc
+// is polled for new pids once a second, which misses short-lived processes.
+class ProcessExecMonitor {
+public:
+    ProcessExecMonitor();
+    ~ProcessExecMonitor();
+
+    void setCallback(std::function<void(const ProcessExec&)> callback);
+
+    // Blocks until stop()
+    void run();
+    void stop();
+
+private:
+    bool runConnector();
+    void runProcPolling();
+    bool loadProcess(int pid, ProcessExec& exec);
+    bool waitForWake(int timeout_ms);
+
+    std::function<void(const ProcessExec&)> callback_;
+    std::atomic<bool> stopped_;
+    int wake_pipe_[2];
+};
+
+#endif // PROCESS_EXEC_MONITOR_H
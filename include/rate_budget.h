@@ -0,0 +1,39 @@
+#ifndef RATE_BUDGET_H
+#define RATE_BUDGET_H
+
+#include <chrono>
+
+// Requests-per-minute and tokens-per-minute allowance for one provider, kept
+// as two token buckets that refill continuously. A request is sent only when
+// both buckets cover it, so bursts are allowed up to one minute's quota and
+// sustained use stays under the provider's limits instead of drawing 429s.
+class RateBudget {
+public:
+    static constexpr double DEFAULT_REQUESTS_PER_MINUTE = 50.0;
+    static constexpr double DEFAULT_TOKENS_PER_MINUTE = 40000.0;
+
+    RateBudget(double requests_per_minute = DEFAULT_REQUESTS_PER_MINUTE,
+               double tokens_per_minute = DEFAULT_TOKENS_PER_MINUTE);
+
+    void setLimits(double requests_per_minute, double tokens_per_minute);
+
+    // Takes one request and tokens if both fit. A request larger than the whole
+    // token allowance is let through once the bucket is full.
+    bool tryAcquire(double tokens, std::chrono::steady_clock::time_point now);
+    // Whether tryAcquire would succeed, without taking anything
+    bool covers(double tokens, std::chrono::steady_clock::time_point now);
+
+    // After a 429 the provider's view of our usage is ahead of ours; start over empty
+    void exhaust(std::chrono::steady_clock::time_point now);
+
+private:
+    void refill(std::chrono::steady_clock::time_point now);
+
+    double requests_per_minute_;
+    double tokens_per_minute_;
+    double requests_;
+    double tokens_;
+    std::chrono::steady_clock::time_point updated_;
+};
+
+#endif // RATE_BUDGET_H
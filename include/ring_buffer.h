@@ -0,0 +1,72 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+// Fixed-capacity FIFO that overwrites its oldest element when full. Storage
+// is inline, so a ring never allocates after construction and its memory is
+// bounded no matter how long the agent runs.
+template <typename T, size_t Capacity>
+class RingBuffer {
+public:
+    static_assert(Capacity > 0, "RingBuffer capacity must be positive");
+
+    // Appends value; returns true when the oldest element was overwritten
+    bool push(T value) {
+        bool overwrote = size_ == Capacity;
+        items_[head_] = std::move(value);
+        head_ = (head_ + 1) % Capacity;
+        if (!overwrote) size_++;
+        return overwrote;
+    }
+
+    // 0 is the oldest element
+    const T& operator[](size_t index) const { return items_[(head_ + Capacity - size_ + index) % Capacity]; }
+    T& operator[](size_t index) { return items_[(head_ + Capacity - size_ + index) % Capacity]; }
+
+    // 0 is the newest element
+    const T& fromNewest(size_t index) const { return items_[(head_ + Capacity - 1 - index) % Capacity]; }
+
+    // The element the next push() overwrites once the ring is full
+    const T& oldest() const { return (*this)[0]; }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == Capacity; }
+    static constexpr size_t capacity() { return Capacity; }
+
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    // Iterates oldest to newest
+    class const_iterator {
+    public:
+        const_iterator(const RingBuffer* ring, size_t index) : ring_(ring), index_(index) {}
+        const T& operator*() const { return (*ring_)[index_]; }
+        const T* operator->() const { return &(*ring_)[index_]; }
+        const_iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+
+    private:
+        const RingBuffer* ring_;
+        size_t index_;
+    };
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+
+private:
+    std::array<T, Capacity> items_{};
+    size_t head_ = 0;  // Slot the next push writes
+    size_t size_ = 0;
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,55 @@
+#ifndef RULE_STATS_H
+#define RULE_STATS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+// Counters for one rule. Scanning threads update them without locking.
+struct RuleCounters {
+    std::string policy;
+    std::string rule;  // "*" for the policy roll-up, "pattern[<n>]" or "keywords"
+    std::atomic<uint64_t> evaluations{0};
+    std::atomic<uint64_t> matches{0};
+    std::atomic<uint64_t> bytes_scanned{0};
+    std::atomic<uint64_t> cpu_ns{0};
+
+    void record(uint64_t bytes, uint64_t cpu, bool matched) {
+        evaluations.fetch_add(1, std::memory_order_relaxed);
+        bytes_scanned.fetch_add(bytes, std::memory_order_relaxed);
+        cpu_ns.fetch_add(cpu, std::memory_order_relaxed);
+        if (matched) matches.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+struct RuleStatsSnapshot {
+    std::string policy;
+    std::string rule;
+    uint64_t evaluations;
+    uint64_t matches;
+    uint64_t bytes_scanned;
+    uint64_t cpu_ns;
+};
+
+// Owns the counters of every rule ever registered. Counters stay valid for
+// the registry's lifetime, so a policy that is removed and added again keeps
+// accumulating into the same entries.
+class RuleStatsRegistry {
+public:
+    RuleCounters* registerRule(const std::string& policy, const std::string& rule);
+    std::vector<RuleStatsSnapshot> snapshot() const;
+
+    // CPU time of the calling thread; unlike wall time it excludes preemption
+    static uint64_t threadCpuTimeNs();
+
+private:
+    mutable std::mutex mutex_;
+    std::deque<RuleCounters> rules_;
+    std::unordered_map<std::string, RuleCounters*> index_;
+};
+
+#endif // RULE_STATS_H
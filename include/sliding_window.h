@@ -0,0 +1,33 @@
+#ifndef SLIDING_WINDOW_H
+#define SLIDING_WINDOW_H
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Sum of values added over the trailing window, kept in a fixed ring of time
+// buckets. Buckets are reused as time advances, so memory is constant and
+// the window slides with bucket granularity.
+class SlidingWindowCounter {
+public:
+    SlidingWindowCounter(std::chrono::seconds window, size_t buckets);
+
+    void add(std::chrono::system_clock::time_point time, double value = 1.0);
+    double sum(std::chrono::system_clock::time_point now) const;
+    std::chrono::seconds window() const { return window_; }
+
+private:
+    struct Bucket {
+        int64_t epoch;  // Absolute bucket number the sum belongs to
+        double sum;
+    };
+
+    int64_t epochOf(std::chrono::system_clock::time_point time) const;
+
+    std::chrono::seconds window_;
+    int64_t bucket_ms_;
+    std::vector<Bucket> buckets_;
+};
+
+#endif // SLIDING_WINDOW_H
@@ -0,0 +1,59 @@
+#ifndef SPACE_SAVING_H
+#define SPACE_SAVING_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// Top-k heavy hitters by weight in a fixed number of counters (the
+// Space-Saving algorithm). A new key takes over the smallest counter and
+// inherits its weight as error, so any key heavier than total/capacity is
+// guaranteed to be tracked and counts are overestimated by at most error.
+class SpaceSaving {
+public:
+    struct Entry {
+        std::string key;
+        double weight;
+        double error;  // Upper bound on the overestimate
+    };
+
+    explicit SpaceSaving(size_t capacity);
+
+    void add(const std::string& key, double weight = 1.0);
+    void clear();
+
+    const std::vector<Entry>& entries() const { return entries_; }
+    double total() const { return total_; }
+
+private:
+    size_t capacity_;
+    double total_;
+    std::vector<Entry> entries_;
+};
+
+// Heavy hitters over the trailing window: a summary for the current window
+// and one for the previous, which are rotated as time advances. Queries
+// combine both, so they cover between one and two windows.
+class SlidingHeavyHitters {
+public:
+    SlidingHeavyHitters(std::chrono::seconds window, size_t capacity);
+
+    void add(std::chrono::system_clock::time_point time, const std::string& key, double weight = 1.0);
+
+    // Heaviest first
+    std::vector<std::pair<std::string, double>> top(std::chrono::system_clock::time_point now, size_t k);
+    double total(std::chrono::system_clock::time_point now);
+
+private:
+    void rotate(std::chrono::system_clock::time_point time);
+
+    int64_t window_ms_;
+    int64_t epoch_;
+    SpaceSaving current_;
+    SpaceSaving previous_;
+};
+
+#endif // SPACE_SAVING_H
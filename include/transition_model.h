@@ -0,0 +1,95 @@
+#ifndef TRANSITION_MODEL_H
+#define TRANSITION_MODEL_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include "count_min_sketch.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+struct SequenceScore {
+    double surprise_bits;               // -log2 P of the newest two transitions
+    double z;                           // Against the user's own surprise history
+    bool anomalous;
+    std::vector<std::string> sequence;  // Oldest first, up to three tokens
+};
+
+// Learns which applications and processes follow each other for every user
+// and scores how surprising the newest steps are. Tokens are free-form
+// ("app:firefox", "exec:tar"). Transition probabilities come from trigram
+// counts, backing off to bigrams for contexts seen too rarely, with additive
+// smoothing over the user's vocabulary.
+//
+// Counts for the most common transitions are exact; once a user's table is
+// full, further transitions are counted in a count-min sketch, so memory per
+// user is fixed while rare transitions, the ones that matter, still get a
+// (never under-) estimated count.
+//
+// The surprise of each 3-token window is compared with the user's own
+// history (exponentially weighted mean and mean absolute deviation), so
+// users who switch between many tools do not constantly alarm.
+class TransitionModel {
+public:
+    static constexpr size_t MAX_USERS = 256;
+
+    TransitionModel();
+
+    // Scores token as the next step in user's sequence, then learns from it.
+    // Returns false when there is nothing to score: a repeated token, the
+    // start of a session, or a user still warming up.
+    bool observe(const std::string& user, const std::string& token, std::chrono::system_clock::time_point now,
+                 SequenceScore& score);
+
+    // Learned counts and surprise history, for snapshots. The last tokens
+    // seen are not kept; a restart starts a new session anyway.
+    void save(SnapshotWriter& writer) const;
+    // All or nothing: false leaves the model untouched
+    bool load(SnapshotReader& reader);
+
+private:
+    // Exact counts for the head of the distribution, a sketch for the tail
+    class CountTable {
+    public:
+        CountTable();
+        void add(uint64_t key);
+        uint32_t count(uint64_t key) const;
+        void save(SnapshotWriter& writer) const;
+        bool load(SnapshotReader& reader);
+
+    private:
+        std::unordered_map<uint64_t, uint32_t> exact_;
+        CountMinSketch tail_;
+    };
+
+    struct UserModel {
+        CountTable transitions;  // Bigram and trigram keys
+        CountTable contexts;     // How often each one- or two-token context was followed by anything
+        std::unordered_set<uint64_t> vocabulary;  // Distinct tokens, capped
+        uint64_t observed = 0;
+
+        std::string previous[2];  // [0] is the newest
+        uint64_t previous_hash[2] = {0, 0};
+        size_t history = 0;       // Valid entries in previous
+        double last_surprise = 0.0;
+        std::chrono::system_clock::time_point last_seen;
+
+        double surprise_mean = 0.0;
+        double surprise_deviation = 0.0;
+        uint64_t windows = 0;
+    };
+
+    UserModel& modelFor(const std::string& user, std::chrono::system_clock::time_point now);
+    double transitionSurprise(const UserModel& model, uint64_t token) const;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, UserModel> users_;
+};
+
+#endif // TRANSITION_MODEL_H
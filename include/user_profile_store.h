@@ -0,0 +1,95 @@
+#ifndef USER_PROFILE_STORE_H
+#define USER_PROFILE_STORE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include "ring_buffer.h"
+
+struct BehaviorPattern {
+    std::string user;
+    std::string pattern_type;  // "normal", "suspicious", "anomalous"
+    double confidence_score;   // 0.0 to 1.0
+    std::string description;
+    std::chrono::system_clock::time_point timestamp;
+};
+
+enum class PatternKind : uint8_t { Normal, Anomalous, Suspicious };
+
+// Position of a pattern in its shard's pattern arena
+struct PatternRef {
+    uint64_t sequence;  // Arena slot is sequence % arena capacity
+    PatternKind kind;   // Kept here so risk counts survive reuse of the arena slot
+};
+
+struct UserProfile {
+    static constexpr size_t MAX_RECENT_PATTERNS = 64;
+    static constexpr size_t RISK_WINDOW = 10;  // Newest patterns the risk score covers
+
+    std::string user_id;
+    std::unordered_map<std::string, double> baseline_metrics;  // Filled on copies from getUserProfile
+    RingBuffer<PatternRef, MAX_RECENT_PATTERNS> recent_patterns;  // Oldest are overwritten
+    double risk_score;  // 0.0 to 1.0
+
+    // Suspicious and anomalous patterns among the newest RISK_WINDOW, updated as patterns arrive
+    int window_suspicious = 0;
+    int window_anomalous = 0;
+};
+
+// User profiles and their recent patterns, safe to use from any thread.
+// Users are spread over a fixed number of shards by name hash; each shard has
+// its own lock, profile map and pattern arena, so threads working on
+// different users rarely contend. Visitors run under the shard lock and must
+// not call back into the store.
+class UserProfileStore {
+public:
+    static constexpr size_t SHARDS = 16;
+
+    // pattern_capacity is split evenly over the shards
+    explicit UserProfileStore(size_t pattern_capacity);
+
+    // Appends pattern to pattern.user's profile, creating the profile if needed.
+    // update, if set, runs on the profile under the same lock.
+    void addPattern(const BehaviorPattern& pattern, const std::function<void(UserProfile&)>& update = nullptr);
+
+    // Replaces a profile; its risk window counts are recomputed
+    void put(const UserProfile& profile);
+    // Runs update on user's profile under its shard lock, creating the profile if needed
+    void updateProfile(const std::string& user, const std::function<void(UserProfile&)>& update);
+
+    bool contains(const std::string& user) const;
+    size_t size() const;
+    std::vector<std::string> users() const;
+
+    // Runs visitor on the profile in place; returns false if the user is unknown
+    bool visitProfile(const std::string& user, const std::function<void(const UserProfile&)>& visitor) const;
+
+    // Newest first, at most limit. Patterns the arena has since reused are skipped.
+    void visitRecentPatterns(const std::string& user, size_t limit,
+                             const std::function<void(const BehaviorPattern&)>& visitor) const;
+
+private:
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, UserProfile> profiles;
+        // Every pattern stored for this shard's users. Slot reuse is detected by sequence number.
+        std::vector<BehaviorPattern> arena;
+        uint64_t next_sequence = 0;
+    };
+
+    Shard& shardFor(const std::string& user);
+    const Shard& shardFor(const std::string& user) const;
+    static const BehaviorPattern* resolve(const Shard& shard, const PatternRef& ref);
+    static void appendToProfile(UserProfile& profile, const PatternRef& ref);
+    static void recountRiskWindow(UserProfile& profile);
+
+    std::array<Shard, SHARDS> shards_;
+};
+
+#endif // USER_PROFILE_STORE_H
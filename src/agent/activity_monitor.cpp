@@ -1,4 +1,5 @@
 #include "activity_monitor.h"
+#include "process_attribution.h"
 #include <iostream>
 #include <chrono>
 #include <thread>
@@ -7,6 +8,7 @@
 #include <libevdev-1.0/libevdev/libevdev.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <cstdlib>
 #include <sstream>
 #include <iomanip>
 
@@ -190,6 +192,13 @@ void ActivityMonitor::monitorWindowFocus() {
             last_window_title = current_window_title;
             last_app_name = current_app_name;
 
+            // Resolved before the event goes out, so the callback sees the new owner
+            std::string owner = getActiveWindowUser();
+            {
+                std::lock_guard<std::mutex> lock(focus_mutex_);
+                focused_window_user_ = owner;
+            }
+
             if (callback_) {
                 auto now = std::chrono::system_clock::now();
                 auto time_t = std::chrono::system_clock::to_time_t(now);
@@ -344,6 +353,39 @@ std::set<std::string> ActivityMonitor::getRunningApplications() {
     return applications;
 }
 
+std::string ActivityMonitor::focusedWindowUser() const {
+    std::lock_guard<std::mutex> lock(focus_mutex_);
+    return focused_window_user_;
+}
+
+std::string ActivityMonitor::getActiveWindowUser() {
+    // The focused window's pid, then the owner of its /proc entry, the same
+    // way launched processes and network activity are attributed
+    std::vector<std::string> commands;
+    if (getenv("SWAYSOCK") != nullptr) {
+        commands.push_back("swaymsg -t get_tree | jq -r '.. | select(.focused? == true).pid' 2>/dev/null");
+    }
+    commands.push_back("xdotool getactivewindow getwindowpid 2>/dev/null");
+
+    for (const auto& cmd : commands) {
+        FILE* fp = popen(cmd.c_str(), "r");
+        if (!fp) continue;
+        char buffer[64];
+        long pid = 0;
+        if (fgets(buffer, sizeof(buffer), fp) != nullptr) {
+            pid = std::strtol(buffer, nullptr, 10);
+        }
+        pclose(fp);
+        if (pid <= 0) continue;
+
+        ProcessInfo info;
+        if (readProcessInfo(static_cast<int>(pid), info)) {
+            return info.user;
+        }
+    }
+    return "";
+}
+
 std::string ActivityMonitor::getActiveApplication() {
     // Get the process name of the active window on Wayland
     // This uses system tools as a fallback
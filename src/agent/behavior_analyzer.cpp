@@ -1,13 +1,30 @@
 #include "behavior_analyzer.h"
 #include "llm_behavior_analyzer.h"
+#include "behavior_snapshot.h"
 #include <iostream>
 #include <algorithm>
 #include <cmath>
 #include <sstream>
 #include <iomanip>
+#include <unordered_set>
+#include <cstring>
+
+namespace {
+    // Robust z-score beyond which an observation counts as anomalous
+    constexpr double ANOMALY_Z_THRESHOLD = 4.0;
+
+    // Split over the profile store's shards; enough for 256 users to keep their full recent-pattern rings
+    constexpr size_t PATTERN_ARENA_CAPACITY = 256 * UserProfile::MAX_RECENT_PATTERNS;
+
+    // A week of minute samples typically compresses to 10-20 KB per feature per user
+    constexpr std::chrono::hours METRIC_HISTORY_RETENTION(24 * 7);
+    constexpr size_t METRIC_HISTORY_MAX_BYTES = 64 * 1024 * 1024;
+}
 
 BehaviorAnalyzer::BehaviorAnalyzer()
-    : llm_enabled_(false),
+    : profiles_(PATTERN_ARENA_CAPACITY),
+      metric_history_(METRIC_HISTORY_RETENTION, METRIC_HISTORY_MAX_BYTES),
+      llm_enabled_(false),
       llm_analyzer_(std::make_unique<LLMBehaviorAnalyzer>()) {
     // Set up LLM insight callback
     llm_analyzer_->setInsightCallback(
@@ -25,48 +42,92 @@ BehaviorAnalyzer::~BehaviorAnalyzer() {
 
 void BehaviorAnalyzer::analyzeActivity(const std::string& user, const std::string& activity_type,
                                      const std::unordered_map<std::string, double>& metrics) {
-    // Detect anomalies
-    detectAnomalies(user, metrics);
+    FeatureVector features;
+    {
+        std::lock_guard<std::mutex> lock(baseline_mutex_);
+        features = feature_schema_.vectorize(metrics);
+    }
+    analyzeActivity(user, activity_type, features);
+}
 
-    // Update baseline metrics
-    updateBaseline(user, metrics);
+void BehaviorAnalyzer::analyzeActivity(const std::string& user, const std::string& activity_type,
+                                     const FeatureVector& features) {
+    auto now = std::chrono::system_clock::now();
+    size_t hour_of_week = FeatureBaselines::hourOfWeek(now);
+
+    // Score against the baseline before this observation joins it
+    BaselineScore anomaly{};
+    bool anomalous;
+    std::string top_feature;
+    {
+        std::lock_guard<std::mutex> lock(baseline_mutex_);
+        anomalous = detectAnomalies(user, features, hour_of_week, anomaly);
+        if (anomalous) {
+            top_feature = feature_schema_.name(anomaly.top_feature);
+        }
+
+        // Update baseline metrics
+        updateBaseline(user, features, hour_of_week);
+
+        for (size_t i = 0; i < features.size(); ++i) {
+            if (features.present[i] > 0.0) {
+                metric_history_.append(user, feature_schema_.name(static_cast<FeatureId>(i)), now,
+                                       features.values[i]);
+            }
+        }
+    }
+
+    // The forest catches combinations of features that are each within their own baseline
+    double isolation = 0.0;
+    double isolation_threshold = 1.0;
+    bool isolated = forests_.score(user, features, isolation, isolation_threshold) &&
+                    isolation > isolation_threshold;
+    forests_.addSample(user, features);
 
     // Create behavior pattern
     BehaviorPattern pattern;
     pattern.user = user;
     pattern.confidence_score = calculateRiskScore(user);
-    pattern.timestamp = std::chrono::system_clock::now();
-
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+    pattern.timestamp = now;
+
+    std::string detail;
+    if (anomalous) {
+        // 0.6 at the threshold, approaching 1.0 as the deviation grows
+        double anomaly_confidence = 1.0 - 0.4 * std::exp(-(anomaly.max_z - ANOMALY_Z_THRESHOLD) / 4.0);
+        pattern.confidence_score = std::max(pattern.confidence_score, anomaly_confidence);
+
+        std::stringstream ss;
+        ss << "; " << top_feature << " z=" << std::fixed
+           << std::setprecision(1) << anomaly.max_z;
+        detail = ss.str();
+    }
+    if (isolated) {
+        // 0.6 at the forest's threshold, 1.0 for a point isolated at the root
+        double isolation_confidence = 0.6 + 0.4 * (isolation - isolation_threshold) / (1.0 - isolation_threshold);
+        pattern.confidence_score = std::max(pattern.confidence_score, isolation_confidence);
+
+        std::stringstream ss;
+        ss << "; isolation score " << std::fixed << std::setprecision(2) << isolation;
+        detail += ss.str();
+    }
 
     if (pattern.confidence_score > 0.7) {
         pattern.pattern_type = "suspicious";
         pattern.description = "Suspicious activity detected: " + activity_type +
-                            " (confidence: " + std::to_string(pattern.confidence_score) + ")";
+                            " (confidence: " + std::to_string(pattern.confidence_score) + detail + ")";
     } else if (pattern.confidence_score > 0.5) {
         pattern.pattern_type = "anomalous";
         pattern.description = "Anomalous behavior detected: " + activity_type +
-                            " (confidence: " + std::to_string(pattern.confidence_score) + ")";
+                            " (confidence: " + std::to_string(pattern.confidence_score) + detail + ")";
     } else {
         pattern.pattern_type = "normal";
         pattern.description = "Normal activity: " + activity_type;
     }
 
-    // Store pattern
-    pattern_history_.push_back(pattern);
-    if (pattern_history_.size() > 1000) {  // Keep last 1000 patterns
-        pattern_history_.pop_front();
-    }
-
-    // Update user profile
-    if (user_profiles_.find(user) == user_profiles_.end()) {
-        user_profiles_[user] = UserProfile{user, {}, {}, 0.0};
-    }
-    user_profiles_[user].recent_patterns.push_back(pattern);
-    user_profiles_[user].risk_score = pattern.confidence_score;
+    // Store pattern and update user profile
+    profiles_.addPattern(pattern, [&pattern](UserProfile& profile) {
+        profile.risk_score = pattern.confidence_score;
+    });
 
     // Trigger callback for anomalies
     if (pattern.pattern_type != "normal" && anomaly_callback_) {
@@ -75,124 +136,368 @@ void BehaviorAnalyzer::analyzeActivity(const std::string& user, const std::strin
 }
 
 void BehaviorAnalyzer::updateUserProfile(const std::string& user, const UserProfile& profile) {
-    user_profiles_[user] = profile;
+    UserProfile stored = profile;
+    stored.user_id = user;
+    profiles_.put(stored);
+
+    std::lock_guard<std::mutex> lock(baseline_mutex_);
+    size_t row = baselineRow(user);
+    for (const auto& [name, value] : profile.baseline_metrics) {
+        baselines_.set(row, feature_schema_.registerFeature(name), value);
+    }
 }
 
 UserProfile BehaviorAnalyzer::getUserProfile(const std::string& user) {
-    if (user_profiles_.find(user) != user_profiles_.end()) {
-        return user_profiles_[user];
+    UserProfile profile{user, {}, {}, 0.0};
+    if (profiles_.visitProfile(user, [&profile](const UserProfile& stored) { profile = stored; })) {
+        std::lock_guard<std::mutex> lock(baseline_mutex_);
+        profile.baseline_metrics = baselineMetrics(user);
     }
-    return UserProfile{user, {}, {}, 0.0};
+    return profile;
+}
+
+double BehaviorAnalyzer::getRiskScore(const std::string& user) const {
+    double risk_score = 0.0;
+    profiles_.visitProfile(user, [&risk_score](const UserProfile& profile) { risk_score = profile.risk_score; });
+    return risk_score;
+}
+
+bool BehaviorAnalyzer::visitUserProfile(const std::string& user,
+                                        const std::function<void(const UserProfile&)>& visitor) const {
+    return profiles_.visitProfile(user, visitor);
 }
 
 std::vector<BehaviorPattern> BehaviorAnalyzer::getRecentPatterns(const std::string& user, int limit) {
     std::vector<BehaviorPattern> user_patterns;
+    if (limit <= 0) return user_patterns;
+
+    user_patterns.reserve(std::min(static_cast<size_t>(limit), UserProfile::MAX_RECENT_PATTERNS));
+    visitRecentPatterns(user, static_cast<size_t>(limit), [&user_patterns](const BehaviorPattern& pattern) {
+        user_patterns.push_back(pattern);
+    });
+    return user_patterns;
+}
+
+void BehaviorAnalyzer::visitRecentPatterns(const std::string& user, size_t limit,
+                                           const std::function<void(const BehaviorPattern&)>& visitor) const {
+    profiles_.visitRecentPatterns(user, limit, visitor);
+}
 
-    for (const auto& pattern : pattern_history_) {
-        if (pattern.user == user) {
-            user_patterns.push_back(pattern);
-            if (user_patterns.size() >= static_cast<size_t>(limit)) {
-                break;
+bool BehaviorAnalyzer::saveSnapshot(const std::string& path) {
+    SnapshotWriter writer;
+
+    std::vector<std::string> users = profiles_.users();
+    size_t features = 0;
+    // Serialize under the lock, but keep disk I/O and fsync out of it
+    {
+        std::lock_guard<std::mutex> lock(baseline_mutex_);
+        std::unordered_set<std::string> known(users.begin(), users.end());
+        for (const auto& entry : baseline_rows_) {
+            if (known.insert(entry.first).second) {
+                users.push_back(entry.first);
+            }
+        }
+
+        features = baselines_.features();
+        writer.put<uint32_t>(static_cast<uint32_t>(features));
+        for (size_t i = 0; i < features; ++i) {
+            writer.putString(feature_schema_.name(static_cast<FeatureId>(i)));
+        }
+
+        writer.put<uint32_t>(static_cast<uint32_t>(users.size()));
+        for (const auto& user : users) {
+            double risk_score = 0.0;
+            std::vector<BehaviorPattern> copies;
+            profiles_.visitProfile(user, [&risk_score](const UserProfile& profile) { risk_score = profile.risk_score; });
+            profiles_.visitRecentPatterns(user, UserProfile::MAX_RECENT_PATTERNS,
+                                          [&copies](const BehaviorPattern& pattern) { copies.push_back(pattern); });
+
+            writer.putString(user);
+            writer.put<double>(risk_score);
+
+            // Oldest first, so replaying them rebuilds the ring in order
+            writer.put<uint32_t>(static_cast<uint32_t>(copies.size()));
+            for (auto it = copies.rbegin(); it != copies.rend(); ++it) {
+                writer.putString(it->pattern_type);
+                writer.put<double>(it->confidence_score);
+                writer.put<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        it->timestamp.time_since_epoch()).count());
+                writer.putString(it->description);
+            }
+
+            auto row = baseline_rows_.find(user);
+            writer.put<uint8_t>(row != baseline_rows_.end() ? 1 : 0);
+            if (row != baseline_rows_.end()) {
+                baselines_.exportRow(row->second, writer.buffer());
             }
         }
     }
 
-    return user_patterns;
-}
+    // Isolation forest training rows, indexed like the feature names above, so
+    // forests retrain as soon as they are restored instead of after another hour
+    auto samples = forests_.samples();
+    writer.put<uint32_t>(static_cast<uint32_t>(samples.size()));
+    for (const auto& [user, rows] : samples) {
+        writer.putString(user);
+        writer.put<uint32_t>(static_cast<uint32_t>(rows.size()));
+        for (const auto& row : rows) {
+            // Features registered after the names were written are left out
+            size_t width = std::min(row.size(), features);
+            writer.put<uint32_t>(static_cast<uint32_t>(width));
+            writer.buffer().append(reinterpret_cast<const char*>(row.data()), width * sizeof(float));
+        }
+    }
 
-void BehaviorAnalyzer::setAnomalyCallback(std::function<void(const BehaviorPattern&)> callback) {
-    anomaly_callback_ = callback;
+    transitions_.save(writer);
+
+    if (!writeSnapshotFile(path, writer.buffer())) {
+        std::cerr << "Failed to write behavior snapshot " << path << std::endl;
+        return false;
+    }
+    return true;
 }
 
-void BehaviorAnalyzer::detectAnomalies(const std::string& user,
-                                      const std::unordered_map<std::string, double>& current_metrics) {
-    if (user_profiles_.find(user) == user_profiles_.end()) {
-        return;  // No baseline to compare against
+bool BehaviorAnalyzer::loadSnapshot(const std::string& path) {
+    MappedSnapshot snapshot(path);
+    if (!snapshot.valid()) {
+        std::cerr << "Behavior snapshot " << path << " not restored: " << snapshot.error() << std::endl;
+        return false;
     }
 
-    const auto& baseline = user_profiles_[user].baseline_metrics;
+    struct RestoredUser {
+        std::string name;
+        double risk_score;
+        std::vector<BehaviorPattern> patterns;
+        const unsigned char* baseline;  // Points into the mapping
+    };
+
+    // Parse everything first so a malformed snapshot leaves the analyzer untouched
+    SnapshotReader reader = snapshot.reader();
+    std::vector<std::string> feature_names(reader.get<uint32_t>());
+    for (auto& name : feature_names) {
+        name = reader.getString();
+    }
+    size_t row_bytes = FeatureBaselines::rowBytes(feature_names.size());
+
+    std::vector<RestoredUser> users;
+    uint32_t user_count = reader.get<uint32_t>();
+    for (uint32_t u = 0; u < user_count && reader.ok(); ++u) {
+        RestoredUser user{reader.getString(), reader.get<double>(), {}, nullptr};
+        uint32_t pattern_count = reader.get<uint32_t>();
+        for (uint32_t p = 0; p < pattern_count && reader.ok(); ++p) {
+            BehaviorPattern pattern;
+            pattern.user = user.name;
+            pattern.pattern_type = reader.getString();
+            pattern.confidence_score = reader.get<double>();
+            pattern.timestamp = std::chrono::system_clock::time_point(std::chrono::milliseconds(reader.get<int64_t>()));
+            pattern.description = reader.getString();
+            user.patterns.push_back(std::move(pattern));
+        }
+        if (reader.get<uint8_t>()) {
+            user.baseline = reader.take(row_bytes);
+        }
+        users.push_back(std::move(user));
+    }
 
-    if (isAnomalous(current_metrics, baseline)) {
-        // Anomaly detected - this will be handled in analyzeActivity
+    std::vector<std::pair<std::string, std::vector<std::vector<float>>>> samples;
+    uint32_t sample_users = reader.get<uint32_t>();
+    for (uint32_t u = 0; u < sample_users && reader.ok(); ++u) {
+        samples.emplace_back(reader.getString(), std::vector<std::vector<float>>());
+        auto& rows = samples.back().second;
+        uint32_t row_count = reader.get<uint32_t>();
+        for (uint32_t r = 0; r < row_count && reader.ok(); ++r) {
+            std::vector<float> row(std::min<size_t>(reader.get<uint32_t>(), feature_names.size()));
+            if (const unsigned char* bytes = reader.take(row.size() * sizeof(float))) {
+                std::memcpy(row.data(), bytes, row.size() * sizeof(float));
+            }
+            rows.push_back(std::move(row));
+        }
     }
-}
 
-void BehaviorAnalyzer::updateBaseline(const std::string& user,
-                                    const std::unordered_map<std::string, double>& metrics) {
-    if (user_profiles_.find(user) == user_profiles_.end()) {
-        user_profiles_[user] = UserProfile{user, metrics, {}, 0.0};
-        return;
+    // Last, because it applies itself once it has parsed cleanly
+    if (!reader.ok() || !transitions_.load(reader)) {
+        std::cerr << "Behavior snapshot " << path << " not restored: malformed payload" << std::endl;
+        return false;
     }
 
-    auto& profile = user_profiles_[user];
-    auto& baseline = profile.baseline_metrics;
+    {
+        std::lock_guard<std::mutex> lock(baseline_mutex_);
+        std::vector<FeatureId> ids;
+        ids.reserve(feature_names.size());
+        for (const auto& name : feature_names) {
+            ids.push_back(feature_schema_.registerFeature(name));
+        }
+        for (const auto& user : users) {
+            if (user.baseline) {
+                baselines_.importRow(baselineRow(user.name), user.baseline, ids);
+            }
+        }
 
-    // Simple exponential moving average for baseline update
-    const double alpha = 0.1;  // Learning rate
+        // Training rows move to this run's feature ids
+        size_t dims = ids.empty() ? 0 : *std::max_element(ids.begin(), ids.end()) + 1;
+        for (auto& [user, rows] : samples) {
+            for (auto& row : rows) {
+                std::vector<float> remapped(dims, 0.0f);
+                for (size_t i = 0; i < row.size(); ++i) {
+                    remapped[ids[i]] = row[i];
+                }
+                row = std::move(remapped);
+            }
+            forests_.restoreSamples(user, std::move(rows));
+        }
+    }
 
-    for (const auto& [key, value] : metrics) {
-        if (baseline.find(key) == baseline.end()) {
-            baseline[key] = value;
-        } else {
-            baseline[key] = alpha * value + (1 - alpha) * baseline[key];
+    for (const auto& user : users) {
+        for (const auto& pattern : user.patterns) {
+            profiles_.addPattern(pattern);
         }
+        double risk_score = user.risk_score;
+        profiles_.updateProfile(user.name, [risk_score](UserProfile& profile) { profile.risk_score = risk_score; });
     }
+
+    std::cout << "Restored behavior baselines for " << users.size() << " users from " << path << std::endl;
+    return true;
 }
 
-double BehaviorAnalyzer::calculateRiskScore(const std::string& user) {
-    if (user_profiles_.find(user) == user_profiles_.end()) {
-        return 0.0;
+void BehaviorAnalyzer::setAnomalyCallback(std::function<void(const BehaviorPattern&)> callback) {
+    anomaly_callback_ = callback;
+}
+
+std::vector<MetricPoint> BehaviorAnalyzer::getMetricHistory(const std::string& user, const std::string& metric,
+                                                           std::chrono::system_clock::time_point from,
+                                                           std::chrono::system_clock::time_point to) const {
+    return metric_history_.query(user, metric, from, to);
+}
+
+std::vector<std::string> BehaviorAnalyzer::getMetricNames(const std::string& user) const {
+    return metric_history_.metrics(user);
+}
+
+void BehaviorAnalyzer::pruneMetricHistory(std::chrono::system_clock::time_point now) {
+    metric_history_.enforceRetention(now);
+}
+
+void BehaviorAnalyzer::analyzeTransition(const std::string& user, const std::string& token) {
+    auto now = std::chrono::system_clock::now();
+    SequenceScore sequence;
+    if (!transitions_.observe(user, token, now, sequence) || !sequence.anomalous) {
+        return;
     }
 
-    const auto& profile = user_profiles_[user];
-    double risk_score = 0.0;
+    BehaviorPattern pattern;
+    pattern.user = user;
+    pattern.timestamp = now;
+    // Same mapping as baseline z-scores: 0.6 at the threshold, approaching 1.0
+    pattern.confidence_score = 1.0 - 0.4 * std::exp(-(sequence.z - ANOMALY_Z_THRESHOLD) / 4.0);
+    pattern.pattern_type = pattern.confidence_score > 0.7 ? "suspicious" : "anomalous";
+
+    std::stringstream ss;
+    ss << "Unusual application sequence: ";
+    for (size_t i = 0; i < sequence.sequence.size(); ++i) {
+        if (i > 0) ss << " -> ";
+        ss << sequence.sequence[i];
+    }
+    ss << " (" << std::fixed << std::setprecision(1) << sequence.surprise_bits << " bits, z=" << sequence.z << ")";
+    pattern.description = ss.str();
 
-    // Calculate risk based on recent patterns
-    int suspicious_count = 0;
-    int anomalous_count = 0;
-    int total_recent = 0;
+    profiles_.addPattern(pattern, [&pattern](UserProfile& profile) {
+        profile.risk_score = std::max(profile.risk_score, pattern.confidence_score);
+    });
+
+    if (anomaly_callback_) {
+        anomaly_callback_(pattern);
+    }
+}
 
-    for (const auto& pattern : profile.recent_patterns) {
-        if (++total_recent > 10) break;  // Last 10 patterns
+void BehaviorAnalyzer::recordCorrelatedSequence(const CorrelationMatch& match) {
+    BehaviorPattern pattern;
+    pattern.user = match.user.empty() ? "current_user" : match.user;
+    pattern.pattern_type = "suspicious";
+    pattern.confidence_score = match.confidence;
+    pattern.timestamp = std::chrono::system_clock::now();
 
-        if (pattern.pattern_type == "suspicious") {
-            suspicious_count++;
-        } else if (pattern.pattern_type == "anomalous") {
-            anomalous_count++;
+    pattern.description = "Correlated sequence " + match.rule + ": " + match.description + " (";
+    for (size_t i = 0; i < match.events.size(); ++i) {
+        const auto& event = match.events[i];
+        if (i > 0) pattern.description += " -> ";
+        pattern.description += event.type;
+        if (!event.process.empty()) {
+            pattern.description += " " + event.process.substr(event.process.find_last_of('/') + 1);
+        }
+        if (!event.path.empty()) {
+            pattern.description += " " + event.path;
         }
     }
+    pattern.description += ")";
 
-    if (total_recent > 0) {
-        risk_score = (suspicious_count * 0.8 + anomalous_count * 0.4) / total_recent;
+    profiles_.addPattern(pattern, [&match](UserProfile& profile) {
+        profile.risk_score = std::max(profile.risk_score, match.confidence);
+    });
+
+    if (anomaly_callback_) {
+        anomaly_callback_(pattern);
     }
+}
 
-    return std::min(risk_score, 1.0);
+bool BehaviorAnalyzer::detectAnomalies(const std::string& user, const FeatureVector& current,
+                                       size_t hour_of_week, BaselineScore& score) {
+    auto row = baseline_rows_.find(user);
+    if (row == baseline_rows_.end()) {
+        return false;  // No baseline to compare against
+    }
+
+    return isAnomalous(row->second, current, hour_of_week, score, ANOMALY_Z_THRESHOLD);
 }
 
-bool BehaviorAnalyzer::isAnomalous(const std::unordered_map<std::string, double>& current,
-                                  const std::unordered_map<std::string, double>& baseline,
-                                  double threshold) {
-    if (baseline.empty()) return false;
+void BehaviorAnalyzer::updateBaseline(const std::string& user, const FeatureVector& features,
+                                      size_t hour_of_week) {
+    // Exponentially weighted mean and variance, about the last 50 observations
+    const double alpha = 0.02;  // Learning rate
+    baselines_.update(baselineRow(user), features, hour_of_week, alpha);
+}
 
-    double total_deviation = 0.0;
-    int metrics_count = 0;
+size_t BehaviorAnalyzer::baselineRow(const std::string& user) {
+    auto it = baseline_rows_.find(user);
+    if (it != baseline_rows_.end()) return it->second;
 
-    for (const auto& [key, current_value] : current) {
-        auto baseline_it = baseline.find(key);
-        if (baseline_it != baseline.end()) {
-            double baseline_value = baseline_it->second;
-            if (baseline_value != 0) {
-                double deviation = std::abs(current_value - baseline_value) / baseline_value;
-                total_deviation += deviation;
-                metrics_count++;
-            }
+    size_t row = baselines_.addRow();
+    baseline_rows_.emplace(user, row);
+    return row;
+}
+
+std::unordered_map<std::string, double> BehaviorAnalyzer::baselineMetrics(const std::string& user) const {
+    std::unordered_map<std::string, double> metrics;
+    auto it = baseline_rows_.find(user);
+    if (it == baseline_rows_.end()) return metrics;
+
+    const double* means = baselines_.means(it->second);
+    const double* counts = baselines_.counts(it->second);
+    for (size_t i = 0; i < baselines_.features(); ++i) {
+        if (counts[i] != 0.0) {
+            metrics[feature_schema_.name(static_cast<FeatureId>(i))] = means[i];
         }
     }
+    return metrics;
+}
 
-    if (metrics_count == 0) return false;
+double BehaviorAnalyzer::calculateRiskScore(const std::string& user) const {
+    double risk_score = 0.0;
+
+    // Calculate risk based on the newest patterns, counted as they were stored
+    profiles_.visitProfile(user, [&risk_score](const UserProfile& profile) {
+        size_t total_recent = std::min(profile.recent_patterns.size(), UserProfile::RISK_WINDOW);
+        if (total_recent > 0) {
+            risk_score = (profile.window_suspicious * 0.8 + profile.window_anomalous * 0.4) / total_recent;
+        }
+    });
 
-    double average_deviation = total_deviation / metrics_count;
-    return average_deviation > threshold;
+    return std::min(risk_score, 1.0);
+}
+
+bool BehaviorAnalyzer::isAnomalous(size_t baseline_row, const FeatureVector& current, size_t hour_of_week,
+                                   BaselineScore& score, double threshold) {
+    if (!baselines_.score(baseline_row, current, hour_of_week, score)) return false;
+    return score.max_z > threshold;
 }
 
 // LLM Integration Methods
@@ -206,8 +511,9 @@ void BehaviorAnalyzer::enableLLMAnalysis(bool enable) {
 }
 
 void BehaviorAnalyzer::setLLMProvider(const std::string& provider) {
-    // This would be stored and used when initializing the LLM analyzer
-    // For now, we'll assume it's set directly on the analyzer
+    if (llm_analyzer_) {
+        llm_analyzer_->setProvider(provider);
+    }
 }
 
 void BehaviorAnalyzer::setLLMAPIKey(const std::string& provider, const std::string& api_key) {
@@ -222,6 +528,37 @@ void BehaviorAnalyzer::setLLMModel(const std::string& provider, const std::strin
     }
 }
 
+void BehaviorAnalyzer::setLLMEndpoint(const std::string& provider, const std::string& url) {
+    if (llm_analyzer_) {
+        llm_analyzer_->setEndpoint(provider, url);
+    }
+}
+
+void BehaviorAnalyzer::setLLMMaxConcurrentRequests(const std::string& provider, size_t limit) {
+    if (llm_analyzer_) {
+        llm_analyzer_->setMaxConcurrentRequests(provider, limit);
+    }
+}
+
+void BehaviorAnalyzer::setLLMRequestTimeout(std::chrono::seconds timeout) {
+    if (llm_analyzer_) {
+        llm_analyzer_->setRequestTimeout(timeout);
+    }
+}
+
+void BehaviorAnalyzer::setLLMRateLimits(const std::string& provider, double requests_per_minute,
+                                        double tokens_per_minute) {
+    if (llm_analyzer_) {
+        llm_analyzer_->setRateLimits(provider, requests_per_minute, tokens_per_minute);
+    }
+}
+
+void BehaviorAnalyzer::setLLMBatchSize(size_t users) {
+    if (llm_analyzer_) {
+        llm_analyzer_->setBatchSize(users);
+    }
+}
+
 void BehaviorAnalyzer::startLLMAnalysis() {
     if (llm_enabled_ && llm_analyzer_ && !llm_analyzer_->isRunning()) {
         llm_analyzer_->startAnalysis();
@@ -240,17 +577,22 @@ void BehaviorAnalyzer::requestLLMAnalysis(const std::string& user) {
     }
 
     // Get user context and send to LLM analyzer
-    if (user_profiles_.find(user) != user_profiles_.end()) {
-        const auto& profile = user_profiles_[user];
-
-        // Convert behavior patterns to activity strings
+    if (profiles_.contains(user)) {
+        // Convert behavior patterns to activity strings, oldest first
         std::vector<std::string> activities;
-        for (const auto& pattern : profile.recent_patterns) {
+        visitRecentPatterns(user, UserProfile::MAX_RECENT_PATTERNS, [&activities](const BehaviorPattern& pattern) {
             activities.push_back(pattern.description);
+        });
+        std::reverse(activities.begin(), activities.end());
+
+        std::unordered_map<std::string, double> metrics;
+        {
+            std::lock_guard<std::mutex> lock(baseline_mutex_);
+            metrics = baselineMetrics(user);
         }
 
         // Send to LLM analyzer
-        llm_analyzer_->analyzeUserBehavior(user, activities, profile.baseline_metrics);
+        llm_analyzer_->updateUserBehavior(user, activities, metrics, getRiskScore(user));
     }
 }
 
@@ -282,20 +624,10 @@ void BehaviorAnalyzer::handleLLMInsight(const LLMBehaviorInsight& insight) {
     pattern.description = "[" + insight.insight_type + "] " + insight.description +
                         " (LLM confidence: " + std::to_string(insight.confidence_score) + ")";
 
-    // Store the pattern
-    pattern_history_.push_back(pattern);
-    if (pattern_history_.size() > 1000) {
-        pattern_history_.pop_front();
-    }
-
-    // Update user profile
-    if (user_profiles_.find(insight.user) != user_profiles_.end()) {
-        user_profiles_[insight.user].recent_patterns.push_back(pattern);
-        user_profiles_[insight.user].risk_score = std::max(
-            user_profiles_[insight.user].risk_score,
-            insight.confidence_score
-        );
-    }
+    // Store the pattern and update the user profile
+    profiles_.addPattern(pattern, [&insight](UserProfile& profile) {
+        profile.risk_score = std::max(profile.risk_score, insight.confidence_score);
+    });
 
     // Trigger callback if this is an anomaly
     if (pattern.pattern_type != "normal" && anomaly_callback_) {
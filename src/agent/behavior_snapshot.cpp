@@ -0,0 +1,132 @@
+#include "behavior_snapshot.h"
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr uint32_t SNAPSHOT_MAGIC = 0x53424d57;  // "WMBS"
+
+    struct SnapshotHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t payload_size;
+        uint32_t payload_crc;
+        uint32_t reserved;
+    };
+
+    std::array<uint32_t, 256> makeCrcTable() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }
+
+    bool writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+}
+
+uint32_t snapshotCrc32(const unsigned char* data, size_t size) {
+    static const std::array<uint32_t, 256> table = makeCrcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+bool writeSnapshotFile(const std::string& path, const std::string& payload) {
+    SnapshotHeader header{SNAPSHOT_MAGIC, SNAPSHOT_FORMAT_VERSION, payload.size(),
+                          snapshotCrc32(reinterpret_cast<const unsigned char*>(payload.data()), payload.size()), 0};
+
+    std::string temp_path = path + ".tmp";
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+
+    bool ok = writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) &&
+              writeAll(fd, payload.data(), payload.size()) &&
+              fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+
+    if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    // Make the rename itself durable
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    int dir_fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return true;
+}
+
+MappedSnapshot::MappedSnapshot(const std::string& path)
+    : mapping_(nullptr), mapping_size_(0), payload_(nullptr), payload_size_(0) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error_ = errno == ENOENT ? "no snapshot" : "cannot open snapshot";
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        error_ = "snapshot is truncated";
+        return;
+    }
+
+    mapping_size_ = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping_size_ = 0;
+        error_ = "cannot map snapshot";
+        return;
+    }
+    mapping_ = mapping;
+    madvise(mapping_, mapping_size_, MADV_SEQUENTIAL);
+
+    SnapshotHeader header;
+    std::memcpy(&header, mapping_, sizeof(header));
+    const unsigned char* payload = static_cast<const unsigned char*>(mapping_) + sizeof(header);
+
+    if (header.magic != SNAPSHOT_MAGIC) {
+        error_ = "not a behavior snapshot";
+    } else if (header.version != SNAPSHOT_FORMAT_VERSION) {
+        error_ = "unsupported snapshot version " + std::to_string(header.version);
+    } else if (header.payload_size != mapping_size_ - sizeof(header)) {
+        error_ = "snapshot is truncated";
+    } else if (snapshotCrc32(payload, header.payload_size) != header.payload_crc) {
+        error_ = "snapshot checksum mismatch";
+    } else {
+        payload_ = payload;
+        payload_size_ = header.payload_size;
+    }
+}
+
+MappedSnapshot::~MappedSnapshot() {
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+    }
+}
@@ -0,0 +1,486 @@
+#include "clipboard_monitor.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_WAYLAND_DATA_CONTROL
+#include <wayland-client.h>
+#include "ext-data-control-v1-client-protocol.h"
+#endif
+
+#ifdef HAVE_X11_CLIPBOARD
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/Xfixes.h>
+#endif
+
+namespace {
+    // A selection owner that stops writing is abandoned after this long
+    constexpr int TRANSFER_TIMEOUT_MS = 2000;
+
+    int remainingMs(std::chrono::steady_clock::time_point deadline) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        return remaining > 0 ? static_cast<int>(remaining) : 0;
+    }
+}
+
+#ifdef HAVE_WAYLAND_DATA_CONTROL
+namespace {
+    struct WaylandState {
+        struct wl_seat* seat = nullptr;
+        struct ext_data_control_manager_v1* manager = nullptr;
+        std::unordered_map<struct ext_data_control_offer_v1*, std::vector<std::string>> offers;
+        struct ext_data_control_offer_v1* selection = nullptr;
+        struct ext_data_control_offer_v1* primary = nullptr;
+        bool selection_changed = false;
+        bool primary_changed = false;
+        bool finished = false;
+    };
+
+    void onOfferMimeType(void* data, struct ext_data_control_offer_v1* offer, const char* mime_type) {
+        static_cast<WaylandState*>(data)->offers[offer].push_back(mime_type);
+    }
+
+    const struct ext_data_control_offer_v1_listener offer_listener = {
+        onOfferMimeType
+    };
+
+    void onDataOffer(void* data, struct ext_data_control_device_v1*, struct ext_data_control_offer_v1* offer) {
+        auto* state = static_cast<WaylandState*>(data);
+        state->offers[offer];
+        ext_data_control_offer_v1_add_listener(offer, &offer_listener, state);
+    }
+
+    // The previous offer for a selection is dead once a new one replaces it
+    void replaceOffer(WaylandState* state, struct ext_data_control_offer_v1*& current,
+                      struct ext_data_control_offer_v1* offer) {
+        if (current && current != offer) {
+            state->offers.erase(current);
+            ext_data_control_offer_v1_destroy(current);
+        }
+        current = offer;
+    }
+
+    void onSelection(void* data, struct ext_data_control_device_v1*, struct ext_data_control_offer_v1* offer) {
+        auto* state = static_cast<WaylandState*>(data);
+        replaceOffer(state, state->selection, offer);
+        state->selection_changed = true;
+    }
+
+    void onFinished(void* data, struct ext_data_control_device_v1*) {
+        static_cast<WaylandState*>(data)->finished = true;
+    }
+
+    void onPrimarySelection(void* data, struct ext_data_control_device_v1*, struct ext_data_control_offer_v1* offer) {
+        auto* state = static_cast<WaylandState*>(data);
+        replaceOffer(state, state->primary, offer);
+        state->primary_changed = true;
+    }
+
+    const struct ext_data_control_device_v1_listener device_listener = {
+        onDataOffer,
+        onSelection,
+        onFinished,
+        onPrimarySelection
+    };
+
+    void onRegistryGlobal(void* data, struct wl_registry* registry, uint32_t name,
+                          const char* interface, uint32_t) {
+        auto* state = static_cast<WaylandState*>(data);
+        if (!state->seat && strcmp(interface, wl_seat_interface.name) == 0) {
+            state->seat = static_cast<struct wl_seat*>(
+                wl_registry_bind(registry, name, &wl_seat_interface, 1));
+        } else if (!state->manager && strcmp(interface, ext_data_control_manager_v1_interface.name) == 0) {
+            state->manager = static_cast<struct ext_data_control_manager_v1*>(
+                wl_registry_bind(registry, name, &ext_data_control_manager_v1_interface, 1));
+        }
+    }
+
+    void onRegistryGlobalRemove(void*, struct wl_registry*, uint32_t) {}
+
+    const struct wl_registry_listener registry_listener = {
+        onRegistryGlobal,
+        onRegistryGlobalRemove
+    };
+
+    std::string pickTextMimeType(const std::vector<std::string>& mime_types) {
+        static const char* preferred[] = {
+            "text/plain;charset=utf-8", "UTF8_STRING", "text/plain", "STRING", "TEXT"
+        };
+        for (const char* wanted : preferred) {
+            for (const auto& mime_type : mime_types) {
+                if (mime_type == wanted) return mime_type;
+            }
+        }
+        return "";
+    }
+
+    // Reads a transfer pipe until EOF, the size cap, or the source stalls
+    bool readPipe(int fd, size_t max_size, std::string& content, bool& truncated) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TRANSFER_TIMEOUT_MS);
+        char buffer[8192];
+        content.clear();
+        truncated = false;
+
+        while (true) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, remainingMs(deadline));
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0) return !content.empty();
+
+            ssize_t len = read(fd, buffer, sizeof(buffer));
+            if (len < 0 && errno == EINTR) continue;
+            if (len <= 0) return len == 0;
+
+            size_t room = max_size - content.size();
+            if (static_cast<size_t>(len) > room) {
+                content.append(buffer, room);
+                truncated = true;
+                return true;
+            }
+            content.append(buffer, static_cast<size_t>(len));
+        }
+    }
+}
+#endif
+
+#ifdef HAVE_X11_CLIPBOARD
+namespace {
+    struct X11Context {
+        Display* display;
+        Window window;
+        Atom utf8_string;
+        Atom incr;
+        Atom property;
+    };
+
+    // Xlib's default handler exits the process on any protocol error
+    int ignoreXError(Display*, XErrorEvent*) {
+        return 0;
+    }
+
+    bool waitForWindowEvent(const X11Context& ctx, int type, XEvent& event) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TRANSFER_TIMEOUT_MS);
+        while (true) {
+            if (XCheckTypedWindowEvent(ctx.display, ctx.window, type, &event)) return true;
+
+            int timeout = remainingMs(deadline);
+            if (timeout == 0) return false;
+            struct pollfd pfd = {ConnectionNumber(ctx.display), POLLIN, 0};
+            poll(&pfd, 1, timeout);
+        }
+    }
+
+    // Fetches and deletes the transfer property; only 8-bit text formats are accepted
+    bool takeProperty(const X11Context& ctx, size_t max_size, Atom& type, std::string& chunk, bool& truncated) {
+        int format = 0;
+        unsigned long items = 0;
+        unsigned long bytes_after = 0;
+        unsigned char* data = nullptr;
+        long max_words = static_cast<long>((max_size + 3) / 4);
+
+        if (XGetWindowProperty(ctx.display, ctx.window, ctx.property, 0, max_words, False,
+                               AnyPropertyType, &type, &format, &items, &bytes_after, &data) != Success) {
+            return false;
+        }
+        XDeleteProperty(ctx.display, ctx.window, ctx.property);
+
+        chunk.clear();
+        if (data && format == 8) {
+            chunk.assign(reinterpret_cast<const char*>(data), items);
+        }
+        truncated = bytes_after > 0 || chunk.size() > max_size;
+        if (chunk.size() > max_size) chunk.resize(max_size);
+        if (data) XFree(data);
+        return format == 8 || type == ctx.incr || items == 0;
+    }
+
+    // Large selections arrive in chunks, each announced with PropertyNotify
+    bool readIncremental(const X11Context& ctx, size_t max_size, std::string& content, bool& truncated) {
+        content.clear();
+        truncated = false;
+
+        while (true) {
+            XEvent event;
+            do {
+                if (!waitForWindowEvent(ctx, PropertyNotify, event)) return !content.empty();
+            } while (event.xproperty.atom != ctx.property || event.xproperty.state != PropertyNewValue);
+
+            Atom type;
+            std::string chunk;
+            bool chunk_truncated = false;
+            if (!takeProperty(ctx, max_size - content.size(), type, chunk, chunk_truncated)) return false;
+            if (chunk.empty()) return true;
+
+            content += chunk;
+            if (chunk_truncated || content.size() >= max_size) {
+                // Stop acknowledging chunks; the owner abandons the transfer
+                content.resize(std::min(content.size(), max_size));
+                truncated = true;
+                return true;
+            }
+        }
+    }
+
+    bool readSelection(const X11Context& ctx, Atom selection, Time time, size_t max_size,
+                       std::string& content, bool& truncated) {
+        for (Atom target : {ctx.utf8_string, static_cast<Atom>(XA_STRING)}) {
+            XDeleteProperty(ctx.display, ctx.window, ctx.property);
+            XConvertSelection(ctx.display, selection, target, ctx.property, ctx.window, time);
+
+            XEvent event;
+            if (!waitForWindowEvent(ctx, SelectionNotify, event)) return false;
+            if (event.xselection.property == None) continue;  // Owner refused this target
+
+            Atom type;
+            if (!takeProperty(ctx, max_size, type, content, truncated)) return false;
+            if (type == ctx.incr) {
+                return readIncremental(ctx, max_size, content, truncated);
+            }
+            return true;
+        }
+        return false;
+    }
+}
+#endif
+
+ClipboardMonitor::ClipboardMonitor()
+    : max_content_size_(256 * 1024), stopped_(false) {
+    if (pipe2(wake_pipe_, O_CLOEXEC | O_NONBLOCK) < 0) {
+        wake_pipe_[0] = wake_pipe_[1] = -1;
+    }
+}
+
+ClipboardMonitor::~ClipboardMonitor() {
+    if (wake_pipe_[0] >= 0) close(wake_pipe_[0]);
+    if (wake_pipe_[1] >= 0) close(wake_pipe_[1]);
+}
+
+void ClipboardMonitor::setCallback(std::function<void(const ClipboardChange&)> callback) {
+    callback_ = callback;
+}
+
+bool ClipboardMonitor::waylandSupported() {
+#ifdef HAVE_WAYLAND_DATA_CONTROL
+    return std::getenv("WAYLAND_DISPLAY") != nullptr;
+#else
+    return false;
+#endif
+}
+
+bool ClipboardMonitor::x11Supported() {
+#ifdef HAVE_X11_CLIPBOARD
+    return std::getenv("DISPLAY") != nullptr;
+#else
+    return false;
+#endif
+}
+
+bool ClipboardMonitor::run() {
+    if (stopped_) return true;
+
+    // Compositors without data-control still mirror the clipboard to XWayland
+    if (waylandSupported() && runWayland()) return true;
+    if (x11Supported() && runX11()) return true;
+    return false;
+}
+
+void ClipboardMonitor::stop() {
+    stopped_ = true;
+    if (wake_pipe_[1] >= 0) {
+        ssize_t written = write(wake_pipe_[1], "x", 1);
+        (void)written;
+    }
+}
+
+void ClipboardMonitor::report(const std::string& selection, const std::string& backend,
+                              std::string content, bool truncated) {
+    size_t hash = std::hash<std::string>{}(content);
+    auto it = last_hashes_.find(selection);
+    if (it != last_hashes_.end() && it->second == hash) {
+        return;  // Same text copied again, or ownership moved without a change
+    }
+    last_hashes_[selection] = hash;
+
+    if (callback_) {
+        callback_(ClipboardChange{selection, backend, std::move(content), truncated});
+    }
+}
+
+bool ClipboardMonitor::runWayland() {
+#ifdef HAVE_WAYLAND_DATA_CONTROL
+    struct wl_display* display = wl_display_connect(nullptr);
+    if (!display) return false;
+
+    WaylandState state;
+    struct wl_registry* registry = wl_display_get_registry(display);
+    wl_registry_add_listener(registry, &registry_listener, &state);
+    wl_display_roundtrip(display);
+
+    if (!state.seat || !state.manager) {
+        std::cerr << "Wayland compositor does not offer ext-data-control" << std::endl;
+        if (state.seat) wl_seat_destroy(state.seat);
+        if (state.manager) ext_data_control_manager_v1_destroy(state.manager);
+        wl_registry_destroy(registry);
+        wl_display_disconnect(display);
+        return false;
+    }
+
+    struct ext_data_control_device_v1* device =
+        ext_data_control_manager_v1_get_data_device(state.manager, state.seat);
+    ext_data_control_device_v1_add_listener(device, &device_listener, &state);
+    std::cout << "Clipboard monitoring started (Wayland data-control)" << std::endl;
+
+    auto readOffer = [&](struct ext_data_control_offer_v1* offer, const std::string& selection) {
+        if (!offer) {
+            forget(selection);
+            return;
+        }
+        std::string mime_type = pickTextMimeType(state.offers[offer]);
+        if (mime_type.empty()) return;  // Images and other binary formats are not scanned
+
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) < 0) return;
+        ext_data_control_offer_v1_receive(offer, mime_type.c_str(), fds[1]);
+        close(fds[1]);
+        wl_display_flush(display);
+
+        std::string content;
+        bool truncated = false;
+        if (readPipe(fds[0], max_content_size_, content, truncated)) {
+            report(selection, "wayland", std::move(content), truncated);
+        }
+        close(fds[0]);
+    };
+
+    int display_fd = wl_display_get_fd(display);
+    while (!stopped_ && !state.finished) {
+        if (state.selection_changed) {
+            state.selection_changed = false;
+            readOffer(state.selection, "CLIPBOARD");
+        }
+        if (state.primary_changed) {
+            state.primary_changed = false;
+            readOffer(state.primary, "PRIMARY");
+        }
+
+        while (wl_display_prepare_read(display) != 0) {
+            wl_display_dispatch_pending(display);
+        }
+        wl_display_flush(display);
+
+        struct pollfd fds[2] = {{display_fd, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+        int ready = poll(fds, 2, -1);
+        if (ready < 0) {
+            wl_display_cancel_read(display);
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            wl_display_cancel_read(display);
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            if (wl_display_read_events(display) < 0) break;
+        } else {
+            wl_display_cancel_read(display);
+            if (fds[0].revents & (POLLERR | POLLHUP)) break;
+        }
+        if (wl_display_dispatch_pending(display) < 0) break;
+    }
+
+    for (auto& [offer, mime_types] : state.offers) {
+        ext_data_control_offer_v1_destroy(offer);
+    }
+    ext_data_control_device_v1_destroy(device);
+    ext_data_control_manager_v1_destroy(state.manager);
+    wl_seat_destroy(state.seat);
+    wl_registry_destroy(registry);
+    wl_display_disconnect(display);
+    std::cout << "Clipboard monitoring stopped (Wayland data-control)" << std::endl;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ClipboardMonitor::runX11() {
+#ifdef HAVE_X11_CLIPBOARD
+    Display* display = XOpenDisplay(nullptr);
+    if (!display) return false;
+
+    int event_base = 0;
+    int error_base = 0;
+    if (!XFixesQueryExtension(display, &event_base, &error_base)) {
+        std::cerr << "X server does not support XFixes" << std::endl;
+        XCloseDisplay(display);
+        return false;
+    }
+    XSetErrorHandler(ignoreXError);
+
+    // An unmapped window receives the converted selection contents
+    Window root = DefaultRootWindow(display);
+    X11Context ctx{
+        display,
+        XCreateSimpleWindow(display, root, 0, 0, 1, 1, 0, 0, 0),
+        XInternAtom(display, "UTF8_STRING", False),
+        XInternAtom(display, "INCR", False),
+        XInternAtom(display, "WM_AGENT_SELECTION", False)
+    };
+    XSelectInput(display, ctx.window, PropertyChangeMask);
+
+    Atom clipboard = XInternAtom(display, "CLIPBOARD", False);
+    const unsigned long notify_mask = XFixesSetSelectionOwnerNotifyMask |
+                                      XFixesSelectionWindowDestroyNotifyMask |
+                                      XFixesSelectionClientCloseNotifyMask;
+    XFixesSelectSelectionInput(display, root, clipboard, notify_mask);
+    XFixesSelectSelectionInput(display, root, XA_PRIMARY, notify_mask);
+    XFlush(display);
+    std::cout << "Clipboard monitoring started (XFixes)" << std::endl;
+
+    int display_fd = ConnectionNumber(display);
+    while (!stopped_) {
+        if (XPending(display) == 0) {
+            struct pollfd fds[2] = {{display_fd, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+            int ready = poll(fds, 2, -1);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready < 0 || (fds[1].revents & POLLIN)) break;
+            if (fds[0].revents & (POLLERR | POLLHUP)) break;
+            continue;
+        }
+
+        XEvent event;
+        XNextEvent(display, &event);
+        if (event.type != event_base + XFixesSelectionNotify) continue;
+
+        auto* notify = reinterpret_cast<XFixesSelectionNotifyEvent*>(&event);
+        std::string selection = notify->selection == clipboard ? "CLIPBOARD" : "PRIMARY";
+        if (notify->subtype != XFixesSetSelectionOwnerNotify || notify->owner == None) {
+            forget(selection);
+            continue;
+        }
+
+        std::string content;
+        bool truncated = false;
+        if (readSelection(ctx, notify->selection, notify->selection_timestamp,
+                          max_content_size_, content, truncated)) {
+            report(selection, "x11", std::move(content), truncated);
+        }
+    }
+
+    XDestroyWindow(display, ctx.window);
+    XCloseDisplay(display);
+    std::cout << "Clipboard monitoring stopped (XFixes)" << std::endl;
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,253 @@
+#include "correlation_engine.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+    // Host-wide key for events the producer could not attribute to a user or process
+    const std::string UNATTRIBUTED_KEY;
+
+    std::string baseName(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    bool endsWithIgnoreCase(const std::string& value, const std::string& suffix) {
+        if (suffix.size() > value.size()) return false;
+        return std::equal(suffix.rbegin(), suffix.rend(), value.rbegin(), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        });
+    }
+}
+
+CorrelationEngine::CorrelationEngine()
+    : max_keys_per_rule_(1024), last_expiry_(std::chrono::steady_clock::now()) {}
+
+void CorrelationEngine::addRule(const CorrelationRule& rule) {
+    if (rule.steps.empty()) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& state : rules_) {
+        if (state.rule.name == rule.name) {
+            state.rule = rule;
+            state.keys.clear();
+            return;
+        }
+    }
+    rules_.push_back(RuleState{rule, {}});
+}
+
+void CorrelationEngine::removeRule(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rules_.erase(std::remove_if(rules_.begin(), rules_.end(),
+                                [&name](const RuleState& state) { return state.rule.name == name; }),
+                 rules_.end());
+}
+
+void CorrelationEngine::setMatchCallback(std::function<void(const CorrelationMatch&)> callback) {
+    callback_ = callback;
+}
+
+void CorrelationEngine::ingest(const CorrelationEvent& event) {
+    CorrelationEvent timed = event;
+    if (timed.time == std::chrono::steady_clock::time_point()) {
+        timed.time = std::chrono::steady_clock::now();
+    }
+
+    std::vector<CorrelationMatch> matches;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        bool expire_now = timed.time - last_expiry_ >= std::chrono::seconds(1);
+        if (expire_now) last_expiry_ = timed.time;
+
+        for (auto& state : rules_) {
+            if (expire_now) expire(state, timed.time);
+
+            bool relevant = false;
+            for (const auto& step : state.rule.steps) {
+                if (stepMatches(step, timed)) {
+                    relevant = true;
+                    break;
+                }
+            }
+            if (!relevant) continue;
+
+            std::string key;
+            if (state.rule.key_by == CorrelationRule::KeyBy::User) {
+                key = timed.user;
+            } else if (timed.pid > 0) {
+                key = std::to_string(timed.pid);
+            }
+            advance(state, key, timed, matches);
+        }
+    }
+
+    // Callbacks run without the lock so they may feed events back in
+    if (callback_) {
+        for (const auto& match : matches) {
+            callback_(match);
+        }
+    }
+}
+
+bool CorrelationEngine::stepMatches(const CorrelationStep& step, const CorrelationEvent& event) {
+    if (!step.event_types.empty() &&
+        std::find(step.event_types.begin(), step.event_types.end(), event.type) == step.event_types.end()) {
+        return false;
+    }
+
+    if (!step.processes.empty()) {
+        std::string process = baseName(event.process);
+        if (std::find(step.processes.begin(), step.processes.end(), process) == step.processes.end()) {
+            return false;
+        }
+    }
+
+    if (!step.path_suffixes.empty()) {
+        bool suffix_matched = false;
+        for (const auto& suffix : step.path_suffixes) {
+            if (endsWithIgnoreCase(event.path, suffix)) {
+                suffix_matched = true;
+                break;
+            }
+        }
+        if (!suffix_matched) return false;
+    }
+
+    return true;
+}
+
+void CorrelationEngine::advance(RuleState& state, const std::string& key, const CorrelationEvent& event,
+                                std::vector<CorrelationMatch>& matches) {
+    const auto& steps = state.rule.steps;
+    const size_t last = steps.size() - 1;
+
+    KeyState& own = keyState(state, key, event.time);
+    KeyState* shared = nullptr;
+    if (!key.empty()) {
+        auto it = state.keys.find(UNATTRIBUTED_KEY);
+        if (it != state.keys.end()) shared = &it->second;
+    }
+
+    auto within_window = [&](const Partial& partial) {
+        return partial.active && event.time - partial.started <= state.rule.window;
+    };
+
+    // Walk from the last step down so one event never advances the same partial twice
+    for (size_t step = last; step > 0; --step) {
+        if (!stepMatches(steps[step], event)) continue;
+
+        Partial* from = within_window(own.partials[step - 1]) ? &own.partials[step - 1] : nullptr;
+        if (shared && within_window(shared->partials[step - 1]) &&
+            (!from || shared->partials[step - 1].started > from->started)) {
+            from = &shared->partials[step - 1];
+        }
+        if (!from) continue;
+
+        if (step == last) {
+            CorrelationMatch match;
+            match.rule = state.rule.name;
+            match.description = state.rule.description;
+            match.key = key;
+            match.user = event.user;
+            match.confidence = state.rule.confidence;
+            match.events = from->events;
+            match.events.push_back(event);
+            matches.push_back(std::move(match));
+
+            // Report a sequence once rather than again for each later transfer
+            from->active = false;
+            for (auto& partial : own.partials) partial.active = false;
+            return;
+        }
+
+        Partial& to = own.partials[step];
+        if (!to.active || to.started <= from->started) {
+            std::vector<CorrelationEvent> events = from->events;
+            events.push_back(event);
+            to.started = from->started;
+            to.events = std::move(events);
+            to.active = true;
+        }
+    }
+
+    if (stepMatches(steps[0], event)) {
+        if (last == 0) {
+            matches.push_back(CorrelationMatch{state.rule.name, state.rule.description, key,
+                                               event.user, state.rule.confidence, {event}});
+            return;
+        }
+        Partial& first = own.partials[0];
+        first.active = true;
+        first.started = event.time;
+        first.events.assign(1, event);
+    }
+}
+
+CorrelationEngine::KeyState& CorrelationEngine::keyState(RuleState& state, const std::string& key,
+                                                         std::chrono::steady_clock::time_point now) {
+    auto it = state.keys.find(key);
+    if (it == state.keys.end()) {
+        if (state.keys.size() >= max_keys_per_rule_) {
+            // Evict the key that has been idle the longest. The unattributed key is
+            // exempt: its partials are shared by every pid-less event (see advance).
+            auto oldest = state.keys.end();
+            for (auto candidate = state.keys.begin(); candidate != state.keys.end(); ++candidate) {
+                if (candidate->first == UNATTRIBUTED_KEY) continue;
+                if (oldest == state.keys.end() || candidate->second.last_seen < oldest->second.last_seen) {
+                    oldest = candidate;
+                }
+            }
+            if (oldest != state.keys.end()) {
+                state.keys.erase(oldest);
+            }
+        }
+        it = state.keys.emplace(key, KeyState{}).first;
+        it->second.partials.resize(state.rule.steps.size());
+    }
+    it->second.last_seen = now;
+    return it->second;
+}
+
+void CorrelationEngine::expire(RuleState& state, std::chrono::steady_clock::time_point now) {
+    for (auto it = state.keys.begin(); it != state.keys.end();) {
+        bool any_active = false;
+        for (auto& partial : it->second.partials) {
+            if (partial.active && now - partial.started > state.rule.window) {
+                partial.active = false;
+                partial.events.clear();
+            }
+            any_active = any_active || partial.active;
+        }
+
+        if (!any_active && now - it->second.last_seen > state.rule.window) {
+            it = state.keys.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+CorrelationRule CorrelationEngine::exfiltrationSequenceRule() {
+    CorrelationRule rule;
+    rule.name = "sensitive_archive_transfer";
+    rule.description = "Sensitive file accessed, archived and sent off the host";
+    rule.window = std::chrono::minutes(5);
+    rule.key_by = CorrelationRule::KeyBy::User;
+    rule.confidence = 0.9;
+
+    rule.steps.push_back(CorrelationStep{"sensitive_file", {"file_access"}, {}, {}});
+    rule.steps.push_back(CorrelationStep{
+        "archive",
+        {"process_exec"},
+        {"tar", "zip", "7z", "7za", "7zr", "rar", "gzip", "bzip2", "xz", "zstd"},
+        {}
+    });
+    rule.steps.push_back(CorrelationStep{
+        "transfer",
+        {"process_exec", "suspicious_process", "network_transfer", "restricted_destination", "transfer_blocked"},
+        {"scp", "sftp", "rsync", "curl", "wget", "ftp", "nc", "netcat", "rclone"},
+        {}
+    });
+    return rule;
+}
@@ -0,0 +1,42 @@
+#include "count_min_sketch.h"
+#include <algorithm>
+#include <limits>
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth)
+    : width_(std::max<size_t>(width, 1)),
+      depth_(std::max<size_t>(depth, 1)),
+      total_(0),
+      counters_(width_ * depth_, 0) {}
+
+size_t CountMinSketch::slot(uint64_t key, size_t row) const {
+    return row * width_ + static_cast<size_t>(mixHash(key + row * 0x9e3779b97f4a7c15ULL) % width_);
+}
+
+void CountMinSketch::add(uint64_t key, uint32_t count) {
+    constexpr uint32_t MAX = std::numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < depth_; ++row) {
+        uint32_t& counter = counters_[slot(key, row)];
+        counter = counter > MAX - count ? MAX : counter + count;
+    }
+    total_ += count;
+}
+
+uint32_t CountMinSketch::estimate(uint64_t key) const {
+    uint32_t smallest = std::numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < depth_; ++row) {
+        smallest = std::min(smallest, counters_[slot(key, row)]);
+    }
+    return smallest;
+}
+
+bool CountMinSketch::restore(const std::vector<uint32_t>& counters, uint64_t total) {
+    if (counters.size() != counters_.size()) return false;
+    counters_ = counters;
+    total_ = total;
+    return true;
+}
+
+void CountMinSketch::clear() {
+    std::fill(counters_.begin(), counters_.end(), 0);
+    total_ = 0;
+}
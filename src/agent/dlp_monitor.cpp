@@ -7,9 +7,12 @@
 #include <sstream>
 #include <iomanip>
 #include <sys/inotify.h>
+#include <poll.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <cstring>
+#include <cstdlib>
+#include <cstdio>
 #include <arpa/inet.h>
 #include <algorithm>
 
@@ -21,7 +24,64 @@
 
 namespace fs = std::filesystem;
 
-DLPMonitor::DLPMonitor() : running_(false) {}
+namespace {
+    // Processes that can move data off the host; enforcement only ever denies these
+    const std::vector<std::string> TRANSFER_TOOLS = {
+        "scp", "rsync", "ftp", "sftp", "wget", "curl", "nc", "netcat", "ssh"
+    };
+
+    // Content beyond this is not read when classifying a file for enforcement
+    constexpr size_t MAX_ENFORCEMENT_SCAN_BYTES = 1024 * 1024;
+
+    // Reprinted documents reuse their verdict instead of being scanned again
+    constexpr size_t MAX_PRINT_VERDICTS = 256;
+
+    struct LocalSocket {
+        uint32_t local_addr;   // Network byte order, as in FlowKey
+        uint32_t remote_addr;  // Zero for unconnected sockets
+        uint16_t remote_port;
+        uint64_t inode;
+    };
+
+    // Reads /proc/net/tcp or /proc/net/udp into IPv4 sockets keyed by local port.
+    // Addresses are printed as the raw 32-bit value, ports in host byte order.
+    std::unordered_multimap<uint16_t, LocalSocket> readSocketTable(const char* path) {
+        std::unordered_multimap<uint16_t, LocalSocket> sockets;
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);  // Header
+
+        while (std::getline(file, line)) {
+            unsigned int local_addr, local_port, remote_addr, remote_port, state;
+            unsigned long long inode;
+            // sl local rem st tx_queue:rx_queue tr:tm->when retrnsmt uid timeout inode
+            if (sscanf(line.c_str(), " %*d: %8X:%4X %8X:%4X %2X %*x:%*x %*x:%*x %*x %*u %*u %llu",
+                       &local_addr, &local_port, &remote_addr, &remote_port, &state, &inode) != 6) {
+                continue;
+            }
+            if (inode == 0) continue;
+            sockets.emplace(static_cast<uint16_t>(local_port),
+                            LocalSocket{local_addr, remote_addr, static_cast<uint16_t>(remote_port), inode});
+        }
+        return sockets;
+    }
+
+    // Prefers the connected socket for the exact flow, then a socket bound to
+    // the local port with no peer (unconnected UDP)
+    uint64_t findFlowSocket(const std::unordered_multimap<uint16_t, LocalSocket>& sockets, const FlowKey& key) {
+        uint64_t unconnected = 0;
+        auto range = sockets.equal_range(key.sport);
+        for (auto it = range.first; it != range.second; ++it) {
+            const LocalSocket& socket = it->second;
+            if (socket.local_addr != 0 && socket.local_addr != key.saddr) continue;
+            if (socket.remote_addr == key.daddr && socket.remote_port == key.dport) return socket.inode;
+            if (socket.remote_addr == 0 && unconnected == 0) unconnected = socket.inode;
+        }
+        return unconnected;
+    }
+}
+
+DLPMonitor::DLPMonitor() : running_(false), enforcement_enabled_(false), policy_version_(0) {}
 
 DLPMonitor::~DLPMonitor() {
     stopMonitoring();
@@ -29,100 +89,300 @@ DLPMonitor::~DLPMonitor() {
 
 void DLPMonitor::addPolicy(const DLPPolicy& policy) {
     policies_.push_back(policy);
+
+    PolicyRuleStats stats;
+    stats.policy = rule_stats_.registerRule(policy.name, "*");
+    for (size_t i = 0; i < policy.content_patterns.size(); ++i) {
+        stats.patterns.push_back(rule_stats_.registerRule(policy.name, "pattern[" + std::to_string(i) + "]"));
+    }
+    stats.keywords = rule_stats_.registerRule(policy.name, "keywords");
+    policy_rule_stats_.push_back(std::move(stats));
+
     // Update monitored paths
     for (const auto& path : policy.restricted_paths) {
         monitored_paths_.insert(path);
     }
+    if (!policy.restricted_domains.empty()) {
+        domain_matchers_[policy.name] = DomainSuffixMatcher(policy.restricted_domains);
+    }
+    policy_version_++;
+    enforcer_.invalidate();
 }
 
 void DLPMonitor::removePolicy(const std::string& policy_name) {
-    policies_.erase(
-        std::remove_if(policies_.begin(), policies_.end(),
-            [&policy_name](const DLPPolicy& p) { return p.name == policy_name; }),
-        policies_.end()
-    );
+    // Rule statistics are kept in step with policies_ by index
+    for (size_t i = policies_.size(); i-- > 0;) {
+        if (policies_[i].name == policy_name) {
+            policies_.erase(policies_.begin() + static_cast<std::ptrdiff_t>(i));
+            policy_rule_stats_.erase(policy_rule_stats_.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+    }
+    domain_matchers_.erase(policy_name);
+    policy_version_++;
+    enforcer_.invalidate();
 }
 
 void DLPMonitor::startMonitoring() {
     if (running_) return;
     running_ = true;
 
+    // Hostname policies need DNS answers to map destination IPs back to names
+    if (!domain_matchers_.empty()) {
+        dns_observer_.start();
+    }
+
+    if (enforcement_enabled_) {
+        startEnforcement();
+    }
+
     // Start monitoring threads
     std::thread(&DLPMonitor::monitorFileSystem, this).detach();
     std::thread(&DLPMonitor::monitorClipboard, this).detach();
+    std::thread(&DLPMonitor::monitorPrintSpool, this).detach();
     std::thread(&DLPMonitor::monitorNetworkTransfers, this).detach();
 }
 
 void DLPMonitor::stopMonitoring() {
     running_ = false;
+    clipboard_monitor_.stop();
+    print_monitor_.stop();
+    dns_observer_.stop();
+    flow_monitor_.stop();
+
+    if (enforcer_.isRunning()) {
+        enforcer_.stop();
+        FanotifyStats stats = enforcer_.stats();
+        std::cout << "Enforcement summary: " << stats.events << " decisions, "
+                  << stats.fast_allows << " fast allows, " << stats.cache_hits << " cache hits, "
+                  << stats.classified << " classified, " << stats.timeouts << " budget timeouts, "
+                  << stats.denials << " denials (" << stats.unreported_denials << " unreported), avg "
+                  << (stats.events ? stats.total_latency_ns / stats.events / 1000 : 0) << "us, max "
+                  << stats.max_latency_ns / 1000 << "us" << std::endl;
+    }
 }
 
 void DLPMonitor::setCallback(std::function<void(const DLPEvent&)> callback) {
     callback_ = callback;
 }
 
+void DLPMonitor::setObservationCallback(std::function<void(const DataObservation&)> callback) {
+    observation_callback_ = callback;
+}
+
+void DLPMonitor::setCaptureInterface(const std::string& interface) {
+    capture_interface_ = interface;
+}
+
+void DLPMonitor::setPrintSpoolDirectory(const std::string& directory) {
+    print_monitor_.setSpoolDirectory(directory);
+}
+
+void DLPMonitor::setEnforcement(bool enabled, std::chrono::microseconds latency_budget) {
+    enforcement_enabled_ = enabled;
+    enforcer_.setLatencyBudget(latency_budget);
+}
+
+void DLPMonitor::startEnforcement() {
+    std::vector<std::string> paths;
+    for (const auto& policy : policies_) {
+        if (!policy.block_transfer) continue;
+        for (const auto& path : policy.restricted_paths) {
+            if (std::find(paths.begin(), paths.end(), path) == paths.end()) {
+                paths.push_back(path);
+            }
+        }
+    }
+    if (paths.empty()) return;
+
+    enforcer_.setRestrictedProcesses(TRANSFER_TOOLS);
+    enforcer_.setClassifier([this](int fd, const std::string& path) {
+        return classifyForEnforcement(fd, path);
+    });
+    enforcer_.setDenialCallback([this](const AccessDenial& denial) {
+        reportBlockedAccess(denial);
+    });
+
+    if (!enforcer_.start(paths)) {
+        std::cerr << "Transfer blocking unavailable (fanotify needs CAP_SYS_ADMIN), continuing in alert-only mode" << std::endl;
+    }
+}
+
+AccessVerdict DLPMonitor::classifyForEnforcement(int fd, const std::string& path) {
+    // Restricted paths scope enforcement; extensions and the policy's own content
+    // patterns decide sensitivity. The keyword fallback only ever alerts.
+    thread_local std::vector<char> buffer(MAX_ENFORCEMENT_SCAN_BYTES);
+    ssize_t len = -1;  // Content is read once, by the first in-scope policy with patterns
+    std::string lower_content;
+
+    for (size_t i = 0; i < policies_.size(); ++i) {
+        const DLPPolicy& policy = policies_[i];
+        if (!policy.block_transfer) continue;
+
+        bool in_scope = policy.restricted_paths.empty();
+        for (const auto& restricted : policy.restricted_paths) {
+            if (path.compare(0, restricted.size(), restricted) == 0) {
+                in_scope = true;
+                break;
+            }
+        }
+        if (!in_scope) continue;
+
+        for (const auto& ext : policy.file_extensions) {
+            if (path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0) {
+                return AccessVerdict{true, policy.name};
+            }
+        }
+
+        if (policy.content_patterns.empty()) continue;
+        if (len < 0) {
+            len = std::max<ssize_t>(pread(fd, buffer.data(), buffer.size(), 0), 0);
+        }
+        if (len > 0 && scanPolicy(i, std::string_view(buffer.data(), static_cast<size_t>(len)), path,
+                                  false, lower_content)) {
+            return AccessVerdict{true, policy.name};
+        }
+    }
+    return AccessVerdict{false, ""};
+}
+
+void DLPMonitor::reportBlockedAccess(const AccessDenial& denial) {
+    std::cout << "DLP blocked " << denial.comm << " (pid " << denial.pid << ") from reading " << denial.path << std::endl;
+    if (!callback_) return;
+
+    auto now = std::chrono::system_clock::now();
+    auto time_t = std::chrono::system_clock::to_time_t(now);
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+
+    DLPEvent dlp_event{
+        ss.str(),
+        "transfer_blocked",
+        denial.path,
+        denial.comm,
+        "current_user",
+        "Blocked " + denial.comm + " from reading sensitive file (" + denial.policy + ")",
+        true
+    };
+    ProcessInfo process;
+    if (process_cache_.lookupProcess(denial.pid, process, denial.comm)) {
+        attachProcessInfo(dlp_event, process);
+    } else {
+        dlp_event.pid = denial.pid;
+    }
+    callback_(dlp_event);
+}
+
 void DLPMonitor::monitorFileSystem() {
-    int inotify_fd = inotify_init();
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     if (inotify_fd < 0) {
         std::cerr << "Failed to initialize inotify" << std::endl;
         return;
     }
 
     // Map watch descriptors to paths for proper path reconstruction
-    std::unordered_map<int, std::string> wd_to_path;
+    std::unordered_map<int, WatchTarget> watches;
 
     // Add watches for monitored paths
     for (const auto& path : monitored_paths_) {
         int wd = inotify_add_watch(inotify_fd, path.c_str(),
             IN_CREATE | IN_MODIFY | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE);
         if (wd >= 0) {
-            wd_to_path[wd] = path;
+            watches[wd] = WatchTarget{path, "", ""};
             std::cout << "Monitoring path: " << path << " (wd: " << wd << ")" << std::endl;
         } else {
             std::cerr << "Failed to watch path: " << path << " (errno: " << errno << ")" << std::endl;
         }
     }
 
-    if (wd_to_path.empty()) {
+    // Removable drives and network shares get watches of their own as they are mounted
+    {
+        std::lock_guard<std::mutex> lock(mount_walk_mutex_);
+        mount_walks_.clear();
+        walked_watches_.clear();
+    }
+    MountMonitor mount_monitor;
+    bool mounts_available = mount_monitor.open();
+    if (mounts_available) {
+        for (const auto& [id, mount] : mount_monitor.mounts()) {
+            if (MountMonitor::isExternal(mount)) {
+                queueMountWalk(mount);
+            }
+        }
+    } else {
+        std::cerr << "Mount monitoring unavailable: " << strerror(errno) << std::endl;
+    }
+
+    if (watches.empty() && !mounts_available) {
         std::cerr << "No paths were successfully monitored" << std::endl;
         close(inotify_fd);
         return;
     }
+    std::thread mount_walker(&DLPMonitor::mountWalkLoop, this, inotify_fd);
 
     const size_t BUF_LEN = 4096;
-    char buffer[BUF_LEN];
+    alignas(struct inotify_event) char buffer[BUF_LEN];
+
+    struct pollfd fds[2] = {
+        {inotify_fd, POLLIN, 0},
+        {mount_monitor.fd(), POLLPRI, 0}
+    };
+    nfds_t fd_count = mounts_available ? 2 : 1;
 
     std::cout << "File system monitoring started" << std::endl;
 
     while (running_) {
-        ssize_t len = read(inotify_fd, buffer, BUF_LEN);
-        if (len < 0) {
-            if (errno != EAGAIN) {
-                std::cerr << "Error reading inotify events: " << strerror(errno) << std::endl;
+        int ready = poll(fds, fd_count, 500);  // Wake periodically to notice stopMonitoring()
+        if (ready <= 0) {
+            if (ready < 0 && errno != EINTR) {
+                std::cerr << "Error polling file system events: " << strerror(errno) << std::endl;
             }
             continue;
         }
 
-        ssize_t i = 0;
-        while (i < len) {
-            struct inotify_event* event = (struct inotify_event*)&buffer[i];
+        if (fd_count > 1 && (fds[1].revents & (POLLPRI | POLLERR))) {
+            handleMountChanges(mount_monitor);
+        }
 
-            // Find the path for this watch descriptor
-            auto it = wd_to_path.find(event->wd);
-            if (it == wd_to_path.end()) {
-                i += sizeof(struct inotify_event) + event->len;
-                continue;
-            }
+        if (!(fds[0].revents & POLLIN)) continue;
+        mergeWalkedWatches(watches);
+
+        ssize_t len;
+        while ((len = read(inotify_fd, buffer, BUF_LEN)) > 0) {
+            const struct inotify_event* event;
+            for (ssize_t i = 0; i < len; i += sizeof(struct inotify_event) + event->len) {
+                event = reinterpret_cast<const struct inotify_event*>(&buffer[i]);
+
+                // Find the path for this watch descriptor; a walk may have just added it
+                auto it = watches.find(event->wd);
+                if (it == watches.end()) {
+                    mergeWalkedWatches(watches);
+                    it = watches.find(event->wd);
+                    if (it == watches.end()) continue;
+                }
+
+                // The kernel dropped the watch (directory deleted or unmounted)
+                if (event->mask & IN_IGNORED) {
+                    watches.erase(it);
+                    continue;
+                }
 
-            std::string watch_path = it->second;
-            std::string full_file_path;
+                if (event->len == 0) continue;
 
-            if (event->len > 0) {
-                // Construct full path
-                if (watch_path.back() == '/') {
-                    full_file_path = watch_path + event->name;
-                } else {
-                    full_file_path = watch_path + "/" + event->name;
+                const WatchTarget& target = it->second;
+                std::string full_file_path = target.path;
+                if (full_file_path.back() != '/') {
+                    full_file_path += "/";
+                }
+                full_file_path += event->name;
+
+                if (!target.mount_point.empty()) {
+                    if ((event->mask & IN_CREATE) && (event->mask & IN_ISDIR)) {
+                        addDirectoryWatch(inotify_fd, full_file_path, target, watches);
+                    } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && !(event->mask & IN_ISDIR)) {
+                        observeFile(full_file_path);
+                        checkRemovableWrite(full_file_path, target);
+                    }
+                    continue;
                 }
 
                 //std::cout << "File event: " << full_file_path << " (mask: " << event->mask << ")" << std::endl;
@@ -134,6 +394,10 @@ void DLPMonitor::monitorFileSystem() {
                     continue;
                 }
 
+                if (!(event->mask & IN_ISDIR)) {
+                    observeFile(full_file_path);
+                }
+
                 // Check if this file violates any policies
                 if (checkFileAgainstPolicies(full_file_path)) {
                     if (callback_) {
@@ -156,36 +420,285 @@ void DLPMonitor::monitorFileSystem() {
                     }
                 }
             }
-
-            i += sizeof(struct inotify_event) + event->len;
         }
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 
+    mount_walk_cv_.notify_all();
+    mount_walker.join();
+    mergeWalkedWatches(watches);
+
     // Clean up watches
-    for (const auto& pair : wd_to_path) {
+    for (const auto& pair : watches) {
         inotify_rm_watch(inotify_fd, pair.first);
     }
     close(inotify_fd);
     std::cout << "File system monitoring stopped" << std::endl;
 }
 
-void DLPMonitor::monitorClipboard() {
-    // Clipboard monitoring functionality has been removed
-    // This is a placeholder for future clipboard monitoring implementations
+void DLPMonitor::mountWalkLoop(int inotify_fd) {
     while (running_) {
-        // Basic clipboard monitoring placeholder
-        // Could be implemented using different approaches:
-        // - Command-line tools like xclip
-        // - Wayland protocols (if applicable)
-        // - Other clipboard monitoring libraries
+        MountInfo mount;
+        {
+            std::unique_lock<std::mutex> lock(mount_walk_mutex_);
+            // running_ is cleared without this lock, so wake up now and then to notice it
+            mount_walk_cv_.wait_for(lock, std::chrono::milliseconds(500),
+                                    [this] { return !running_ || !mount_walks_.empty(); });
+            if (!running_ || mount_walks_.empty()) continue;
+            mount = std::move(mount_walks_.front());
+            mount_walks_.pop_front();
+        }
+        addMountWatches(inotify_fd, mount);
+    }
+}
+
+void DLPMonitor::queueMountWalk(const MountInfo& mount) {
+    {
+        std::lock_guard<std::mutex> lock(mount_walk_mutex_);
+        mount_walks_.push_back(mount);
+    }
+    mount_walk_cv_.notify_one();
+}
+
+void DLPMonitor::mergeWalkedWatches(std::unordered_map<int, WatchTarget>& watches) {
+    std::lock_guard<std::mutex> lock(mount_walk_mutex_);
+    for (auto& [wd, target] : walked_watches_) {
+        watches[wd] = std::move(target);
+    }
+    walked_watches_.clear();
+}
+
+void DLPMonitor::addMountWatches(int inotify_fd, const MountInfo& mount) {
+    // Bound the walk so a huge network share cannot exhaust inotify watches, and
+    // bound the entries visited so huge flat directories are not fully listed
+    const size_t MAX_MOUNT_WATCHES = 2048;
+    const size_t MAX_MOUNT_ENTRIES = 65536;
+    const int MAX_MOUNT_DEPTH = 8;
+
+    // The watch is published under the lock it was added under, so the inotify
+    // thread finds it as soon as it can see an event for it
+    auto add_watch = [&](const std::string& directory) {
+        std::lock_guard<std::mutex> lock(mount_walk_mutex_);
+        int wd = inotify_add_watch(inotify_fd, directory.c_str(),
+            IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+        if (wd < 0) return false;
+        walked_watches_.emplace_back(wd, WatchTarget{directory, mount.mount_point, mount.source});
+        return true;
+    };
+    add_watch(mount.mount_point);
+
+    size_t added = 1;
+    size_t visited = 0;
+    std::error_code ec;
+    fs::recursive_directory_iterator it(mount.mount_point, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::recursive_directory_iterator() && running_ &&
+           added < MAX_MOUNT_WATCHES && visited < MAX_MOUNT_ENTRIES; it.increment(ec)) {
+        visited++;
+        if (it.depth() >= MAX_MOUNT_DEPTH) {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (it->is_directory(ec) && !it->is_symlink(ec) && add_watch(it->path().string())) {
+            added++;
+        }
+    }
+
+    std::cout << "Monitoring " << (mount.network ? "network share " : "removable media ")
+              << mount.source << " at " << mount.mount_point << " (" << added << " directories, "
+              << visited << " entries visited)" << std::endl;
+}
+
+void DLPMonitor::addDirectoryWatch(int inotify_fd, const std::string& directory, const WatchTarget& mount,
+                                   std::unordered_map<int, WatchTarget>& watches) {
+    int wd = inotify_add_watch(inotify_fd, directory.c_str(),
+        IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+    if (wd >= 0) {
+        watches[wd] = WatchTarget{directory, mount.mount_point, mount.mount_source};
+    }
+}
+
+void DLPMonitor::handleMountChanges(MountMonitor& mount_monitor) {
+    std::vector<MountInfo> added;
+    std::vector<MountInfo> removed;
+    if (!mount_monitor.refresh(added, removed)) return;
+
+    for (const auto& mount : removed) {
+        if (MountMonitor::isExternal(mount)) {
+            // Watches below the mount are dropped by the kernel with IN_IGNORED
+            std::cout << "Unmounted: " << mount.mount_point << std::endl;
+        }
+    }
+
+    for (const auto& mount : added) {
+        if (!MountMonitor::isExternal(mount)) continue;
+
+        queueMountWalk(mount);
+
+        if (callback_) {
+            auto now = std::chrono::system_clock::now();
+            auto time_t = std::chrono::system_clock::to_time_t(now);
+            std::stringstream ss;
+            ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+
+            DLPEvent dlp_event{
+                ss.str(),
+                "removable_media_mounted",
+                mount.source,
+                mount.mount_point,
+                "current_user",
+                std::string(mount.network ? "Network share mounted: " : "Removable media mounted: ") +
+                    mount.source + " (" + mount.fs_type + ")",
+                false  // Alert only
+            };
+            callback_(dlp_event);
+        }
+    }
+}
 
-        std::this_thread::sleep_for(std::chrono::seconds(10));
+void DLPMonitor::checkRemovableWrite(const std::string& file_path, const WatchTarget& mount) {
+    bool content_checked = false;
+    bool content_matched = false;
+
+    for (const auto& policy : policies_) {
+        if (!policy.removable_destination) continue;
+
+        bool matched = false;
+        for (const auto& ext : policy.file_extensions) {
+            if (file_path.find(ext) != std::string::npos) {
+                matched = true;
+                break;
+            }
+        }
+
+        // Content is scanned at most once per write, whichever policy asks first
+        if (!matched) {
+            if (!content_checked) {
+                content_matched = checkContentAgainstPolicies(file_path);
+                content_checked = true;
+            }
+            matched = content_matched;
+        }
+
+        if (matched && callback_) {
+            auto now = std::chrono::system_clock::now();
+            auto time_t = std::chrono::system_clock::to_time_t(now);
+            std::stringstream ss;
+            ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+
+            DLPEvent dlp_event{
+                ss.str(),
+                "removable_media_write",
+                file_path,
+                mount.mount_point + " (" + mount.mount_source + ")",
+                "current_user",
+                "Sensitive file written to removable destination (" + policy.name + ")",
+                false  // The write already happened; inotify cannot prevent it
+            };
+            std::cout << "DLP violation detected: " << file_path << " copied to " << mount.mount_point << std::endl;
+            callback_(dlp_event);
+            break;
+        }
+    }
+}
+
+void DLPMonitor::monitorClipboard() {
+    clipboard_monitor_.setCallback([this](const ClipboardChange& change) {
+        checkClipboardContent(change);
+    });
+
+    // Blocks on selection ownership notifications until stopMonitoring()
+    if (!clipboard_monitor_.run()) {
+        std::cerr << "Clipboard monitoring unavailable: no Wayland data-control or X11 display" << std::endl;
     }
 }
 
+void DLPMonitor::checkClipboardContent(const ClipboardChange& change) {
+    if (change.content.empty()) return;
+
+    const DLPPolicy* policy = scanContent(change.content, "clipboard " + change.selection);
+    if (!policy || !callback_) return;
+
+    auto now = std::chrono::system_clock::now();
+    auto time_t = std::chrono::system_clock::to_time_t(now);
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+
+    DLPEvent dlp_event{
+        ss.str(),
+        "clipboard",
+        change.selection + " (" + change.backend + ")",
+        "clipboard",
+        "current_user",
+        "Sensitive content copied to clipboard (" + policy->name + ")" +
+            (change.truncated ? ", only the first " + std::to_string(change.content.size()) + " bytes scanned" : ""),
+        false  // Selections are observed after they are set
+    };
+    dlp_event.bytes = change.content.size();
+    std::cout << "DLP violation detected: sensitive content in " << change.selection << " selection" << std::endl;
+    callback_(dlp_event);
+}
+
+void DLPMonitor::monitorPrintSpool() {
+    print_monitor_.setCallback([this](const PrintJob& job) {
+        checkPrintJob(job);
+    });
 
+    if (!print_monitor_.run()) {
+        std::cerr << "Print monitoring unavailable: " << print_monitor_.spoolDirectory() << std::endl;
+    }
+}
+
+void DLPMonitor::checkPrintJob(const PrintJob& job) {
+    std::string policy_name;
+    auto cached = print_verdicts_.find(job.content_hash);
+    if (cached != print_verdicts_.end() && cached->second.policy_version == policy_version_) {
+        policy_name = cached->second.policy;
+    } else {
+        // The job name is usually the printed file's name
+        for (const auto& policy : policies_) {
+            for (const auto& ext : policy.file_extensions) {
+                if (job.job_name.find(ext) != std::string::npos) {
+                    policy_name = policy.name;
+                    break;
+                }
+            }
+            if (!policy_name.empty()) break;
+        }
+
+        if (policy_name.empty() && !job.text.empty()) {
+            const DLPPolicy* policy = scanContent(job.text, "print job " + std::to_string(job.job_id));
+            if (policy) policy_name = policy->name;
+        }
+
+        if (cached == print_verdicts_.end()) {
+            if (print_verdict_order_.size() >= MAX_PRINT_VERDICTS) {
+                print_verdicts_.erase(print_verdict_order_.front());
+                print_verdict_order_.pop_front();
+            }
+            print_verdict_order_.push_back(job.content_hash);
+        }
+        print_verdicts_[job.content_hash] = PrintVerdict{policy_version_, policy_name};
+    }
+
+    if (policy_name.empty() || !callback_) return;
+
+    auto now = std::chrono::system_clock::now();
+    auto time_t = std::chrono::system_clock::to_time_t(now);
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+
+    DLPEvent dlp_event{
+        ss.str(),
+        "print_job",
+        job.job_name.empty() ? job.data_path : job.job_name,
+        job.printer.empty() ? "printer" : job.printer,
+        job.user.empty() ? "current_user" : job.user,
+        "Sensitive document sent to printer (" + policy_name + ", " + job.format + ")",
+        false  // The job is already spooled; CUPS prints it regardless
+    };
+    dlp_event.bytes = job.size;
+    std::cout << "DLP violation detected: print job " << job.job_id << " matched " << policy_name << std::endl;
+    callback_(dlp_event);
+}
 
 void DLPMonitor::monitorNetworkTransfers() {
     // eBPF program source for network monitoring
@@ -352,22 +865,93 @@ void DLPMonitor::checkNetworkTransfer(void* event_data) {
 
     transfer_event_t* event = static_cast<transfer_event_t*>(event_data);
 
+    NetworkTransfer transfer{
+        event->saddr,
+        event->daddr,
+        event->dport,
+        event->size,
+        static_cast<int>(event->pid),
+        std::string(event->comm, strnlen(event->comm, sizeof(event->comm)))
+    };
+    checkTransfer(transfer);
+}
+
+void DLPMonitor::checkFlowRecords(const std::vector<FlowRecord>& flows) {
+    // Flows are aggregated per flush interval; tiny ones (handshakes, keepalives) still count as
+    // contact with the destination but are not checked as transfers
+    const uint64_t MIN_FLOW_BYTES = 1024;
+
+    if (flows.empty()) return;
+
+    // Attribute flows like the /proc/net fallback does: local port -> socket inode -> process
+    auto tcp_sockets = readSocketTable("/proc/net/tcp");
+    auto udp_sockets = readSocketTable("/proc/net/udp");
+
+    for (const auto& flow : flows) {
+        NetworkTransfer transfer{
+            flow.key.saddr,
+            flow.key.daddr,
+            flow.key.dport,
+            flow.bytes,
+            0,
+            flow.key.protocol == IPPROTO_TCP ? "tcp_flow" : "udp_flow"
+        };
+
+        uint64_t inode = findFlowSocket(flow.key.protocol == IPPROTO_TCP ? tcp_sockets : udp_sockets, flow.key);
+        ProcessInfo process;
+        if (inode != 0 && process_cache_.lookupSocket(inode, process)) {
+            transfer.pid = process.pid;
+            transfer.comm = process.comm;
+        }
+        checkTransfer(transfer, flow.bytes >= MIN_FLOW_BYTES);
+    }
+}
+
+void DLPMonitor::observeFile(const std::string& file_path) {
+    if (!observation_callback_) return;
+
+    DataObservation observation;
+    observation.type = "file_access";
+    observation.file_path = file_path;
+    observation_callback_(observation);
+}
+
+void DLPMonitor::checkTransfer(const NetworkTransfer& transfer, bool check_policies) {
     // Convert IP addresses to strings
     char src_ip[INET_ADDRSTRLEN];
     char dst_ip[INET_ADDRSTRLEN];
 
-    inet_ntop(AF_INET, &event->saddr, src_ip, INET_ADDRSTRLEN);
-    inet_ntop(AF_INET, &event->daddr, dst_ip, INET_ADDRSTRLEN);
+    inet_ntop(AF_INET, &transfer.saddr, src_ip, INET_ADDRSTRLEN);
+    inet_ntop(AF_INET, &transfer.daddr, dst_ip, INET_ADDRSTRLEN);
 
     // Check against restricted destinations
-    std::string destination = std::string(dst_ip) + ":" + std::to_string(event->dport);
+    std::string destination = std::string(dst_ip) + ":" + std::to_string(transfer.dport);
+
+    DnsResolution resolution;
+    bool have_hostname = dns_observer_.resolve(dst_ip, resolution);
+    if (have_hostname) {
+        destination = resolution.hostname + " (" + destination + ")";
+    }
+
+    ProcessInfo process;
+    bool have_process = process_cache_.lookupProcess(transfer.pid, process, transfer.comm);
+
+    if (observation_callback_) {
+        DataObservation observation;
+        observation.type = "network_transfer";
+        observation.host = have_hostname ? resolution.hostname : dst_ip;
+        observation.bytes = transfer.size;
+        observation_callback_(observation);
+    }
+
+    if (!check_policies) return;
 
     for (const auto& policy : policies_) {
         bool violation = false;
         std::string violation_reason;
 
         // Check file size thresholds (large transfers might indicate data exfiltration)
-        if (event->size > 1024 * 1024) { // 1MB threshold
+        if (transfer.size > 1024 * 1024) { // 1MB threshold
             violation = true;
             violation_reason = "Large network transfer detected";
         }
@@ -381,9 +965,16 @@ void DLPMonitor::checkNetworkTransfer(void* event_data) {
             }
         }
 
+        // Check the hostname the destination was resolved from
+        std::string matched_name;
+        if (have_hostname && matchRestrictedDomain(policy, resolution, matched_name)) {
+            violation = true;
+            violation_reason = "Transfer to restricted domain: " + matched_name;
+        }
+
         // Check for suspicious protocols/ports
         std::vector<int> suspicious_ports = {21, 22, 25, 110, 143, 993, 995}; // FTP, SSH, SMTP, POP3, IMAP
-        if (std::find(suspicious_ports.begin(), suspicious_ports.end(), event->dport) != suspicious_ports.end()) {
+        if (std::find(suspicious_ports.begin(), suspicious_ports.end(), transfer.dport) != suspicious_ports.end()) {
             violation = true;
             violation_reason = "Transfer using potentially insecure protocol";
         }
@@ -397,12 +988,18 @@ void DLPMonitor::checkNetworkTransfer(void* event_data) {
             DLPEvent dlp_event{
                 ss.str(),
                 "network_transfer",
-                std::string(event->comm),
+                transfer.comm,
                 destination,
-                "current_user",  // In real implementation, get actual username
+                "current_user",
                 violation_reason,
                 policy.block_transfer
             };
+            if (have_process) {
+                attachProcessInfo(dlp_event, process);
+            } else {
+                dlp_event.pid = transfer.pid;
+            }
+            dlp_event.bytes = transfer.size;
             callback_(dlp_event);
         }
     }
@@ -411,6 +1008,14 @@ void DLPMonitor::checkNetworkTransfer(void* event_data) {
 void DLPMonitor::fallbackNetworkMonitoring() {
     std::cout << "Starting fallback network monitoring..." << std::endl;
 
+    // Without eBPF, per-flow byte counts come from the packet ring when configured
+    if (!capture_interface_.empty()) {
+        flow_monitor_.setCallback([this](const std::vector<FlowRecord>& flows) {
+            checkFlowRecords(flows);
+        });
+        flow_monitor_.start(capture_interface_);
+    }
+
     while (running_) {
         // Use system tools to monitor network connections
         monitorNetworkConnections();
@@ -463,11 +1068,7 @@ void DLPMonitor::monitorNetworkConnections() {
 
 void DLPMonitor::monitorSuspiciousProcesses() {
     // Monitor processes that might be involved in data exfiltration
-    std::vector<std::string> suspicious_commands = {
-        "scp", "rsync", "ftp", "sftp", "wget", "curl", "nc", "netcat", "ssh"
-    };
-
-    for (const auto& cmd : suspicious_commands) {
+    for (const auto& cmd : TRANSFER_TOOLS) {
         std::string command = "pgrep -x " + cmd + " 2>/dev/null || true";
         FILE* pipe = popen(command.c_str(), "r");
         if (!pipe) continue;
@@ -478,6 +1079,14 @@ void DLPMonitor::monitorSuspiciousProcesses() {
             std::string pid_str(buffer);
             pid_str.erase(pid_str.find_last_not_of(" \n\r\t") + 1);
 
+            ProcessInfo process;
+            bool have_process = false;
+            try {
+                have_process = process_cache_.lookupProcess(std::stoi(pid_str), process);
+            } catch (const std::exception&) {
+                // Malformed pgrep output, report without attribution
+            }
+
             // Get process information
             std::string ps_command = "ps -p " + pid_str + " -o pid,ppid,cmd 2>/dev/null || true";
             FILE* ps_pipe = popen(ps_command.c_str(), "r");
@@ -503,6 +1112,9 @@ void DLPMonitor::monitorSuspiciousProcesses() {
                                 "Suspicious network process detected: " + cmd,
                                 false  // Don't block, just alert
                             };
+                            if (have_process) {
+                                attachProcessInfo(dlp_event, process);
+                            }
                             callback_(dlp_event);
                         }
                     }
@@ -535,7 +1147,7 @@ void DLPMonitor::monitorFileTransfers() {
             }
         }
 
-        if (fields.size() >= 8) {
+        if (fields.size() >= 10) {
             // Parse local and remote addresses
             std::string local_addr = fields[1];
             std::string remote_addr = fields[2];
@@ -545,7 +1157,15 @@ void DLPMonitor::monitorFileTransfers() {
             if (state == "01") {
                 // Convert hex addresses to readable format
                 std::string readable_remote = hexToIp(remote_addr);
-                checkDestinationAgainstPolicies(readable_remote);
+
+                // Attribute the connection to its owning process via the socket inode
+                ProcessInfo process;
+                uint64_t inode = std::strtoull(fields[9].c_str(), nullptr, 10);
+                if (process_cache_.lookupSocket(inode, process)) {
+                    checkDestinationAgainstPolicies(readable_remote, &process);
+                } else {
+                    checkDestinationAgainstPolicies(readable_remote);
+                }
             }
         }
     }
@@ -577,8 +1197,36 @@ void DLPMonitor::checkPortAgainstPolicies(int port) {
     }
 }
 
-void DLPMonitor::checkDestinationAgainstPolicies(const std::string& destination) {
+void DLPMonitor::checkDestinationAgainstPolicies(const std::string& destination, const ProcessInfo* process) {
+    DnsResolution resolution;
+    bool have_hostname = dns_observer_.resolve(destination, resolution);
+
     for (const auto& policy : policies_) {
+        std::string matched_name;
+        if (have_hostname && matchRestrictedDomain(policy, resolution, matched_name)) {
+            if (callback_) {
+                auto now = std::chrono::system_clock::now();
+                auto time_t = std::chrono::system_clock::to_time_t(now);
+                std::stringstream ss;
+                ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+
+                DLPEvent dlp_event{
+                    ss.str(),
+                    "restricted_destination",
+                    "Network transfer",
+                    resolution.hostname + " (" + destination + ")",
+                    "current_user",
+                    "Transfer to restricted domain: " + matched_name,
+                    policy.block_transfer
+                };
+                if (process) {
+                    attachProcessInfo(dlp_event, *process);
+                }
+                callback_(dlp_event);
+            }
+            continue;
+        }
+
         for (const auto& restricted_dest : policy.restricted_paths) {
             if (destination.find(restricted_dest) != std::string::npos) {
                 if (callback_) {
@@ -596,6 +1244,9 @@ void DLPMonitor::checkDestinationAgainstPolicies(const std::string& destination)
                         "Transfer to restricted destination: " + destination,
                         policy.block_transfer
                     };
+                    if (process) {
+                        attachProcessInfo(dlp_event, *process);
+                    }
                     callback_(dlp_event);
                 }
                 break;
@@ -604,6 +1255,31 @@ void DLPMonitor::checkDestinationAgainstPolicies(const std::string& destination)
     }
 }
 
+bool DLPMonitor::matchRestrictedDomain(const DLPPolicy& policy, const DnsResolution& resolution,
+                                       std::string& matched_name) {
+    auto matcher = domain_matchers_.find(policy.name);
+    if (matcher == domain_matchers_.end()) return false;
+
+    // A CNAME target (e.g. a CDN edge owned by the service) counts as well
+    if (matcher->second.match(resolution.hostname)) {
+        matched_name = resolution.hostname;
+        return true;
+    }
+    if (!resolution.canonical_name.empty() && matcher->second.match(resolution.canonical_name)) {
+        matched_name = resolution.canonical_name;
+        return true;
+    }
+    return false;
+}
+
+void DLPMonitor::attachProcessInfo(DLPEvent& event, const ProcessInfo& process) {
+    event.pid = process.pid;
+    event.process_path = process.exe_path.empty() ? process.comm : process.exe_path;
+    if (!process.user.empty()) {
+        event.user = process.user;
+    }
+}
+
 std::string DLPMonitor::hexToIp(const std::string& hex_addr) {
     // Convert hex IP:port format to readable format
     // Example: 0100007F:0016 -> 127.0.0.1:22
@@ -671,42 +1347,74 @@ bool DLPMonitor::checkContentAgainstPolicies(const std::string& file_path) {
 
     std::cout << "Checking content of file: " << file_path << " (size: " << content.size() << " bytes)" << std::endl;
 
-    // Convert content to lowercase for case-insensitive matching
-    std::string lower_content = content;
-    std::transform(lower_content.begin(), lower_content.end(), lower_content.begin(), ::tolower);
+    if (scanContent(content, file_path)) {
+        return true;
+    }
 
-    for (const auto& policy : policies_) {
-        for (const auto& pattern : policy.content_patterns) {
-            try {
-                // Try case-sensitive match first
-                if (std::regex_search(content, pattern)) {
-                    std::cout << "Content pattern matched (case-sensitive): " << file_path << std::endl;
-                    return true;
-                }
+    std::cout << "No content patterns matched for file: " << file_path << std::endl;
+    return false;
+}
 
-                // For case-insensitive matching, we'll use a simple string search approach
-                // since we can't easily extract the pattern string from std::regex
-                std::string search_content = lower_content;
-
-                // Try simple string matching for common patterns
-                // This is a simplified approach - in production you'd want more sophisticated pattern matching
-                if (search_content.find("confidential") != std::string::npos ||
-                    search_content.find("secret") != std::string::npos ||
-                    search_content.find("internal") != std::string::npos ||
-                    search_content.find("password") != std::string::npos ||
-                    search_content.find("api_key") != std::string::npos ||
-                    search_content.find("token") != std::string::npos) {
-                    std::cout << "Content pattern matched (string search): " << file_path << std::endl;
-                    return true;
-                }
+const DLPPolicy* DLPMonitor::scanContent(const std::string& content, const std::string& source) {
+    // Lowercased copy for the keyword fallback, built on first use
+    std::string lower_content;
 
-            } catch (const std::regex_error& e) {
-                std::cerr << "Regex error for pattern: " << e.what() << std::endl;
-                // Continue with other patterns
-            }
+    for (size_t i = 0; i < policies_.size(); ++i) {
+        if (scanPolicy(i, content, source, true, lower_content)) {
+            return &policies_[i];
         }
     }
+    return nullptr;
+}
 
-    std::cout << "No content patterns matched for file: " << file_path << std::endl;
-    return false;
+bool DLPMonitor::scanPolicy(size_t index, std::string_view content, const std::string& source,
+                            bool keyword_fallback, std::string& lower_content) {
+    const DLPPolicy& policy = policies_[index];
+    if (policy.content_patterns.empty()) return false;
+
+    const PolicyRuleStats& stats = policy_rule_stats_[index];
+    uint64_t policy_start = RuleStatsRegistry::threadCpuTimeNs();
+    bool matched = false;
+
+    for (size_t p = 0; p < policy.content_patterns.size() && !matched; ++p) {
+        uint64_t start = RuleStatsRegistry::threadCpuTimeNs();
+        try {
+            // Try case-sensitive match first
+            matched = std::regex_search(content.begin(), content.end(), policy.content_patterns[p]);
+        } catch (const std::regex_error& e) {
+            std::cerr << "Regex error for pattern: " << e.what() << std::endl;
+            // Continue with other patterns
+        }
+        stats.patterns[p]->record(content.size(), RuleStatsRegistry::threadCpuTimeNs() - start, matched);
+        if (matched) {
+            std::cout << "Content pattern matched (case-sensitive): " << source << std::endl;
+        }
+    }
+
+    if (!matched && keyword_fallback) {
+        uint64_t start = RuleStatsRegistry::threadCpuTimeNs();
+
+        // For case-insensitive matching, we'll use a simple string search approach
+        // since we can't easily extract the pattern string from std::regex
+        if (lower_content.empty()) {
+            lower_content.assign(content.begin(), content.end());
+            std::transform(lower_content.begin(), lower_content.end(), lower_content.begin(), ::tolower);
+        }
+
+        // Try simple string matching for common patterns
+        // This is a simplified approach - in production you'd want more sophisticated pattern matching
+        matched = lower_content.find("confidential") != std::string::npos ||
+                  lower_content.find("secret") != std::string::npos ||
+                  lower_content.find("internal") != std::string::npos ||
+                  lower_content.find("password") != std::string::npos ||
+                  lower_content.find("api_key") != std::string::npos ||
+                  lower_content.find("token") != std::string::npos;
+        stats.keywords->record(content.size(), RuleStatsRegistry::threadCpuTimeNs() - start, matched);
+        if (matched) {
+            std::cout << "Content pattern matched (string search): " << source << std::endl;
+        }
+    }
+
+    stats.policy->record(content.size(), RuleStatsRegistry::threadCpuTimeNs() - policy_start, matched);
+    return matched;
 }
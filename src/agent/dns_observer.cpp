@@ -0,0 +1,352 @@
+#include "dns_observer.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING 23
+#endif
+
+namespace {
+    const uint16_t DNS_TYPE_A = 1;
+    const uint16_t DNS_TYPE_CNAME = 5;
+    const uint16_t DNS_TYPE_AAAA = 28;
+
+    // Connections routinely outlive short DNS TTLs, so keep mappings at least
+    // this long, and never trust absurdly long TTLs.
+    const uint32_t MIN_TTL_SECONDS = 60;
+    const uint32_t MAX_TTL_SECONDS = 86400;
+
+    std::string normalizeName(const std::string& name) {
+        std::string result = name;
+        std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+        while (!result.empty() && result.back() == '.') {
+            result.pop_back();
+        }
+        return result;
+    }
+
+    uint16_t readU16(const uint8_t* p) {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    uint32_t readU32(const uint8_t* p) {
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+    }
+
+    // Reads a possibly compressed DNS name starting at offset. On success the
+    // offset is advanced past the name as it appears in place.
+    bool readName(const uint8_t* data, size_t length, size_t& offset, std::string& name) {
+        name.clear();
+        size_t pos = offset;
+        bool jumped = false;
+        int jumps = 0;
+
+        while (pos < length) {
+            uint8_t label_len = data[pos];
+            if (label_len == 0) {
+                if (!jumped) offset = pos + 1;
+                return true;
+            }
+
+            if ((label_len & 0xC0) == 0xC0) {
+                if (pos + 1 >= length || ++jumps > 16) return false;
+                size_t target = static_cast<size_t>(((label_len & 0x3F) << 8) | data[pos + 1]);
+                if (!jumped) offset = pos + 2;
+                jumped = true;
+                pos = target;
+                continue;
+            }
+
+            if ((label_len & 0xC0) != 0 || pos + 1 + label_len > length) return false;
+            if (!name.empty()) name += '.';
+            name.append(reinterpret_cast<const char*>(data + pos + 1), label_len);
+            if (name.size() > 255) return false;
+            pos += 1 + label_len;
+        }
+        return false;
+    }
+}
+
+DomainSuffixMatcher::DomainSuffixMatcher(const std::vector<std::string>& patterns)
+    : patterns_(patterns) {
+    compile();
+}
+
+DomainSuffixMatcher::DomainSuffixMatcher(const DomainSuffixMatcher& other)
+    : patterns_(other.patterns_) {
+    compile();
+}
+
+DomainSuffixMatcher& DomainSuffixMatcher::operator=(const DomainSuffixMatcher& other) {
+    if (this != &other) {
+        patterns_ = other.patterns_;
+        compile();
+    }
+    return *this;
+}
+
+void DomainSuffixMatcher::compile() {
+    exact_.clear();
+    suffixes_.clear();
+    normalized_.clear();
+    normalized_.reserve(patterns_.size());
+
+    // Views below point into normalized_, which must not reallocate afterwards
+    for (const auto& pattern : patterns_) {
+        std::string name = normalizeName(pattern);
+        bool wildcard = name.compare(0, 2, "*.") == 0;
+        if (wildcard) name.erase(0, 2);
+        normalized_.push_back(wildcard ? "*" + name : name);
+    }
+
+    for (size_t i = 0; i < normalized_.size(); ++i) {
+        std::string_view name(normalized_[i]);
+        if (name.empty()) continue;
+        if (name[0] == '*') {
+            name.remove_prefix(1);
+            if (!name.empty()) suffixes_.emplace(name, i);
+        } else {
+            exact_.emplace(name, i);
+        }
+    }
+}
+
+bool DomainSuffixMatcher::match(const std::string& hostname, std::string* matched_pattern) const {
+    if (patterns_.empty() || hostname.empty()) return false;
+
+    std::string name = normalizeName(hostname);
+    std::string_view view(name);
+
+    auto report = [&](size_t index) {
+        if (matched_pattern) *matched_pattern = patterns_[index];
+        return true;
+    };
+
+    auto exact = exact_.find(view);
+    if (exact != exact_.end()) return report(exact->second);
+
+    // Try every proper suffix that starts at a label boundary
+    for (size_t dot = view.find('.'); dot != std::string_view::npos; dot = view.find('.', dot + 1)) {
+        auto suffix = suffixes_.find(view.substr(dot + 1));
+        if (suffix != suffixes_.end()) return report(suffix->second);
+    }
+
+    return false;
+}
+
+DnsCache::DnsCache(size_t capacity) : capacity_(capacity) {}
+
+void DnsCache::insert(const std::string& ip, const std::string& hostname,
+                      const std::string& canonical_name, uint32_t ttl_seconds) {
+    ttl_seconds = std::clamp(ttl_seconds, MIN_TTL_SECONDS, MAX_TTL_SECONDS);
+    auto expires = std::chrono::steady_clock::now() + std::chrono::seconds(ttl_seconds);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = index_.find(ip);
+    if (it != index_.end()) {
+        it->second->resolution = DnsResolution{hostname, canonical_name};
+        it->second->expires = expires;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+
+    if (lru_.size() >= capacity_) {
+        index_.erase(lru_.back().ip);
+        lru_.pop_back();
+    }
+
+    lru_.push_front(Entry{ip, DnsResolution{hostname, canonical_name}, expires});
+    index_[ip] = lru_.begin();
+}
+
+bool DnsCache::lookup(const std::string& ip, DnsResolution& resolution) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = index_.find(ip);
+    if (it == index_.end()) return false;
+
+    if (it->second->expires < std::chrono::steady_clock::now()) {
+        lru_.erase(it->second);
+        index_.erase(it);
+        return false;
+    }
+
+    lru_.splice(lru_.begin(), lru_, it->second);
+    resolution = it->second->resolution;
+    return true;
+}
+
+size_t DnsCache::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
+
+DnsObserver::DnsObserver() : socket_fd_(-1), running_(false) {}
+
+DnsObserver::~DnsObserver() {
+    stop();
+}
+
+bool DnsObserver::start() {
+    if (running_) return true;
+
+    // Cooked sockets deliver packets starting at the network header on any link type
+    socket_fd_ = socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC, htons(ETH_P_ALL));
+    if (socket_fd_ < 0) {
+        std::cerr << "DNS observer unavailable: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (!attachFilter(socket_fd_)) {
+        std::cerr << "Failed to attach DNS capture filter: " << strerror(errno) << std::endl;
+        close(socket_fd_);
+        socket_fd_ = -1;
+        return false;
+    }
+
+    // Only responses received by this host are interesting; loopback would otherwise show each twice
+    int ignore_outgoing = 1;
+    setsockopt(socket_fd_, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore_outgoing, sizeof(ignore_outgoing));
+
+    running_ = true;
+    capture_thread_ = std::thread(&DnsObserver::captureLoop, this);
+    std::cout << "DNS response observation started" << std::endl;
+    return true;
+}
+
+void DnsObserver::stop() {
+    running_ = false;
+    if (capture_thread_.joinable()) {
+        capture_thread_.join();
+    }
+    if (socket_fd_ >= 0) {
+        close(socket_fd_);
+        socket_fd_ = -1;
+    }
+}
+
+bool DnsObserver::resolve(const std::string& ip, DnsResolution& resolution) {
+    return cache_.lookup(ip, resolution);
+}
+
+bool DnsObserver::attachFilter(int fd) {
+    // Accept UDP datagrams with source port 53 over IPv4 (unfragmented or first
+    // fragment only) and IPv6 without extension headers; drop everything else.
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),                 // 0: A = version/ihl
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 4),                // 1: A = version
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 4, 0, 7),          // 2: IPv4 ? 3 : 10
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9),                 // 3: A = protocol
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 11), // 4: UDP ? 5 : reject
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6),                 // 5: A = frag offset
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 9, 0),    // 6: later fragment ? reject : 7
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),                // 7: X = IPv4 header length
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, 0),                 // 8: A = UDP source port
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 53, 5, 6),         // 9: port 53 ? accept : reject
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 6, 0, 5),          // 10: IPv6 ? 11 : reject
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 6),                 // 11: A = next header
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 3), // 12: UDP ? 13 : reject
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 40),                // 13: A = UDP source port
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 53, 0, 1),         // 14: port 53 ? accept : reject
+        BPF_STMT(BPF_RET | BPF_K, 0xffff),                     // 15: accept
+        BPF_STMT(BPF_RET | BPF_K, 0),                          // 16: reject
+    };
+
+    struct sock_fprog program;
+    program.len = sizeof(code) / sizeof(code[0]);
+    program.filter = code;
+
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) == 0;
+}
+
+void DnsObserver::captureLoop() {
+    std::vector<uint8_t> buffer(65536);
+    struct pollfd pfd = {socket_fd_, POLLIN, 0};
+
+    while (running_) {
+        int ready = poll(&pfd, 1, 500);  // Wake periodically to notice stop()
+        if (ready <= 0) continue;
+
+        ssize_t len = recv(socket_fd_, buffer.data(), buffer.size(), 0);
+        if (len <= 0) continue;
+
+        const uint8_t* packet = buffer.data();
+        size_t packet_len = static_cast<size_t>(len);
+        size_t udp_offset;
+
+        uint8_t version = packet[0] >> 4;
+        if (version == 4 && packet_len >= 20) {
+            udp_offset = static_cast<size_t>(packet[0] & 0x0F) * 4;
+        } else if (version == 6 && packet_len >= 40) {
+            udp_offset = 40;
+        } else {
+            continue;
+        }
+
+        if (packet_len < udp_offset + 8) continue;
+        processResponse(packet + udp_offset + 8, packet_len - udp_offset - 8);
+    }
+}
+
+void DnsObserver::processResponse(const uint8_t* data, size_t length) {
+    if (length < 12) return;
+
+    uint16_t flags = readU16(data + 2);
+    if (!(flags & 0x8000) || (flags & 0x000F) != 0) return;  // Not a successful response
+
+    uint16_t question_count = readU16(data + 4);
+    uint16_t answer_count = readU16(data + 6);
+    if (question_count == 0) return;
+
+    size_t offset = 12;
+    std::string hostname;
+    std::string name;
+
+    for (uint16_t i = 0; i < question_count; ++i) {
+        if (!readName(data, length, offset, name) || offset + 4 > length) return;
+        if (i == 0) hostname = normalizeName(name);
+        offset += 4;  // QTYPE and QCLASS
+    }
+
+    std::string canonical_name;
+    for (uint16_t i = 0; i < answer_count; ++i) {
+        if (!readName(data, length, offset, name) || offset + 10 > length) return;
+
+        uint16_t type = readU16(data + offset);
+        uint32_t ttl = readU32(data + offset + 4);
+        uint16_t rdlength = readU16(data + offset + 8);
+        offset += 10;
+        if (offset + rdlength > length) return;
+
+        if (type == DNS_TYPE_CNAME) {
+            size_t target_offset = offset;
+            std::string target;
+            if (readName(data, length, target_offset, target)) {
+                canonical_name = normalizeName(target);
+            }
+        } else if (type == DNS_TYPE_A && rdlength == 4) {
+            char ip[INET_ADDRSTRLEN];
+            if (inet_ntop(AF_INET, data + offset, ip, sizeof(ip))) {
+                cache_.insert(ip, hostname, canonical_name, ttl);
+            }
+        } else if (type == DNS_TYPE_AAAA && rdlength == 16) {
+            char ip[INET6_ADDRSTRLEN];
+            if (inet_ntop(AF_INET6, data + offset, ip, sizeof(ip))) {
+                cache_.insert(ip, hostname, canonical_name, ttl);
+            }
+        }
+
+        offset += rdlength;
+    }
+}
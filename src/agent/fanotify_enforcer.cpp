@@ -0,0 +1,482 @@
+#include "fanotify_enforcer.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <sys/fanotify.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    constexpr size_t MAX_QUEUED_JOBS = 1024;
+    constexpr size_t MAX_QUEUED_DENIALS = 256;
+    constexpr size_t MAX_CACHED_VERDICTS = 65536;
+    constexpr uint64_t PERMISSION_EVENTS = FAN_OPEN_PERM;
+
+    int64_t toNanoseconds(const struct timespec& ts) {
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+}
+
+FanotifyEnforcer::FanotifyEnforcer()
+    : fanotify_fd_(-1), running_(false), self_pid_(getpid()),
+      latency_budget_(std::chrono::milliseconds(5)), policy_version_(1),
+      next_request_id_(0), stats_{} {
+    if (pipe2(wake_pipe_, O_CLOEXEC | O_NONBLOCK) < 0) {
+        wake_pipe_[0] = wake_pipe_[1] = -1;
+    }
+}
+
+FanotifyEnforcer::~FanotifyEnforcer() {
+    stop();
+    if (wake_pipe_[0] >= 0) close(wake_pipe_[0]);
+    if (wake_pipe_[1] >= 0) close(wake_pipe_[1]);
+}
+
+void FanotifyEnforcer::setRestrictedProcesses(const std::vector<std::string>& comms) {
+    restricted_processes_ = std::unordered_set<std::string>(comms.begin(), comms.end());
+}
+
+bool FanotifyEnforcer::start(const std::vector<std::string>& paths) {
+    if (running_) return true;
+    if (wake_pipe_[0] < 0) return false;
+
+    fanotify_fd_ = fanotify_init(FAN_CLASS_CONTENT | FAN_CLOEXEC | FAN_NONBLOCK,
+                                 O_RDONLY | O_LARGEFILE | O_CLOEXEC);
+    if (fanotify_fd_ < 0) {
+        std::cerr << "fanotify_init failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Mount marks cover whole subtrees; paths on the same mount share one mark
+    marked_paths_.clear();
+    for (const auto& path : paths) {
+        if (fanotify_mark(fanotify_fd_, FAN_MARK_ADD | FAN_MARK_MOUNT, PERMISSION_EVENTS,
+                          AT_FDCWD, path.c_str()) == 0) {
+            marked_paths_.push_back(path);
+        } else {
+            std::cerr << "fanotify_mark failed for " << path << ": " << strerror(errno) << std::endl;
+        }
+    }
+    if (marked_paths_.empty()) {
+        close(fanotify_fd_);
+        fanotify_fd_ = -1;
+        return false;
+    }
+
+    // Drain a stale wakeup left by a previous stop()
+    char drain[16];
+    while (read(wake_pipe_[0], drain, sizeof(drain)) > 0) {}
+
+    running_ = true;
+    event_thread_ = std::thread(&FanotifyEnforcer::eventLoop, this);
+    classifier_thread_ = std::thread(&FanotifyEnforcer::classifierLoop, this);
+    std::cout << "fanotify enforcement started on " << marked_paths_.size() << " path(s), budget "
+              << latency_budget_.count() << "us" << std::endl;
+    return true;
+}
+
+void FanotifyEnforcer::stop() {
+    if (!running_) return;
+    {
+        // Taking the queue lock orders the flag with the classifier's wait
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        running_ = false;
+    }
+
+    ssize_t written = write(wake_pipe_[1], "x", 1);
+    (void)written;
+    queue_cv_.notify_all();
+    if (event_thread_.joinable()) event_thread_.join();
+    if (classifier_thread_.joinable()) classifier_thread_.join();
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        for (auto* jobs : {&held_jobs_, &background_jobs_}) {
+            for (auto& job : *jobs) {
+                close(job.fd);
+            }
+            jobs->clear();
+        }
+        background_keys_.clear();
+    }
+
+    // Closing the group releases any access the kernel is still holding
+    close(fanotify_fd_);
+    fanotify_fd_ = -1;
+    std::cout << "fanotify enforcement stopped" << std::endl;
+}
+
+void FanotifyEnforcer::invalidate() {
+    policy_version_++;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        verdicts_.clear();
+    }
+    // Ignore marks are inode marks; the mount marks themselves stay
+    if (fanotify_fd_ >= 0) {
+        fanotify_mark(fanotify_fd_, FAN_MARK_FLUSH, 0, AT_FDCWD, nullptr);
+    }
+}
+
+FanotifyStats FanotifyEnforcer::stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+void FanotifyEnforcer::eventLoop() {
+    alignas(struct fanotify_event_metadata) char buffer[8192];
+
+    while (running_) {
+        struct pollfd fds[2] = {{fanotify_fd_, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+        struct timespec timeout;
+        bool has_timeout = nextTimeout(timeout);
+        int ready = ppoll(fds, 2, has_timeout ? &timeout : nullptr, nullptr);
+
+        expirePending();
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "fanotify poll failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        if (fds[1].revents & POLLIN) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        ssize_t len = read(fanotify_fd_, buffer, sizeof(buffer));
+        if (len <= 0) {
+            if (len < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            std::cerr << "fanotify read failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        auto received = std::chrono::steady_clock::now();
+        auto* metadata = reinterpret_cast<struct fanotify_event_metadata*>(buffer);
+        for (; FAN_EVENT_OK(metadata, len); metadata = FAN_EVENT_NEXT(metadata, len)) {
+            if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+                std::cerr << "fanotify metadata version mismatch" << std::endl;
+                running_ = false;
+                break;
+            }
+            if (metadata->fd < 0) continue;  // Queue overflow
+
+            if (metadata->mask & PERMISSION_EVENTS) {
+                handleEvent(metadata->fd, metadata->pid, received);
+            } else {
+                close(metadata->fd);
+            }
+        }
+    }
+
+    // Nothing may stay held once the loop exits
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    for (auto& [id, pending] : pending_) {
+        respond(pending.fd, true, pending.received);
+    }
+    pending_.clear();
+}
+
+void FanotifyEnforcer::handleEvent(int fd, int pid, std::chrono::steady_clock::time_point received) {
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.events++;
+    }
+
+    // The agent's own opens, including classification, must never wait on itself
+    if (pid == self_pid_) {
+        countFastAllow();
+        respond(fd, true, received);
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        countFastAllow();
+        respond(fd, true, received);
+        return;
+    }
+
+    FileKey key{st.st_dev, st.st_ino};
+    int64_t mtime_ns = toNanoseconds(st.st_mtim);
+    AccessVerdict verdict;
+    bool cached = lookupVerdict(key, mtime_ns, verdict);
+    if (cached && !verdict.sensitive) {
+        countCacheHit();
+        respond(fd, true, received);
+        return;
+    }
+
+    std::string comm;
+    bool restricted = readComm(pid, comm) && restricted_processes_.count(comm) > 0;
+    if (!restricted) {
+        // Classify in the background so the kernel can stop reporting clean files
+        if (!cached) {
+            int job_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            if (job_fd >= 0) {
+                enqueueJob(ClassifyJob{0, job_fd, key, mtime_ns, policy_version_, pid, comm});
+            }
+        }
+        countFastAllow();
+        respond(fd, true, received);
+        return;
+    }
+
+    if (cached) {
+        countCacheHit();
+        std::string path = fdPath(fd);
+        respond(fd, false, received);
+        queueDenial(AccessDenial{pid, comm, path, verdict.policy});
+        return;
+    }
+
+    // A restricted process opened an unclassified file: wait for the classifier, within budget
+    int job_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (job_fd < 0) {
+        countFastAllow();
+        respond(fd, true, received);
+        return;
+    }
+
+    uint64_t request_id;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        request_id = ++next_request_id_;
+        pending_[request_id] = PendingResponse{fd, received + latency_budget_, received};
+    }
+    if (!enqueueJob(ClassifyJob{request_id, job_fd, key, mtime_ns, policy_version_, pid, comm})) {
+        completePending(request_id, true);
+    }
+}
+
+void FanotifyEnforcer::classifierLoop() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        queue_cv_.wait(lock, [this] {
+            return !running_ || !held_jobs_.empty() || !background_jobs_.empty() || !denials_.empty();
+        });
+        if (!running_) break;
+
+        // Held opens are classified first and denials reported next; background
+        // jobs are produced by any uncached open, so they must not starve reports
+        if (!held_jobs_.empty() || (denials_.empty() && !background_jobs_.empty())) {
+            auto& jobs = held_jobs_.empty() ? background_jobs_ : held_jobs_;
+            ClassifyJob job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+
+            std::string path = fdPath(job.fd);
+            AccessVerdict verdict = classifier_ ? classifier_(job.fd, path) : AccessVerdict{false, ""};
+            storeVerdict(job, verdict);
+            if (job.request_id == 0) {
+                std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+                background_keys_.erase(job.key);
+            }
+
+            // When the budget already ran out the open was allowed; the cached verdict applies next time
+            if (job.request_id != 0 && completePending(job.request_id, !verdict.sensitive)) {
+                {
+                    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+                    stats_.classified++;
+                }
+                if (verdict.sensitive) {
+                    queueDenial(AccessDenial{job.pid, job.comm, path, verdict.policy});
+                }
+            }
+            close(job.fd);
+            continue;
+        }
+
+        AccessDenial denial = std::move(denials_.front());
+        denials_.pop_front();
+        lock.unlock();
+
+        if (denial_callback_) {
+            denial_callback_(denial);
+        }
+    }
+}
+
+bool FanotifyEnforcer::lookupVerdict(const FileKey& key, int64_t mtime_ns, AccessVerdict& verdict) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = verdicts_.find(key);
+    if (it == verdicts_.end()) return false;
+    if (it->second.policy_version != policy_version_ || it->second.mtime_ns != mtime_ns) {
+        verdicts_.erase(it);
+        return false;
+    }
+    verdict = it->second.verdict;
+    return true;
+}
+
+void FanotifyEnforcer::storeVerdict(const ClassifyJob& job, const AccessVerdict& verdict) {
+    if (job.policy_version != policy_version_) return;  // Policies changed while classifying
+
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        if (verdicts_.size() >= MAX_CACHED_VERDICTS) {
+            verdicts_.clear();
+        }
+        verdicts_[job.key] = CachedVerdict{job.policy_version, job.mtime_ns, verdict};
+    }
+
+    // Without FAN_MARK_IGNORED_SURV_MODIFY the kernel drops the ignore mark on the
+    // next write, so a file that later becomes sensitive is reported again
+    if (!verdict.sensitive) {
+        struct stat st;
+        if (fstat(job.fd, &st) == 0 && toNanoseconds(st.st_mtim) == job.mtime_ns &&
+            fanotify_mark(fanotify_fd_, FAN_MARK_ADD | FAN_MARK_IGNORED_MASK, PERMISSION_EVENTS,
+                          job.fd, nullptr) == 0) {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.ignore_marks++;
+        }
+    }
+}
+
+bool FanotifyEnforcer::enqueueJob(ClassifyJob job) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        // Each inode is classified in the background at most once at a time
+        if (job.request_id == 0 && background_keys_.count(job.key) > 0) {
+            close(job.fd);
+            return false;
+        }
+        if (held_jobs_.size() + background_jobs_.size() >= MAX_QUEUED_JOBS) {
+            // Background jobs only warm the cache; a held open makes room by dropping the newest
+            if (job.request_id == 0 || background_jobs_.empty()) {
+                close(job.fd);
+                return false;
+            }
+            background_keys_.erase(background_jobs_.back().key);
+            close(background_jobs_.back().fd);
+            background_jobs_.pop_back();
+        }
+        if (job.request_id == 0) {
+            background_keys_.insert(job.key);
+            background_jobs_.push_back(std::move(job));
+        } else {
+            held_jobs_.push_back(std::move(job));
+        }
+    }
+    queue_cv_.notify_one();
+    return true;
+}
+
+void FanotifyEnforcer::queueDenial(AccessDenial denial) {
+    bool queued;
+    {
+        // A restricted process retrying a denied file must not grow the queue without bound
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        queued = denials_.size() < MAX_QUEUED_DENIALS;
+        if (queued) {
+            denials_.push_back(std::move(denial));
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.denials++;
+        if (!queued) stats_.unreported_denials++;
+    }
+    if (queued) queue_cv_.notify_one();
+}
+
+void FanotifyEnforcer::respond(int fd, bool allow, std::chrono::steady_clock::time_point received) {
+    struct fanotify_response response;
+    response.fd = fd;
+    response.response = allow ? FAN_ALLOW : FAN_DENY;
+    ssize_t written = write(fanotify_fd_, &response, sizeof(response));
+    (void)written;
+    close(fd);
+
+    uint64_t latency_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - received).count());
+    int bucket = latency_ns < 10000 ? 0 : latency_ns < 100000 ? 1 : latency_ns < 1000000 ? 2 : 3;
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.total_latency_ns += latency_ns;
+    stats_.max_latency_ns = std::max(stats_.max_latency_ns, latency_ns);
+    stats_.latency_buckets[bucket]++;
+}
+
+bool FanotifyEnforcer::completePending(uint64_t request_id, bool allow) {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    auto it = pending_.find(request_id);
+    if (it == pending_.end()) return false;
+
+    respond(it->second.fd, allow, it->second.received);
+    pending_.erase(it);
+    return true;
+}
+
+void FanotifyEnforcer::expirePending() {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t expired = 0;
+
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        if (it->second.deadline <= now) {
+            respond(it->second.fd, true, it->second.received);  // Fail open
+            it = pending_.erase(it);
+            expired++;
+        } else {
+            ++it;
+        }
+    }
+
+    if (expired > 0) {
+        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+        stats_.timeouts += expired;
+    }
+}
+
+bool FanotifyEnforcer::nextTimeout(struct timespec& timeout) {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    if (pending_.empty()) return false;
+
+    auto earliest = std::chrono::steady_clock::time_point::max();
+    for (const auto& [id, pending] : pending_) {
+        earliest = std::min(earliest, pending.deadline);
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        earliest - std::chrono::steady_clock::now()).count();
+    if (remaining < 0) remaining = 0;
+    timeout.tv_sec = static_cast<time_t>(remaining / 1000000000LL);
+    timeout.tv_nsec = static_cast<long>(remaining % 1000000000LL);
+    return true;
+}
+
+void FanotifyEnforcer::countFastAllow() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.fast_allows++;
+}
+
+void FanotifyEnforcer::countCacheHit() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.cache_hits++;
+}
+
+bool FanotifyEnforcer::readComm(int pid, std::string& comm) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    char buffer[64];
+    ssize_t len = read(fd, buffer, sizeof(buffer));
+    close(fd);
+    if (len <= 0) return false;
+
+    comm.assign(buffer, static_cast<size_t>(len));
+    if (!comm.empty() && comm.back() == '\n') comm.pop_back();
+    return true;
+}
+
+std::string FanotifyEnforcer::fdPath(int fd) {
+    char link[64];
+    char target[PATH_MAX];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    ssize_t len = readlink(link, target, sizeof(target) - 1);
+    if (len < 0) return "";
+    return std::string(target, static_cast<size_t>(len));
+}
@@ -0,0 +1,234 @@
+#include "feature_baselines.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+namespace {
+    constexpr size_t ROW_ALIGNMENT = 8;  // doubles per 64-byte cache line
+
+    // Samples before a feature, or one hour-of-week bucket of it, is scored
+    constexpr double MIN_SAMPLES = 30.0;
+    constexpr double MIN_SEASONAL_SAMPLES = 30.0;
+
+    // Each bucket sees one week's worth of its hour per update burst, so it forgets slowly
+    constexpr double SEASONAL_ALPHA = 0.02;
+
+    // Mean absolute deviation of a normal distribution is sigma * sqrt(2 / pi)
+    constexpr double DEVIATION_TO_SIGMA = 1.2533;
+
+    // Residuals beyond this many scales are clipped before they update the baseline
+    constexpr double CLIP_SCALES = 4.0;
+
+    // Scale floor: keeps constant and zero baselines from producing infinite scores
+    constexpr double MIN_RELATIVE_SCALE = 0.05;
+    constexpr double MIN_ABSOLUTE_SCALE = 0.25;
+
+    size_t paddedStride(size_t features) {
+        return std::max<size_t>(ROW_ALIGNMENT, (features + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT);
+    }
+
+    inline double robustScale(double deviation, double variance, double mean) {
+        double scale = deviation > 0.0 ? DEVIATION_TO_SIGMA * deviation : std::sqrt(variance);
+        return std::max(scale, MIN_ABSOLUTE_SCALE + MIN_RELATIVE_SCALE * std::fabs(mean));
+    }
+
+    template <typename T>
+    void relayoutArray(std::vector<T>& values, size_t blocks, size_t old_stride, size_t new_stride) {
+        std::vector<T> resized(blocks * new_stride, T(0));
+        for (size_t block = 0; block < blocks; ++block) {
+            std::copy_n(&values[block * old_stride], old_stride, &resized[block * new_stride]);
+        }
+        values.swap(resized);
+    }
+}
+
+FeatureBaselines::FeatureBaselines() : rows_(0), features_(0), stride_(ROW_ALIGNMENT) {}
+
+size_t FeatureBaselines::addRow() {
+    size_t overall = (rows_ + 1) * stride_;
+    count_.resize(overall, 0.0);
+    mean_.resize(overall, 0.0);
+    variance_.resize(overall, 0.0);
+    deviation_.resize(overall, 0.0);
+
+    size_t seasonal = (rows_ + 1) * HOURS_PER_WEEK * stride_;
+    seasonal_count_.resize(seasonal, 0.0f);
+    seasonal_mean_.resize(seasonal, 0.0f);
+    seasonal_deviation_.resize(seasonal, 0.0f);
+    return rows_++;
+}
+
+void FeatureBaselines::ensureFeatures(size_t features) {
+    if (features <= features_) return;
+    features_ = features;
+    if (features > stride_) {
+        relayout(paddedStride(features));
+    }
+}
+
+void FeatureBaselines::relayout(size_t stride) {
+    relayoutArray(count_, rows_, stride_, stride);
+    relayoutArray(mean_, rows_, stride_, stride);
+    relayoutArray(variance_, rows_, stride_, stride);
+    relayoutArray(deviation_, rows_, stride_, stride);
+
+    size_t buckets = rows_ * HOURS_PER_WEEK;
+    relayoutArray(seasonal_count_, buckets, stride_, stride);
+    relayoutArray(seasonal_mean_, buckets, stride_, stride);
+    relayoutArray(seasonal_deviation_, buckets, stride_, stride);
+    stride_ = stride;
+}
+
+void FeatureBaselines::update(size_t row, const FeatureVector& observation, size_t hour_of_week, double alpha) {
+    ensureFeatures(observation.size());
+    hour_of_week %= HOURS_PER_WEEK;
+
+    double* count = &count_[row * stride_];
+    double* mean = &mean_[row * stride_];
+    double* variance = &variance_[row * stride_];
+    double* deviation = &deviation_[row * stride_];
+    float* seasonal_count = &seasonal_count_[seasonalOffset(row, hour_of_week)];
+    float* seasonal_mean = &seasonal_mean_[seasonalOffset(row, hour_of_week)];
+    float* seasonal_deviation = &seasonal_deviation_[seasonalOffset(row, hour_of_week)];
+    const double* x = observation.values.data();
+    const double* present = observation.present.data();
+    const size_t features = observation.size();
+
+    for (size_t i = 0; i < features; ++i) {
+        double p = present[i];
+        double n = count[i] + p;
+
+        // Clip outliers once the scale is trustworthy
+        double limit = count[i] >= MIN_SAMPLES
+            ? CLIP_SCALES * robustScale(deviation[i], variance[i], mean[i])
+            : HUGE_VAL;
+        double diff = std::clamp(x[i] - mean[i], -limit, limit);
+
+        // 1/n is Welford's running average; alpha takes over after 1/alpha samples
+        double weight = p * std::max(alpha, 1.0 / std::max(n, 1.0));
+        double increment = weight * diff;
+        mean[i] += increment;
+        variance[i] = (1.0 - weight) * (variance[i] + diff * increment);
+        deviation[i] += weight * (std::fabs(diff) - deviation[i]);
+        count[i] = n;
+
+        double seasonal_n = seasonal_count[i] + p;
+        double seasonal_diff = std::clamp(x[i] - seasonal_mean[i], -limit, limit);
+        double seasonal_weight = p * std::max(SEASONAL_ALPHA, 1.0 / std::max(seasonal_n, 1.0));
+        seasonal_mean[i] += static_cast<float>(seasonal_weight * seasonal_diff);
+        seasonal_deviation[i] += static_cast<float>(seasonal_weight * (std::fabs(seasonal_diff) - seasonal_deviation[i]));
+        seasonal_count[i] = static_cast<float>(seasonal_n);
+    }
+}
+
+void FeatureBaselines::set(size_t row, FeatureId id, double mean) {
+    ensureFeatures(static_cast<size_t>(id) + 1);
+    size_t index = row * stride_ + id;
+    mean_[index] = mean;
+    count_[index] = std::max(count_[index], 1.0);
+}
+
+size_t FeatureBaselines::rowBytes(size_t features) {
+    return features * (4 * sizeof(double) + 3 * HOURS_PER_WEEK * sizeof(float));
+}
+
+void FeatureBaselines::exportRow(size_t row, std::string& out) const {
+    auto append = [&out](const auto* values, size_t count) {
+        out.append(reinterpret_cast<const char*>(values), count * sizeof(*values));
+    };
+
+    for (const auto* stats : {&count_, &mean_, &variance_, &deviation_}) {
+        append(&(*stats)[row * stride_], features_);
+    }
+    for (const auto* stats : {&seasonal_count_, &seasonal_mean_, &seasonal_deviation_}) {
+        for (size_t hour = 0; hour < HOURS_PER_WEEK; ++hour) {
+            append(&(*stats)[seasonalOffset(row, hour)], features_);
+        }
+    }
+}
+
+void FeatureBaselines::importRow(size_t row, const unsigned char* data, const std::vector<FeatureId>& ids) {
+    if (!ids.empty()) {
+        ensureFeatures(static_cast<size_t>(*std::max_element(ids.begin(), ids.end())) + 1);
+    }
+
+    // The snapshot may sit at any alignment in the mapped file, so values are copied bytewise
+    auto scatter = [&data, &ids](auto* destination) {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            std::memcpy(&destination[ids[i]], data, sizeof(*destination));
+            data += sizeof(*destination);
+        }
+    };
+
+    for (auto* stats : {&count_, &mean_, &variance_, &deviation_}) {
+        scatter(&(*stats)[row * stride_]);
+    }
+    for (auto* stats : {&seasonal_count_, &seasonal_mean_, &seasonal_deviation_}) {
+        for (size_t hour = 0; hour < HOURS_PER_WEEK; ++hour) {
+            scatter(&(*stats)[seasonalOffset(row, hour)]);
+        }
+    }
+}
+
+bool FeatureBaselines::score(size_t row, const FeatureVector& observation, size_t hour_of_week,
+                             BaselineScore& result) const {
+    hour_of_week %= HOURS_PER_WEEK;
+
+    const double* count = &count_[row * stride_];
+    const double* mean = &mean_[row * stride_];
+    const double* variance = &variance_[row * stride_];
+    const double* deviation = &deviation_[row * stride_];
+    const float* seasonal_count = &seasonal_count_[seasonalOffset(row, hour_of_week)];
+    const float* seasonal_mean = &seasonal_mean_[seasonalOffset(row, hour_of_week)];
+    const float* seasonal_deviation = &seasonal_deviation_[seasonalOffset(row, hour_of_week)];
+    const double* x = observation.values.data();
+    const double* present = observation.present.data();
+    const size_t features = std::min(observation.size(), features_);
+
+    auto robust_z = [&](size_t i) {
+        // The hour-of-week bucket is the expectation once it has enough history
+        bool seasonal = seasonal_count[i] >= MIN_SEASONAL_SAMPLES;
+        double expected = seasonal ? seasonal_mean[i] : mean[i];
+        double scale = seasonal
+            ? robustScale(seasonal_deviation[i], variance[i], expected)
+            : robustScale(deviation[i], variance[i], expected);
+        return std::fabs(x[i] - expected) / scale;
+    };
+
+    double max_z = 0.0;
+    double sum_squares = 0.0;
+    double compared = 0.0;
+#ifdef HAVE_OPENMP_SIMD
+#pragma omp simd reduction(max:max_z) reduction(+:sum_squares, compared)
+#endif
+    for (size_t i = 0; i < features; ++i) {
+        double weight = present[i] * (count[i] >= MIN_SAMPLES ? 1.0 : 0.0);
+        double z = weight * robust_z(i);
+        max_z = std::max(max_z, z);
+        sum_squares += z * z;
+        compared += weight;
+    }
+
+    if (compared == 0.0) return false;
+
+    result.max_z = max_z;
+    result.rms_z = std::sqrt(sum_squares / compared);
+    result.compared = static_cast<size_t>(compared);
+    result.top_feature = 0;
+    for (size_t i = 0; i < features; ++i) {
+        if (present[i] != 0.0 && count[i] >= MIN_SAMPLES && robust_z(i) >= max_z) {
+            result.top_feature = static_cast<FeatureId>(i);
+            break;
+        }
+    }
+    return true;
+}
+
+size_t FeatureBaselines::hourOfWeek(std::chrono::system_clock::time_point time) {
+    std::time_t time_t = std::chrono::system_clock::to_time_t(time);
+    std::tm local;
+    localtime_r(&time_t, &local);
+    // tm_wday counts from Sunday
+    return static_cast<size_t>(((local.tm_wday + 6) % 7) * 24 + local.tm_hour);
+}
@@ -0,0 +1,213 @@
+#include "feature_extractor.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <ctime>
+
+namespace {
+    // Ring buckets per window; 30 gives 10-second granularity over five minutes
+    constexpr size_t WINDOW_BUCKETS = 30;
+
+    // Distinct counts slide by the minute; 2^10 registers give about 3% error
+    constexpr size_t SKETCH_BUCKETS = 5;
+    constexpr unsigned SKETCH_PRECISION = 10;
+    constexpr size_t HEAVY_HITTER_CAPACITY = 16;
+
+    constexpr size_t MAX_USERS = 256;
+    const std::chrono::hours USER_RETENTION(1);
+}
+
+std::string FeatureExtractor::focusedApplication(const ActivityEvent& event) {
+    // ActivityMonitor reports focus changes as "Window focus changed - <app> (<title>)"
+    static const std::string prefix = "Window focus changed - ";
+    if (event.type != "window" || event.details.compare(0, prefix.size(), prefix) != 0) return "";
+    std::string app = event.details.substr(prefix.size());
+    size_t title = app.find(" (");
+    return title == std::string::npos ? app : app.substr(0, title);
+}
+
+FeatureExtractor::UserWindows::UserWindows(std::chrono::seconds window)
+    : keystrokes(window, WINDOW_BUCKETS),
+      mouse_events(window, WINDOW_BUCKETS),
+      app_switches(window, WINDOW_BUCKETS),
+      focused_apps(window, SKETCH_BUCKETS, SKETCH_PRECISION),
+      input_events(window, WINDOW_BUCKETS),
+      after_hours_events(window, WINDOW_BUCKETS),
+      dlp_events(window, WINDOW_BUCKETS),
+      outbound_bytes(window, WINDOW_BUCKETS),
+      new_processes(window, WINDOW_BUCKETS),
+      destinations(window, SKETCH_BUCKETS, SKETCH_PRECISION),
+      files(window, SKETCH_BUCKETS, SKETCH_PRECISION),
+      destination_bytes(window, HEAVY_HITTER_CAPACITY) {}
+
+FeatureExtractor::FeatureExtractor(FeatureSchema& schema, std::chrono::seconds window)
+    : window_(window), work_start_hour_(8), work_end_hour_(18), after_hours_minute_(-1), after_hours_(false) {
+    keystrokes_per_min_ = schema.registerFeature("keystrokes_per_min");
+    mouse_events_per_min_ = schema.registerFeature("mouse_events_per_min");
+    app_switches_per_min_ = schema.registerFeature("app_switches_per_min");
+    distinct_apps_ = schema.registerFeature("distinct_apps");
+    after_hours_ratio_ = schema.registerFeature("after_hours_ratio");
+    dlp_events_ = schema.registerFeature("dlp_events");
+    outbound_bytes_ = schema.registerFeature("outbound_bytes");
+    new_processes_ = schema.registerFeature("new_processes");
+    distinct_destinations_ = schema.registerFeature("distinct_destinations");
+    distinct_files_ = schema.registerFeature("distinct_files");
+    top_destination_share_ = schema.registerFeature("top_destination_share");
+    feature_count_ = schema.size();
+}
+
+void FeatureExtractor::setWorkingHours(int start_hour, int end_hour) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    work_start_hour_ = start_hour;
+    work_end_hour_ = end_hour;
+    after_hours_minute_ = -1;
+}
+
+void FeatureExtractor::recordActivity(const std::string& user, const ActivityEvent& event) {
+    auto now = std::chrono::system_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    UserWindows& windows = windowsFor(user, now);
+
+    if (event.type == "keyboard") {
+        windows.keystrokes.add(now);
+        recordInput(windows, now);
+    } else if (event.type == "mouse") {
+        windows.mouse_events.add(now);
+        recordInput(windows, now);
+    } else if (event.type == "window") {
+        std::string app = focusedApplication(event);
+        if (!app.empty()) {
+            if (app != windows.focused_app) {
+                windows.app_switches.add(now);
+                windows.focused_app = app;
+            }
+            windows.focused_apps.add(now, std::hash<std::string>{}(app));
+        }
+        recordInput(windows, now);
+    }
+}
+
+void FeatureExtractor::recordDLPEvent(const std::string& user, const DLPEvent&) {
+    auto now = std::chrono::system_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    UserWindows& windows = windowsFor(user, now);
+
+    windows.dlp_events.add(now);
+}
+
+void FeatureExtractor::recordDataObservation(const std::string& user, const DataObservation& observation) {
+    auto now = std::chrono::system_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    UserWindows& windows = windowsFor(user, now);
+
+    // Violations are reported separately as DLP events; volume and distinct
+    // counts come from everything observed so they do not depend on policy
+    if (!observation.file_path.empty()) {
+        windows.files.add(now, std::hash<std::string>{}(observation.file_path));
+    }
+    if (!observation.host.empty()) {
+        windows.destinations.add(now, std::hash<std::string>{}(observation.host));
+        if (observation.bytes > 0) {
+            windows.destination_bytes.add(now, observation.host, static_cast<double>(observation.bytes));
+        }
+    }
+    if (observation.bytes > 0) {
+        windows.outbound_bytes.add(now, static_cast<double>(observation.bytes));
+    }
+}
+
+void FeatureExtractor::recordProcessExec(const std::string& user, const ProcessExec&) {
+    auto now = std::chrono::system_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    windowsFor(user, now).new_processes.add(now);
+}
+
+std::vector<std::string> FeatureExtractor::activeUsers(std::chrono::system_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<std::string> users;
+    for (auto it = users_.begin(); it != users_.end();) {
+        if (now - it->second.last_seen > USER_RETENTION) {
+            it = users_.erase(it);
+        } else {
+            users.push_back(it->first);
+            ++it;
+        }
+    }
+    return users;
+}
+
+FeatureVector FeatureExtractor::extract(const std::string& user, std::chrono::system_clock::time_point now) {
+    FeatureVector features(feature_count_);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = users_.find(user);
+    if (it == users_.end()) return features;
+    UserWindows& windows = it->second;
+
+    double minutes = std::chrono::duration<double, std::ratio<60>>(window_).count();
+    double input_events = windows.input_events.sum(now);
+
+    features.set(keystrokes_per_min_, windows.keystrokes.sum(now) / minutes);
+    features.set(mouse_events_per_min_, windows.mouse_events.sum(now) / minutes);
+    features.set(app_switches_per_min_, windows.app_switches.sum(now) / minutes);
+    features.set(distinct_apps_, std::round(windows.focused_apps.count(now)));
+    features.set(after_hours_ratio_, input_events > 0 ? windows.after_hours_events.sum(now) / input_events : 0.0);
+    features.set(dlp_events_, windows.dlp_events.sum(now));
+    features.set(outbound_bytes_, windows.outbound_bytes.sum(now));
+    features.set(new_processes_, windows.new_processes.sum(now));
+    features.set(distinct_destinations_, std::round(windows.destinations.count(now)));
+    features.set(distinct_files_, std::round(windows.files.count(now)));
+
+    // Share of outbound bytes that went to the single heaviest destination
+    double destination_total = windows.destination_bytes.total(now);
+    auto heaviest = windows.destination_bytes.top(now, 1);
+    features.set(top_destination_share_,
+                 destination_total > 0 && !heaviest.empty() ? heaviest[0].second / destination_total : 0.0);
+    return features;
+}
+
+std::vector<std::pair<std::string, double>> FeatureExtractor::topDestinations(
+    const std::string& user, std::chrono::system_clock::time_point now, size_t k) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = users_.find(user);
+    if (it == users_.end()) return {};
+    return it->second.destination_bytes.top(now, k);
+}
+
+FeatureExtractor::UserWindows& FeatureExtractor::windowsFor(const std::string& user,
+                                                            std::chrono::system_clock::time_point now) {
+    auto it = users_.find(user);
+    if (it == users_.end()) {
+        if (users_.size() >= MAX_USERS) {
+            auto idlest = std::min_element(users_.begin(), users_.end(), [](const auto& a, const auto& b) {
+                return a.second.last_seen < b.second.last_seen;
+            });
+            users_.erase(idlest);
+        }
+        it = users_.emplace(user, UserWindows(window_)).first;
+    }
+    it->second.last_seen = now;
+    return it->second;
+}
+
+bool FeatureExtractor::isAfterHours(std::chrono::system_clock::time_point time) {
+    // Input events arrive in bursts; the local-time conversion is done once a minute
+    int64_t minute = std::chrono::duration_cast<std::chrono::minutes>(time.time_since_epoch()).count();
+    if (minute == after_hours_minute_) return after_hours_;
+
+    std::time_t time_t = std::chrono::system_clock::to_time_t(time);
+    std::tm local;
+    localtime_r(&time_t, &local);
+    bool weekend = local.tm_wday == 0 || local.tm_wday == 6;
+    after_hours_ = weekend || local.tm_hour < work_start_hour_ || local.tm_hour >= work_end_hour_;
+    after_hours_minute_ = minute;
+    return after_hours_;
+}
+
+void FeatureExtractor::recordInput(UserWindows& windows, std::chrono::system_clock::time_point time) {
+    windows.input_events.add(time);
+    if (isAfterHours(time)) {
+        windows.after_hours_events.add(time);
+    }
+}
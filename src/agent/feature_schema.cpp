@@ -0,0 +1,42 @@
+#include "feature_schema.h"
+#include <algorithm>
+
+FeatureId FeatureSchema::registerFeature(const std::string& name) {
+    auto it = index_.find(name);
+    if (it != index_.end()) return it->second;
+
+    FeatureId id = static_cast<FeatureId>(names_.size());
+    names_.push_back(name);
+    index_.emplace(name, id);
+    return id;
+}
+
+bool FeatureSchema::lookup(const std::string& name, FeatureId& id) const {
+    auto it = index_.find(name);
+    if (it == index_.end()) return false;
+    id = it->second;
+    return true;
+}
+
+FeatureVector FeatureSchema::vectorize(const std::unordered_map<std::string, double>& metrics) {
+    for (const auto& [name, value] : metrics) {
+        registerFeature(name);
+    }
+
+    FeatureVector vector(names_.size());
+    for (const auto& [name, value] : metrics) {
+        vector.set(index_[name], value);
+    }
+    return vector;
+}
+
+std::unordered_map<std::string, double> FeatureSchema::toMap(const FeatureVector& vector) const {
+    std::unordered_map<std::string, double> metrics;
+    size_t count = std::min(vector.size(), names_.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (vector.present[i] != 0.0) {
+            metrics[names_[i]] = vector.values[i];
+        }
+    }
+    return metrics;
+}
@@ -0,0 +1,95 @@
+#include "hyperloglog.h"
+#include "hash_mix.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr unsigned MIN_PRECISION = 4;
+    constexpr unsigned MAX_PRECISION = 16;
+}
+
+HyperLogLog::HyperLogLog(unsigned precision)
+    : precision_(std::clamp(precision, MIN_PRECISION, MAX_PRECISION)),
+      registers_(size_t(1) << precision_, 0) {}
+
+void HyperLogLog::add(uint64_t key_hash) {
+    // Callers pass std::hash values, which need not be well mixed
+    uint64_t hash = mixHash(key_hash);
+    size_t index = static_cast<size_t>(hash >> (64 - precision_));
+    uint64_t rest = hash << precision_;
+    uint8_t rank = rest == 0 ? static_cast<uint8_t>(64 - precision_ + 1)
+                             : static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    registers_[index] = std::max(registers_[index], rank);
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    if (other.registers_.size() != registers_.size()) return;
+    for (size_t i = 0; i < registers_.size(); ++i) {
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    return estimate(registers_.data(), registers_.size());
+}
+
+double HyperLogLog::estimate(const uint8_t* registers, size_t count) {
+    double m = static_cast<double>(count);
+    double alpha = count == 16 ? 0.673 : count == 32 ? 0.697 : count == 64 ? 0.709 : 0.7213 / (1.0 + 1.079 / m);
+
+    double harmonic = 0.0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < count; ++i) {
+        harmonic += std::ldexp(1.0, -registers[i]);
+        zeros += registers[i] == 0;
+    }
+
+    double raw = alpha * m * m / harmonic;
+    if (raw <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / static_cast<double>(zeros));  // Linear counting
+    }
+    return raw;
+}
+
+void HyperLogLog::clear() {
+    std::fill(registers_.begin(), registers_.end(), 0);
+}
+
+SlidingHyperLogLog::SlidingHyperLogLog(std::chrono::seconds window, size_t buckets, unsigned precision)
+    : bucket_ms_(std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(window).count() /
+                                          static_cast<int64_t>(std::max<size_t>(buckets, 1)))),
+      epochs_(std::max<size_t>(buckets, 1), -1),
+      sketches_(std::max<size_t>(buckets, 1), HyperLogLog(precision)) {}
+
+int64_t SlidingHyperLogLog::epochOf(std::chrono::system_clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() / bucket_ms_;
+}
+
+void SlidingHyperLogLog::add(std::chrono::system_clock::time_point time, uint64_t key_hash) {
+    int64_t epoch = epochOf(time);
+    size_t slot = static_cast<size_t>(epoch) % sketches_.size();
+    if (epochs_[slot] != epoch) {
+        // An older epoch in this slot has slid out of the window
+        if (epochs_[slot] > epoch) return;
+        epochs_[slot] = epoch;
+        sketches_[slot].clear();
+    }
+    sketches_[slot].add(key_hash);
+}
+
+double SlidingHyperLogLog::count(std::chrono::system_clock::time_point now) const {
+    int64_t current = epochOf(now);
+    int64_t oldest = current - static_cast<int64_t>(sketches_.size()) + 1;
+
+    std::vector<uint8_t> merged(sketches_[0].registers().size(), 0);
+    bool any = false;
+    for (size_t slot = 0; slot < sketches_.size(); ++slot) {
+        if (epochs_[slot] < oldest || epochs_[slot] > current) continue;
+        const auto& registers = sketches_[slot].registers();
+        for (size_t i = 0; i < merged.size(); ++i) {
+            merged[i] = std::max(merged[i], registers[i]);
+        }
+        any = true;
+    }
+    return any ? HyperLogLog::estimate(merged.data(), merged.size()) : 0.0;
+}
@@ -0,0 +1,285 @@
+#include "isolation_forest.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <random>
+
+namespace {
+    // Random features tried at a node before it becomes a leaf because nothing splits
+    constexpr int SPLIT_ATTEMPTS = 8;
+
+    const std::chrono::seconds TRAINING_POLL(30);
+
+    constexpr size_t MAX_USERS = 256;
+    const std::chrono::hours USER_RETENTION(24);
+
+    // Calibration: the threshold sits this far above the given quantile of training scores
+    constexpr double CALIBRATION_QUANTILE = 0.995;
+    constexpr double CALIBRATION_MARGIN = 0.04;
+    constexpr double MIN_THRESHOLD = 0.6;
+
+    struct TreeBuilder {
+        const std::vector<float>& samples;
+        size_t dims;      // Row stride
+        size_t features;  // Features eligible for splits
+        std::mt19937_64& rng;
+        uint16_t* split_feature;
+        float* split_value;
+        double (*path_length)(size_t);
+        uint16_t leaf;
+        size_t max_depth;
+
+        void build(size_t node, size_t depth, size_t* begin, size_t* end) {
+            size_t n = static_cast<size_t>(end - begin);
+            if (depth < max_depth && n > 1) {
+                std::uniform_int_distribution<size_t> pick_feature(0, features - 1);
+                for (int attempt = 0; attempt < SPLIT_ATTEMPTS; ++attempt) {
+                    size_t feature = pick_feature(rng);
+                    float low = samples[*begin * dims + feature];
+                    float high = low;
+                    for (size_t* it = begin + 1; it != end; ++it) {
+                        float value = samples[*it * dims + feature];
+                        low = std::min(low, value);
+                        high = std::max(high, value);
+                    }
+                    if (!(low < high)) continue;
+
+                    float threshold = std::uniform_real_distribution<float>(low, high)(rng);
+                    if (threshold <= low) threshold = high;  // Keep both sides non-empty
+                    size_t* middle = std::partition(begin, end, [&](size_t row) {
+                        return samples[row * dims + feature] < threshold;
+                    });
+
+                    split_feature[node] = static_cast<uint16_t>(feature);
+                    split_value[node] = threshold;
+                    build(2 * node + 1, depth + 1, begin, middle);
+                    build(2 * node + 2, depth + 1, middle, end);
+                    return;
+                }
+            }
+
+            // Unsplit points would have needed c(n) more splits on average
+            split_feature[node] = leaf;
+            split_value[node] = static_cast<float>(depth + path_length(n));
+        }
+    };
+}
+
+IsolationForest::IsolationForest(const std::vector<float>& samples, size_t dims, uint64_t seed)
+    : dims_(std::min<size_t>(dims, LEAF)),
+      normalizer_(averagePathLength(SUBSAMPLE)),
+      threshold_(1.0),
+      split_feature_(TREES * NODES_PER_TREE, LEAF),
+      split_value_(TREES * NODES_PER_TREE, 0.0f) {
+    size_t sample_count = dims == 0 ? 0 : samples.size() / dims;
+    if (sample_count == 0 || dims_ == 0) return;
+
+    std::mt19937_64 rng(seed);
+    std::vector<size_t> rows(sample_count);
+    for (size_t i = 0; i < sample_count; ++i) rows[i] = i;
+    size_t subsample = std::min(SUBSAMPLE, sample_count);
+
+    for (size_t tree = 0; tree < TREES; ++tree) {
+        // Partial Fisher-Yates shuffle draws the subsample without replacement
+        for (size_t i = 0; i < subsample; ++i) {
+            std::uniform_int_distribution<size_t> pick(i, sample_count - 1);
+            std::swap(rows[i], rows[pick(rng)]);
+        }
+
+        TreeBuilder builder{samples, dims, dims_, rng, &split_feature_[tree * NODES_PER_TREE],
+                            &split_value_[tree * NODES_PER_TREE], &averagePathLength, LEAF, MAX_DEPTH};
+        builder.build(0, 0, rows.data(), rows.data() + subsample);
+    }
+
+    std::vector<double> training_scores(sample_count);
+    for (size_t i = 0; i < sample_count; ++i) {
+        const float* row = &samples[i * dims];
+        training_scores[i] = scoreWith([row](size_t feature) { return static_cast<double>(row[feature]); });
+    }
+    auto quantile = training_scores.begin() + static_cast<ptrdiff_t>(CALIBRATION_QUANTILE * (sample_count - 1));
+    std::nth_element(training_scores.begin(), quantile, training_scores.end());
+    threshold_ = std::max(MIN_THRESHOLD, *quantile + CALIBRATION_MARGIN);
+}
+
+double IsolationForest::averagePathLength(size_t n) {
+    if (n <= 1) return 0.0;
+    if (n == 2) return 1.0;
+    constexpr double EULER_GAMMA = 0.5772156649;
+    double harmonic = std::log(static_cast<double>(n - 1)) + EULER_GAMMA;
+    return 2.0 * harmonic - 2.0 * static_cast<double>(n - 1) / static_cast<double>(n);
+}
+
+double IsolationForest::score(const FeatureVector& observation) const {
+    const double* values = observation.values.data();
+    size_t observed = observation.size();
+    return scoreWith([values, observed](size_t feature) { return feature < observed ? values[feature] : 0.0; });
+}
+
+template <typename ValueOf>
+double IsolationForest::scoreWith(ValueOf value_of) const {
+    double total_path = 0.0;
+    for (size_t tree = 0; tree < TREES; ++tree) {
+        const uint16_t* feature = &split_feature_[tree * NODES_PER_TREE];
+        const float* value = &split_value_[tree * NODES_PER_TREE];
+
+        size_t node = 0;
+        while (feature[node] != LEAF) {
+            node = 2 * node + (value_of(feature[node]) < value[node] ? 1 : 2);
+        }
+        total_path += value[node];
+    }
+    return std::exp2(-(total_path / TREES) / normalizer_);
+}
+
+UserForests::UserForests() : stopping_(false), seed_(std::random_device{}()) {
+    training_thread_ = std::thread(&UserForests::trainingLoop, this);
+}
+
+UserForests::~UserForests() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (training_thread_.joinable()) {
+        training_thread_.join();
+    }
+}
+
+void UserForests::addSample(const std::string& user, const FeatureVector& observation) {
+    std::vector<float> row(observation.size());
+    for (size_t i = 0; i < row.size(); ++i) {
+        row[i] = static_cast<float>(observation.values[i] * observation.present[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    UserSamples& samples = samplesFor(user);
+    if (samples.rows.size() < MAX_SAMPLES) {
+        samples.rows.push_back(std::move(row));
+    } else {
+        samples.rows[samples.next] = std::move(row);
+    }
+    samples.next = (samples.next + 1) % MAX_SAMPLES;
+    samples.since_training++;
+
+    if (!samples.training && samples.rows.size() >= MIN_TRAINING_SAMPLES &&
+        (samples.since_training >= RETRAIN_AFTER || !samples.forest)) {
+        samples.training = true;
+        wake_.notify_one();
+    }
+}
+
+bool UserForests::score(const std::string& user, const FeatureVector& observation, double& result,
+                        double& threshold) const {
+    std::shared_ptr<const IsolationForest> forest;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = users_.find(user);
+        if (it == users_.end() || !it->second.forest) return false;
+        forest = it->second.forest;
+    }
+    result = forest->score(observation);
+    threshold = forest->threshold();
+    return true;
+}
+
+std::unordered_map<std::string, std::vector<std::vector<float>>> UserForests::samples() const {
+    std::unordered_map<std::string, std::vector<std::vector<float>>> copies;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [user, samples] : users_) {
+        auto& rows = copies[user];
+        size_t count = samples.rows.size();
+        size_t oldest = count < MAX_SAMPLES ? 0 : samples.next;
+        rows.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            rows.push_back(samples.rows[(oldest + i) % count]);
+        }
+    }
+    return copies;
+}
+
+void UserForests::restoreSamples(const std::string& user, std::vector<std::vector<float>> rows) {
+    if (rows.size() > MAX_SAMPLES) {
+        rows.erase(rows.begin(), rows.end() - MAX_SAMPLES);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    UserSamples& samples = samplesFor(user);
+    samples.rows = std::move(rows);
+    samples.next = samples.rows.size() % MAX_SAMPLES;
+    samples.since_training = samples.rows.size();
+    if (!samples.training && samples.rows.size() >= MIN_TRAINING_SAMPLES) {
+        samples.training = true;
+        wake_.notify_one();
+    }
+}
+
+UserForests::UserSamples& UserForests::samplesFor(const std::string& user) {
+    auto it = users_.find(user);
+    if (it == users_.end()) {
+        if (users_.size() >= MAX_USERS) {
+            auto idlest = std::min_element(users_.begin(), users_.end(), [](const auto& a, const auto& b) {
+                return a.second.last_seen < b.second.last_seen;
+            });
+            users_.erase(idlest);
+        }
+        it = users_.emplace(user, UserSamples{}).first;
+    }
+    it->second.last_seen = std::chrono::steady_clock::now();
+    return it->second;
+}
+
+void UserForests::dropIdleUsers() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = users_.begin(); it != users_.end();) {
+        if (!it->second.training && now - it->second.last_seen > USER_RETENTION) {
+            it = users_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void UserForests::trainingLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        dropIdleUsers();
+
+        // Users flagged for training by addSample
+        std::deque<std::string> pending;
+        for (const auto& entry : users_) {
+            if (entry.second.training) pending.push_back(entry.first);
+        }
+        if (pending.empty()) {
+            wake_.wait_for(lock, TRAINING_POLL);
+            continue;
+        }
+
+        for (const auto& user : pending) {
+            if (stopping_) break;
+            auto it = users_.find(user);
+            if (it == users_.end()) continue;
+
+            // Copy the samples out so analysis keeps running while the forest is built
+            size_t dims = 0;
+            for (const auto& row : it->second.rows) dims = std::max(dims, row.size());
+            std::vector<float> flat(it->second.rows.size() * dims, 0.0f);
+            for (size_t r = 0; r < it->second.rows.size(); ++r) {
+                std::copy(it->second.rows[r].begin(), it->second.rows[r].end(), flat.begin() + r * dims);
+            }
+            it->second.since_training = 0;
+            uint64_t seed = seed_++;
+
+            lock.unlock();
+            auto forest = std::make_shared<const IsolationForest>(flat, dims, seed);
+            lock.lock();
+
+            it = users_.find(user);
+            if (it != users_.end()) {
+                it->second.forest = std::move(forest);
+                it->second.training = false;
+            }
+        }
+    }
+}
@@ -4,11 +4,10 @@
 #include <iomanip>
 #include <algorithm>
 #include <random>
+#include <cctype>
+#include <cmath>
 #include <nlohmann/json.hpp>
-
-// For HTTP requests to LLM APIs
-#include <curl/curl.h>
-#include <openssl/ssl.h>
+#include "hash_mix.h"
 
 // For local model support
 #ifdef USE_LOCAL_MODELS
@@ -20,11 +19,220 @@
 using json = nlohmann::json;
 
 namespace {
-    // cURL write callback
-    size_t writeCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
-        size_t total_size = size * nmemb;
-        output->append(static_cast<char*>(contents), total_size);
-        return total_size;
+    constexpr const char* SYSTEM_PROMPT =
+        "You are an expert cybersecurity analyst specializing in behavioral analysis and insider threat "
+        "detection. Analyze user behavior patterns and provide detailed insights.";
+
+    // Recent activities compared when deciding whether a context changed
+    constexpr size_t PROMPT_ACTIVITIES = 20;
+    // Distinct activities listed in a user's compact summary
+    constexpr size_t SUMMARY_ACTIVITIES = 10;
+
+    constexpr const char* BATCH_PROMPT_HEADER =
+        "Analyze the following users' behavior for security risks and anomalies. "
+        "Each section starts with the user's ID; activity counts are over the recent window.\n\n";
+
+    constexpr const char* BATCH_PROMPT_FOOTER = R"(For each user, assess the risk level, the behavioral patterns you see, potential
+security concerns, your confidence and recommended actions.
+
+Respond with one JSON object keyed by user ID, with an entry for every user above:
+{
+    "<user id>": {
+        "risk_level": "low|medium|high|critical",
+        "confidence_score": 0.0-1.0,
+        "patterns": ["pattern1", "pattern2"],
+        "concerns": ["concern1", "concern2"],
+        "analysis": "detailed analysis text",
+        "recommendations": ["rec1", "rec2"]
+    }
+}
+)";
+
+    constexpr std::chrono::seconds SCHEDULER_TICK(1);
+
+    double roundToSignificant(double value, int digits) {
+        if (value == 0.0 || !std::isfinite(value)) return value;
+        double scale = std::pow(10.0, digits - 1 - static_cast<int>(std::floor(std::log10(std::fabs(value)))));
+        return std::round(value * scale) / scale;
+    }
+
+    // Numbers in descriptions (confidences, z-scores) vary on every pass; mask them
+    std::string maskNumbers(const std::string& text) {
+        std::string masked;
+        masked.reserve(text.size());
+        bool in_number = false;
+        for (char c : text) {
+            bool numeric = std::isdigit(static_cast<unsigned char>(c)) || (in_number && c == '.');
+            if (numeric) {
+                if (!in_number) masked += '#';
+            } else {
+                masked += c;
+            }
+            in_number = numeric;
+        }
+        return masked;
+    }
+
+    ContextFingerprint fingerprintOf(const UserBehaviorContext& context) {
+        std::hash<std::string> hasher;
+        ContextFingerprint fingerprint;
+        uint64_t hash = hasher(context.user_id);
+
+        std::vector<std::pair<std::string, double>> metrics;
+        for (const auto& [name, value] : context.behavior_metrics) {
+            metrics.emplace_back(name, roundToSignificant(value, 2));
+        }
+        std::sort(metrics.begin(), metrics.end());
+        for (const auto& [name, value] : metrics) {
+            hash = combineHash(hash, hasher(name));
+            hash = combineHash(hash, std::hash<double>()(value));
+            fingerprint.metrics[name] = value;
+        }
+
+        size_t first = context.recent_activities.size() > PROMPT_ACTIVITIES
+                           ? context.recent_activities.size() - PROMPT_ACTIVITIES : 0;
+        for (size_t i = first; i < context.recent_activities.size(); ++i) {
+            fingerprint.activities.push_back(maskNumbers(context.recent_activities[i]));
+            hash = combineHash(hash, hasher(fingerprint.activities.back()));
+        }
+
+        fingerprint.risk_indicators = context.risk_indicators;
+        std::sort(fingerprint.risk_indicators.begin(), fingerprint.risk_indicators.end());
+        for (const auto& indicator : fingerprint.risk_indicators) {
+            hash = combineHash(hash, hasher(indicator));
+        }
+
+        fingerprint.hash = hash;
+        return fingerprint;
+    }
+
+    size_t batchFrameChars() {
+        return std::char_traits<char>::length(BATCH_PROMPT_HEADER) +
+               std::char_traits<char>::length(BATCH_PROMPT_FOOTER);
+    }
+
+    // Providers reserve max_tokens up front, so ask for what the batch needs
+    int batchResponseTokens(size_t users) {
+        return std::max(LLMBehaviorAnalyzer::MAX_RESPONSE_TOKENS,
+                        LLMBehaviorAnalyzer::RESPONSE_TOKENS_PER_USER * static_cast<int>(users));
+    }
+
+    // Distinct recent activities with counts, rounded metrics and risk indicators;
+    // a fraction of formatBehaviorData's size so many users fit in one prompt
+    std::string summarizeBehavior(const UserBehaviorContext& context) {
+        std::vector<std::pair<std::string, int>> activities;  // Newest first
+        std::unordered_map<std::string, size_t> index;
+        for (auto it = context.recent_activities.rbegin(); it != context.recent_activities.rend(); ++it) {
+            auto found = index.find(*it);
+            if (found != index.end()) {
+                activities[found->second].second++;
+            } else {
+                index.emplace(*it, activities.size());
+                activities.emplace_back(*it, 1);
+            }
+        }
+
+        std::stringstream ss;
+        ss << "Activities (" << context.recent_activities.size() << " recent, " << activities.size()
+           << " distinct):\n";
+        for (size_t i = 0; i < activities.size() && i < SUMMARY_ACTIVITIES; ++i) {
+            ss << "- " << activities[i].first;
+            if (activities[i].second > 1) ss << " (x" << activities[i].second << ")";
+            ss << "\n";
+        }
+
+        std::vector<std::pair<std::string, double>> metrics(context.behavior_metrics.begin(),
+                                                            context.behavior_metrics.end());
+        std::sort(metrics.begin(), metrics.end());
+        ss << "Metrics:";
+        for (size_t i = 0; i < metrics.size(); ++i) {
+            ss << (i ? ", " : " ") << metrics[i].first << "=" << roundToSignificant(metrics[i].second, 2);
+        }
+        ss << "\n";
+
+        if (!context.risk_indicators.empty()) {
+            ss << "Risk indicators:";
+            for (size_t i = 0; i < context.risk_indicators.size(); ++i) {
+                ss << (i ? "; " : " ") << context.risk_indicators[i];
+            }
+            ss << "\n";
+        }
+        return ss.str();
+    }
+
+    LLMBehaviorInsight insightFromJson(const json& entry, const std::string& user_id) {
+        LLMBehaviorInsight insight;
+        insight.user = user_id;
+        insight.timestamp = std::chrono::system_clock::now();
+        insight.severity = entry.value("risk_level", "medium");
+        insight.confidence_score = entry.value("confidence_score", 0.5);
+        insight.analysis = entry.value("analysis", "Analysis completed");
+
+        if (entry.contains("patterns") && !entry["patterns"].empty()) {
+            insight.description = "Detected patterns: ";
+            for (const auto& pattern : entry["patterns"]) {
+                insight.description += pattern.get<std::string>() + ", ";
+            }
+            insight.description = insight.description.substr(0, insight.description.size() - 2);
+        }
+
+        if (entry.contains("recommendations")) {
+            for (const auto& rec : entry["recommendations"]) {
+                insight.recommendations.push_back(rec.get<std::string>());
+            }
+        }
+
+        // Determine insight type based on severity
+        if (insight.severity == "critical" || insight.severity == "high") {
+            insight.insight_type = "alert";
+        } else if (!insight.recommendations.empty()) {
+            insight.insight_type = "recommendation";
+        } else {
+            insight.insight_type = "pattern";
+        }
+        return insight;
+    }
+
+    std::string describeUsers(const std::vector<std::string>& user_ids) {
+        std::string text = user_ids.size() == 1 ? "user " : "users ";
+        for (size_t i = 0; i < user_ids.size(); ++i) {
+            text += (i ? ", " : "") + user_ids[i];
+        }
+        return text;
+    }
+
+    // 0 for equivalent contexts, 1 for entirely different ones
+    double contextDelta(const ContextFingerprint& previous, const ContextFingerprint& current) {
+        if (previous.hash == current.hash) return 0.0;
+        if (previous.risk_indicators != current.risk_indicators) return 1.0;
+
+        double delta = 0.0;
+        for (const auto& [name, value] : current.metrics) {
+            auto it = previous.metrics.find(name);
+            if (it == previous.metrics.end()) return 1.0;
+            double scale = std::max({std::fabs(value), std::fabs(it->second), 1.0});
+            delta = std::max(delta, std::fabs(value - it->second) / scale);
+        }
+        if (previous.metrics.size() != current.metrics.size()) return 1.0;
+
+        // Share of the current activities that were not in the previous prompt
+        std::unordered_map<std::string, int> seen;
+        for (const auto& activity : previous.activities) {
+            seen[activity]++;
+        }
+        size_t changed = 0;
+        for (const auto& activity : current.activities) {
+            auto it = seen.find(activity);
+            if (it != seen.end() && it->second > 0) {
+                it->second--;
+            } else {
+                changed++;
+            }
+        }
+        if (!current.activities.empty()) {
+            delta = std::max(delta, static_cast<double>(changed) / current.activities.size());
+        }
+        return delta;
     }
 
     // Helper function to get current timestamp as string
@@ -43,7 +251,13 @@ LLMBehaviorAnalyzer::LLMBehaviorAnalyzer()
       llm_provider_("openai"),
       openai_model_("gpt-4"),
       anthropic_model_("claude-3-sonnet-20240229"),
-      analysis_interval_(300) {  // 5 minutes default
+      openai_url_("https://api.openai.com/v1/chat/completions"),
+      anthropic_url_("https://api.anthropic.com/v1/messages"),
+      request_timeout_(60),
+      analysis_interval_(300),  // 5 minutes default
+      change_threshold_(0.1),
+      cache_ttl_(3600),
+      batch_size_(DEFAULT_BATCH_USERS) {
 }
 
 LLMBehaviorAnalyzer::~LLMBehaviorAnalyzer() {
@@ -66,10 +280,51 @@ void LLMBehaviorAnalyzer::setModel(const std::string& provider, const std::strin
     }
 }
 
+void LLMBehaviorAnalyzer::setProvider(const std::string& provider) {
+    llm_provider_ = provider;
+}
+
+void LLMBehaviorAnalyzer::setEndpoint(const std::string& provider, const std::string& url) {
+    if (provider == "openai") {
+        openai_url_ = url;
+    } else if (provider == "anthropic") {
+        anthropic_url_ = url;
+    }
+}
+
+void LLMBehaviorAnalyzer::setMaxConcurrentRequests(const std::string& provider, size_t limit) {
+    http_client_.setConcurrencyLimit(provider, limit);
+}
+
+void LLMBehaviorAnalyzer::setRequestTimeout(std::chrono::seconds timeout) {
+    request_timeout_ = timeout;
+}
+
+void LLMBehaviorAnalyzer::setRateLimits(const std::string& provider, double requests_per_minute,
+                                         double tokens_per_minute) {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    budgets_[provider].setLimits(requests_per_minute, tokens_per_minute);
+}
+
 void LLMBehaviorAnalyzer::setAnalysisInterval(int seconds) {
     analysis_interval_ = seconds;
 }
 
+void LLMBehaviorAnalyzer::setChangeThreshold(double threshold) {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    change_threshold_ = threshold;
+}
+
+void LLMBehaviorAnalyzer::setInsightCacheTTL(std::chrono::seconds ttl) {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    cache_ttl_ = ttl;
+}
+
+void LLMBehaviorAnalyzer::setBatchSize(size_t users) {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    batch_size_ = std::max<size_t>(users, 1);
+}
+
 void LLMBehaviorAnalyzer::enableRealTimeAnalysis(bool enable) {
     real_time_enabled_ = enable;
 }
@@ -77,15 +332,39 @@ void LLMBehaviorAnalyzer::enableRealTimeAnalysis(bool enable) {
 void LLMBehaviorAnalyzer::startAnalysis() {
     if (running_) return;
 
+    http_client_.start();
     running_ = true;
     analysis_thread_ = std::thread(&LLMBehaviorAnalyzer::analysisLoop, this);
+    for (size_t i = 0; i < WORKER_THREADS; ++i) {
+        workers_.emplace_back(&LLMBehaviorAnalyzer::workerLoop, this);
+    }
 }
 
 void LLMBehaviorAnalyzer::stopAnalysis() {
-    running_ = false;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        running_ = false;
+    }
+    queue_cv_.notify_all();
+    schedule_cv_.notify_all();
+
     if (analysis_thread_.joinable()) {
         analysis_thread_.join();
     }
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+    http_client_.stop();
+
+    // Jobs that never ran must be queueable again after a restart
+    std::lock_guard<std::mutex> data_lock(data_mutex_);
+    std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+    jobs_.clear();
+    completed_.clear();
+    for (auto& entry : user_states_) {
+        entry.second.queued = false;
+    }
 }
 
 bool LLMBehaviorAnalyzer::isRunning() const {
@@ -95,237 +374,389 @@ bool LLMBehaviorAnalyzer::isRunning() const {
 void LLMBehaviorAnalyzer::analyzeUserBehavior(const std::string& user_id,
                                             const std::vector<std::string>& activities,
                                             const std::unordered_map<std::string, double>& metrics) {
-    std::lock_guard<std::mutex> lock(data_mutex_);
-
-    // Update user context
-    if (user_contexts_.find(user_id) == user_contexts_.end()) {
-        user_contexts_[user_id] = UserBehaviorContext{user_id, {}, {}, {}, std::chrono::system_clock::now()};
-    }
+    {
+        std::lock_guard<std::mutex> lock(data_mutex_);
 
-    auto& context = user_contexts_[user_id];
-    context.recent_activities.insert(context.recent_activities.end(),
-                                   activities.begin(), activities.end());
-    context.behavior_metrics = metrics;
-    context.last_analysis = std::chrono::system_clock::now();
+        // Update user context
+        UserState& state = stateLocked(user_id);
+        for (const auto& activity : activities) {
+            state.activities.push(activity);
+        }
+        state.metrics = metrics;
 
-    // Keep only recent activities (last 100)
-    if (context.recent_activities.size() > 100) {
-        context.recent_activities.erase(
-            context.recent_activities.begin(),
-            context.recent_activities.end() - 100
-        );
+        // Analyze right away if real-time analysis is enabled
+        if (!real_time_enabled_) return;
+        state.requested = true;
     }
+    requestScheduling();
+}
+
+void LLMBehaviorAnalyzer::updateUserBehavior(const std::string& user_id,
+                                           const std::vector<std::string>& activities,
+                                           const std::unordered_map<std::string, double>& metrics,
+                                           double risk_score) {
+    {
+        std::lock_guard<std::mutex> lock(data_mutex_);
+        UserState& state = stateLocked(user_id);
+        state.activities.clear();
+        for (const auto& activity : activities) {
+            state.activities.push(activity);
+        }
+        state.metrics = metrics;
+        state.risk_score = risk_score;
 
-    // Add to analysis queue if real-time analysis is enabled
-    if (real_time_enabled_) {
-        pending_analyses_.push_back(user_id);
+        if (!real_time_enabled_) return;
+        state.requested = true;
     }
+    requestScheduling();
 }
 
 void LLMBehaviorAnalyzer::addBehaviorData(const std::string& user_id, const std::string& activity) {
     std::lock_guard<std::mutex> lock(data_mutex_);
+    stateLocked(user_id).activities.push(activity);
+}
 
-    if (user_contexts_.find(user_id) == user_contexts_.end()) {
-        user_contexts_[user_id] = UserBehaviorContext{user_id, {}, {}, {}, std::chrono::system_clock::now()};
+void LLMBehaviorAnalyzer::analyzeRiskPatterns(const std::string& user_id) {
+    {
+        std::lock_guard<std::mutex> lock(data_mutex_);
+        auto it = user_states_.find(user_id);
+        if (it == user_states_.end()) {
+            return;
+        }
+        it->second.requested = true;
     }
+    requestScheduling();
+}
 
-    user_contexts_[user_id].recent_activities.push_back(activity);
-
-    // Keep only recent activities
-    if (user_contexts_[user_id].recent_activities.size() > 100) {
-        user_contexts_[user_id].recent_activities.erase(
-            user_contexts_[user_id].recent_activities.begin()
-        );
+void LLMBehaviorAnalyzer::generateSecurityRecommendations(const std::string& user_id) {
+    {
+        std::lock_guard<std::mutex> lock(data_mutex_);
+        auto it = user_states_.find(user_id);
+        if (it == user_states_.end()) {
+            return;
+        }
+        it->second.recommendations_requested = true;
     }
+    requestScheduling();
 }
 
-void LLMBehaviorAnalyzer::analyzeRiskPatterns(const std::string& user_id) {
-    if (user_contexts_.find(user_id) == user_contexts_.end()) {
-        return;
+void LLMBehaviorAnalyzer::requestScheduling() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        schedule_requested_ = true;
     }
+    schedule_cv_.notify_one();
+}
 
-    std::string prompt = buildAnalysisPrompt(user_id);
-    std::string response;
+LLMBehaviorAnalyzer::UserState& LLMBehaviorAnalyzer::stateLocked(const std::string& user_id) {
+    auto it = user_states_.find(user_id);
+    if (it == user_states_.end()) {
+        it = user_states_.emplace(user_id, UserState{}).first;
+        it->second.last_analysis = std::chrono::system_clock::now();
+    }
+    return it->second;
+}
 
-    try {
-        if (llm_provider_ == "openai") {
-            response = analyzeWithOpenAI(prompt);
-        } else if (llm_provider_ == "anthropic") {
-            response = analyzeWithAnthropic(prompt);
-        } else if (llm_provider_ == "local") {
-            response = analyzeWithLocalModel(prompt);
-        }
+UserBehaviorContext LLMBehaviorAnalyzer::snapshotLocked(const std::string& user_id, const UserState& state) const {
+    UserBehaviorContext context;
+    context.user_id = user_id;
+    context.recent_activities.reserve(state.activities.size());
+    for (const auto& activity : state.activities) {
+        context.recent_activities.push_back(activity);
+    }
+    context.behavior_metrics = state.metrics;
+    context.risk_indicators = state.risk_indicators;
+    context.last_analysis = state.last_analysis;
+    return context;
+}
 
-        if (!response.empty()) {
-            LLMBehaviorInsight insight = parseLLMResponse(response, user_id);
-            storeInsight(insight);
+size_t LLMBehaviorAnalyzer::estimateRequestTokens(size_t prompt_chars, int max_tokens) const {
+    // Roughly four characters per token for English and JSON. Providers count
+    // the requested max_tokens against the per-minute limit up front as well.
+    size_t characters = std::char_traits<char>::length(SYSTEM_PROMPT) + prompt_chars;
+    return (characters + 3) / 4 + static_cast<size_t>(max_tokens);
+}
 
-            if (insight_callback_) {
-                insight_callback_(insight);
-            }
+bool LLMBehaviorAnalyzer::scheduleRiskAnalysisLocked(const std::string& user_id, UserState& state,
+                                                     RateBudget* budget, std::chrono::steady_clock::time_point now,
+                                                     PendingBatch& batch) {
+    UserBehaviorContext context = snapshotLocked(user_id, state);
+    ContextFingerprint fingerprint = fingerprintOf(context);
+    auto wall_now = std::chrono::system_clock::now();
+
+    // Nothing worth a new call since the last analysis
+    if (state.analyzed && contextDelta(state.fingerprint, fingerprint) < change_threshold_) {
+        state.requested = false;
+        state.last_analysis = wall_now;
+        return true;
+    }
+
+    auto cached = insight_cache_.find(fingerprint.hash);
+    if (cached != insight_cache_.end() && cached->second.expires > wall_now) {
+        // Seen this exact context before; deliver that analysis through the workers
+        state.requested = false;
+        state.queued = true;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            completed_.push_back(CompletedJob{JobKind::RiskAnalysis, {user_id}, "", {std::move(fingerprint)},
+                                              {cached->second.insight}});
         }
-    } catch (const std::exception& e) {
-        std::cerr << "LLM analysis error for user " << user_id << ": " << e.what() << std::endl;
+        queue_cv_.notify_one();
+        return true;
     }
-}
 
-void LLMBehaviorAnalyzer::generateSecurityRecommendations(const std::string& user_id) {
-    if (user_contexts_.find(user_id) == user_contexts_.end()) {
-        return;
+    std::string section = "User ID: " + user_id + "\n" + summarizeBehavior(context) + "\n";
+
+    // Start a new request once this user would overflow the current one
+    if (!batch.contexts.empty() &&
+        (batch.contexts.size() >= batch_size_ ||
+         estimateRequestTokens(batchFrameChars() + batch.section_chars + section.size(), 0) >
+             MAX_BATCH_PROMPT_TOKENS)) {
+        flushBatchLocked(batch, budget, now);
     }
 
-    std::string prompt = R"(
-Based on the following user behavior data, generate specific security recommendations:
+    // The batch is only paid for when flushed, so check that it still fits with this user in it
+    size_t prompt_chars = batchFrameChars() + batch.section_chars + section.size();
+    int max_tokens = batchResponseTokens(batch.contexts.size() + 1);
+    if (budget && !budget->covers(static_cast<double>(estimateRequestTokens(prompt_chars, max_tokens)), now)) {
+        return false;
+    }
 
-User: )" + user_id + R"(
-Behavior Data: )" + formatBehaviorData(user_id) + R"(
+    state.requested = false;
+    state.queued = true;
+    batch.section_chars += section.size();
+    batch.sections.push_back(std::move(section));
+    batch.contexts.push_back(std::move(context));
+    batch.fingerprints.push_back(std::move(fingerprint));
+    return true;
+}
 
-Please provide:
-1. Specific security recommendations
-2. Risk mitigation strategies
-3. Monitoring suggestions
-4. Policy adjustments if needed
+void LLMBehaviorAnalyzer::flushBatchLocked(PendingBatch& batch, RateBudget* budget,
+                                           std::chrono::steady_clock::time_point now) {
+    if (batch.contexts.empty()) return;
 
-Format as JSON with keys: recommendations, risk_level, actions
-)";
+    int max_tokens = batchResponseTokens(batch.contexts.size());
+    std::string prompt = buildAnalysisPrompt(batch.sections);
+    if (budget) {
+        // covers() already vouched for this batch when its last user was added
+        budget->tryAcquire(static_cast<double>(estimateRequestTokens(prompt.size(), max_tokens)), now);
+    }
+    queueJob(AnalysisJob{JobKind::RiskAnalysis, std::move(batch.contexts), std::move(batch.fingerprints),
+                         std::move(prompt), max_tokens});
+    batch = PendingBatch{};
+}
 
-    try {
-        std::string response;
-        if (llm_provider_ == "openai") {
-            response = analyzeWithOpenAI(prompt);
-        } else if (llm_provider_ == "anthropic") {
-            response = analyzeWithAnthropic(prompt);
-        }
+bool LLMBehaviorAnalyzer::scheduleRecommendationsLocked(const std::string& user_id, UserState& state,
+                                                        RateBudget* budget,
+                                                        std::chrono::steady_clock::time_point now) {
+    UserBehaviorContext context = snapshotLocked(user_id, state);
+    std::string prompt = buildRecommendationPrompt(context);
+    if (budget && !budget->tryAcquire(
+                      static_cast<double>(estimateRequestTokens(prompt.size(), MAX_RESPONSE_TOKENS)), now)) {
+        return false;
+    }
 
-        if (!response.empty()) {
-            LLMBehaviorInsight insight = parseLLMResponse(response, user_id);
-            insight.insight_type = "recommendation";
-            storeInsight(insight);
+    state.recommendations_requested = false;
+    queueJob(AnalysisJob{JobKind::Recommendations, {std::move(context)}, {}, std::move(prompt), MAX_RESPONSE_TOKENS});
+    return true;
+}
 
-            if (insight_callback_) {
-                insight_callback_(insight);
-            }
+void LLMBehaviorAnalyzer::cacheInsightLocked(uint64_t hash, const LLMBehaviorInsight& insight) {
+    auto now = std::chrono::system_clock::now();
+    if (insight_cache_.size() >= MAX_CACHED_INSIGHTS) {
+        for (auto it = insight_cache_.begin(); it != insight_cache_.end();) {
+            it = it->second.expires <= now ? insight_cache_.erase(it) : std::next(it);
+        }
+        // Still full of live entries: drop the one closest to expiry
+        if (insight_cache_.size() >= MAX_CACHED_INSIGHTS) {
+            auto oldest = std::min_element(insight_cache_.begin(), insight_cache_.end(),
+                                           [](const auto& a, const auto& b) {
+                                               return a.second.expires < b.second.expires;
+                                           });
+            insight_cache_.erase(oldest);
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Recommendation generation error for user " << user_id << ": " << e.what() << std::endl;
     }
+    insight_cache_[hash] = CachedInsight{insight, now + cache_ttl_};
 }
 
-std::string LLMBehaviorAnalyzer::analyzeWithOpenAI(const std::string& prompt) {
-    if (openai_api_key_.empty()) {
-        throw std::runtime_error("OpenAI API key not set");
+void LLMBehaviorAnalyzer::queueJob(AnalysisJob job) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        jobs_.push_back(std::move(job));
     }
+    queue_cv_.notify_one();
+}
 
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        throw std::runtime_error("Failed to initialize CURL");
+void LLMBehaviorAnalyzer::processJob(AnalysisJob&& job) {
+    CompletedJob completed{job.kind, {}, "", std::move(job.fingerprints), {}};
+    for (const auto& context : job.contexts) {
+        completed.user_ids.push_back(context.user_id);
     }
+    const std::string& prompt = job.prompt;
 
-    std::string response;
-    std::string json_payload = R"({
-        "model": ")" + openai_model_ + R"(",
-        "messages": [
-            {
-                "role": "system",
-                "content": "You are an expert cybersecurity analyst specializing in behavioral analysis and insider threat detection. Analyze user behavior patterns and provide detailed insights."
-            },
+    if (llm_provider_ == "openai" || llm_provider_ == "anthropic") {
+        HttpRequest request;
+        try {
+            request = llm_provider_ == "openai" ? openAIRequest(prompt, job.max_tokens)
+                                                : anthropicRequest(prompt, job.max_tokens);
+        } catch (const std::exception& e) {
+            std::cerr << "LLM analysis error for " << describeUsers(completed.user_ids) << ": " << e.what()
+                      << std::endl;
+            completeJob(std::move(completed));
+            return;
+        }
+
+        // The worker moves on immediately; the client completes the job on its own thread
+        std::string provider = llm_provider_;
+        http_client_.submit(std::move(request), [this, completed, provider](HttpResponse&& response) mutable {
+            if (response.status == 429) {
+                // Our budget undercounted; hold off until it refills
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                budgets_[provider].exhaust(std::chrono::steady_clock::now());
+            }
+            try {
+                completed.response = responseText(response);
+            } catch (const std::exception& e) {
+                std::cerr << "LLM analysis error for " << describeUsers(completed.user_ids) << ": " << e.what()
+                          << std::endl;
+            }
             {
-                "role": "user",
-                "content": ")" + prompt + R"("
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                completed_.push_back(std::move(completed));
             }
-        ],
-        "max_tokens": 1000,
-        "temperature": 0.3
-    })";
-
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, ("Authorization: Bearer " + openai_api_key_).c_str());
-
-    curl_easy_setopt(curl, CURLOPT_URL, "https://api.openai.com/v1/chat/completions");
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-
-    CURLcode res = curl_easy_perform(curl);
-
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
-    if (res != CURLE_OK) {
-        throw std::runtime_error("OpenAI API request failed: " + std::string(curl_easy_strerror(res)));
+            queue_cv_.notify_one();
+        });
+        return;
     }
 
-    // Parse response
     try {
-        json response_json = json::parse(response);
-        if (response_json.contains("choices") && !response_json["choices"].empty()) {
-            return response_json["choices"][0]["message"]["content"];
+        if (llm_provider_ == "local") {
+            completed.response = analyzeWithLocalModel(prompt);
         }
     } catch (const std::exception& e) {
-        throw std::runtime_error("Failed to parse OpenAI response: " + std::string(e.what()));
+        std::cerr << "LLM analysis error for " << describeUsers(completed.user_ids) << ": " << e.what()
+                  << std::endl;
     }
-
-    return "";
+    completeJob(std::move(completed));
 }
 
-std::string LLMBehaviorAnalyzer::analyzeWithAnthropic(const std::string& prompt) {
-    if (anthropic_api_key_.empty()) {
-        throw std::runtime_error("Anthropic API key not set");
+void LLMBehaviorAnalyzer::completeJob(CompletedJob&& completed) {
+    bool from_cache = !completed.cached.empty();
+    std::vector<LLMBehaviorInsight> insights = std::move(completed.cached);
+    if (!from_cache && !completed.response.empty()) {
+        insights = parseLLMResponse(completed.response, completed.user_ids);
     }
 
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        throw std::runtime_error("Failed to initialize CURL");
+    auto now = std::chrono::system_clock::now();
+    for (auto& insight : insights) {
+        insight.timestamp = now;
+        if (completed.kind == JobKind::Recommendations) {
+            insight.insight_type = "recommendation";
+        }
+        storeInsight(insight);
+
+        if (insight_callback_) {
+            insight_callback_(insight);
+        }
     }
 
-    std::string response;
-    std::string json_payload = R"({
-        "model": ")" + anthropic_model_ + R"(",
-        "max_tokens": 1000,
-        "messages": [
-            {
-                "role": "user",
-                "content": ")" + prompt + R"("
+    if (completed.kind == JobKind::RiskAnalysis) {
+        std::lock_guard<std::mutex> lock(data_mutex_);
+        for (size_t i = 0; i < completed.user_ids.size(); ++i) {
+            const std::string& user_id = completed.user_ids[i];
+            auto it = user_states_.find(user_id);
+            if (it == user_states_.end()) continue;
+            it->second.queued = false;
+            it->second.last_analysis = now;
+
+            // Users the call failed for, or the response left out, keep the old
+            // fingerprint, so the next pass retries them
+            auto insight = std::find_if(insights.begin(), insights.end(),
+                                        [&user_id](const LLMBehaviorInsight& x) { return x.user == user_id; });
+            if (insight == insights.end()) {
+                if (!completed.response.empty()) {
+                    std::cerr << "LLM response had no analysis for user " << user_id << std::endl;
+                }
+                continue;
             }
-        ]
-    })";
+            it->second.analyzed = true;
+            it->second.fingerprint = completed.fingerprints[i];
+            if (!from_cache) {
+                cacheInsightLocked(completed.fingerprints[i].hash, *insight);
+            }
+        }
+    }
+}
 
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, "anthropic-version: 2023-06-01");
-    headers = curl_slist_append(headers, ("x-api-key: " + anthropic_api_key_).c_str());
+HttpRequest LLMBehaviorAnalyzer::openAIRequest(const std::string& prompt, int max_tokens) const {
+    if (openai_api_key_.empty()) {
+        throw std::runtime_error("OpenAI API key not set");
+    }
 
-    curl_easy_setopt(curl, CURLOPT_URL, "https://api.anthropic.com/v1/messages");
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+    json payload = {
+        {"model", openai_model_},
+        {"messages", json::array({
+            {{"role", "system"}, {"content", SYSTEM_PROMPT}},
+            {{"role", "user"}, {"content", prompt}}
+        })},
+        {"max_tokens", max_tokens},
+        {"temperature", 0.3}
+    };
+
+    HttpRequest request;
+    request.pool = "openai";
+    request.url = openai_url_;
+    request.headers = {"Content-Type: application/json", "Authorization: Bearer " + openai_api_key_};
+    request.body = payload.dump();
+    request.timeout = request_timeout_;
+    return request;
+}
 
-    CURLcode res = curl_easy_perform(curl);
+HttpRequest LLMBehaviorAnalyzer::anthropicRequest(const std::string& prompt, int max_tokens) const {
+    if (anthropic_api_key_.empty()) {
+        throw std::runtime_error("Anthropic API key not set");
+    }
 
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    json payload = {
+        {"model", anthropic_model_},
+        {"max_tokens", max_tokens},
+        {"system", SYSTEM_PROMPT},
+        {"messages", json::array({
+            {{"role", "user"}, {"content", prompt}}
+        })}
+    };
+
+    HttpRequest request;
+    request.pool = "anthropic";
+    request.url = anthropic_url_;
+    request.headers = {"Content-Type: application/json", "anthropic-version: 2023-06-01",
+                       "x-api-key: " + anthropic_api_key_};
+    request.body = payload.dump();
+    request.timeout = request_timeout_;
+    return request;
+}
 
-    if (res != CURLE_OK) {
-        throw std::runtime_error("Anthropic API request failed: " + std::string(curl_easy_strerror(res)));
+std::string LLMBehaviorAnalyzer::responseText(const HttpResponse& response) const {
+    std::string provider = llm_provider_ == "anthropic" ? "Anthropic" : "OpenAI";
+    if (response.status == 0) {
+        throw std::runtime_error(provider + " API request failed: " + response.error);
+    }
+    if (response.status != 200) {
+        throw std::runtime_error(provider + " API returned HTTP " + std::to_string(response.status) + ": " +
+                                 response.body.substr(0, 200));
     }
 
     // Parse response
     try {
-        json response_json = json::parse(response);
+        json response_json = json::parse(response.body);
+        if (response_json.contains("choices") && !response_json["choices"].empty()) {
+            return response_json["choices"][0]["message"]["content"];
+        }
         if (response_json.contains("content") && !response_json["content"].empty()) {
             return response_json["content"][0]["text"];
         }
     } catch (const std::exception& e) {
-        throw std::runtime_error("Failed to parse Anthropic response: " + std::string(e.what()));
+        throw std::runtime_error("Failed to parse " + provider + " response: " + std::string(e.what()));
     }
 
     return "";
@@ -341,43 +772,33 @@ std::string LLMBehaviorAnalyzer::analyzeWithLocalModel(const std::string& prompt
 #endif
 }
 
-std::string LLMBehaviorAnalyzer::buildAnalysisPrompt(const std::string& user_id) {
-    std::string behavior_data = formatBehaviorData(user_id);
+std::string LLMBehaviorAnalyzer::buildAnalysisPrompt(const std::vector<std::string>& user_sections) {
+    std::string prompt = BATCH_PROMPT_HEADER;
+    for (const auto& section : user_sections) {
+        prompt += section;
+    }
+    prompt += BATCH_PROMPT_FOOTER;
+    return prompt;
+}
 
-    std::string prompt = R"(
-Analyze the following user behavior data for security risks and anomalies:
+std::string LLMBehaviorAnalyzer::buildRecommendationPrompt(const UserBehaviorContext& context) {
+    return R"(
+Based on the following user behavior data, generate specific security recommendations:
 
-User ID: )" + user_id + R"(
-Behavior Data:
-)" + behavior_data + R"(
+User: )" + context.user_id + R"(
+Behavior Data: )" + formatBehaviorData(context) + R"(
 
-Please provide a detailed analysis including:
-1. Risk assessment (Low/Medium/High/Critical)
-2. Specific behavioral patterns identified
-3. Potential security concerns
-4. Confidence level in your analysis
-5. Recommended actions
+Please provide:
+1. Specific security recommendations
+2. Risk mitigation strategies
+3. Monitoring suggestions
+4. Policy adjustments if needed
 
-Format your response as JSON with the following structure:
-{
-    "risk_level": "low|medium|high|critical",
-    "confidence_score": 0.0-1.0,
-    "patterns": ["pattern1", "pattern2"],
-    "concerns": ["concern1", "concern2"],
-    "analysis": "detailed analysis text",
-    "recommendations": ["rec1", "rec2"]
-}
+Format as JSON with keys: recommendations, risk_level, actions
 )";
-
-    return prompt;
 }
 
-std::string LLMBehaviorAnalyzer::formatBehaviorData(const std::string& user_id) {
-    if (user_contexts_.find(user_id) == user_contexts_.end()) {
-        return "No behavior data available";
-    }
-
-    const auto& context = user_contexts_[user_id];
+std::string LLMBehaviorAnalyzer::formatBehaviorData(const UserBehaviorContext& context) {
     std::stringstream ss;
 
     ss << "Recent Activities (" << context.recent_activities.size() << "):\n";
@@ -398,60 +819,67 @@ std::string LLMBehaviorAnalyzer::formatBehaviorData(const std::string& user_id)
     return ss.str();
 }
 
-LLMBehaviorInsight LLMBehaviorAnalyzer::parseLLMResponse(const std::string& response, const std::string& user_id) {
-    LLMBehaviorInsight insight;
-    insight.user = user_id;
-    insight.timestamp = std::chrono::system_clock::now();
+std::vector<LLMBehaviorInsight> LLMBehaviorAnalyzer::parseLLMResponse(const std::string& response,
+                                                                      const std::vector<std::string>& user_ids) {
+    std::vector<LLMBehaviorInsight> insights;
 
-    try {
-        json response_json = json::parse(response);
-
-        insight.severity = response_json.value("risk_level", "medium");
-        insight.confidence_score = response_json.value("confidence_score", 0.5);
-        insight.analysis = response_json.value("analysis", "Analysis completed");
-
-        if (response_json.contains("patterns")) {
-            insight.description = "Detected patterns: ";
-            for (const auto& pattern : response_json["patterns"]) {
-                insight.description += pattern.get<std::string>() + ", ";
-            }
-            insight.description = insight.description.substr(0, insight.description.size() - 2);
+    // Models sometimes wrap the JSON in prose or a code fence
+    json response_json;
+    size_t open = response.find('{');
+    size_t close = response.rfind('}');
+    if (open != std::string::npos && close != std::string::npos && close > open) {
+        try {
+            response_json = json::parse(response.substr(open, close - open + 1));
+        } catch (const std::exception&) {
+            response_json = json();
         }
+    }
 
-        if (response_json.contains("recommendations")) {
-            for (const auto& rec : response_json["recommendations"]) {
-                insight.recommendations.push_back(rec.get<std::string>());
+    if (response_json.is_object()) {
+        for (const auto& user_id : user_ids) {
+            auto entry = response_json.find(user_id);
+            if (entry == response_json.end() || !entry->is_object()) continue;
+            try {
+                insights.push_back(insightFromJson(*entry, user_id));
+            } catch (const std::exception& e) {
+                std::cerr << "Malformed LLM analysis for user " << user_id << ": " << e.what() << std::endl;
             }
         }
+        if (!insights.empty() || user_ids.size() != 1) {
+            return insights;
+        }
 
-        // Determine insight type based on severity
-        if (insight.severity == "critical" || insight.severity == "high") {
-            insight.insight_type = "alert";
-        } else if (!insight.recommendations.empty()) {
-            insight.insight_type = "recommendation";
-        } else {
-            insight.insight_type = "pattern";
+        // A single user's analysis may come back without the key
+        try {
+            insights.push_back(insightFromJson(response_json, user_ids.front()));
+            return insights;
+        } catch (const std::exception&) {
         }
+    }
 
-    } catch (const std::exception& e) {
-        // Fallback parsing for non-JSON responses
+    // Fallback parsing for non-JSON responses; free text can't be split between users
+    if (user_ids.size() == 1) {
+        LLMBehaviorInsight insight;
+        insight.user = user_ids.front();
+        insight.timestamp = std::chrono::system_clock::now();
         insight.severity = "medium";
         insight.confidence_score = 0.5;
         insight.analysis = response;
         insight.description = "LLM analysis completed";
         insight.insight_type = "pattern";
+        insights.push_back(insight);
     }
 
-    return insight;
+    return insights;
 }
 
 void LLMBehaviorAnalyzer::storeInsight(const LLMBehaviorInsight& insight) {
-    std::lock_guard<std::mutex> lock(data_mutex_);
+    std::lock_guard<std::mutex> lock(insights_mutex_);
 
     insights_history_.push_back(insight);
 
-    // Keep only last 1000 insights
-    if (insights_history_.size() > 1000) {
+    // Keep only the newest insights
+    if (insights_history_.size() > MAX_INSIGHTS) {
         insights_history_.pop_front();
     }
 }
@@ -464,39 +892,93 @@ void LLMBehaviorAnalyzer::analysisLoop() {
             std::cerr << "Analysis loop error: " << e.what() << std::endl;
         }
 
-        // Sleep for analysis interval
-        std::this_thread::sleep_for(std::chrono::seconds(analysis_interval_));
+        // Budgets refill and users come due continuously, so re-plan every tick
+        // or as soon as an analysis is requested
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        schedule_cv_.wait_for(lock, SCHEDULER_TICK, [this] { return !running_ || schedule_requested_; });
+        schedule_requested_ = false;
+    }
+}
+
+void LLMBehaviorAnalyzer::workerLoop() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        queue_cv_.wait(lock, [this] { return !running_ || !jobs_.empty() || !completed_.empty(); });
+        if (!running_) return;
+
+        // Finish requests before starting new ones
+        if (!completed_.empty()) {
+            CompletedJob completed = std::move(completed_.front());
+            completed_.pop_front();
+            lock.unlock();
+            completeJob(std::move(completed));
+            continue;
+        }
+
+        AnalysisJob job = std::move(jobs_.front());
+        jobs_.pop_front();
+        lock.unlock();
+        processJob(std::move(job));
     }
 }
 
 void LLMBehaviorAnalyzer::performBehavioralAnalysis() {
+    // Only snapshots are taken here; the workers make the provider calls
     std::lock_guard<std::mutex> lock(data_mutex_);
-
-    // Analyze users who have pending analysis or haven't been analyzed recently
     auto now = std::chrono::system_clock::now();
-
-    for (auto& [user_id, context] : user_contexts_) {
-        auto time_since_analysis = std::chrono::duration_cast<std::chrono::seconds>(
-            now - context.last_analysis).count();
-
-        // Analyze if it's been more than the interval or if in pending queue
-        auto it = std::find(pending_analyses_.begin(), pending_analyses_.end(), user_id);
-        if (it != pending_analyses_.end() || time_since_analysis >= analysis_interval_) {
-            analyzeRiskPatterns(user_id);
-            context.last_analysis = now;
-
-            if (it != pending_analyses_.end()) {
-                pending_analyses_.erase(it);
+    auto steady_now = std::chrono::steady_clock::now();
+
+    struct Candidate {
+        double priority;
+        const std::string* user_id;
+        UserState* state;
+    };
+    std::vector<Candidate> candidates;
+    double interval = std::max(analysis_interval_, MIN_ANALYSIS_INTERVAL);
+
+    for (auto& [user_id, state] : user_states_) {
+        if (state.queued) continue;
+
+        // Riskier users come due sooner, down to MIN_ANALYSIS_INTERVAL
+        double age = std::chrono::duration<double>(now - state.last_analysis).count();
+        double risk = std::clamp(state.risk_score, 0.0, 1.0);
+        double due_after = std::max<double>(MIN_ANALYSIS_INTERVAL, interval * (1.0 - risk));
+        bool requested = state.requested || state.recommendations_requested;
+        if (!requested && age < due_after) continue;
+
+        // Risk first, then staleness; explicit requests jump the queue
+        double priority = risk + age / interval + (requested ? 1.0 : 0.0);
+        candidates.push_back(Candidate{priority, &user_id, &state});
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+
+    // Local models have no quota
+    RateBudget* budget = llm_provider_ == "local" ? nullptr : &budgets_[llm_provider_];
+    PendingBatch batch;
+    for (const auto& candidate : candidates) {
+        UserState& state = *candidate.state;
+        if (state.recommendations_requested) {
+            // Pay for the pending batch first; it was only checked against the budget
+            flushBatchLocked(batch, budget, steady_now);
+            if (!scheduleRecommendationsLocked(*candidate.user_id, state, budget, steady_now)) {
+                break;
             }
         }
+        // Lower-priority users wait rather than slip in ahead when the budget runs short
+        if (!scheduleRiskAnalysisLocked(*candidate.user_id, state, budget, steady_now, batch)) {
+            break;
+        }
     }
+    flushBatchLocked(batch, budget, steady_now);
 }
 
 UserBehaviorContext LLMBehaviorAnalyzer::getUserContext(const std::string& user_id) {
     std::lock_guard<std::mutex> lock(data_mutex_);
 
-    if (user_contexts_.find(user_id) != user_contexts_.end()) {
-        return user_contexts_[user_id];
+    auto it = user_states_.find(user_id);
+    if (it != user_states_.end()) {
+        return snapshotLocked(user_id, it->second);
     }
 
     return UserBehaviorContext{user_id, {}, {}, {}, std::chrono::system_clock::now()};
@@ -504,11 +986,18 @@ UserBehaviorContext LLMBehaviorAnalyzer::getUserContext(const std::string& user_
 
 void LLMBehaviorAnalyzer::updateUserContext(const std::string& user_id, const UserBehaviorContext& context) {
     std::lock_guard<std::mutex> lock(data_mutex_);
-    user_contexts_[user_id] = context;
+    UserState& state = stateLocked(user_id);
+    state.activities.clear();
+    for (const auto& activity : context.recent_activities) {
+        state.activities.push(activity);
+    }
+    state.metrics = context.behavior_metrics;
+    state.risk_indicators = context.risk_indicators;
+    state.last_analysis = context.last_analysis;
 }
 
 std::vector<LLMBehaviorInsight> LLMBehaviorAnalyzer::getRecentInsights(const std::string& user_id, int limit) {
-    std::lock_guard<std::mutex> lock(data_mutex_);
+    std::lock_guard<std::mutex> lock(insights_mutex_);
 
     std::vector<LLMBehaviorInsight> user_insights;
 
@@ -0,0 +1,254 @@
+#include "llm_http_client.h"
+#include <curl/curl.h>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    constexpr long DEFAULT_CONNECT_TIMEOUT_MS = 10000;
+    constexpr int POLL_TIMEOUT_MS = 1000;
+
+    size_t writeCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
+        size_t total_size = size * nmemb;
+        output->append(static_cast<char*>(contents), total_size);
+        return total_size;
+    }
+}
+
+struct LLMHttpClient::Transfer {
+    HttpRequest request;
+    Completion done;
+    HttpResponse response;
+    CURL* easy = nullptr;
+    curl_slist* headers = nullptr;
+    std::chrono::steady_clock::time_point started;
+    char error[CURL_ERROR_SIZE] = {};
+};
+
+LLMHttpClient::LLMHttpClient()
+    : multi_(nullptr), connect_timeout_ms_(DEFAULT_CONNECT_TIMEOUT_MS), running_(false) {}
+
+LLMHttpClient::~LLMHttpClient() {
+    stop();
+    for (void* easy : idle_handles_) {
+        curl_easy_cleanup(static_cast<CURL*>(easy));
+    }
+}
+
+void LLMHttpClient::setConcurrencyLimit(const std::string& pool, size_t limit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pools_[pool].limit = std::max<size_t>(limit, 1);
+}
+
+void LLMHttpClient::start() {
+    if (running_) return;
+
+    multi_ = curl_multi_init();
+    if (!multi_) {
+        std::cerr << "Failed to initialize CURL multi handle" << std::endl;
+        return;
+    }
+    // Let concurrent requests to one host share a single HTTP/2 connection
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    running_ = true;
+    driver_ = std::thread(&LLMHttpClient::driverLoop, this);
+}
+
+void LLMHttpClient::stop() {
+    if (!running_) return;
+
+    {
+        // Under the lock so a concurrent submit either lands before cancelAll or is refused
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        wakeUp();
+    }
+    driver_.join();
+
+    cancelAll();
+    curl_multi_cleanup(multi_);
+    multi_ = nullptr;
+}
+
+void LLMHttpClient::submit(HttpRequest request, Completion done) {
+    auto transfer = std::make_unique<Transfer>();
+    transfer->request = std::move(request);
+    transfer->done = std::move(done);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) {
+            submitted_.push_back(std::move(transfer));
+            wakeUp();
+            return;
+        }
+    }
+
+    transfer->response.error = "HTTP client not running";
+    transfer->done(std::move(transfer->response));
+}
+
+void LLMHttpClient::wakeUp() {
+#if LIBCURL_VERSION_NUM >= 0x074400
+    if (multi_) curl_multi_wakeup(multi_);
+#endif
+}
+
+void* LLMHttpClient::takeEasyHandle() {
+    if (!idle_handles_.empty()) {
+        void* easy = idle_handles_.back();
+        idle_handles_.pop_back();
+        curl_easy_reset(static_cast<CURL*>(easy));
+        return easy;
+    }
+    return curl_easy_init();
+}
+
+void LLMHttpClient::launchReady() {
+    std::vector<std::unique_ptr<Transfer>> failed;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto& transfer : submitted_) {
+        pools_[transfer->request.pool].waiting.push_back(std::move(transfer));
+    }
+    submitted_.clear();
+
+    for (auto& entry : pools_) {
+        Pool& pool = entry.second;
+        while (pool.active < pool.limit && !pool.waiting.empty()) {
+            std::unique_ptr<Transfer> transfer = std::move(pool.waiting.front());
+            pool.waiting.pop_front();
+
+            CURL* easy = static_cast<CURL*>(takeEasyHandle());
+            if (!easy) {
+                transfer->response.error = "Failed to initialize CURL";
+                failed.push_back(std::move(transfer));
+                continue;
+            }
+
+            const HttpRequest& request = transfer->request;
+            for (const auto& header : request.headers) {
+                transfer->headers = curl_slist_append(transfer->headers, header.c_str());
+            }
+            curl_easy_setopt(easy, CURLOPT_URL, request.url.c_str());
+            curl_easy_setopt(easy, CURLOPT_POST, 1L);
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDS, request.body.c_str());
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(request.body.size()));
+            curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+            curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, writeCallback);
+            curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response.body);
+            curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, transfer->error);
+            curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 1L);
+            curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, 2L);
+            curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+            // Over TLS, ALPN tells curl quickly whether a connection can multiplex, so
+            // waiting for it beats opening another. Cleartext stays on HTTP/1.1, where
+            // waiting would only serialize requests behind the first response.
+            if (request.url.compare(0, 8, "https://") == 0) {
+                curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+            }
+            curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, connect_timeout_ms_);
+            curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, static_cast<long>(request.timeout.count()));
+            curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+
+            transfer->easy = easy;
+            transfer->started = std::chrono::steady_clock::now();
+            curl_multi_add_handle(multi_, easy);
+            pool.active++;
+            in_flight_[easy] = std::move(transfer);
+        }
+    }
+    lock.unlock();
+
+    // Completions may submit again, so they run without the lock
+    for (auto& transfer : failed) {
+        transfer->done(std::move(transfer->response));
+    }
+}
+
+void LLMHttpClient::finish(Transfer* transfer, int result) {
+    CURL* easy = transfer->easy;
+    auto owned = std::move(in_flight_[easy]);
+    in_flight_.erase(easy);
+
+    curl_multi_remove_handle(multi_, easy);
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &owned->response.status);
+    curl_slist_free_all(owned->headers);
+    owned->headers = nullptr;
+    idle_handles_.push_back(easy);
+
+    if (result != CURLE_OK) {
+        owned->response.status = 0;
+        owned->response.error = owned->error[0] ? owned->error : curl_easy_strerror(static_cast<CURLcode>(result));
+    }
+    owned->response.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - owned->started);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pools_[owned->request.pool].active--;
+    }
+    owned->done(std::move(owned->response));
+}
+
+void LLMHttpClient::driverLoop() {
+    while (running_) {
+        launchReady();
+
+        int still_running = 0;
+        curl_multi_perform(multi_, &still_running);
+
+        int queued = 0;
+        bool finished = false;
+        while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+            if (message->msg != CURLMSG_DONE) continue;
+            auto it = in_flight_.find(message->easy_handle);
+            if (it != in_flight_.end()) {
+                finish(it->second.get(), message->data.result);
+                finished = true;
+            }
+        }
+        if (finished) continue;  // Freed slots can start waiting requests right away
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+        curl_multi_poll(multi_, nullptr, 0, POLL_TIMEOUT_MS, nullptr);
+#else
+        // Without curl_multi_wakeup, poll briefly so new submissions start promptly
+        curl_multi_wait(multi_, nullptr, 0, 50, nullptr);
+#endif
+    }
+}
+
+void LLMHttpClient::cancelAll() {
+    std::vector<std::unique_ptr<Transfer>> cancelled;
+    for (auto& entry : in_flight_) {
+        CURL* easy = static_cast<CURL*>(entry.first);
+        curl_multi_remove_handle(multi_, easy);
+        curl_slist_free_all(entry.second->headers);
+        entry.second->headers = nullptr;
+        idle_handles_.push_back(easy);
+        cancelled.push_back(std::move(entry.second));
+    }
+    in_flight_.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& transfer : submitted_) {
+            cancelled.push_back(std::move(transfer));
+        }
+        submitted_.clear();
+        for (auto& entry : pools_) {
+            for (auto& transfer : entry.second.waiting) {
+                cancelled.push_back(std::move(transfer));
+            }
+            entry.second.waiting.clear();
+            entry.second.active = 0;
+        }
+    }
+
+    for (auto& transfer : cancelled) {
+        transfer->response.status = 0;
+        transfer->response.error = "HTTP client stopped";
+        transfer->done(std::move(transfer->response));
+    }
+}
@@ -7,6 +7,8 @@
 #include <curl/curl.h>
 #include <sstream>
 #include <iomanip>
+#include <mutex>
+#include <algorithm>
 #ifdef HAS_NLOHMANN_JSON
 #include <nlohmann/json.hpp>
 #endif
@@ -14,6 +16,10 @@
 #include "dlp_monitor.h"
 #include "time_tracker.h"
 #include "behavior_analyzer.h"
+#include "rate_budget.h"
+#include "correlation_engine.h"
+#include "process_exec_monitor.h"
+#include "feature_extractor.h"
 #include "upgrade_manager.h"
 
 std::atomic<bool> running(true);
@@ -208,6 +214,89 @@ void sendRecentBehaviorPatterns(BehaviorAnalyzer& behavior_analyzer, const std::
 #endif
 }
 
+void sendDlpRuleStats(const DLPMonitor& dlp_monitor) {
+    std::vector<RuleStatsSnapshot> rules = dlp_monitor.ruleStats();
+    if (rules.empty()) {
+        return;
+    }
+
+    auto now = std::chrono::system_clock::now();
+    auto now_t = std::chrono::system_clock::to_time_t(now);
+    std::stringstream timestamp_ss;
+    timestamp_ss << std::put_time(std::gmtime(&now_t), "%Y-%m-%dT%H:%M:%SZ");
+
+    // Counters are cumulative since agent start; the backend derives rates
+    const RuleStatsSnapshot* costliest = nullptr;
+    size_t never_matched = 0;
+    for (const auto& rule : rules) {
+        if (rule.rule == "*") continue;
+        if (!costliest || rule.cpu_ns > costliest->cpu_ns) costliest = &rule;
+        if (rule.evaluations > 0 && rule.matches == 0) never_matched++;
+    }
+    if (costliest) {
+        std::cout << "DLP rule stats: costliest " << costliest->policy << "/" << costliest->rule << " ("
+                  << costliest->cpu_ns / 1000000 << " ms CPU over " << costliest->evaluations << " scans), "
+                  << never_matched << " evaluated rule(s) never matched" << std::endl;
+    }
+
+#ifdef HAS_NLOHMANN_JSON
+    nlohmann::json rules_array = nlohmann::json::array();
+    for (const auto& rule : rules) {
+        rules_array.push_back({
+            {"policy", rule.policy},
+            {"rule", rule.rule},
+            {"evaluations", rule.evaluations},
+            {"matches", rule.matches},
+            {"bytes_scanned", rule.bytes_scanned},
+            {"cpu_ns", rule.cpu_ns}
+        });
+    }
+
+    nlohmann::json stats_json = {
+        {"type", "dlp_rule_stats"},
+        {"timestamp", timestamp_ss.str()},
+        {"rules", rules_array}
+    };
+    sendDataToBackend(stats_json.dump());
+#else
+    std::stringstream stats_json;
+    stats_json << "{\"type\":\"dlp_rule_stats\",\"timestamp\":\"" << timestamp_ss.str() << "\",\"rules\":[";
+
+    bool first = true;
+    for (const auto& rule : rules) {
+        if (!first) stats_json << ",";
+        stats_json << "{\"policy\":\"" << rule.policy
+                   << "\",\"rule\":\"" << rule.rule
+                   << "\",\"evaluations\":" << rule.evaluations
+                   << ",\"matches\":" << rule.matches
+                   << ",\"bytes_scanned\":" << rule.bytes_scanned
+                   << ",\"cpu_ns\":" << rule.cpu_ns << "}";
+        first = false;
+    }
+
+    stats_json << "]}";
+    sendDataToBackend(stats_json.str());
+#endif
+}
+
+// DLP events join the correlation stream under their own type names
+CorrelationEvent toCorrelationEvent(const DLPEvent& event) {
+    CorrelationEvent correlation_event;
+    correlation_event.type = event.type;
+    // "current_user" marks events the monitors could not attribute to a process
+    correlation_event.user = event.user == "current_user" ? "" : event.user;
+    correlation_event.pid = event.pid;
+    correlation_event.process = event.process_path;
+    if (event.type == "suspicious_process" && event.process_path.empty()) {
+        correlation_event.process = event.file_path;  // pgrep name when /proc was unreadable
+    }
+    correlation_event.path = event.file_path;
+    correlation_event.destination = event.destination;
+    correlation_event.detail = event.policy_violated;
+    correlation_event.time = std::chrono::steady_clock::now();
+    return correlation_event;
+}
+
 int main(int argc, char* argv[]) {
     std::cout << "Workforce Monitoring Agent starting..." << std::endl;
 
@@ -229,6 +318,26 @@ int main(int argc, char* argv[]) {
     TimeTracker time_tracker;
     BehaviorAnalyzer behavior_analyzer;
     UpgradeManager upgrade_manager;
+    CorrelationEngine correlation_engine;
+    ProcessExecMonitor exec_monitor;
+    FeatureExtractor feature_extractor(behavior_analyzer.featureSchema());
+
+    // Matches arrive on monitor threads; the main loop hands them to the analyzer
+    std::mutex correlation_mutex;
+    std::vector<CorrelationMatch> correlation_matches;
+    // Focused applications and launched processes per user, for the transition model
+    std::mutex transition_mutex;
+    std::vector<std::pair<std::string, std::string>> transition_tokens;
+
+    // Features and transitions are keyed by the desktop session's account: the owner
+    // of the focused window, or the agent's own account before any window was focused.
+    // The monitors attribute events differently (placeholder, process owner), and one
+    // user's input, file, process and network activity must land in the same vector.
+    std::string agent_user = time_tracker.getCurrentUser();
+    auto session_user = [&activity_monitor, agent_user]() {
+        std::string owner = activity_monitor.focusedWindowUser();
+        return owner.empty() ? agent_user : owner;
+    };
 
     // Configure DLP Policies
     DLPPolicy confidential_policy;
@@ -236,7 +345,9 @@ int main(int argc, char* argv[]) {
     confidential_policy.file_extensions = {".docx", ".xlsx", ".pdf", ".txt"};
     confidential_policy.content_patterns = {std::regex("confidential"), std::regex("secret"), std::regex("internal")};
     confidential_policy.restricted_paths = {"/home", "/tmp"};
+    confidential_policy.restricted_domains = {"*.dropbox.com", "dropbox.com", "*.wetransfer.com", "*.mega.nz", "mega.nz"};
     confidential_policy.block_transfer = true;
+    confidential_policy.removable_destination = true;
     dlp_monitor.addPolicy(confidential_policy);
 
     DLPPolicy sensitive_policy;
@@ -245,8 +356,28 @@ int main(int argc, char* argv[]) {
     sensitive_policy.content_patterns = {std::regex("password"), std::regex("api_key"), std::regex("token")};
     sensitive_policy.restricted_paths = {"/var", "/etc"};
     sensitive_policy.block_transfer = true;
+    sensitive_policy.removable_destination = true;
     dlp_monitor.addPolicy(sensitive_policy);
 
+    // Optional packet ring flow accounting for hosts without eBPF support
+    const char* capture_interface = std::getenv("DLP_CAPTURE_INTERFACE");
+    if (capture_interface) {
+        dlp_monitor.setCaptureInterface(capture_interface);
+    }
+
+    // CUPS keeps spooled documents in /var/spool/cups unless RequestRoot says otherwise
+    const char* print_spool = std::getenv("DLP_PRINT_SPOOL");
+    if (print_spool) {
+        dlp_monitor.setPrintSpoolDirectory(print_spool);
+    }
+
+    // Opt-in blocking of block_transfer policies through fanotify permission events
+    const char* enforce = std::getenv("DLP_ENFORCE");
+    if (enforce && std::string(enforce) == "1") {
+        const char* budget = std::getenv("DLP_ENFORCE_BUDGET_US");
+        dlp_monitor.setEnforcement(true, std::chrono::microseconds(budget ? std::atoi(budget) : 5000));
+    }
+
     // Configure LLM Analysis (optional - requires API keys)
     // Uncomment and configure these lines to enable LLM-powered behavioral analysis
     /*
@@ -275,6 +406,30 @@ int main(int argc, char* argv[]) {
             behavior_analyzer.setLLMModel("anthropic", "claude-3-sonnet-20240229");
         }
 
+        // Endpoint overrides allow proxies and local stand-in servers
+        if (const char* url = std::getenv("OPENAI_API_URL")) {
+            behavior_analyzer.setLLMEndpoint("openai", url);
+        }
+        if (const char* url = std::getenv("ANTHROPIC_API_URL")) {
+            behavior_analyzer.setLLMEndpoint("anthropic", url);
+        }
+        if (const char* limit = std::getenv("LLM_MAX_CONCURRENT_REQUESTS")) {
+            behavior_analyzer.setLLMMaxConcurrentRequests(llm_provider, std::max(1, std::atoi(limit)));
+        }
+        if (const char* timeout = std::getenv("LLM_REQUEST_TIMEOUT_SEC")) {
+            behavior_analyzer.setLLMRequestTimeout(std::chrono::seconds(std::max(5, std::atoi(timeout))));
+        }
+        const char* rpm = std::getenv("LLM_REQUESTS_PER_MINUTE");
+        const char* tpm = std::getenv("LLM_TOKENS_PER_MINUTE");
+        if (rpm || tpm) {
+            behavior_analyzer.setLLMRateLimits(llm_provider,
+                                               rpm ? std::atof(rpm) : RateBudget::DEFAULT_REQUESTS_PER_MINUTE,
+                                               tpm ? std::atof(tpm) : RateBudget::DEFAULT_TOKENS_PER_MINUTE);
+        }
+        if (const char* batch = std::getenv("LLM_BATCH_USERS")) {
+            behavior_analyzer.setLLMBatchSize(std::max(1, std::atoi(batch)));
+        }
+
         behavior_analyzer.startLLMAnalysis();
         std::cout << "LLM analysis enabled with provider: " << llm_provider << std::endl;
     } else {
@@ -283,8 +438,30 @@ int main(int argc, char* argv[]) {
         std::cout << "         export OPENAI_API_KEY=your-key-here" << std::endl;
     }
 
+    // Warm-start behavior baselines from the last snapshot so scoring resumes right away
+    const char* snapshot_env = std::getenv("BEHAVIOR_SNAPSHOT_PATH");
+    std::string snapshot_path = snapshot_env ? snapshot_env : "/var/lib/workforce_agent/behavior.snapshot";
+    int snapshot_interval = 600;  // seconds
+    if (const char* interval = std::getenv("BEHAVIOR_SNAPSHOT_INTERVAL_SEC")) {
+        snapshot_interval = std::max(60, std::atoi(interval));
+    }
+    if (!snapshot_env) {
+        mkdir("/var/lib/workforce_agent", 0700);
+    }
+    behavior_analyzer.loadSnapshot(snapshot_path);
+
     // Set up callbacks
-    activity_monitor.setCallback([](const ActivityEvent& event) {
+    activity_monitor.setCallback([&session_user, &feature_extractor, &transition_mutex,
+                                  &transition_tokens](const ActivityEvent& event) {
+        std::string user = session_user();
+        feature_extractor.recordActivity(user, event);
+
+        std::string app = FeatureExtractor::focusedApplication(event);
+        if (!app.empty()) {
+            std::lock_guard<std::mutex> lock(transition_mutex);
+            transition_tokens.emplace_back(user, "app:" + app);
+        }
+
 #ifdef HAS_NLOHMANN_JSON
         nlohmann::json json_data = {
             {"type", "activity"},
@@ -304,7 +481,14 @@ int main(int argc, char* argv[]) {
 #endif
     });
 
-    dlp_monitor.setCallback([](const DLPEvent& event) {
+    dlp_monitor.setObservationCallback([&session_user, &feature_extractor](const DataObservation& observation) {
+        feature_extractor.recordDataObservation(session_user(), observation);
+    });
+
+    dlp_monitor.setCallback([&session_user, &correlation_engine, &feature_extractor](const DLPEvent& event) {
+        correlation_engine.ingest(toCorrelationEvent(event));
+        feature_extractor.recordDLPEvent(session_user(), event);
+
         // Send DLP event data
 #ifdef HAS_NLOHMANN_JSON
         nlohmann::json dlp_json = {
@@ -313,7 +497,10 @@ int main(int argc, char* argv[]) {
             {"dlp_type", event.type},
             {"policy_violated", event.policy_violated},
             {"user", event.user},
-            {"blocked", event.blocked}
+            {"blocked", event.blocked},
+            {"pid", event.pid},
+            {"process", event.process_path},
+            {"bytes", event.bytes}
         };
         sendDataToBackend(dlp_json.dump());
 #else
@@ -322,7 +509,10 @@ int main(int argc, char* argv[]) {
                  << "\",\"dlp_type\":\"" << event.type
                  << "\",\"policy_violated\":\"" << event.policy_violated
                  << "\",\"user\":\"" << event.user
-                 << "\",\"blocked\":" << (event.blocked ? "true" : "false") << "}";
+                 << "\",\"blocked\":" << (event.blocked ? "true" : "false")
+                 << ",\"pid\":" << event.pid
+                 << ",\"process\":\"" << event.process_path
+                 << "\",\"bytes\":" << event.bytes << "}";
         sendDataToBackend(dlp_json.str());
 #endif
 
@@ -349,6 +539,23 @@ int main(int argc, char* argv[]) {
         } else if (event.type == "restricted_destination") {
             alert_title = "Restricted Network Destination";
             alert_description = event.policy_violated;
+        } else if (event.type == "removable_media_write") {
+            alert_title = "Removable Media Transfer";
+            alert_description = "Copied: " + event.file_path + " to " + event.destination + " - " + event.policy_violated;
+            severity = "high";
+        } else if (event.type == "removable_media_mounted") {
+            alert_title = "Removable Media Connected";
+            alert_description = event.policy_violated;
+        } else if (event.type == "transfer_blocked") {
+            alert_title = "File Transfer Blocked";
+            alert_description = "Blocked: " + event.file_path + " - " + event.policy_violated;
+        } else if (event.type == "print_job") {
+            alert_title = "Sensitive Document Printed";
+            alert_description = "Printed: " + event.file_path + " on " + event.destination + " - " + event.policy_violated;
+            severity = "high";
+        } else if (event.type == "clipboard") {
+            alert_title = "Sensitive Data Copied to Clipboard";
+            alert_description = event.policy_violated;
         }
 
 #ifdef HAS_NLOHMANN_JSON
@@ -451,6 +658,34 @@ int main(int argc, char* argv[]) {
 #endif
     });
 
+    // Multi-step exfiltration sequences across DLP, process and network events
+    correlation_engine.addRule(CorrelationEngine::exfiltrationSequenceRule());
+    correlation_engine.setMatchCallback([&correlation_mutex, &correlation_matches](const CorrelationMatch& match) {
+        std::cout << "Correlated sequence " << match.rule << " for "
+                  << (match.user.empty() ? "unattributed activity" : match.user) << std::endl;
+        std::lock_guard<std::mutex> lock(correlation_mutex);
+        correlation_matches.push_back(match);
+    });
+
+    exec_monitor.setCallback([&session_user, &correlation_engine, &feature_extractor, &transition_mutex,
+                              &transition_tokens](const ProcessExec& exec) {
+        std::string user = session_user();
+        feature_extractor.recordProcessExec(user, exec);
+        {
+            std::lock_guard<std::mutex> lock(transition_mutex);
+            transition_tokens.emplace_back(user, "exec:" + exec.comm);
+        }
+
+        CorrelationEvent event;
+        event.type = "process_exec";
+        event.user = exec.user;
+        event.pid = exec.pid;
+        event.process = exec.exe_path.empty() ? exec.comm : exec.exe_path;
+        event.detail = exec.cmdline;
+        event.time = exec.time;
+        correlation_engine.ingest(event);
+    });
+
     // Initialize upgrade manager
     upgrade_manager.initialize();
     upgrade_manager.setUpdateAvailableCallback([](const UpdateInfo& update) {
@@ -471,6 +706,7 @@ int main(int argc, char* argv[]) {
     activity_monitor.startMonitoring();
     dlp_monitor.startMonitoring();
     time_tracker.startTracking();
+    std::thread exec_thread(&ProcessExecMonitor::run, &exec_monitor);
 
     std::cout << "Monitoring started. Press Ctrl+C to stop." << std::endl;
 
@@ -478,13 +714,35 @@ int main(int argc, char* argv[]) {
     while (running) {
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
+        std::vector<CorrelationMatch> matches;
+        {
+            std::lock_guard<std::mutex> lock(correlation_mutex);
+            matches.swap(correlation_matches);
+        }
+        for (const auto& match : matches) {
+            behavior_analyzer.recordCorrelatedSequence(match);
+        }
+
+        std::vector<std::pair<std::string, std::string>> tokens;
+        {
+            std::lock_guard<std::mutex> lock(transition_mutex);
+            tokens.swap(transition_tokens);
+        }
+        for (const auto& [user, token] : tokens) {
+            behavior_analyzer.analyzeTransition(user, token);
+        }
+
         // Periodic analysis
         static int counter = 0;
         if (++counter % 60 == 0) {  // Every minute
-            // Analyze current activity patterns
-            std::unordered_map<std::string, double> metrics;
-            metrics["activity_level"] = 0.8;  // Placeholder
-            behavior_analyzer.analyzeActivity("current_user", "periodic_check", metrics);
+            // Analyze windowed features of every user seen in the last hour
+            auto analysis_time = std::chrono::system_clock::now();
+            for (const auto& user : feature_extractor.activeUsers(analysis_time)) {
+                behavior_analyzer.analyzeActivity(user, "periodic_check",
+                                                  feature_extractor.extract(user, analysis_time));
+                // No-op unless LLM analysis is enabled; the scheduler decides when to call out
+                behavior_analyzer.requestLLMAnalysis(user);
+            }
 
             // Report productivity metrics
             std::string current_user = time_tracker.getCurrentUser();
@@ -523,12 +781,27 @@ int main(int argc, char* argv[]) {
             // Send recent behavior patterns to backend
             sendRecentBehaviorPatterns(behavior_analyzer, current_user);
         }
+
+        if (counter % 300 == 0) {  // Every five minutes
+            sendDlpRuleStats(dlp_monitor);
+        }
+
+        if (counter % snapshot_interval == 0) {
+            behavior_analyzer.saveSnapshot(snapshot_path);
+        }
+
+        if (counter % 3600 == 0) {  // Every hour
+            behavior_analyzer.pruneMetricHistory(std::chrono::system_clock::now());
+        }
     }
 
     // Stop monitoring
     activity_monitor.stopMonitoring();
     dlp_monitor.stopMonitoring();
     time_tracker.stopTracking();
+    exec_monitor.stop();
+    exec_thread.join();
+    behavior_analyzer.saveSnapshot(snapshot_path);
 
     std::cout << "Workforce Monitoring Agent stopped." << std::endl;
     return 0;
@@ -0,0 +1,293 @@
+#include "metric_store.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace {
+    constexpr unsigned NO_WINDOW = 0xFF;
+
+    uint64_t toBits(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    double fromBits(uint64_t bits) {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Delta-of-delta buckets: control prefix, prefix length, payload bits, payload offset
+    struct DeltaBucket {
+        uint64_t prefix;
+        unsigned prefix_bits;
+        unsigned value_bits;
+        int64_t offset;
+    };
+    constexpr DeltaBucket DELTA_BUCKETS[] = {
+        {0b10, 2, 7, 63},
+        {0b110, 3, 9, 255},
+        {0b1110, 4, 12, 2047},
+    };
+
+    class BitReader {
+    public:
+        BitReader(const std::vector<uint8_t>& bytes, size_t bit_count) : bytes_(bytes), bit_count_(bit_count), position_(0) {}
+
+        uint64_t read(unsigned count) {
+            uint64_t value = 0;
+            while (count > 0) {
+                if (position_ >= bit_count_) return value << count;
+                size_t offset = position_ % 8;
+                unsigned available = static_cast<unsigned>(8 - offset);
+                unsigned take = std::min(available, count);
+                uint64_t byte = bytes_[position_ / 8];
+                uint64_t chunk = (byte >> (available - take)) & ((1u << take) - 1);
+                value = (value << take) | chunk;
+                position_ += take;
+                count -= take;
+            }
+            return value;
+        }
+
+        bool bit() { return read(1) != 0; }
+
+    private:
+        const std::vector<uint8_t>& bytes_;
+        size_t bit_count_;
+        size_t position_;
+    };
+}
+
+MetricChunk::MetricChunk()
+    : bit_count_(0), points_(0), first_timestamp_(0), last_timestamp_(0), last_delta_(0), last_value_(0),
+      last_leading_(NO_WINDOW), last_trailing_(0) {}
+
+void MetricChunk::writeBits(uint64_t value, unsigned count) {
+    while (count > 0) {
+        size_t offset = bit_count_ % 8;
+        if (offset == 0) bits_.push_back(0);
+        unsigned available = static_cast<unsigned>(8 - offset);
+        unsigned take = std::min(available, count);
+        uint64_t chunk = (value >> (count - take)) & ((1u << take) - 1);
+        bits_.back() |= static_cast<uint8_t>(chunk << (available - take));
+        bit_count_ += take;
+        count -= take;
+    }
+}
+
+void MetricChunk::append(int64_t timestamp, double value) {
+    uint64_t bits = toBits(value);
+    if (points_ == 0) {
+        writeBits(static_cast<uint64_t>(timestamp), 64);
+        writeBits(bits, 64);
+        first_timestamp_ = last_timestamp_ = timestamp;
+        last_value_ = bits;
+        points_ = 1;
+        return;
+    }
+
+    int64_t delta = timestamp - last_timestamp_;
+    int64_t delta_of_delta = delta - last_delta_;
+    if (delta_of_delta == 0) {
+        writeBits(0, 1);
+    } else {
+        bool written = false;
+        for (const auto& bucket : DELTA_BUCKETS) {
+            int64_t high = (int64_t(1) << bucket.value_bits) - 1 - bucket.offset;
+            if (delta_of_delta >= -bucket.offset && delta_of_delta <= high) {
+                writeBits(bucket.prefix, bucket.prefix_bits);
+                writeBits(static_cast<uint64_t>(delta_of_delta + bucket.offset), bucket.value_bits);
+                written = true;
+                break;
+            }
+        }
+        if (!written) {
+            writeBits(0b1111, 4);
+            writeBits(static_cast<uint64_t>(delta_of_delta), 64);
+        }
+    }
+    last_delta_ = delta;
+    last_timestamp_ = timestamp;
+
+    uint64_t xored = bits ^ last_value_;
+    if (xored == 0) {
+        writeBits(0, 1);
+    } else {
+        unsigned leading = std::min(31u, static_cast<unsigned>(__builtin_clzll(xored)));
+        unsigned trailing = static_cast<unsigned>(__builtin_ctzll(xored));
+        if (last_leading_ != NO_WINDOW && leading >= last_leading_ && trailing >= last_trailing_) {
+            // Fits in the previous window of meaningful bits
+            writeBits(0b10, 2);
+            writeBits(xored >> last_trailing_, 64 - last_leading_ - last_trailing_);
+        } else {
+            unsigned meaningful = 64 - leading - trailing;
+            writeBits(0b11, 2);
+            writeBits(leading, 5);
+            writeBits(meaningful - 1, 6);
+            writeBits(xored >> trailing, meaningful);
+            last_leading_ = leading;
+            last_trailing_ = trailing;
+        }
+    }
+    last_value_ = bits;
+    points_++;
+}
+
+void MetricChunk::decode(std::vector<MetricPoint>& out, int64_t from, int64_t to) const {
+    if (points_ == 0 || last_timestamp_ < from || first_timestamp_ > to) return;
+
+    BitReader reader(bits_, bit_count_);
+    int64_t timestamp = static_cast<int64_t>(reader.read(64));
+    uint64_t bits = reader.read(64);
+    int64_t delta = 0;
+    unsigned leading = 0;
+    unsigned trailing = 0;
+
+    for (size_t i = 0; i < points_; ++i) {
+        if (i > 0) {
+            int64_t delta_of_delta = 0;
+            if (reader.bit()) {
+                // Each longer bucket adds one more 1 to the prefix; a 0 ends it
+                bool decoded = false;
+                for (const auto& bucket : DELTA_BUCKETS) {
+                    if (!reader.bit()) {
+                        delta_of_delta = static_cast<int64_t>(reader.read(bucket.value_bits)) - bucket.offset;
+                        decoded = true;
+                        break;
+                    }
+                }
+                if (!decoded) {
+                    delta_of_delta = static_cast<int64_t>(reader.read(64));
+                }
+            }
+            delta += delta_of_delta;
+            timestamp += delta;
+
+            if (reader.bit()) {
+                if (reader.bit()) {
+                    leading = static_cast<unsigned>(reader.read(5));
+                    unsigned meaningful = static_cast<unsigned>(reader.read(6)) + 1;
+                    trailing = 64 - leading - meaningful;
+                }
+                bits ^= reader.read(64 - leading - trailing) << trailing;
+            }
+        }
+
+        if (timestamp > to) break;
+        if (timestamp >= from) {
+            out.push_back(MetricPoint{timestamp, fromBits(bits)});
+        }
+    }
+}
+
+MetricStore::MetricStore(std::chrono::hours retention, size_t max_bytes)
+    : retention_(retention), max_bytes_(max_bytes), sealed_bytes_(0) {}
+
+void MetricStore::append(const std::string& user, const std::string& metric,
+                         std::chrono::system_clock::time_point time, double value) {
+    int64_t timestamp = std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series& series = users_[user][metric];
+    if (!series.chunks.empty()) {
+        MetricChunk& open = series.chunks.back();
+        if (open.points() > 0 && timestamp <= open.lastTimestamp()) {
+            return;  // Chunks only take increasing timestamps
+        }
+        if (open.points() >= CHUNK_POINTS) {
+            open.seal();
+            sealed_bytes_ += open.bytes();
+            series.chunks.emplace_back();
+        }
+    } else {
+        series.chunks.emplace_back();
+    }
+    series.chunks.back().append(timestamp, value);
+
+    while (sealed_bytes_ > max_bytes_ && dropOldestChunk()) {
+    }
+}
+
+bool MetricStore::dropOldestChunk() {
+    Series* oldest = nullptr;
+    for (auto& user : users_) {
+        for (auto& entry : user.second) {
+            Series& series = entry.second;
+            if (series.chunks.size() < 2) continue;  // Only sealed chunks are dropped
+            if (!oldest || series.chunks.front().lastTimestamp() < oldest->chunks.front().lastTimestamp()) {
+                oldest = &series;
+            }
+        }
+    }
+    if (!oldest) return false;
+
+    sealed_bytes_ -= oldest->chunks.front().bytes();
+    oldest->chunks.pop_front();
+    return true;
+}
+
+void MetricStore::enforceRetention(std::chrono::system_clock::time_point now) {
+    int64_t cutoff = std::chrono::duration_cast<std::chrono::seconds>((now - retention_).time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto user = users_.begin(); user != users_.end();) {
+        auto& metrics = user->second;
+        for (auto metric = metrics.begin(); metric != metrics.end();) {
+            auto& chunks = metric->second.chunks;
+            while (chunks.size() > 1 && chunks.front().lastTimestamp() < cutoff) {
+                sealed_bytes_ -= chunks.front().bytes();
+                chunks.pop_front();
+            }
+            // A series whose open chunk has expired as well is gone entirely
+            if (chunks.size() == 1 && chunks.front().lastTimestamp() < cutoff) {
+                chunks.clear();
+            }
+            metric = chunks.empty() ? metrics.erase(metric) : std::next(metric);
+        }
+        user = metrics.empty() ? users_.erase(user) : std::next(user);
+    }
+}
+
+std::vector<MetricPoint> MetricStore::query(const std::string& user, const std::string& metric,
+                                            std::chrono::system_clock::time_point from,
+                                            std::chrono::system_clock::time_point to) const {
+    int64_t first = std::chrono::duration_cast<std::chrono::seconds>(from.time_since_epoch()).count();
+    int64_t last = std::chrono::duration_cast<std::chrono::seconds>(to.time_since_epoch()).count();
+
+    std::vector<MetricPoint> points;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto user_it = users_.find(user);
+    if (user_it == users_.end()) return points;
+    auto metric_it = user_it->second.find(metric);
+    if (metric_it == user_it->second.end()) return points;
+
+    for (const auto& chunk : metric_it->second.chunks) {
+        chunk.decode(points, first, last);
+    }
+    return points;
+}
+
+std::vector<std::string> MetricStore::metrics(const std::string& user) const {
+    std::vector<std::string> names;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = users_.find(user);
+    if (it == users_.end()) return names;
+    for (const auto& entry : it->second) {
+        names.push_back(entry.first);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+size_t MetricStore::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t open_bytes = 0;
+    for (const auto& user : users_) {
+        for (const auto& entry : user.second) {
+            if (!entry.second.chunks.empty()) open_bytes += entry.second.chunks.back().bytes();
+        }
+    }
+    return sealed_bytes_ + open_bytes;
+}
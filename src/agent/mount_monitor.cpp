@@ -0,0 +1,151 @@
+#include "mount_monitor.h"
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    // mountinfo escapes space, tab, newline and backslash as \ooo
+    std::string unescapeMountField(const std::string& field) {
+        std::string result;
+        result.reserve(field.size());
+        for (size_t i = 0; i < field.size(); ++i) {
+            if (field[i] == '\\' && i + 3 < field.size() &&
+                field[i + 1] >= '0' && field[i + 1] <= '7' &&
+                field[i + 2] >= '0' && field[i + 2] <= '7' &&
+                field[i + 3] >= '0' && field[i + 3] <= '7') {
+                result += static_cast<char>(((field[i + 1] - '0') << 6) | ((field[i + 2] - '0') << 3) | (field[i + 3] - '0'));
+                i += 3;
+            } else {
+                result += field[i];
+            }
+        }
+        return result;
+    }
+
+    bool readFlag(const std::string& path) {
+        std::ifstream file(path);
+        int value = 0;
+        return file >> value && value != 0;
+    }
+}
+
+MountMonitor::MountMonitor() : fd_(-1) {}
+
+MountMonitor::~MountMonitor() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool MountMonitor::open() {
+    fd_ = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) return false;
+    return readMountTable(mounts_);
+}
+
+bool MountMonitor::refresh(std::vector<MountInfo>& added, std::vector<MountInfo>& removed) {
+    added.clear();
+    removed.clear();
+
+    std::unordered_map<int, MountInfo> table;
+    if (!readMountTable(table)) return false;
+
+    for (const auto& [id, mount] : table) {
+        if (!mounts_.count(id)) added.push_back(mount);
+    }
+    for (const auto& [id, mount] : mounts_) {
+        if (!table.count(id)) removed.push_back(mount);
+    }
+
+    mounts_.swap(table);
+    return true;
+}
+
+bool MountMonitor::readMountTable(std::unordered_map<int, MountInfo>& table) {
+    if (fd_ < 0) return false;
+
+    // Reading the file from the start also re-arms the POLLPRI notification
+    if (lseek(fd_, 0, SEEK_SET) < 0) return false;
+
+    std::string contents;
+    char buffer[8192];
+    ssize_t len;
+    while ((len = read(fd_, buffer, sizeof(buffer))) > 0) {
+        contents.append(buffer, static_cast<size_t>(len));
+    }
+    if (len < 0) return false;
+
+    std::istringstream stream(contents);
+    std::string line;
+    while (std::getline(stream, line)) {
+        MountInfo mount;
+        if (parseLine(line, mount)) {
+            table[mount.mount_id] = mount;
+        }
+    }
+    return true;
+}
+
+bool MountMonitor::parseLine(const std::string& line, MountInfo& mount) {
+    // 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+    std::istringstream fields(line);
+    std::string parent_id, device, root, mount_point, options, field;
+
+    if (!(fields >> mount.mount_id >> parent_id >> device >> root >> mount_point >> options)) {
+        return false;
+    }
+
+    // Optional fields end at the "-" separator
+    while (fields >> field && field != "-") {}
+    if (field != "-" || !(fields >> mount.fs_type >> mount.source)) {
+        return false;
+    }
+
+    mount.mount_point = unescapeMountField(mount_point);
+    mount.source = unescapeMountField(mount.source);
+    mount.network = isNetworkFilesystem(mount.fs_type);
+    mount.removable = !mount.network &&
+        (isRemovableSource(mount.source) ||
+         mount.mount_point.rfind("/media/", 0) == 0 ||
+         mount.mount_point.rfind("/run/media/", 0) == 0);
+    return true;
+}
+
+bool MountMonitor::isRemovableSource(const std::string& source) {
+    if (source.rfind("/dev/", 0) != 0) return false;
+
+    // Resolve /dev/disk/by-* symlinks and device-mapper names to the kernel name
+    char resolved[PATH_MAX];
+    std::string device = realpath(source.c_str(), resolved) ? resolved : source;
+    std::string name = device.substr(device.find_last_of('/') + 1);
+    if (name.empty()) return false;
+
+    std::string sys_path = "/sys/class/block/" + name;
+    char sys_resolved[PATH_MAX];
+    if (!realpath(sys_path.c_str(), sys_resolved)) return false;
+    std::string device_path = sys_resolved;
+
+    // USB disks frequently report removable=0, so the bus counts as well
+    if (device_path.find("/usb") != std::string::npos) return true;
+
+    if (readFlag(device_path + "/removable")) return true;
+
+    // Partitions carry the flag on their parent disk
+    std::ifstream partition(device_path + "/partition");
+    if (partition.is_open()) {
+        return readFlag(device_path.substr(0, device_path.find_last_of('/')) + "/removable");
+    }
+    return false;
+}
+
+bool MountMonitor::isNetworkFilesystem(const std::string& fs_type) {
+    static const std::unordered_set<std::string> network_types = {
+        "nfs", "nfs4", "cifs", "smb3", "smbfs", "9p", "afs", "ceph", "glusterfs",
+        "davfs", "fuse.sshfs", "fuse.rclone", "fuse.davfs2", "fuse.s3fs"
+    };
+    return network_types.count(fs_type) > 0;
+}
@@ -0,0 +1,289 @@
+#include "packet_flow_monitor.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+namespace {
+    // Ring geometry: 16 x 256 KiB blocks. Captures are header-sized, so this
+    // holds tens of thousands of packets between wakeups.
+    const unsigned int RING_BLOCK_SIZE = 1 << 18;
+    const unsigned int RING_BLOCK_COUNT = 16;
+    const unsigned int RING_FRAME_SIZE = 2048;
+    const unsigned int BLOCK_RETIRE_TIMEOUT_MS = 50;
+
+    const size_t MAX_PROBE = 32;
+
+    size_t roundUpPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) result <<= 1;
+        return result;
+    }
+}
+
+FlowTable::FlowTable(size_t capacity)
+    : slots_(roundUpPowerOfTwo(capacity)),
+      mask_(roundUpPowerOfTwo(capacity) - 1),
+      used_count_(0),
+      dropped_packets_(0) {
+    for (auto& slot : slots_) {
+        slot.used = false;
+    }
+}
+
+size_t FlowTable::slotFor(const FlowKey& key) const {
+    uint64_t h = (static_cast<uint64_t>(key.saddr) << 32) ^ key.daddr;
+    h ^= (static_cast<uint64_t>(key.sport) << 24) ^ (static_cast<uint64_t>(key.dport) << 8) ^ key.protocol;
+    // splitmix64 finalizer
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return static_cast<size_t>(h) & mask_;
+}
+
+bool FlowTable::account(const FlowKey& key, uint32_t bytes) {
+    size_t index = slotFor(key);
+    for (size_t probe = 0; probe < MAX_PROBE; ++probe) {
+        Slot& slot = slots_[(index + probe) & mask_];
+        if (!slot.used) {
+            slot.used = true;
+            slot.record = FlowRecord{key, bytes, 1};
+            ++used_count_;
+            return true;
+        }
+        if (slot.record.key == key) {
+            slot.record.bytes += bytes;
+            slot.record.packets++;
+            return true;
+        }
+    }
+    ++dropped_packets_;
+    return false;
+}
+
+void FlowTable::drain(std::vector<FlowRecord>& flows) {
+    flows.clear();
+    if (used_count_ == 0) return;
+
+    flows.reserve(used_count_);
+    for (auto& slot : slots_) {
+        if (slot.used) {
+            flows.push_back(slot.record);
+            slot.used = false;
+        }
+    }
+    used_count_ = 0;
+}
+
+PacketFlowMonitor::PacketFlowMonitor()
+    : socket_fd_(-1),
+      ring_(nullptr),
+      ring_size_(0),
+      block_size_(RING_BLOCK_SIZE),
+      block_count_(RING_BLOCK_COUNT),
+      running_(false),
+      flush_interval_(5) {}
+
+PacketFlowMonitor::~PacketFlowMonitor() {
+    stop();
+}
+
+void PacketFlowMonitor::setCallback(std::function<void(const std::vector<FlowRecord>&)> callback) {
+    callback_ = callback;
+}
+
+bool PacketFlowMonitor::start(const std::string& interface) {
+    if (running_) return true;
+
+    socket_fd_ = socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC, htons(ETH_P_ALL));
+    if (socket_fd_ < 0) {
+        std::cerr << "Packet capture unavailable: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    int version = TPACKET_V3;
+    if (setsockopt(socket_fd_, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0 ||
+        !attachFilter() || !setupRing()) {
+        std::cerr << "Failed to set up packet capture ring: " << strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+
+    struct sockaddr_ll address;
+    std::memset(&address, 0, sizeof(address));
+    address.sll_family = AF_PACKET;
+    address.sll_protocol = htons(ETH_P_ALL);
+    address.sll_ifindex = 0;
+    if (!interface.empty() && interface != "any") {
+        address.sll_ifindex = static_cast<int>(if_nametoindex(interface.c_str()));
+        if (address.sll_ifindex == 0) {
+            std::cerr << "Unknown capture interface: " << interface << std::endl;
+            stop();
+            return false;
+        }
+    }
+
+    if (bind(socket_fd_, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Failed to bind packet capture socket: " << strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+
+    running_ = true;
+    capture_thread_ = std::thread(&PacketFlowMonitor::captureLoop, this);
+    std::cout << "Packet flow accounting started on " << (interface.empty() ? "any" : interface) << std::endl;
+    return true;
+}
+
+void PacketFlowMonitor::stop() {
+    running_ = false;
+    if (capture_thread_.joinable()) {
+        capture_thread_.join();
+    }
+    if (ring_) {
+        munmap(ring_, ring_size_);
+        ring_ = nullptr;
+        ring_size_ = 0;
+    }
+    if (socket_fd_ >= 0) {
+        close(socket_fd_);
+        socket_fd_ = -1;
+    }
+}
+
+bool PacketFlowMonitor::attachFilter() {
+    // Outgoing, unfragmented (or first fragment) IPv4 TCP/UDP only. The return
+    // value is the snap length: IP header plus TCP or UDP header, never payload.
+    // The socket listens on ETH_P_ALL because only those taps see transmitted
+    // packets, so the ethertype is checked here.
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<__u32>(SKF_AD_OFF + SKF_AD_PROTOCOL)), // 0: A = ethertype
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 19),            // 1: IPv4 ? 2 : reject
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<__u32>(SKF_AD_OFF + SKF_AD_PKTTYPE)),  // 2: A = packet type
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 0, 17),     // 3: outgoing ? 4 : reject
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),                           // 4: A = version/ihl
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 4),                          // 5: A = version
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 4, 0, 14),                   // 6: IPv4 ? 7 : reject
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6),                           // 7: A = frag offset
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 12, 0),             // 8: later fragment ? reject : 9
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),                          // 9: X = IPv4 header length
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9),                           // 10: A = protocol
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, 0, 5),          // 11: TCP ? 12 : 17
+        BPF_STMT(BPF_LD | BPF_B | BPF_IND, 12),                          // 12: A = TCP data offset byte
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xf0),                       // 13
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 2),                          // 14: A = TCP header length
+        BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),                          // 15: A += IP header length
+        BPF_STMT(BPF_RET | BPF_A, 0),                                    // 16: keep headers only
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 3),          // 17: UDP ? 18 : reject
+        BPF_STMT(BPF_MISC | BPF_TXA, 0),                                 // 18: A = IP header length
+        BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 8),                          // 19: A += UDP header length
+        BPF_STMT(BPF_RET | BPF_A, 0),                                    // 20: keep headers only
+        BPF_STMT(BPF_RET | BPF_K, 0),                                    // 21: reject
+    };
+
+    struct sock_fprog program;
+    program.len = sizeof(code) / sizeof(code[0]);
+    program.filter = code;
+
+    return setsockopt(socket_fd_, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) == 0;
+}
+
+bool PacketFlowMonitor::setupRing() {
+    struct tpacket_req3 request;
+    std::memset(&request, 0, sizeof(request));
+    request.tp_block_size = block_size_;
+    request.tp_block_nr = block_count_;
+    request.tp_frame_size = RING_FRAME_SIZE;
+    request.tp_frame_nr = (block_size_ / RING_FRAME_SIZE) * block_count_;
+    request.tp_retire_blk_tov = BLOCK_RETIRE_TIMEOUT_MS;
+
+    if (setsockopt(socket_fd_, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)) != 0) {
+        return false;
+    }
+
+    ring_size_ = static_cast<size_t>(block_size_) * block_count_;
+    void* ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, socket_fd_, 0);
+    if (ring == MAP_FAILED) {
+        // MAP_LOCKED can fail under RLIMIT_MEMLOCK; the ring works unlocked too
+        ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED, socket_fd_, 0);
+    }
+    if (ring == MAP_FAILED) {
+        ring_size_ = 0;
+        return false;
+    }
+
+    ring_ = static_cast<uint8_t*>(ring);
+    return true;
+}
+
+void PacketFlowMonitor::captureLoop() {
+    unsigned int block_index = 0;
+    auto last_flush = std::chrono::steady_clock::now();
+    struct pollfd pfd = {socket_fd_, POLLIN | POLLERR, 0};
+
+    while (running_) {
+        auto* block = reinterpret_cast<struct tpacket_block_desc*>(
+            ring_ + static_cast<size_t>(block_index) * block_size_);
+
+        uint32_t status = __atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+        if (status & TP_STATUS_USER) {
+            processBlock(block);
+            __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            block_index = (block_index + 1) % block_count_;
+        } else {
+            poll(&pfd, 1, 250);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_flush >= flush_interval_) {
+            flush();
+            last_flush = now;
+        }
+    }
+
+    flush();
+}
+
+void PacketFlowMonitor::processBlock(struct tpacket_block_desc* block) {
+    uint32_t packet_count = block->hdr.bh1.num_pkts;
+    auto* header = reinterpret_cast<struct tpacket3_hdr*>(
+        reinterpret_cast<uint8_t*>(block) + block->hdr.bh1.offset_to_first_pkt);
+
+    for (uint32_t i = 0; i < packet_count; ++i) {
+        const uint8_t* ip = reinterpret_cast<const uint8_t*>(header) + header->tp_net;
+        uint32_t captured = header->tp_snaplen - (header->tp_net - header->tp_mac);
+        size_t ip_header_len = static_cast<size_t>(ip[0] & 0x0F) * 4;
+
+        if (captured >= ip_header_len + 4 && ip_header_len >= 20) {
+            FlowKey key;
+            key.protocol = ip[9];
+            std::memcpy(&key.saddr, ip + 12, sizeof(key.saddr));
+            std::memcpy(&key.daddr, ip + 16, sizeof(key.daddr));
+            key.sport = static_cast<uint16_t>((ip[ip_header_len] << 8) | ip[ip_header_len + 1]);
+            key.dport = static_cast<uint16_t>((ip[ip_header_len + 2] << 8) | ip[ip_header_len + 3]);
+
+            // tp_len is the original length, including any payload the filter cut off
+            flow_table_.account(key, header->tp_len);
+        }
+
+        header = reinterpret_cast<struct tpacket3_hdr*>(
+            reinterpret_cast<uint8_t*>(header) + header->tp_next_offset);
+    }
+}
+
+void PacketFlowMonitor::flush() {
+    flow_table_.drain(drained_flows_);
+    if (!drained_flows_.empty() && callback_) {
+        callback_(drained_flows_);
+    }
+}
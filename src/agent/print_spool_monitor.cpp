@@ -0,0 +1,376 @@
+#include "print_spool_monitor.h"
+#include <iostream>
+#include <fstream>
+#include <string_view>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+    // Decompressed PDF streams are capped separately from the spooled size
+    constexpr size_t MAX_INFLATED_BYTES = 32 * 1024 * 1024;
+    constexpr size_t MAX_TEXT_BYTES = 4 * 1024 * 1024;
+    constexpr size_t MAX_CONTROL_FILE_BYTES = 64 * 1024;
+
+    // Data files are named d<job-id>-<document>, e.g. d00042-001
+    bool parseDataFileName(const char* name, int& job_id) {
+        if (name[0] != 'd' || !isdigit(static_cast<unsigned char>(name[1]))) return false;
+        char* end = nullptr;
+        long id = strtol(name + 1, &end, 10);
+        if (*end != '-' || !isdigit(static_cast<unsigned char>(end[1]))) return false;
+        job_id = static_cast<int>(id);
+        return true;
+    }
+
+    bool readFile(const std::string& path, size_t max_size, std::string& data, uint64_t& size) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        file.seekg(0, std::ios::end);
+        size = static_cast<uint64_t>(file.tellg());
+        file.seekg(0, std::ios::beg);
+
+        data.resize(static_cast<size_t>(std::min<uint64_t>(size, max_size)));
+        file.read(&data[0], static_cast<std::streamsize>(data.size()));
+        data.resize(static_cast<size_t>(file.gcount()));
+        return true;
+    }
+
+    void appendText(std::string& out, const std::string& piece, size_t max_text, bool separate = true) {
+        if (piece.empty() || out.size() >= max_text) return;
+        out.append(piece, 0, max_text - out.size());
+        if (separate && out.size() < max_text) out += ' ';
+    }
+
+    // Collects PostScript/PDF string literals "(...)" and printable hex strings "<...>".
+    // Pieces of a PDF TJ array form one run of text; only large kerning offsets are spaces.
+    void appendStrings(std::string_view src, std::string& out, size_t max_text) {
+        bool in_array = false;
+        size_t i = 0;
+        while (i < src.size() && out.size() < max_text) {
+            char c = src[i];
+            if (c == '[' || c == ']') {
+                in_array = c == '[';
+                if (!in_array && !out.empty() && out.back() != ' ') out += ' ';
+                ++i;
+            } else if (in_array && (c == '-' || isdigit(static_cast<unsigned char>(c)))) {
+                size_t end = i + 1;
+                while (end < src.size() && (isdigit(static_cast<unsigned char>(src[end])) || src[end] == '.')) ++end;
+                double offset = strtod(std::string(src.substr(i, end - i)).c_str(), nullptr);
+                if ((offset >= 200 || offset <= -200) && !out.empty() && out.back() != ' ') out += ' ';
+                i = end;
+            } else if (c == '(') {
+                std::string literal;
+                int depth = 1;
+                ++i;
+                while (i < src.size() && depth > 0) {
+                    char ch = src[i++];
+                    if (ch == '\\' && i < src.size()) {
+                        char esc = src[i++];
+                        switch (esc) {
+                            case 'n': literal += '\n'; break;
+                            case 'r': literal += '\r'; break;
+                            case 't': literal += '\t'; break;
+                            case 'b': case 'f': break;
+                            case '\n': break;  // Line continuation
+                            default:
+                                if (esc >= '0' && esc <= '7') {
+                                    int value = esc - '0';
+                                    for (int n = 0; n < 2 && i < src.size() && src[i] >= '0' && src[i] <= '7'; ++n) {
+                                        value = value * 8 + (src[i++] - '0');
+                                    }
+                                    literal += static_cast<char>(value);
+                                } else {
+                                    literal += esc;
+                                }
+                        }
+                    } else if (ch == '(') {
+                        ++depth;
+                        literal += ch;
+                    } else if (ch == ')') {
+                        if (--depth > 0) literal += ch;
+                    } else {
+                        literal += ch;
+                    }
+                }
+                appendText(out, literal, max_text, !in_array);
+            } else if (c == '<' && i + 1 < src.size() && src[i + 1] == '<') {
+                i += 2;  // Dictionary start, not a hex string
+            } else if (c == '<') {
+                size_t end = src.find('>', i + 1);
+                if (end == std::string_view::npos) break;
+
+                std::string decoded;
+                bool printable = true;
+                int high = -1;
+                for (size_t j = i + 1; j < end && printable; ++j) {
+                    if (!isxdigit(static_cast<unsigned char>(src[j]))) continue;
+                    int digit = isdigit(static_cast<unsigned char>(src[j])) ? src[j] - '0' : (tolower(src[j]) - 'a' + 10);
+                    if (high < 0) {
+                        high = digit;
+                    } else {
+                        char byte = static_cast<char>(high * 16 + digit);
+                        printable = isprint(static_cast<unsigned char>(byte)) || isspace(static_cast<unsigned char>(byte));
+                        decoded += byte;
+                        high = -1;
+                    }
+                }
+                // Two-byte glyph ids of embedded fonts cannot be mapped back to text
+                if (printable) appendText(out, decoded, max_text, !in_array);
+                i = end + 1;
+            } else {
+                ++i;
+            }
+        }
+    }
+
+#ifdef HAVE_ZLIB
+    bool inflateStream(std::string_view input, std::string& output, size_t max_output) {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit(&stream) != Z_OK) return false;
+
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream.avail_in = static_cast<uInt>(input.size());
+
+        char buffer[16384];
+        int ret;
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(buffer);
+            stream.avail_out = sizeof(buffer);
+            ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END) break;
+            output.append(buffer, sizeof(buffer) - stream.avail_out);
+        } while (ret == Z_OK && output.size() < max_output);
+
+        inflateEnd(&stream);
+        return !output.empty();
+    }
+#endif
+
+    void extractPdfText(const std::string& data, std::string& text, size_t max_text) {
+        std::string_view view(data);
+#ifdef HAVE_ZLIB
+        size_t inflated_total = 0;
+#endif
+        size_t outside_start = 0;
+        size_t pos = 0;
+
+        while (text.size() < max_text) {
+            size_t keyword = data.find("stream", pos);
+            if (keyword == std::string::npos) break;
+            if (keyword >= 3 && data.compare(keyword - 3, 3, "end") == 0) {
+                pos = keyword + 6;
+                continue;
+            }
+
+            size_t begin = keyword + 6;
+            if (begin < data.size() && data[begin] == '\r') ++begin;
+            if (begin < data.size() && data[begin] == '\n') ++begin;
+            size_t end = data.find("endstream", begin);
+            if (end == std::string::npos) break;
+
+            // Text outside streams carries the document info (/Title, /Author, ...)
+            appendStrings(view.substr(outside_start, keyword - outside_start), text, max_text);
+
+            size_t object = data.rfind("obj", keyword);
+            std::string_view dictionary = object == std::string::npos ? std::string_view()
+                                                                       : view.substr(object, keyword - object);
+            std::string_view body = view.substr(begin, end - begin);
+
+            if (dictionary.find("/FlateDecode") != std::string_view::npos) {
+#ifdef HAVE_ZLIB
+                std::string inflated;
+                if (inflated_total < MAX_INFLATED_BYTES &&
+                    inflateStream(body, inflated, MAX_INFLATED_BYTES - inflated_total)) {
+                    inflated_total += inflated.size();
+                    appendStrings(inflated, text, max_text);
+                }
+#endif
+            } else if (dictionary.find("/Filter") == std::string_view::npos) {
+                appendStrings(body, text, max_text);
+            }
+            // Images and other encoded streams carry no text
+
+            pos = end + 9;
+            outside_start = pos;
+        }
+
+        if (outside_start < data.size()) {
+            appendStrings(view.substr(outside_start), text, max_text);
+        }
+    }
+
+    void extractPostScriptText(const std::string& data, std::string& text, size_t max_text) {
+        // DSC comments name the document, e.g. "%%Title: q3-forecast.xlsx"
+        size_t line_start = 0;
+        while (line_start < data.size() && data[line_start] == '%') {
+            size_t line_end = data.find('\n', line_start);
+            if (line_end == std::string::npos) line_end = data.size();
+            if (data.compare(line_start, 8, "%%Title:") == 0) {
+                appendText(text, data.substr(line_start + 8, line_end - line_start - 8), max_text);
+            }
+            line_start = line_end + 1;
+        }
+        appendStrings(data, text, max_text);
+    }
+}
+
+PrintSpoolMonitor::PrintSpoolMonitor()
+    : spool_directory_("/var/spool/cups"), max_document_size_(64 * 1024 * 1024), stopped_(false) {
+    if (pipe2(wake_pipe_, O_CLOEXEC | O_NONBLOCK) < 0) {
+        wake_pipe_[0] = wake_pipe_[1] = -1;
+    }
+}
+
+PrintSpoolMonitor::~PrintSpoolMonitor() {
+    if (wake_pipe_[0] >= 0) close(wake_pipe_[0]);
+    if (wake_pipe_[1] >= 0) close(wake_pipe_[1]);
+}
+
+void PrintSpoolMonitor::setCallback(std::function<void(const PrintJob&)> callback) {
+    callback_ = callback;
+}
+
+bool PrintSpoolMonitor::run() {
+    if (stopped_) return true;
+
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) return false;
+
+    // cupsd writes documents in place or renames them in from its tmp directory
+    if (inotify_add_watch(inotify_fd, spool_directory_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "Cannot watch print spool " << spool_directory_ << ": " << strerror(errno) << std::endl;
+        close(inotify_fd);
+        return false;
+    }
+    std::cout << "Monitoring print spool: " << spool_directory_ << std::endl;
+
+    alignas(struct inotify_event) char buffer[4096];
+    while (!stopped_) {
+        struct pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+        int ready = poll(fds, 2, -1);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0 || (fds[1].revents & POLLIN)) break;
+
+        ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+        if (len <= 0) continue;
+
+        bool spool_removed = false;
+        for (char* ptr = buffer; ptr < buffer + len;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_IGNORED) {
+                spool_removed = true;
+                continue;
+            }
+            if (event->len == 0 || (event->mask & IN_ISDIR)) continue;
+
+            PrintJob job;
+            if (loadJob(event->name, job) && callback_) {
+                callback_(job);
+            }
+        }
+        if (spool_removed) {
+            std::cerr << "Print spool directory removed: " << spool_directory_ << std::endl;
+            break;
+        }
+    }
+
+    close(inotify_fd);
+    return true;
+}
+
+void PrintSpoolMonitor::stop() {
+    stopped_ = true;
+    if (wake_pipe_[1] >= 0) {
+        ssize_t written = write(wake_pipe_[1], "x", 1);
+        (void)written;
+    }
+}
+
+bool PrintSpoolMonitor::loadJob(const std::string& file_name, PrintJob& job) {
+    if (!parseDataFileName(file_name.c_str(), job.job_id)) return false;
+
+    job.data_path = spool_directory_ + "/" + file_name;
+    std::string data;
+    if (!readFile(job.data_path, max_document_size_, data, job.size)) return false;
+    if (data.empty()) return false;
+
+    job.content_hash = std::hash<std::string>{}(data);
+    job.text = extractText(data, job.format, MAX_TEXT_BYTES);
+
+    // Job attributes are optional; the control file may not be written yet
+    std::string control_path = spool_directory_ + "/c" + file_name.substr(1, file_name.find('-') - 1);
+    parseControlFile(control_path, job);
+    return true;
+}
+
+std::string PrintSpoolMonitor::extractText(const std::string& data, std::string& format, size_t max_text) {
+    std::string text;
+    if (data.compare(0, 5, "%PDF-") == 0) {
+        format = "pdf";
+        extractPdfText(data, text, max_text);
+    } else if (data.compare(0, 2, "%!") == 0) {
+        format = "postscript";
+        extractPostScriptText(data, text, max_text);
+    } else {
+        // Plain text and printer languages such as PCL are scanned as they are
+        format = "raw";
+        text = data.substr(0, max_text);
+    }
+    return text;
+}
+
+bool PrintSpoolMonitor::parseControlFile(const std::string& path, PrintJob& job) {
+    std::string data;
+    uint64_t size = 0;
+    if (!readFile(path, MAX_CONTROL_FILE_BYTES, data, size) || data.size() < 8) return false;
+
+    // IPP message: version, operation, request id, then tagged attributes
+    auto readLength = [&data](size_t pos) {
+        return (static_cast<size_t>(static_cast<unsigned char>(data[pos])) << 8) |
+               static_cast<unsigned char>(data[pos + 1]);
+    };
+
+    size_t pos = 8;
+    while (pos < data.size()) {
+        unsigned char tag = static_cast<unsigned char>(data[pos++]);
+        if (tag == 0x03) break;     // End of attributes
+        if (tag < 0x10) continue;   // Group delimiter
+
+        if (pos + 2 > data.size()) break;
+        size_t name_length = readLength(pos);
+        pos += 2;
+        if (pos + name_length + 2 > data.size()) break;
+        std::string name = data.substr(pos, name_length);
+        pos += name_length;
+
+        size_t value_length = readLength(pos);
+        pos += 2;
+        if (pos + value_length > data.size()) break;
+        std::string value = data.substr(pos, value_length);
+        pos += value_length;
+
+        if (name == "job-name") {
+            job.job_name = value;
+        } else if (name == "job-originating-user-name") {
+            job.user = value;
+        } else if (name == "job-printer-uri" || name == "printer-uri") {
+            job.printer = value.substr(value.find_last_of('/') + 1);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,236 @@
+#include "process_attribution.h"
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <sys/stat.h>
+
+namespace {
+    // Upper bound on remembered misses before the negative cache is reset
+    const size_t MAX_UNRESOLVED_SOCKETS = 4096;
+
+    // Parses "socket:[12345]" readlink targets
+    bool parseSocketInode(const char* target, ssize_t len, uint64_t& inode) {
+        static const char prefix[] = "socket:[";
+        const ssize_t prefix_len = sizeof(prefix) - 1;
+        if (len <= prefix_len + 1 || std::memcmp(target, prefix, prefix_len) != 0) return false;
+        if (target[len - 1] != ']') return false;
+
+        uint64_t value = 0;
+        for (ssize_t i = prefix_len; i < len - 1; ++i) {
+            if (target[i] < '0' || target[i] > '9') return false;
+            value = value * 10 + static_cast<uint64_t>(target[i] - '0');
+        }
+        inode = value;
+        return true;
+    }
+}
+
+bool parseProcPid(const char* name, int& pid) {
+    if (*name < '1' || *name > '9') return false;
+    char* end = nullptr;
+    long value = std::strtol(name, &end, 10);
+    if (*end != '\0' || value <= 0) return false;
+    pid = static_cast<int>(value);
+    return true;
+}
+
+bool readProcessInfo(int pid, ProcessInfo& info) {
+    std::string proc_dir = "/proc/" + std::to_string(pid);
+
+    struct stat st;
+    if (stat(proc_dir.c_str(), &st) != 0) return false;
+
+    info.pid = pid;
+    info.uid = st.st_uid;
+    info.user = userName(st.st_uid);
+
+    info.comm.clear();
+    std::ifstream comm_file(proc_dir + "/comm");
+    if (comm_file.is_open()) {
+        std::getline(comm_file, info.comm);
+    }
+
+    char exe[4096];
+    ssize_t len = readlink((proc_dir + "/exe").c_str(), exe, sizeof(exe) - 1);
+    if (len > 0) {
+        info.exe_path.assign(exe, static_cast<size_t>(len));
+    } else {
+        // Kernel threads and other users' processes without ptrace access
+        info.exe_path.clear();
+    }
+
+    return true;
+}
+
+std::string userName(uid_t uid) {
+    static std::mutex mutex;
+    static std::unordered_map<uid_t, std::string> names;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = names.find(uid);
+    if (it != names.end()) return it->second;
+
+    std::string name = std::to_string(uid);
+    struct passwd pwd;
+    struct passwd* result = nullptr;
+    char buffer[1024];
+    if (getpwuid_r(uid, &pwd, buffer, sizeof(buffer), &result) == 0 && result) {
+        name = result->pw_name;
+    }
+
+    names.emplace(uid, name);
+    return name;
+}
+
+ProcessAttributionCache::ProcessAttributionCache()
+    : last_full_scan_(),
+      rescan_interval_(std::chrono::seconds(2)) {}
+
+void ProcessAttributionCache::setRescanInterval(std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rescan_interval_ = interval;
+}
+
+bool ProcessAttributionCache::lookupSocket(uint64_t inode, ProcessInfo& info) {
+    if (inode == 0) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto resolve = [&]() {
+        auto owner = socket_owners_.find(inode);
+        if (owner == socket_owners_.end()) return false;
+        auto entry = pids_.find(owner->second);
+        if (entry == pids_.end()) return false;
+        info = entry->second.info;
+        return true;
+    };
+
+    if (resolve()) return true;
+
+    auto now = std::chrono::steady_clock::now();
+    bool rescan_due = now - last_full_scan_ >= rescan_interval_;
+
+    // Known miss and nothing could have changed enough to justify another walk
+    if (!rescan_due && unresolved_sockets_.count(inode)) return false;
+
+    // Cheap pass first: only processes we have not seen before
+    refreshPidList(false);
+    if (resolve()) return true;
+
+    // Sockets opened later by already known processes need a full rescan
+    if (rescan_due) {
+        refreshPidList(true);
+        last_full_scan_ = now;
+        unresolved_sockets_.clear();
+        if (resolve()) return true;
+    }
+
+    if (unresolved_sockets_.size() >= MAX_UNRESOLVED_SOCKETS) {
+        unresolved_sockets_.clear();
+    }
+    unresolved_sockets_.insert(inode);
+    return false;
+}
+
+bool ProcessAttributionCache::lookupProcess(int pid, ProcessInfo& info, const std::string& comm_hint) {
+    if (pid <= 0) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = pids_.find(pid);
+    if (it != pids_.end()) {
+        // A different comm means the pid was reused or the process exec'd
+        if (comm_hint.empty() || comm_hint == it->second.info.comm) {
+            info = it->second.info;
+            return true;
+        }
+        forgetPid(pid);
+    }
+
+    PidEntry entry;
+    if (!readProcessInfo(pid, entry.info)) return false;
+    info = entry.info;
+    pids_.emplace(pid, std::move(entry));
+    return true;
+}
+
+void ProcessAttributionCache::refreshPidList(bool rescan_known) {
+    DIR* proc_dir = opendir("/proc");
+    if (!proc_dir) return;
+
+    std::unordered_set<int> live_pids;
+    live_pids.reserve(pids_.size() + 64);
+
+    struct dirent* dir_entry;
+    while ((dir_entry = readdir(proc_dir)) != nullptr) {
+        int pid;
+        if (!parseProcPid(dir_entry->d_name, pid)) continue;
+        live_pids.insert(pid);
+
+        auto it = pids_.find(pid);
+        if (it == pids_.end()) {
+            PidEntry entry;
+            if (!readProcessInfo(pid, entry.info)) continue;
+            it = pids_.emplace(pid, std::move(entry)).first;
+            scanPidSockets(pid, it->second);
+        } else if (rescan_known || !it->second.sockets_scanned) {
+            scanPidSockets(pid, it->second);
+        }
+    }
+    closedir(proc_dir);
+
+    // Drop processes that have exited along with the sockets they owned
+    std::vector<int> exited;
+    for (const auto& [pid, entry] : pids_) {
+        if (!live_pids.count(pid)) exited.push_back(pid);
+    }
+    for (int pid : exited) {
+        forgetPid(pid);
+    }
+}
+
+void ProcessAttributionCache::scanPidSockets(int pid, PidEntry& entry) {
+    for (uint64_t inode : entry.sockets) {
+        auto owner = socket_owners_.find(inode);
+        if (owner != socket_owners_.end() && owner->second == pid) {
+            socket_owners_.erase(owner);
+        }
+    }
+    entry.sockets.clear();
+    entry.sockets_scanned = true;
+
+    std::string fd_path = "/proc/" + std::to_string(pid) + "/fd";
+    DIR* fd_dir = opendir(fd_path.c_str());
+    if (!fd_dir) return;
+
+    int dir_fd = dirfd(fd_dir);
+    char target[64];
+    struct dirent* fd_entry;
+    while ((fd_entry = readdir(fd_dir)) != nullptr) {
+        if (fd_entry->d_name[0] == '.') continue;
+
+        ssize_t len = readlinkat(dir_fd, fd_entry->d_name, target, sizeof(target));
+        uint64_t inode;
+        if (len > 0 && parseSocketInode(target, len, inode)) {
+            entry.sockets.push_back(inode);
+            socket_owners_[inode] = pid;
+        }
+    }
+    closedir(fd_dir);
+}
+
+void ProcessAttributionCache::forgetPid(int pid) {
+    auto it = pids_.find(pid);
+    if (it == pids_.end()) return;
+
+    for (uint64_t inode : it->second.sockets) {
+        auto owner = socket_owners_.find(inode);
+        if (owner != socket_owners_.end() && owner->second == pid) {
+            socket_owners_.erase(owner);
+        }
+    }
+    pids_.erase(it);
+}
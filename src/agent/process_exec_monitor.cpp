@@ -0,0 +1,204 @@
+#include "process_exec_monitor.h"
+#include "process_attribution.h"
+#include <iostream>
+#include <fstream>
+#include <unordered_set>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+namespace {
+    constexpr size_t MAX_CMDLINE_BYTES = 1024;
+
+    // Subscribes (or unsubscribes) the socket to process connector multicasts
+    bool sendConnectorOp(int sock, enum proc_cn_mcast_op op) {
+        alignas(struct nlmsghdr) char buffer[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))];
+        memset(buffer, 0, sizeof(buffer));
+
+        auto* header = reinterpret_cast<struct nlmsghdr*>(buffer);
+        header->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+        header->nlmsg_type = NLMSG_DONE;
+        header->nlmsg_pid = static_cast<__u32>(getpid());
+
+        auto* message = reinterpret_cast<struct cn_msg*>(NLMSG_DATA(header));
+        message->id.idx = CN_IDX_PROC;
+        message->id.val = CN_VAL_PROC;
+        message->len = sizeof(op);
+        memcpy(message->data, &op, sizeof(op));
+
+        return send(sock, buffer, header->nlmsg_len, 0) == static_cast<ssize_t>(header->nlmsg_len);
+    }
+}
+
+ProcessExecMonitor::ProcessExecMonitor() : stopped_(false) {
+    if (pipe2(wake_pipe_, O_CLOEXEC | O_NONBLOCK) < 0) {
+        wake_pipe_[0] = wake_pipe_[1] = -1;
+    }
+}
+
+ProcessExecMonitor::~ProcessExecMonitor() {
+    if (wake_pipe_[0] >= 0) close(wake_pipe_[0]);
+    if (wake_pipe_[1] >= 0) close(wake_pipe_[1]);
+}
+
+void ProcessExecMonitor::setCallback(std::function<void(const ProcessExec&)> callback) {
+    callback_ = callback;
+}
+
+void ProcessExecMonitor::run() {
+    if (stopped_) return;
+
+    if (!runConnector() && !stopped_) {
+        std::cout << "Process connector unavailable, polling /proc for new processes" << std::endl;
+        runProcPolling();
+    }
+}
+
+void ProcessExecMonitor::stop() {
+    stopped_ = true;
+    if (wake_pipe_[1] >= 0) {
+        ssize_t written = write(wake_pipe_[1], "x", 1);
+        (void)written;
+    }
+}
+
+bool ProcessExecMonitor::runConnector() {
+    int sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (sock < 0) return false;
+
+    struct sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = CN_IDX_PROC;
+    if (bind(sock, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 ||
+        !sendConnectorOp(sock, PROC_CN_MCAST_LISTEN)) {
+        close(sock);
+        return false;
+    }
+    std::cout << "Monitoring process execution via the process connector" << std::endl;
+
+    alignas(struct nlmsghdr) char buffer[8192];
+    while (!stopped_) {
+        struct pollfd fds[2] = {{sock, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+        int ready = poll(fds, 2, -1);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0 || (fds[1].revents & POLLIN)) break;
+
+        ssize_t len = recv(sock, buffer, sizeof(buffer), 0);
+        if (len < 0) {
+            // ENOBUFS means events were dropped under load; keep listening
+            if (errno == EINTR || errno == ENOBUFS) continue;
+            break;
+        }
+
+        int remaining = static_cast<int>(len);
+        for (auto* header = reinterpret_cast<struct nlmsghdr*>(buffer);
+             NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) continue;
+
+            auto* message = reinterpret_cast<struct cn_msg*>(NLMSG_DATA(header));
+            if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) continue;
+
+            auto* event = reinterpret_cast<struct proc_event*>(message->data);
+            if (event->what != proc_event::PROC_EVENT_EXEC) continue;
+
+            // Threads calling execve report their own pid; only whole processes matter
+            int pid = static_cast<int>(event->event_data.exec.process_tgid);
+            if (static_cast<int>(event->event_data.exec.process_pid) != pid) continue;
+
+            ProcessExec exec;
+            if (loadProcess(pid, exec) && callback_) {
+                callback_(exec);
+            }
+        }
+    }
+
+    sendConnectorOp(sock, PROC_CN_MCAST_IGNORE);
+    close(sock);
+    return true;
+}
+
+void ProcessExecMonitor::runProcPolling() {
+    std::unordered_set<int> known;
+    bool first_pass = true;
+
+    while (!stopped_) {
+        DIR* proc_dir = opendir("/proc");
+        if (!proc_dir) return;
+
+        std::unordered_set<int> live;
+        live.reserve(known.size() + 64);
+
+        struct dirent* entry;
+        while ((entry = readdir(proc_dir)) != nullptr) {
+            int pid;
+            if (!parseProcPid(entry->d_name, pid)) continue;
+            live.insert(pid);
+
+            // Processes already running at startup are not new executions
+            if (first_pass || known.count(pid)) continue;
+
+            ProcessExec exec;
+            if (loadProcess(pid, exec) && callback_) {
+                callback_(exec);
+            }
+        }
+        closedir(proc_dir);
+
+        known.swap(live);
+        first_pass = false;
+
+        if (waitForWake(1000)) break;
+    }
+}
+
+bool ProcessExecMonitor::loadProcess(int pid, ProcessExec& exec) {
+    // A process that exited before its comm could be read is not reported
+    ProcessInfo info;
+    if (!readProcessInfo(pid, info) || info.comm.empty()) return false;
+
+    exec.pid = pid;
+    exec.ppid = 0;
+    exec.uid = info.uid;
+    exec.user = info.user;
+    exec.comm = info.comm;
+    exec.exe_path = info.exe_path;
+    exec.time = std::chrono::steady_clock::now();
+
+    std::string proc_dir = "/proc/" + std::to_string(pid);
+
+    // The parent pid follows the parenthesised command name, which may contain spaces
+    std::ifstream stat_file(proc_dir + "/stat");
+    std::string stat_line;
+    if (std::getline(stat_file, stat_line)) {
+        size_t close_paren = stat_line.rfind(')');
+        if (close_paren != std::string::npos && close_paren + 4 < stat_line.size()) {
+            exec.ppid = std::atoi(stat_line.c_str() + close_paren + 4);
+        }
+    }
+
+    std::ifstream cmdline_file(proc_dir + "/cmdline", std::ios::binary);
+    char cmdline[MAX_CMDLINE_BYTES];
+    cmdline_file.read(cmdline, sizeof(cmdline));
+    std::streamsize read_len = cmdline_file.gcount();
+    exec.cmdline.assign(cmdline, static_cast<size_t>(read_len > 0 ? read_len : 0));
+    while (!exec.cmdline.empty() && exec.cmdline.back() == '\0') exec.cmdline.pop_back();
+    for (char& c : exec.cmdline) {
+        if (c == '\0') c = ' ';
+    }
+
+    return true;
+}
+
+bool ProcessExecMonitor::waitForWake(int timeout_ms) {
+    struct pollfd fd = {wake_pipe_[0], POLLIN, 0};
+    return poll(&fd, 1, timeout_ms) > 0 || stopped_;
+}
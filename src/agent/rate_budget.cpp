@@ -0,0 +1,48 @@
+#include "rate_budget.h"
+#include <algorithm>
+
+RateBudget::RateBudget(double requests_per_minute, double tokens_per_minute)
+    : requests_per_minute_(std::max(requests_per_minute, 1.0)),
+      tokens_per_minute_(std::max(tokens_per_minute, 1.0)),
+      requests_(requests_per_minute_),
+      tokens_(tokens_per_minute_),
+      updated_(std::chrono::steady_clock::now()) {}
+
+void RateBudget::setLimits(double requests_per_minute, double tokens_per_minute) {
+    // Keep the same fraction of each allowance, so a budget configured at
+    // startup begins full at its new size
+    requests_per_minute = std::max(requests_per_minute, 1.0);
+    tokens_per_minute = std::max(tokens_per_minute, 1.0);
+    requests_ *= requests_per_minute / requests_per_minute_;
+    tokens_ *= tokens_per_minute / tokens_per_minute_;
+    requests_per_minute_ = requests_per_minute;
+    tokens_per_minute_ = tokens_per_minute;
+}
+
+void RateBudget::refill(std::chrono::steady_clock::time_point now) {
+    if (now <= updated_) return;
+    double minutes = std::chrono::duration<double>(now - updated_).count() / 60.0;
+    requests_ = std::min(requests_per_minute_, requests_ + minutes * requests_per_minute_);
+    tokens_ = std::min(tokens_per_minute_, tokens_ + minutes * tokens_per_minute_);
+    updated_ = now;
+}
+
+bool RateBudget::covers(double tokens, std::chrono::steady_clock::time_point now) {
+    refill(now);
+    return requests_ >= 1.0 && tokens_ >= std::min(tokens, tokens_per_minute_);
+}
+
+bool RateBudget::tryAcquire(double tokens, std::chrono::steady_clock::time_point now) {
+    if (!covers(tokens, now)) {
+        return false;
+    }
+    requests_ -= 1.0;
+    tokens_ -= std::min(tokens, tokens_per_minute_);
+    return true;
+}
+
+void RateBudget::exhaust(std::chrono::steady_clock::time_point now) {
+    refill(now);
+    requests_ = 0.0;
+    tokens_ = 0.0;
+}
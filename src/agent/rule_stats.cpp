@@ -0,0 +1,41 @@
+#include "rule_stats.h"
+#include <time.h>
+
+RuleCounters* RuleStatsRegistry::registerRule(const std::string& policy, const std::string& rule) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::string key = policy + '\n' + rule;
+    auto it = index_.find(key);
+    if (it != index_.end()) return it->second;
+
+    // deque::emplace_back never moves existing elements
+    RuleCounters& counters = rules_.emplace_back();
+    counters.policy = policy;
+    counters.rule = rule;
+    index_.emplace(std::move(key), &counters);
+    return &counters;
+}
+
+std::vector<RuleStatsSnapshot> RuleStatsRegistry::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<RuleStatsSnapshot> result;
+    result.reserve(rules_.size());
+    for (const auto& counters : rules_) {
+        result.push_back(RuleStatsSnapshot{
+            counters.policy,
+            counters.rule,
+            counters.evaluations.load(std::memory_order_relaxed),
+            counters.matches.load(std::memory_order_relaxed),
+            counters.bytes_scanned.load(std::memory_order_relaxed),
+            counters.cpu_ns.load(std::memory_order_relaxed)
+        });
+    }
+    return result;
+}
+
+uint64_t RuleStatsRegistry::threadCpuTimeNs() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
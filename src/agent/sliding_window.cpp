@@ -0,0 +1,38 @@
+#include "sliding_window.h"
+#include <algorithm>
+
+SlidingWindowCounter::SlidingWindowCounter(std::chrono::seconds window, size_t buckets)
+    : window_(window),
+      bucket_ms_(std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(window).count() /
+                                          static_cast<int64_t>(std::max<size_t>(buckets, 1)))),
+      buckets_(std::max<size_t>(buckets, 1), Bucket{-1, 0.0}) {}
+
+int64_t SlidingWindowCounter::epochOf(std::chrono::system_clock::time_point time) const {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+    return ms / bucket_ms_;
+}
+
+void SlidingWindowCounter::add(std::chrono::system_clock::time_point time, double value) {
+    int64_t epoch = epochOf(time);
+    Bucket& bucket = buckets_[static_cast<size_t>(epoch) % buckets_.size()];
+    if (bucket.epoch != epoch) {
+        // An older epoch in this slot has slid out of the window
+        if (bucket.epoch > epoch) return;
+        bucket.epoch = epoch;
+        bucket.sum = 0.0;
+    }
+    bucket.sum += value;
+}
+
+double SlidingWindowCounter::sum(std::chrono::system_clock::time_point now) const {
+    int64_t current = epochOf(now);
+    int64_t oldest = current - static_cast<int64_t>(buckets_.size()) + 1;
+
+    double total = 0.0;
+    for (const auto& bucket : buckets_) {
+        if (bucket.epoch >= oldest && bucket.epoch <= current) {
+            total += bucket.sum;
+        }
+    }
+    return total;
+}
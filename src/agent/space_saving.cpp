@@ -0,0 +1,82 @@
+#include "space_saving.h"
+#include <algorithm>
+#include <unordered_map>
+
+SpaceSaving::SpaceSaving(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)), total_(0.0) {
+    entries_.reserve(capacity_);
+}
+
+void SpaceSaving::add(const std::string& key, double weight) {
+    total_ += weight;
+
+    // Capacities are small, so a scan beats maintaining a heap and an index
+    auto smallest = entries_.end();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->key == key) {
+            it->weight += weight;
+            return;
+        }
+        if (smallest == entries_.end() || it->weight < smallest->weight) {
+            smallest = it;
+        }
+    }
+
+    if (entries_.size() < capacity_) {
+        entries_.push_back(Entry{key, weight, 0.0});
+    } else {
+        smallest->error = smallest->weight;
+        smallest->weight += weight;
+        smallest->key = key;
+    }
+}
+
+void SpaceSaving::clear() {
+    entries_.clear();
+    total_ = 0.0;
+}
+
+SlidingHeavyHitters::SlidingHeavyHitters(std::chrono::seconds window, size_t capacity)
+    : window_ms_(std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(window).count())),
+      epoch_(0),
+      current_(capacity),
+      previous_(capacity) {}
+
+void SlidingHeavyHitters::rotate(std::chrono::system_clock::time_point time) {
+    int64_t epoch = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() / window_ms_;
+    if (epoch <= epoch_) return;
+
+    if (epoch == epoch_ + 1) {
+        std::swap(previous_, current_);
+    } else {
+        previous_.clear();
+    }
+    current_.clear();
+    epoch_ = epoch;
+}
+
+void SlidingHeavyHitters::add(std::chrono::system_clock::time_point time, const std::string& key, double weight) {
+    rotate(time);
+    current_.add(key, weight);
+}
+
+std::vector<std::pair<std::string, double>> SlidingHeavyHitters::top(std::chrono::system_clock::time_point now,
+                                                                      size_t k) {
+    rotate(now);
+
+    std::unordered_map<std::string, double> combined;
+    for (const auto* summary : {&previous_, &current_}) {
+        for (const auto& entry : summary->entries()) {
+            combined[entry.key] += entry.weight;
+        }
+    }
+
+    std::vector<std::pair<std::string, double>> heaviest(combined.begin(), combined.end());
+    std::sort(heaviest.begin(), heaviest.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    if (heaviest.size() > k) heaviest.resize(k);
+    return heaviest;
+}
+
+double SlidingHeavyHitters::total(std::chrono::system_clock::time_point now) {
+    rotate(now);
+    return previous_.total() + current_.total();
+}
@@ -0,0 +1,228 @@
+#include "transition_model.h"
+#include "behavior_snapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+namespace {
+    constexpr size_t MAX_EXACT_COUNTS = 256;
+    constexpr size_t SKETCH_WIDTH = 256;
+    constexpr size_t SKETCH_DEPTH = 4;
+    constexpr size_t MAX_VOCABULARY = 512;
+
+    // A pause this long starts a new session; its first step is not a transition
+    const std::chrono::minutes SESSION_GAP(30);
+
+    // Transitions learned before windows are scored
+    constexpr uint64_t MIN_TRAINING_TRANSITIONS = 200;
+    // Trigram contexts seen fewer times than this back off to the bigram
+    constexpr uint32_t MIN_TRIGRAM_CONTEXT = 5;
+    // Additive smoothing; an unseen transition from a context seen n times costs about log2(2n + V) bits
+    constexpr double SMOOTHING = 0.5;
+
+    // Window surprise is judged against the user's history like the feature baselines
+    constexpr double SURPRISE_ALPHA = 0.01;
+    constexpr double DEVIATION_TO_SIGMA = 1.2533;
+    constexpr double MIN_SCALE_BITS = 1.0;
+    constexpr double Z_THRESHOLD = 4.0;
+    // Two transitions at roughly 1/64 each; below this nothing is unusual enough to report
+    constexpr double MIN_SURPRISE_BITS = 12.0;
+
+    // Separate key spaces for the count tables
+    constexpr uint64_t BIGRAM = 1;
+    constexpr uint64_t TRIGRAM = 2;
+    constexpr uint64_t UNIGRAM_CONTEXT = 3;
+    constexpr uint64_t BIGRAM_CONTEXT = 4;
+}
+
+TransitionModel::CountTable::CountTable() : tail_(SKETCH_WIDTH, SKETCH_DEPTH) {}
+
+void TransitionModel::CountTable::add(uint64_t key) {
+    auto it = exact_.find(key);
+    if (it != exact_.end()) {
+        if (it->second < std::numeric_limits<uint32_t>::max()) it->second++;
+    } else if (exact_.size() < MAX_EXACT_COUNTS) {
+        exact_.emplace(key, 1);
+    } else {
+        // Keys admitted while the table had room stay exact; everything later is sketched
+        tail_.add(key);
+    }
+}
+
+uint32_t TransitionModel::CountTable::count(uint64_t key) const {
+    auto it = exact_.find(key);
+    return it != exact_.end() ? it->second : tail_.estimate(key);
+}
+
+void TransitionModel::CountTable::save(SnapshotWriter& writer) const {
+    writer.put<uint32_t>(static_cast<uint32_t>(exact_.size()));
+    for (const auto& [key, count] : exact_) {
+        writer.put<uint64_t>(key);
+        writer.put<uint32_t>(count);
+    }
+    writer.put<uint64_t>(tail_.total());
+    const std::vector<uint32_t>& counters = tail_.counters();
+    writer.put<uint32_t>(static_cast<uint32_t>(counters.size()));
+    writer.buffer().append(reinterpret_cast<const char*>(counters.data()), counters.size() * sizeof(uint32_t));
+}
+
+bool TransitionModel::CountTable::load(SnapshotReader& reader) {
+    uint32_t exact = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < exact && reader.ok(); ++i) {
+        uint64_t key = reader.get<uint64_t>();
+        exact_[key] = reader.get<uint32_t>();
+    }
+    uint64_t total = reader.get<uint64_t>();
+    std::vector<uint32_t> counters(reader.get<uint32_t>());
+    if (const unsigned char* bytes = reader.take(counters.size() * sizeof(uint32_t))) {
+        std::memcpy(counters.data(), bytes, counters.size() * sizeof(uint32_t));
+    }
+    // A sketch of another shape means a different build wrote the snapshot
+    return reader.ok() && tail_.restore(counters, total);
+}
+
+TransitionModel::TransitionModel() {}
+
+// Token hashes are std::hash values, which only need to match within the
+// build that wrote the snapshot, like the rest of its host-order payload
+void TransitionModel::save(SnapshotWriter& writer) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    writer.put<uint32_t>(static_cast<uint32_t>(users_.size()));
+    for (const auto& [user, model] : users_) {
+        writer.putString(user);
+        model.transitions.save(writer);
+        model.contexts.save(writer);
+        writer.put<uint32_t>(static_cast<uint32_t>(model.vocabulary.size()));
+        for (uint64_t token : model.vocabulary) {
+            writer.put<uint64_t>(token);
+        }
+        writer.put<uint64_t>(model.observed);
+        writer.put<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                model.last_seen.time_since_epoch()).count());
+        writer.put<double>(model.surprise_mean);
+        writer.put<double>(model.surprise_deviation);
+        writer.put<uint64_t>(model.windows);
+    }
+}
+
+bool TransitionModel::load(SnapshotReader& reader) {
+    std::unordered_map<std::string, UserModel> users;
+    uint32_t user_count = reader.get<uint32_t>();
+    if (user_count > MAX_USERS) return false;
+    for (uint32_t u = 0; u < user_count && reader.ok(); ++u) {
+        UserModel& model = users[reader.getString()];
+        if (!model.transitions.load(reader) || !model.contexts.load(reader)) return false;
+        uint32_t vocabulary = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < vocabulary && reader.ok(); ++i) {
+            uint64_t token = reader.get<uint64_t>();
+            if (model.vocabulary.size() < MAX_VOCABULARY) model.vocabulary.insert(token);
+        }
+        model.observed = reader.get<uint64_t>();
+        model.last_seen = std::chrono::system_clock::time_point(std::chrono::milliseconds(reader.get<int64_t>()));
+        model.surprise_mean = reader.get<double>();
+        model.surprise_deviation = reader.get<double>();
+        model.windows = reader.get<uint64_t>();
+    }
+    if (!reader.ok()) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    users_ = std::move(users);
+    return true;
+}
+
+bool TransitionModel::observe(const std::string& user, const std::string& token,
+                              std::chrono::system_clock::time_point now, SequenceScore& score) {
+    uint64_t hash = std::hash<std::string>{}(token);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    UserModel& model = modelFor(user, now);
+    if (model.history > 0 && now - model.last_seen > SESSION_GAP) {
+        model.history = 0;
+    }
+    model.last_seen = now;
+    if (model.history > 0 && hash == model.previous_hash[0]) {
+        return false;  // Same application again
+    }
+
+    bool scored = false;
+    if (model.history >= 1) {
+        double surprise = transitionSurprise(model, hash);
+
+        model.transitions.add(combineHash(combineHash(BIGRAM, model.previous_hash[0]), hash));
+        model.contexts.add(combineHash(UNIGRAM_CONTEXT, model.previous_hash[0]));
+        if (model.history >= 2) {
+            uint64_t context = combineHash(combineHash(BIGRAM_CONTEXT, model.previous_hash[1]), model.previous_hash[0]);
+            uint64_t trigram = combineHash(combineHash(combineHash(TRIGRAM, model.previous_hash[1]),
+                                                       model.previous_hash[0]), hash);
+            model.transitions.add(trigram);
+            model.contexts.add(context);
+
+            double window = model.last_surprise + surprise;
+            double scale = std::max(MIN_SCALE_BITS, DEVIATION_TO_SIGMA * model.surprise_deviation);
+            if (model.observed >= MIN_TRAINING_TRANSITIONS) {
+                score.surprise_bits = window;
+                score.z = (window - model.surprise_mean) / scale;
+                score.anomalous = score.z >= Z_THRESHOLD && window >= MIN_SURPRISE_BITS;
+                score.sequence = {model.previous[1], model.previous[0], token};
+                scored = true;
+            }
+
+            double weight = std::max(SURPRISE_ALPHA, 1.0 / static_cast<double>(++model.windows));
+            double diff = window - model.surprise_mean;
+            model.surprise_mean += weight * diff;
+            model.surprise_deviation += weight * (std::fabs(diff) - model.surprise_deviation);
+        }
+
+        model.last_surprise = surprise;
+        model.observed++;
+    }
+
+    if (model.vocabulary.size() < MAX_VOCABULARY) {
+        model.vocabulary.insert(hash);
+    }
+    model.previous[1] = std::move(model.previous[0]);
+    model.previous_hash[1] = model.previous_hash[0];
+    model.previous[0] = token;
+    model.previous_hash[0] = hash;
+    model.history = std::min<size_t>(model.history + 1, 2);
+    return scored;
+}
+
+double TransitionModel::transitionSurprise(const UserModel& model, uint64_t token) const {
+    // Every known token plus one slot for tokens never seen before
+    double vocabulary = static_cast<double>(model.vocabulary.size() + 1);
+
+    uint32_t context_count = 0;
+    uint32_t transition_count = 0;
+    if (model.history >= 2) {
+        context_count = model.contexts.count(
+            combineHash(combineHash(BIGRAM_CONTEXT, model.previous_hash[1]), model.previous_hash[0]));
+        transition_count = model.transitions.count(
+            combineHash(combineHash(combineHash(TRIGRAM, model.previous_hash[1]), model.previous_hash[0]), token));
+    }
+    if (context_count < MIN_TRIGRAM_CONTEXT) {
+        context_count = model.contexts.count(combineHash(UNIGRAM_CONTEXT, model.previous_hash[0]));
+        transition_count = model.transitions.count(combineHash(combineHash(BIGRAM, model.previous_hash[0]), token));
+    }
+
+    double probability = (transition_count + SMOOTHING) / (context_count + SMOOTHING * vocabulary);
+    return -std::log2(std::min(probability, 1.0));
+}
+
+TransitionModel::UserModel& TransitionModel::modelFor(const std::string& user,
+                                                      std::chrono::system_clock::time_point now) {
+    auto it = users_.find(user);
+    if (it != users_.end()) return it->second;
+
+    if (users_.size() >= MAX_USERS) {
+        auto idlest = std::min_element(users_.begin(), users_.end(), [](const auto& a, const auto& b) {
+            return a.second.last_seen < b.second.last_seen;
+        });
+        users_.erase(idlest);
+    }
+    it = users_.emplace(user, UserModel()).first;
+    it->second.last_seen = now;
+    return it->second;
+}
@@ -0,0 +1,160 @@
+#include "user_profile_store.h"
+#include <algorithm>
+
+UserProfileStore::UserProfileStore(size_t pattern_capacity) {
+    size_t per_shard = std::max<size_t>(1, pattern_capacity / SHARDS);
+    for (auto& shard : shards_) {
+        shard.arena.resize(per_shard);
+    }
+}
+
+UserProfileStore::Shard& UserProfileStore::shardFor(const std::string& user) {
+    return shards_[std::hash<std::string>{}(user) % SHARDS];
+}
+
+const UserProfileStore::Shard& UserProfileStore::shardFor(const std::string& user) const {
+    return shards_[std::hash<std::string>{}(user) % SHARDS];
+}
+
+void UserProfileStore::addPattern(const BehaviorPattern& pattern, const std::function<void(UserProfile&)>& update) {
+    PatternKind kind = PatternKind::Normal;
+    if (pattern.pattern_type == "suspicious") {
+        kind = PatternKind::Suspicious;
+    } else if (pattern.pattern_type == "anomalous") {
+        kind = PatternKind::Anomalous;
+    }
+
+    Shard& shard = shardFor(pattern.user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.profiles.find(pattern.user);
+    if (it == shard.profiles.end()) {
+        it = shard.profiles.emplace(pattern.user, UserProfile{pattern.user, {}, {}, 0.0}).first;
+    }
+
+    uint64_t sequence = shard.next_sequence++;
+    shard.arena[sequence % shard.arena.size()] = pattern;
+    appendToProfile(it->second, PatternRef{sequence, kind});
+
+    if (update) {
+        update(it->second);
+    }
+}
+
+void UserProfileStore::put(const UserProfile& profile) {
+    Shard& shard = shardFor(profile.user_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    UserProfile& stored = shard.profiles[profile.user_id];
+    stored = profile;
+    stored.baseline_metrics.clear();  // Baselines live in FeatureBaselines
+    recountRiskWindow(stored);
+}
+
+void UserProfileStore::updateProfile(const std::string& user, const std::function<void(UserProfile&)>& update) {
+    Shard& shard = shardFor(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.profiles.find(user);
+    if (it == shard.profiles.end()) {
+        it = shard.profiles.emplace(user, UserProfile{user, {}, {}, 0.0}).first;
+    }
+    update(it->second);
+}
+
+bool UserProfileStore::contains(const std::string& user) const {
+    const Shard& shard = shardFor(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.profiles.find(user) != shard.profiles.end();
+}
+
+size_t UserProfileStore::size() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.profiles.size();
+    }
+    return total;
+}
+
+std::vector<std::string> UserProfileStore::users() const {
+    std::vector<std::string> names;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& entry : shard.profiles) {
+            names.push_back(entry.first);
+        }
+    }
+    return names;
+}
+
+bool UserProfileStore::visitProfile(const std::string& user,
+                                    const std::function<void(const UserProfile&)>& visitor) const {
+    const Shard& shard = shardFor(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.profiles.find(user);
+    if (it == shard.profiles.end()) return false;
+    visitor(it->second);
+    return true;
+}
+
+void UserProfileStore::visitRecentPatterns(const std::string& user, size_t limit,
+                                           const std::function<void(const BehaviorPattern&)>& visitor) const {
+    const Shard& shard = shardFor(user);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.profiles.find(user);
+    if (it == shard.profiles.end()) return;
+
+    const auto& refs = it->second.recent_patterns;
+    size_t count = std::min(limit, refs.size());
+    for (size_t i = 0; i < count; ++i) {
+        const BehaviorPattern* pattern = resolve(shard, refs.fromNewest(i));
+        if (!pattern) break;  // Older references have been reused as well
+        visitor(*pattern);
+    }
+}
+
+const BehaviorPattern* UserProfileStore::resolve(const Shard& shard, const PatternRef& ref) {
+    // The slot has been overwritten once the arena has wrapped past this sequence
+    if (shard.next_sequence - ref.sequence > shard.arena.size()) {
+        return nullptr;
+    }
+    return &shard.arena[ref.sequence % shard.arena.size()];
+}
+
+void UserProfileStore::appendToProfile(UserProfile& profile, const PatternRef& ref) {
+    auto& patterns = profile.recent_patterns;
+
+    // The pattern at the far end of the risk window drops out of it
+    if (patterns.size() >= UserProfile::RISK_WINDOW) {
+        PatternKind leaving = patterns.fromNewest(UserProfile::RISK_WINDOW - 1).kind;
+        if (leaving == PatternKind::Suspicious) {
+            profile.window_suspicious--;
+        } else if (leaving == PatternKind::Anomalous) {
+            profile.window_anomalous--;
+        }
+    }
+
+    patterns.push(ref);
+    if (ref.kind == PatternKind::Suspicious) {
+        profile.window_suspicious++;
+    } else if (ref.kind == PatternKind::Anomalous) {
+        profile.window_anomalous++;
+    }
+}
+
+void UserProfileStore::recountRiskWindow(UserProfile& profile) {
+    profile.window_suspicious = 0;
+    profile.window_anomalous = 0;
+    size_t window = std::min(profile.recent_patterns.size(), UserProfile::RISK_WINDOW);
+    for (size_t i = 0; i < window; ++i) {
+        PatternKind kind = profile.recent_patterns.fromNewest(i).kind;
+        if (kind == PatternKind::Suspicious) {
+            profile.window_suspicious++;
+        } else if (kind == PatternKind::Anomalous) {
+            profile.window_anomalous++;
+        }
+    }
+}
@@ -18,6 +18,8 @@ dlp_events = []
 time_entries = []
 behavior_patterns = []
 alerts = []
+dlp_rule_stats = {'timestamp': None, 'rules': []}
+DLP_RULE_STATS_SORT_KEYS = ('evaluations', 'matches', 'bytes_scanned', 'cpu_ns')
 
 @app.route('/')
 def index():
@@ -67,6 +69,15 @@ def get_dlp_events():
     limit = int(request.args.get('limit', 50))
     return jsonify(dlp_events[-limit:])
 
+@app.route('/api/dlp-rule-stats')
+def get_dlp_rule_stats():
+    """Get the latest per-policy and per-pattern DLP scan statistics"""
+    sort_key = request.args.get('sort', 'cpu_ns')
+    if sort_key not in DLP_RULE_STATS_SORT_KEYS:
+        return jsonify({'error': 'sort must be one of: ' + ', '.join(DLP_RULE_STATS_SORT_KEYS)}), 400
+    rules = sorted(dlp_rule_stats['rules'], key=lambda rule: rule.get(sort_key, 0), reverse=True)
+    return jsonify({'timestamp': dlp_rule_stats['timestamp'], 'rules': rules})
+
 @app.route('/api/productivity')
 def get_productivity_data():
     """Get productivity analytics"""
@@ -360,6 +371,11 @@ def process_agent_data(data):
         # Store application usage data
         time_entries.append(app_usage_data)
 
+    elif data_type == 'dlp_rule_stats':
+        # Counters are cumulative, so only the latest record is kept
+        dlp_rule_stats['timestamp'] = data.get('timestamp', datetime.now().isoformat())
+        dlp_rule_stats['rules'] = data.get('rules', [])
+
     elif data_type == 'alert':
         # Handle alert data from agent
         alert_data = {
@@ -0,0 +1,248 @@
+// Measures the latency FanotifyEnforcer adds to open()+read().
+//
+// Usage: fanotify-bench <directory> [classify_us]
+//
+// The whole mount containing <directory> is marked, so point it at a scratch
+// mount (for example a tmpfs) rather than the root filesystem. Needs
+// CAP_SYS_ADMIN. Reads happen in forked children so they are not the agent's
+// own pid; a child named "scp" is a restricted process. The classifier treats
+// files ending in ".secret" as sensitive and busy-waits classify_us
+// (default 200) per file to stand in for a content scan.
+#include "fanotify_enforcer.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+namespace {
+    constexpr size_t REPEAT_FILES = 200;
+    constexpr size_t FLOOD_FILES = 4000;
+    constexpr size_t HELD_FILES = 50;
+    constexpr std::chrono::microseconds BUDGET(5000);
+    constexpr uint64_t DENIED = 1ULL << 63;  // Flags a latency whose open was denied
+
+    struct Phase {
+        std::vector<uint64_t> latencies_ns;
+        size_t denied = 0;
+    };
+
+    uint64_t nowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    std::vector<std::string> createFiles(const std::string& directory, const std::string& prefix,
+                                         size_t count, const std::string& suffix) {
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < count; ++i) {
+            std::string path = directory + "/" + prefix + std::to_string(i) + suffix;
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                std::cerr << "Cannot create " << path << ": " << strerror(errno) << std::endl;
+                exit(1);
+            }
+            const char content[] = "benchmark file\n";
+            ssize_t written = write(fd, content, sizeof(content) - 1);
+            (void)written;
+            close(fd);
+            paths.push_back(path);
+        }
+        return paths;
+    }
+
+    // Child side: open and read each path as <comm>, then write one latency per
+    // path back through the pipe
+    void readFiles(int out_fd, const char* comm, const std::vector<std::string>& paths,
+                   std::chrono::microseconds start_delay, std::chrono::microseconds spacing) {
+        prctl(PR_SET_NAME, comm, 0, 0, 0);
+        std::vector<uint64_t> results(paths.size());
+        usleep(static_cast<useconds_t>(start_delay.count()));
+
+        char buffer[256];
+        for (size_t i = 0; i < paths.size(); ++i) {
+            uint64_t start = nowNs();
+            int fd = open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                ssize_t got = read(fd, buffer, sizeof(buffer));
+                (void)got;
+                close(fd);
+                results[i] = nowNs() - start;
+            } else {
+                results[i] = (nowNs() - start) | DENIED;
+            }
+            if (spacing.count() > 0) {
+                usleep(static_cast<useconds_t>(spacing.count()));
+            }
+        }
+
+        const char* data = reinterpret_cast<const char*>(results.data());
+        size_t remaining = results.size() * sizeof(uint64_t);
+        while (remaining > 0) {
+            ssize_t written = write(out_fd, data, remaining);
+            if (written <= 0) break;
+            data += written;
+            remaining -= written;
+        }
+        _exit(0);
+    }
+
+    struct Child {
+        pid_t pid;
+        int fd;
+        size_t count;
+    };
+
+    Child spawnReader(const char* comm, const std::vector<std::string>& paths,
+                      std::chrono::microseconds start_delay = std::chrono::microseconds(0),
+                      std::chrono::microseconds spacing = std::chrono::microseconds(0)) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            std::cerr << "pipe failed: " << strerror(errno) << std::endl;
+            exit(1);
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "fork failed: " << strerror(errno) << std::endl;
+            exit(1);
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            readFiles(fds[1], comm, paths, start_delay, spacing);
+        }
+        close(fds[1]);
+        return Child{pid, fds[0], paths.size()};
+    }
+
+    Phase collect(const Child& child) {
+        std::vector<uint64_t> results(child.count);
+        char* data = reinterpret_cast<char*>(results.data());
+        size_t remaining = results.size() * sizeof(uint64_t);
+        while (remaining > 0) {
+            ssize_t got = read(child.fd, data, remaining);
+            if (got <= 0) break;
+            data += got;
+            remaining -= got;
+        }
+        close(child.fd);
+        waitpid(child.pid, nullptr, 0);
+
+        Phase phase;
+        for (uint64_t latency : results) {
+            if (latency & DENIED) {
+                phase.denied++;
+            }
+            phase.latencies_ns.push_back(latency & ~DENIED);
+        }
+        return phase;
+    }
+
+    Phase run(const char* comm, const std::vector<std::string>& paths) {
+        return collect(spawnReader(comm, paths));
+    }
+
+    void report(const std::string& name, Phase phase) {
+        std::cout << std::left << std::setw(40) << name;
+        auto& values = phase.latencies_ns;
+        if (values.empty()) {
+            std::cout << "no samples" << std::endl;
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        uint64_t total = 0;
+        for (uint64_t value : values) total += value;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "avg " << std::setw(8) << total / 1000.0 / values.size()
+                  << " p50 " << std::setw(8) << values[values.size() / 2] / 1000.0
+                  << " p99 " << std::setw(8) << values[values.size() * 99 / 100] / 1000.0
+                  << " max " << std::setw(8) << values.back() / 1000.0 << " us";
+        if (phase.denied > 0) {
+            std::cout << "  (" << phase.denied << "/" << values.size() << " denied)";
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <directory> [classify_us]" << std::endl;
+        return 1;
+    }
+    std::string root = std::string(argv[1]) + "/fanotify-bench." + std::to_string(getpid());
+    auto classify_cost = std::chrono::microseconds(argc > 2 ? std::atoi(argv[2]) : 200);
+
+    if (mkdir(root.c_str(), 0755) != 0) {
+        std::cerr << "Cannot create " << root << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    auto baseline_files = createFiles(root, "baseline", REPEAT_FILES, "");
+    auto clean_files = createFiles(root, "clean", REPEAT_FILES, "");
+    auto secret_files = createFiles(root, "secret", REPEAT_FILES, ".secret");
+    auto flood_files = createFiles(root, "flood", FLOOD_FILES, "");
+    auto held_files = createFiles(root, "held", HELD_FILES, ".secret");
+
+    std::cout << "classifier cost " << classify_cost.count() << "us, budget " << BUDGET.count()
+              << "us" << std::endl;
+    run("bench-reader", baseline_files);  // Warm the page cache
+    report("no enforcer", run("bench-reader", baseline_files));
+
+    FanotifyEnforcer enforcer;
+    enforcer.setRestrictedProcesses({"scp"});
+    enforcer.setLatencyBudget(BUDGET);
+    enforcer.setClassifier([classify_cost](int, const std::string& path) {
+        auto until = std::chrono::steady_clock::now() + classify_cost;
+        while (std::chrono::steady_clock::now() < until) {}
+        bool sensitive = path.size() > 7 && path.compare(path.size() - 7, 7, ".secret") == 0;
+        return AccessVerdict{sensitive, sensitive ? "bench" : ""};
+    });
+    if (!enforcer.start({root})) {
+        std::cerr << "Cannot start the enforcer (needs CAP_SYS_ADMIN and fanotify permission events)"
+                  << std::endl;
+        return 1;
+    }
+
+    report("unrestricted, new files", run("bench-reader", clean_files));
+    usleep(static_cast<useconds_t>(REPEAT_FILES * classify_cost.count() + 100000));  // Let classification finish
+    report("unrestricted, same files", run("bench-reader", clean_files));
+    report("restricted, new sensitive files", run("scp", secret_files));
+    report("restricted, cached deny", run("scp", secret_files));
+
+    // Held opens while unrestricted reads keep the background queue full
+    FanotifyStats before = enforcer.stats();
+    Child flood = spawnReader("bench-reader", flood_files);
+    Child held = spawnReader("scp", held_files, std::chrono::milliseconds(20), std::chrono::milliseconds(1));
+    Phase held_phase = collect(held);
+    Phase flood_phase = collect(flood);
+    FanotifyStats after = enforcer.stats();
+
+    report("unrestricted, flooding the queue", flood_phase);
+    report("restricted, new files during flood", held_phase);
+    std::cout << "  held opens decided in budget: " << held_phase.denied << "/" << HELD_FILES
+              << ", budget timeouts: " << after.timeouts - before.timeouts << std::endl;
+
+    enforcer.stop();
+    FanotifyStats stats = enforcer.stats();
+    std::cout << "decision latency avg "
+              << (stats.events ? stats.total_latency_ns / stats.events / 1000 : 0) << "us, max "
+              << stats.max_latency_ns / 1000 << "us over " << stats.events << " decisions" << std::endl;
+
+    for (const auto* files : {&baseline_files, &clean_files, &secret_files, &flood_files, &held_files}) {
+        for (const auto& path : *files) {
+            unlink(path.c_str());
+        }
+    }
+    rmdir(root.c_str());
+    return 0;
+}
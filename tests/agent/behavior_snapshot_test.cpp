@@ -0,0 +1,163 @@
+#include "behavior_snapshot.h"
+#include "behavior_analyzer.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+    constexpr size_t HEADER_BYTES = 24;
+
+    class SnapshotTest : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            char pattern[] = "/tmp/wm-snapshot-test.XXXXXX";
+            ASSERT_NE(mkdtemp(pattern), nullptr);
+            directory = pattern;
+            path = directory + "/behavior.snap";
+        }
+
+        void TearDown() override {
+            std::remove(path.c_str());
+            std::remove((path + ".tmp").c_str());
+            rmdir(directory.c_str());
+        }
+
+        std::string readFile() const {
+            std::ifstream in(path, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        void writeFile(const std::string& bytes) const {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+
+        std::string directory;
+        std::string path;
+    };
+
+    std::vector<std::string> descriptions(BehaviorAnalyzer& analyzer, const std::string& user) {
+        std::vector<std::string> result;
+        for (const auto& pattern : analyzer.getRecentPatterns(user, UserProfile::MAX_RECENT_PATTERNS)) {
+            result.push_back(pattern.pattern_type + " " + pattern.description);
+        }
+        return result;
+    }
+}
+
+TEST(SnapshotCrcTest, MatchesStandardCrc32) {
+    const std::string check = "123456789";
+    EXPECT_EQ(snapshotCrc32(reinterpret_cast<const unsigned char*>(check.data()), check.size()), 0xCBF43926u);
+    EXPECT_EQ(snapshotCrc32(nullptr, 0), 0u);
+}
+
+TEST(SnapshotReaderTest, FailsClosedPastTheEnd) {
+    SnapshotWriter writer;
+    writer.put<uint32_t>(7);
+    writer.putString("payroll");
+    writer.put<double>(-0.0);
+
+    const std::string& bytes = writer.buffer();
+    SnapshotReader reader(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size());
+    EXPECT_EQ(reader.get<uint32_t>(), 7u);
+    EXPECT_EQ(reader.getString(), "payroll");
+    EXPECT_TRUE(std::signbit(reader.get<double>()));
+    EXPECT_TRUE(reader.ok());
+
+    EXPECT_EQ(reader.get<uint8_t>(), 0u);
+    EXPECT_FALSE(reader.ok());
+
+    // A length prefix larger than the payload must not read past it
+    SnapshotWriter lying;
+    lying.put<uint32_t>(0xFFFFFFF0u);
+    lying.buffer().append("abc");
+    SnapshotReader truncated(reinterpret_cast<const unsigned char*>(lying.buffer().data()), lying.buffer().size());
+    EXPECT_EQ(truncated.getString(), "");
+    EXPECT_FALSE(truncated.ok());
+    EXPECT_EQ(truncated.get<uint32_t>(), 0u);
+}
+
+TEST_F(SnapshotTest, FileRoundTrip) {
+    SnapshotWriter writer;
+    writer.putString("hello");
+    writer.put<int64_t>(-42);
+    ASSERT_TRUE(writeSnapshotFile(path, writer.buffer()));
+    EXPECT_EQ(access((path + ".tmp").c_str(), F_OK), -1);
+
+    MappedSnapshot snapshot(path);
+    ASSERT_TRUE(snapshot.valid()) << snapshot.error();
+    SnapshotReader reader = snapshot.reader();
+    EXPECT_EQ(reader.getString(), "hello");
+    EXPECT_EQ(reader.get<int64_t>(), -42);
+    EXPECT_TRUE(reader.ok());
+}
+
+TEST_F(SnapshotTest, RejectsDamagedFiles) {
+    EXPECT_EQ(MappedSnapshot(path).error(), "no snapshot");
+
+    ASSERT_TRUE(writeSnapshotFile(path, std::string(100, 'x')));
+    const std::string original = readFile();
+
+    std::string damaged = original;
+    damaged[HEADER_BYTES + 50] ^= 0x01;
+    writeFile(damaged);
+    EXPECT_EQ(MappedSnapshot(path).error(), "snapshot checksum mismatch");
+
+    writeFile(original.substr(0, original.size() - 1));
+    EXPECT_EQ(MappedSnapshot(path).error(), "snapshot is truncated");
+
+    writeFile(original.substr(0, HEADER_BYTES - 1));
+    EXPECT_EQ(MappedSnapshot(path).error(), "snapshot is truncated");
+
+    damaged = original;
+    damaged[0] ^= 0xFF;
+    writeFile(damaged);
+    EXPECT_EQ(MappedSnapshot(path).error(), "not a behavior snapshot");
+
+    damaged = original;
+    damaged[4] = static_cast<char>(SNAPSHOT_FORMAT_VERSION + 1);
+    writeFile(damaged);
+    EXPECT_FALSE(MappedSnapshot(path).valid());
+    EXPECT_EQ(MappedSnapshot(path).error().rfind("unsupported snapshot version", 0), 0u);
+}
+
+TEST_F(SnapshotTest, AnalyzerStateSurvivesRestart) {
+    BehaviorAnalyzer before;
+    for (int i = 0; i < 40; ++i) {
+        before.analyzeActivity("alice", "typing", {{"typing_speed", 50.0 + (i % 2)}, {"clicks", 10.0}});
+        before.analyzeActivity("bob", "browsing", {{"tabs", 5.0 + (i % 3)}});
+    }
+    before.analyzeActivity("alice", "typing", {{"typing_speed", 400.0}, {"clicks", 10.0}});
+    ASSERT_TRUE(before.saveSnapshot(path));
+
+    BehaviorAnalyzer after;
+    ASSERT_TRUE(after.loadSnapshot(path));
+    EXPECT_EQ(after.userCount(), 2u);
+    for (const std::string user : {"alice", "bob"}) {
+        EXPECT_DOUBLE_EQ(after.getRiskScore(user), before.getRiskScore(user));
+        EXPECT_EQ(descriptions(after, user), descriptions(before, user));
+        EXPECT_EQ(after.getUserProfile(user).baseline_metrics, before.getUserProfile(user).baseline_metrics);
+    }
+    EXPECT_FALSE(descriptions(after, "alice").empty());
+}
+
+TEST_F(SnapshotTest, MalformedPayloadLeavesAnalyzerUntouched) {
+    BehaviorAnalyzer source;
+    for (int i = 0; i < 5; ++i) {
+        source.analyzeActivity("alice", "typing", {{"typing_speed", 50.0}});
+    }
+    ASSERT_TRUE(source.saveSnapshot(path));
+
+    // A valid container around a cut-short payload
+    std::string payload = readFile().substr(HEADER_BYTES);
+    ASSERT_TRUE(writeSnapshotFile(path, payload.substr(0, payload.size() / 2)));
+
+    BehaviorAnalyzer target;
+    EXPECT_FALSE(target.loadSnapshot(path));
+    EXPECT_EQ(target.userCount(), 0u);
+}
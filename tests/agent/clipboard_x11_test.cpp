@@ -0,0 +1,104 @@
+// Drives DLPMonitor's clipboard path against a real X server. ctest runs it
+// through xvfb-run, and xclip owns each selection the test sets.
+#include "dlp_monitor.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef XCLIP_PATH
+#define XCLIP_PATH "xclip"
+#endif
+
+namespace {
+    constexpr std::chrono::seconds EVENT_TIMEOUT(5);
+    constexpr std::chrono::milliseconds WARM_UP_STEP(250);
+    constexpr std::chrono::milliseconds SETTLE(500);
+
+    class EventLog {
+    public:
+        void add(const DLPEvent& event) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            events_.push_back(event);
+            cv_.notify_all();
+        }
+
+        bool waitFor(size_t count, std::chrono::milliseconds timeout) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            return cv_.wait_for(lock, timeout, [this, count] { return events_.size() >= count; });
+        }
+
+        std::vector<DLPEvent> events() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return events_;
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<DLPEvent> events_;
+    };
+
+    // xclip forks to serve the selection and exits once it has taken ownership
+    bool setClipboard(const std::string& text) {
+        FILE* xclip = popen(XCLIP_PATH " -selection clipboard -i", "w");
+        if (!xclip) return false;
+        size_t written = fwrite(text.data(), 1, text.size(), xclip);
+        return pclose(xclip) == 0 && written == text.size();
+    }
+}
+
+TEST(ClipboardX11Test, SensitiveSelectionFiresOneEvent) {
+    if (!std::getenv("DISPLAY")) {
+        GTEST_SKIP() << "needs an X display; run through xvfb-run";
+    }
+    unsetenv("WAYLAND_DISPLAY");  // Keep the monitor on the XFixes backend
+
+    // The monitoring threads are detached and may outlive stopMonitoring(), so the
+    // monitor is never destroyed
+    static EventLog* log = new EventLog();
+    static DLPMonitor* monitor = new DLPMonitor();
+    monitor->addPolicy(DLPPolicy{"ssn", {}, {std::regex("\\b\\d{3}-\\d{2}-\\d{4}\\b")}, {}, {}, false});
+    monitor->setCallback([](const DLPEvent& event) {
+        if (event.type == "clipboard") log->add(event);
+    });
+    monitor->startMonitoring();
+
+    // Selection changes are only seen once the monitor has subscribed to them,
+    // so keep setting new sensitive content until one is reported
+    for (int attempt = 0; attempt * WARM_UP_STEP < EVENT_TIMEOUT; ++attempt) {
+        ASSERT_TRUE(setClipboard("warm-up 000-00-" + std::to_string(1000 + attempt)));
+        if (log->waitFor(1, WARM_UP_STEP)) break;
+    }
+    ASSERT_TRUE(log->waitFor(1, EVENT_TIMEOUT)) << "clipboard monitor never reported a selection";
+    std::this_thread::sleep_for(SETTLE);
+    size_t base = log->events().size();
+
+    ASSERT_TRUE(setClipboard("Employee SSN 123-45-6789"));
+    ASSERT_TRUE(log->waitFor(base + 1, EVENT_TIMEOUT));
+
+    // The same text copied again only moves ownership. Events arrive in order,
+    // so once the next distinct selection is reported the repeat has been seen.
+    // The pause keeps the two xclip owners from taking over out of order.
+    ASSERT_TRUE(setClipboard("Employee SSN 123-45-6789"));
+    std::this_thread::sleep_for(SETTLE);
+    ASSERT_TRUE(setClipboard("Employee SSN 987-65-4321"));
+    ASSERT_TRUE(log->waitFor(base + 2, EVENT_TIMEOUT));
+    std::this_thread::sleep_for(SETTLE);
+
+    std::vector<DLPEvent> events = log->events();
+    EXPECT_EQ(events.size(), base + 2);
+    for (size_t i = base; i < events.size(); ++i) {
+        EXPECT_EQ(events[i].file_path, "CLIPBOARD (x11)");
+        EXPECT_NE(events[i].policy_violated.find("(ssn)"), std::string::npos) << events[i].policy_violated;
+        EXPECT_EQ(events[i].bytes, 24u);
+        EXPECT_FALSE(events[i].blocked);
+    }
+
+    monitor->stopMonitoring();
+}
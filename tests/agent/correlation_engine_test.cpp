@@ -0,0 +1,175 @@
+#include "correlation_engine.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point START = Clock::now();
+
+    CorrelationEvent event(const std::string& type, const std::string& user, int pid,
+                           const std::string& process, std::chrono::seconds offset,
+                           const std::string& path = "") {
+        CorrelationEvent result;
+        result.type = type;
+        result.user = user;
+        result.pid = pid;
+        result.process = process;
+        result.path = path;
+        result.time = START + offset;
+        return result;
+    }
+
+    CorrelationEvent fileAccess(const std::string& user, std::chrono::seconds offset) {
+        return event("file_access", user, 0, "", offset, "/srv/finance/payroll.xlsx");
+    }
+
+    CorrelationEvent exec(const std::string& user, int pid, const std::string& process,
+                          std::chrono::seconds offset) {
+        return event("process_exec", user, pid, process, offset);
+    }
+
+    class CorrelationEngineTest : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            engine.addRule(CorrelationEngine::exfiltrationSequenceRule());
+            engine.setMatchCallback([this](const CorrelationMatch& match) { matches.push_back(match); });
+        }
+
+        CorrelationEngine engine;
+        std::vector<CorrelationMatch> matches;
+    };
+
+    using std::chrono::seconds;
+}
+
+TEST_F(CorrelationEngineTest, MatchesSequenceInOrder) {
+    engine.ingest(fileAccess("alice", seconds(0)));
+    engine.ingest(exec("alice", 100, "/usr/bin/tar", seconds(10)));
+    EXPECT_TRUE(matches.empty());
+    engine.ingest(exec("alice", 101, "/usr/bin/scp", seconds(20)));
+
+    ASSERT_EQ(matches.size(), 1u);
+    const CorrelationMatch& match = matches[0];
+    EXPECT_EQ(match.rule, "sensitive_archive_transfer");
+    EXPECT_EQ(match.key, "alice");
+    EXPECT_EQ(match.user, "alice");
+    ASSERT_EQ(match.events.size(), 3u);
+    EXPECT_EQ(match.events[0].type, "file_access");
+    EXPECT_EQ(match.events[1].process, "/usr/bin/tar");
+    EXPECT_EQ(match.events[2].process, "/usr/bin/scp");
+
+    // A later transfer does not report the same sequence again
+    engine.ingest(exec("alice", 102, "curl", seconds(30)));
+    EXPECT_EQ(matches.size(), 1u);
+}
+
+TEST_F(CorrelationEngineTest, IgnoresStepsOutOfOrder) {
+    engine.ingest(exec("alice", 100, "tar", seconds(0)));
+    engine.ingest(fileAccess("alice", seconds(10)));
+    engine.ingest(exec("alice", 101, "scp", seconds(20)));
+    EXPECT_TRUE(matches.empty());
+}
+
+TEST_F(CorrelationEngineTest, RequiresTheWholeSequenceWithinTheWindow) {
+    engine.ingest(fileAccess("alice", seconds(0)));
+    engine.ingest(exec("alice", 100, "tar", seconds(200)));
+    engine.ingest(exec("alice", 101, "scp", seconds(301)));
+    EXPECT_TRUE(matches.empty());
+
+    // A fresh start inside the window still matches
+    engine.ingest(fileAccess("alice", seconds(400)));
+    engine.ingest(exec("alice", 102, "zip", seconds(500)));
+    engine.ingest(exec("alice", 103, "rsync", seconds(600)));
+    EXPECT_EQ(matches.size(), 1u);
+}
+
+TEST_F(CorrelationEngineTest, KeepsUsersApart) {
+    engine.ingest(fileAccess("alice", seconds(0)));
+    engine.ingest(exec("bob", 100, "tar", seconds(10)));
+    engine.ingest(exec("bob", 101, "scp", seconds(20)));
+    EXPECT_TRUE(matches.empty());
+}
+
+TEST_F(CorrelationEngineTest, UnattributedEventsStartAnyUsersSequence) {
+    engine.ingest(fileAccess("", seconds(0)));
+    engine.ingest(exec("alice", 100, "tar", seconds(10)));
+    engine.ingest(exec("alice", 101, "wget", seconds(20)));
+
+    ASSERT_EQ(matches.size(), 1u);
+    EXPECT_EQ(matches[0].key, "alice");
+    EXPECT_EQ(matches[0].events[0].user, "");
+}
+
+TEST_F(CorrelationEngineTest, KeyEvictionSparesUnattributedKey) {
+    engine.setMaxKeysPerRule(2);
+    engine.ingest(fileAccess("", seconds(0)));
+    for (int i = 0; i < 5; ++i) {
+        engine.ingest(exec("user" + std::to_string(i), 100 + i, "tar", seconds(1 + i)));
+    }
+
+    engine.ingest(exec("alice", 200, "tar", seconds(10)));
+    engine.ingest(exec("alice", 201, "scp", seconds(11)));
+    EXPECT_EQ(matches.size(), 1u);
+}
+
+TEST_F(CorrelationEngineTest, StepsMatchBasenameAndPathSuffix) {
+    CorrelationRule rule;
+    rule.name = "key_copy";
+    rule.window = seconds(60);
+    rule.steps.push_back(CorrelationStep{"read", {"file_access"}, {"cp"}, {".PEM", "id_rsa"}});
+    engine.addRule(rule);
+
+    engine.ingest(event("file_access", "alice", 1, "/bin/cp", seconds(0), "/home/alice/server.pem"));
+    engine.ingest(event("file_access", "alice", 1, "/bin/mv", seconds(1), "/home/alice/server.pem"));
+    engine.ingest(event("file_access", "alice", 1, "/bin/cp", seconds(2), "/home/alice/notes.txt"));
+
+    // The one-step rule fires once; the exfiltration rule only starts a partial
+    ASSERT_EQ(matches.size(), 1u);
+    EXPECT_EQ(matches[0].rule, "key_copy");
+}
+
+TEST_F(CorrelationEngineTest, KeysByProcess) {
+    CorrelationRule rule;
+    rule.name = "read_then_send";
+    rule.window = seconds(60);
+    rule.key_by = CorrelationRule::KeyBy::Process;
+    rule.steps.push_back(CorrelationStep{"read", {"file_access"}, {}, {}});
+    rule.steps.push_back(CorrelationStep{"send", {"network_transfer"}, {}, {}});
+    engine.removeRule("sensitive_archive_transfer");
+    engine.addRule(rule);
+
+    engine.ingest(event("file_access", "alice", 10, "python3", seconds(0)));
+    engine.ingest(event("network_transfer", "alice", 11, "python3", seconds(1)));
+    EXPECT_TRUE(matches.empty());
+
+    engine.ingest(event("network_transfer", "alice", 10, "python3", seconds(2)));
+    ASSERT_EQ(matches.size(), 1u);
+    EXPECT_EQ(matches[0].key, "10");
+}
+
+TEST_F(CorrelationEngineTest, ReplacingARuleResetsItsState) {
+    engine.ingest(fileAccess("alice", seconds(0)));
+    engine.ingest(exec("alice", 100, "tar", seconds(10)));
+    engine.addRule(CorrelationEngine::exfiltrationSequenceRule());
+    engine.ingest(exec("alice", 101, "scp", seconds(20)));
+    EXPECT_TRUE(matches.empty());
+}
+
+TEST_F(CorrelationEngineTest, CallbackMayIngest) {
+    bool fed_back = false;
+    engine.setMatchCallback([&](const CorrelationMatch& match) {
+        matches.push_back(match);
+        if (!fed_back) {
+            fed_back = true;
+            engine.ingest(fileAccess("alice", seconds(30)));
+        }
+    });
+
+    engine.ingest(fileAccess("alice", seconds(0)));
+    engine.ingest(exec("alice", 100, "tar", seconds(10)));
+    engine.ingest(exec("alice", 101, "scp", seconds(20)));
+    EXPECT_TRUE(fed_back);
+    EXPECT_EQ(matches.size(), 1u);
+}
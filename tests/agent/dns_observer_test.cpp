@@ -0,0 +1,202 @@
+#include "dns_observer.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+    // Builds DNS response payloads byte by byte
+    class ResponseBuilder {
+    public:
+        ResponseBuilder(uint16_t flags, uint16_t questions, uint16_t answers) {
+            u16(0x1234);
+            u16(flags);
+            u16(questions);
+            u16(answers);
+            u16(0);
+            u16(0);
+        }
+
+        ResponseBuilder& name(const std::string& dotted) {
+            size_t start = 0;
+            while (start <= dotted.size()) {
+                size_t dot = dotted.find('.', start);
+                if (dot == std::string::npos) dot = dotted.size();
+                bytes.push_back(static_cast<uint8_t>(dot - start));
+                bytes.insert(bytes.end(), dotted.begin() + start, dotted.begin() + dot);
+                start = dot + 1;
+            }
+            bytes.push_back(0);
+            return *this;
+        }
+
+        ResponseBuilder& pointer(uint16_t offset) {
+            u16(static_cast<uint16_t>(0xC000 | offset));
+            return *this;
+        }
+
+        ResponseBuilder& question() {
+            u16(1);  // A
+            u16(1);  // IN
+            return *this;
+        }
+
+        ResponseBuilder& answer(uint16_t type, uint32_t ttl, const std::vector<uint8_t>& rdata) {
+            u16(type);
+            u16(1);
+            u16(static_cast<uint16_t>(ttl >> 16));
+            u16(static_cast<uint16_t>(ttl));
+            u16(static_cast<uint16_t>(rdata.size()));
+            bytes.insert(bytes.end(), rdata.begin(), rdata.end());
+            return *this;
+        }
+
+        ResponseBuilder& u16(uint16_t value) {
+            bytes.push_back(static_cast<uint8_t>(value >> 8));
+            bytes.push_back(static_cast<uint8_t>(value));
+            return *this;
+        }
+
+        std::vector<uint8_t> bytes;
+    };
+
+    std::vector<uint8_t> encodedName(const std::string& dotted) {
+        std::vector<uint8_t> bytes = ResponseBuilder(0, 0, 0).name(dotted).bytes;
+        return std::vector<uint8_t>(bytes.begin() + 12, bytes.end());  // Drop the header
+    }
+}
+
+TEST(DomainSuffixMatcherTest, ExactAndWildcard) {
+    DomainSuffixMatcher matcher({"dropbox.com", "*.drive.google.com"});
+    std::string pattern;
+
+    EXPECT_TRUE(matcher.match("dropbox.com", &pattern));
+    EXPECT_EQ(pattern, "dropbox.com");
+    EXPECT_FALSE(matcher.match("www.dropbox.com"));  // Exact names do not cover subdomains
+    EXPECT_FALSE(matcher.match("notdropbox.com"));
+
+    EXPECT_TRUE(matcher.match("docs.drive.google.com", &pattern));
+    EXPECT_EQ(pattern, "*.drive.google.com");
+    EXPECT_TRUE(matcher.match("a.b.drive.google.com"));
+    EXPECT_FALSE(matcher.match("drive.google.com"));  // Wildcards cover subdomains only
+    EXPECT_FALSE(matcher.match("xdrive.google.com"));
+}
+
+TEST(DomainSuffixMatcherTest, NormalizesCaseAndTrailingDot) {
+    DomainSuffixMatcher matcher({"Example.COM.", "*.Upload.Example.org"});
+    EXPECT_TRUE(matcher.match("example.com"));
+    EXPECT_TRUE(matcher.match("EXAMPLE.com."));
+    EXPECT_TRUE(matcher.match("files.UPLOAD.example.ORG."));
+}
+
+TEST(DomainSuffixMatcherTest, LongestSuffixWins) {
+    DomainSuffixMatcher matcher({"*.com", "*.dropbox.com"});
+    std::string pattern;
+    ASSERT_TRUE(matcher.match("dl.dropbox.com", &pattern));
+    EXPECT_EQ(pattern, "*.dropbox.com");
+    ASSERT_TRUE(matcher.match("example.com", &pattern));
+    EXPECT_EQ(pattern, "*.com");
+}
+
+TEST(DomainSuffixMatcherTest, EmptyInputs) {
+    DomainSuffixMatcher none;
+    EXPECT_TRUE(none.empty());
+    EXPECT_FALSE(none.match("example.com"));
+
+    DomainSuffixMatcher matcher({"", "*.", "example.com"});
+    EXPECT_FALSE(matcher.match(""));
+    EXPECT_FALSE(matcher.match("."));
+    EXPECT_TRUE(matcher.match("example.com"));
+}
+
+TEST(DomainSuffixMatcherTest, CopiesOwnTheirPatterns) {
+    DomainSuffixMatcher copy;
+    {
+        DomainSuffixMatcher original({"*.example.com"});
+        copy = original;
+        DomainSuffixMatcher constructed(original);
+        EXPECT_TRUE(constructed.match("a.example.com"));
+    }
+    // The lookup tables hold views, so a copy must not point into the original
+    EXPECT_TRUE(copy.match("a.example.com"));
+}
+
+TEST(DnsCacheTest, EvictsLeastRecentlyUsed) {
+    DnsCache cache(2);
+    cache.insert("10.0.0.1", "one.example", "", 300);
+    cache.insert("10.0.0.2", "two.example", "", 300);
+
+    DnsResolution resolution;
+    ASSERT_TRUE(cache.lookup("10.0.0.1", resolution));  // Now the most recent
+    cache.insert("10.0.0.3", "three.example", "", 300);
+
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_FALSE(cache.lookup("10.0.0.2", resolution));
+    ASSERT_TRUE(cache.lookup("10.0.0.1", resolution));
+    EXPECT_EQ(resolution.hostname, "one.example");
+    EXPECT_TRUE(cache.lookup("10.0.0.3", resolution));
+}
+
+TEST(DnsObserverTest, RecordsAnswersWithCanonicalName) {
+    // Question www.example.com, answered by a CNAME to cdn.example.net whose
+    // A and AAAA records use a compression pointer to the CNAME target
+    ResponseBuilder response(0x8180, 1, 3);
+    response.name("WWW.Example.com").question();
+    size_t answer_start = response.bytes.size();
+    response.pointer(12).answer(5, 300, encodedName("cdn.example.net"));
+    uint16_t target = static_cast<uint16_t>(answer_start + 12);
+    response.pointer(target).answer(1, 300, {192, 0, 2, 7});
+    response.pointer(target).answer(28, 300, {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1});
+
+    DnsObserver observer;
+    observer.processResponse(response.bytes.data(), response.bytes.size());
+
+    DnsResolution resolution;
+    ASSERT_TRUE(observer.resolve("192.0.2.7", resolution));
+    EXPECT_EQ(resolution.hostname, "www.example.com");
+    EXPECT_EQ(resolution.canonical_name, "cdn.example.net");
+    ASSERT_TRUE(observer.resolve("2001:db8::1", resolution));
+    EXPECT_EQ(resolution.hostname, "www.example.com");
+}
+
+TEST(DnsObserverTest, IgnoresQueriesAndErrors) {
+    DnsObserver observer;
+    DnsResolution resolution;
+
+    ResponseBuilder query(0x0100, 1, 1);
+    query.name("example.com").question().pointer(12).answer(1, 300, {192, 0, 2, 1});
+    observer.processResponse(query.bytes.data(), query.bytes.size());
+    EXPECT_FALSE(observer.resolve("192.0.2.1", resolution));
+
+    ResponseBuilder failure(0x8183, 1, 1);  // NXDOMAIN
+    failure.name("example.com").question().pointer(12).answer(1, 300, {192, 0, 2, 2});
+    observer.processResponse(failure.bytes.data(), failure.bytes.size());
+    EXPECT_FALSE(observer.resolve("192.0.2.2", resolution));
+}
+
+TEST(DnsObserverTest, RejectsMalformedResponses) {
+    DnsObserver observer;
+    DnsResolution resolution;
+
+    // A name that points at itself must not loop
+    ResponseBuilder loop(0x8180, 1, 1);
+    loop.pointer(12).question().pointer(12).answer(1, 300, {192, 0, 2, 3});
+    observer.processResponse(loop.bytes.data(), loop.bytes.size());
+    EXPECT_FALSE(observer.resolve("192.0.2.3", resolution));
+
+    // Truncated record data
+    ResponseBuilder truncated(0x8180, 1, 1);
+    truncated.name("example.com").question().pointer(12).answer(1, 300, {192, 0, 2, 4});
+    truncated.bytes.resize(truncated.bytes.size() - 2);
+    observer.processResponse(truncated.bytes.data(), truncated.bytes.size());
+    EXPECT_FALSE(observer.resolve("192.0.2.4", resolution));
+
+    // Every prefix of a valid response is handled without reading past the end
+    ResponseBuilder valid(0x8180, 1, 1);
+    valid.name("example.com").question().pointer(12).answer(1, 300, {192, 0, 2, 5});
+    for (size_t length = 0; length < valid.bytes.size(); ++length) {
+        std::vector<uint8_t> prefix(valid.bytes.begin(), valid.bytes.begin() + length);
+        observer.processResponse(prefix.data(), prefix.size());
+    }
+    EXPECT_FALSE(observer.resolve("192.0.2.5", resolution));
+}
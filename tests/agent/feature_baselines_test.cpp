@@ -0,0 +1,192 @@
+#include "feature_baselines.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace {
+    FeatureVector observation(const std::vector<double>& values) {
+        FeatureVector vector(values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            vector.set(static_cast<FeatureId>(i), values[i]);
+        }
+        return vector;
+    }
+
+    // Alternates around each mean so the deviation is non-zero
+    void train(FeatureBaselines& baselines, size_t row, const std::vector<double>& means, size_t samples,
+               size_t hour = 0) {
+        for (size_t n = 0; n < samples; ++n) {
+            std::vector<double> values = means;
+            for (auto& value : values) value += (n % 2 == 0) ? 1.0 : -1.0;
+            baselines.update(row, observation(values), hour, 0.05);
+        }
+    }
+}
+
+TEST(FeatureBaselinesTest, WelfordAveragesBeforeWarmUp) {
+    FeatureBaselines baselines;
+    size_t row = baselines.addRow();
+    for (int value = 1; value <= 10; ++value) {
+        baselines.update(row, observation({static_cast<double>(value)}), 0, 0.01);
+    }
+    EXPECT_DOUBLE_EQ(baselines.counts(row)[0], 10.0);
+    EXPECT_NEAR(baselines.means(row)[0], 5.5, 1e-12);
+    EXPECT_NEAR(baselines.variances(row)[0], 8.25, 1e-12);  // Population variance of 1..10
+
+    BaselineScore score;
+    EXPECT_FALSE(baselines.score(row, observation({5.0}), 0, score));
+}
+
+TEST(FeatureBaselinesTest, ScoresOutliersAgainstTheBaseline) {
+    FeatureBaselines baselines;
+    size_t row = baselines.addRow();
+    train(baselines, row, {10.0, 100.0, 0.0}, 60);
+
+    BaselineScore score;
+    ASSERT_TRUE(baselines.score(row, observation({10.0, 100.0, 0.0}), 0, score));
+    EXPECT_LT(score.max_z, 1.0);
+    EXPECT_EQ(score.compared, 3u);
+
+    ASSERT_TRUE(baselines.score(row, observation({10.0, 160.0, 0.0}), 0, score));
+    EXPECT_GT(score.max_z, 10.0);
+    EXPECT_EQ(score.top_feature, 1u);
+    EXPECT_LT(score.rms_z, score.max_z);
+}
+
+TEST(FeatureBaselinesTest, ZeroBaselinesStayFinite) {
+    FeatureBaselines baselines;
+    size_t row = baselines.addRow();
+    for (int n = 0; n < 40; ++n) {
+        baselines.update(row, observation({0.0}), 0, 0.05);
+    }
+
+    BaselineScore score;
+    ASSERT_TRUE(baselines.score(row, observation({1.0}), 0, score));
+    EXPECT_TRUE(std::isfinite(score.max_z));
+    EXPECT_GT(score.max_z, 1.0);
+}
+
+TEST(FeatureBaselinesTest, UnobservedFeaturesAreSkipped) {
+    FeatureBaselines baselines;
+    size_t row = baselines.addRow();
+    train(baselines, row, {5.0, 5.0}, 40);
+
+    FeatureVector partial(2);
+    partial.set(0, 5.0);
+    baselines.update(row, partial, 0, 0.05);
+    EXPECT_DOUBLE_EQ(baselines.counts(row)[0], 41.0);
+    EXPECT_DOUBLE_EQ(baselines.counts(row)[1], 40.0);
+
+    // Feature 1 is far off but absent, so it must not count
+    partial.values[1] = 1e6;
+    BaselineScore score;
+    ASSERT_TRUE(baselines.score(row, partial, 0, score));
+    EXPECT_EQ(score.compared, 1u);
+    EXPECT_LT(score.max_z, 1.0);
+}
+
+TEST(FeatureBaselinesTest, ClipsOutliersOnceWarm) {
+    FeatureBaselines baselines;
+    size_t row = baselines.addRow();
+    train(baselines, row, {10.0}, 60);
+    double before = baselines.means(row)[0];
+
+    baselines.update(row, observation({1e9}), 0, 0.05);
+    EXPECT_LT(baselines.means(row)[0] - before, 1.0);
+}
+
+TEST(FeatureBaselinesTest, ComparesAgainstTheSameHourOfWeek) {
+    FeatureBaselines baselines;
+    size_t row = baselines.addRow();
+    const size_t monday_nine = 9;
+    const size_t monday_ten = 10;
+    for (int week = 0; week < 40; ++week) {
+        train(baselines, row, {100.0}, 1, monday_nine);
+        train(baselines, row, {0.0}, 1, monday_ten);
+    }
+
+    BaselineScore at_nine;
+    BaselineScore at_ten;
+    ASSERT_TRUE(baselines.score(row, observation({100.0}), monday_nine, at_nine));
+    ASSERT_TRUE(baselines.score(row, observation({100.0}), monday_ten, at_ten));
+    EXPECT_LT(at_nine.max_z, 1.0);
+    EXPECT_GT(at_ten.max_z, 10.0);
+}
+
+TEST(FeatureBaselinesTest, GrowingTheSchemaKeepsStatistics) {
+    FeatureBaselines baselines;
+    size_t first = baselines.addRow();
+    size_t second = baselines.addRow();
+    train(baselines, first, {1.0, 2.0, 3.0}, 40);
+    train(baselines, second, {4.0, 5.0, 6.0}, 40);
+    double mean = baselines.means(second)[2];
+
+    baselines.ensureFeatures(20);
+    EXPECT_EQ(baselines.features(), 20u);
+    EXPECT_DOUBLE_EQ(baselines.means(second)[2], mean);
+    EXPECT_DOUBLE_EQ(baselines.counts(first)[0], 40.0);
+    EXPECT_DOUBLE_EQ(baselines.counts(first)[19], 0.0);
+
+    BaselineScore score;
+    ASSERT_TRUE(baselines.score(second, observation({4.0, 5.0, 6.0}), 0, score));
+    EXPECT_LT(score.max_z, 1.0);
+}
+
+TEST(FeatureBaselinesTest, ExportImportRoundTrip) {
+    FeatureBaselines source;
+    size_t row = source.addRow();
+    train(source, row, {1.0, 20.0, 300.0}, 50, 30);
+
+    std::string bytes;
+    source.exportRow(row, bytes);
+    ASSERT_EQ(bytes.size(), FeatureBaselines::rowBytes(3));
+
+    // Import into a schema where the features were registered in a different order
+    FeatureBaselines target;
+    size_t imported = target.addRow();
+    target.importRow(imported, reinterpret_cast<const unsigned char*>(bytes.data()), {2, 0, 1});
+    EXPECT_EQ(target.features(), 3u);
+    EXPECT_DOUBLE_EQ(target.means(imported)[2], source.means(row)[0]);
+    EXPECT_DOUBLE_EQ(target.means(imported)[0], source.means(row)[1]);
+    EXPECT_DOUBLE_EQ(target.variances(imported)[1], source.variances(row)[2]);
+    EXPECT_DOUBLE_EQ(target.counts(imported)[1], 50.0);
+
+    BaselineScore expected;
+    BaselineScore actual;
+    ASSERT_TRUE(source.score(row, observation({1.0, 20.0, 330.0}), 30, expected));
+    ASSERT_TRUE(target.score(imported, observation({20.0, 330.0, 1.0}), 30, actual));
+    EXPECT_DOUBLE_EQ(actual.max_z, expected.max_z);
+    EXPECT_EQ(actual.top_feature, 1u);
+}
+
+TEST(FeatureBaselinesTest, SetSeedsTheMean) {
+    FeatureBaselines baselines;
+    size_t row = baselines.addRow();
+    baselines.set(row, 12, 7.5);
+    EXPECT_EQ(baselines.features(), 13u);
+    EXPECT_DOUBLE_EQ(baselines.means(row)[12], 7.5);
+    EXPECT_DOUBLE_EQ(baselines.counts(row)[12], 1.0);
+}
+
+TEST(FeatureBaselinesTest, HourOfWeekStartsOnMonday) {
+    const char* previous = std::getenv("TZ");
+    std::string saved = previous ? previous : "";
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    auto at = [](std::time_t seconds) { return std::chrono::system_clock::from_time_t(seconds); };
+    const std::time_t monday = 1704067200;  // 2024-01-01 00:00 UTC
+    EXPECT_EQ(FeatureBaselines::hourOfWeek(at(monday)), 0u);
+    EXPECT_EQ(FeatureBaselines::hourOfWeek(at(monday + 9 * 3600 + 1800)), 9u);
+    EXPECT_EQ(FeatureBaselines::hourOfWeek(at(monday + 7 * 86400 - 1)), 167u);  // Sunday 23:59
+
+    if (previous) {
+        setenv("TZ", saved.c_str(), 1);
+    } else {
+        unsetenv("TZ");
+    }
+    tzset();
+}
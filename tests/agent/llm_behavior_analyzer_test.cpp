@@ -0,0 +1,99 @@
+#include "llm_behavior_analyzer.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+    const LLMBehaviorInsight* insightFor(const std::vector<LLMBehaviorInsight>& insights, const std::string& user) {
+        for (const auto& insight : insights) {
+            if (insight.user == user) return &insight;
+        }
+        return nullptr;
+    }
+}
+
+TEST(ParseLLMResponseTest, BatchedResponseKeyedByUser) {
+    std::string response = R"({
+        "alice": {"risk_level": "high", "confidence_score": 0.9, "analysis": "Bulk copy to USB",
+                  "patterns": ["usb_copy", "after_hours"], "recommendations": ["Review USB policy"]},
+        "bob": {"risk_level": "low", "confidence_score": 0.2, "analysis": "Routine work"}
+    })";
+    auto insights = LLMBehaviorAnalyzer::parseLLMResponse(response, {"alice", "bob", "carol"});
+    ASSERT_EQ(insights.size(), 2u);
+
+    const LLMBehaviorInsight* alice = insightFor(insights, "alice");
+    ASSERT_NE(alice, nullptr);
+    EXPECT_EQ(alice->severity, "high");
+    EXPECT_EQ(alice->insight_type, "alert");
+    EXPECT_DOUBLE_EQ(alice->confidence_score, 0.9);
+    EXPECT_EQ(alice->analysis, "Bulk copy to USB");
+    EXPECT_EQ(alice->description, "Detected patterns: usb_copy, after_hours");
+    EXPECT_EQ(alice->recommendations, std::vector<std::string>{"Review USB policy"});
+
+    const LLMBehaviorInsight* bob = insightFor(insights, "bob");
+    ASSERT_NE(bob, nullptr);
+    EXPECT_EQ(bob->severity, "low");
+    EXPECT_EQ(bob->insight_type, "pattern");
+
+    // Users the response left out get nothing rather than a default
+    EXPECT_EQ(insightFor(insights, "carol"), nullptr);
+}
+
+TEST(ParseLLMResponseTest, JsonWrappedInProse) {
+    std::string response = "Here is the analysis:\n```json\n"
+                           R"({"alice": {"risk_level": "medium", "recommendations": ["Enable MFA"]}})"
+                           "\n```\nLet me know if you need more.";
+    auto insights = LLMBehaviorAnalyzer::parseLLMResponse(response, {"alice"});
+    ASSERT_EQ(insights.size(), 1u);
+    EXPECT_EQ(insights[0].insight_type, "recommendation");
+    EXPECT_DOUBLE_EQ(insights[0].confidence_score, 0.5);
+}
+
+TEST(ParseLLMResponseTest, SingleUserWithoutKey) {
+    std::string response = R"({"risk_level": "critical", "confidence_score": 0.95, "analysis": "Exfiltration"})";
+    auto insights = LLMBehaviorAnalyzer::parseLLMResponse(response, {"alice"});
+    ASSERT_EQ(insights.size(), 1u);
+    EXPECT_EQ(insights[0].user, "alice");
+    EXPECT_EQ(insights[0].severity, "critical");
+    EXPECT_EQ(insights[0].insight_type, "alert");
+
+    // A batch cannot be attributed without keys
+    EXPECT_TRUE(LLMBehaviorAnalyzer::parseLLMResponse(response, {"alice", "bob"}).empty());
+}
+
+TEST(ParseLLMResponseTest, FreeTextFallsBackForSingleUser) {
+    std::string response = "The user appears to be working normally.";
+    auto insights = LLMBehaviorAnalyzer::parseLLMResponse(response, {"alice"});
+    ASSERT_EQ(insights.size(), 1u);
+    EXPECT_EQ(insights[0].analysis, response);
+    EXPECT_EQ(insights[0].severity, "medium");
+    EXPECT_EQ(insights[0].insight_type, "pattern");
+
+    EXPECT_TRUE(LLMBehaviorAnalyzer::parseLLMResponse(response, {"alice", "bob"}).empty());
+
+    // Braces that are not valid JSON are free text as well
+    insights = LLMBehaviorAnalyzer::parseLLMResponse("Risk {high} for now}", {"alice"});
+    ASSERT_EQ(insights.size(), 1u);
+    EXPECT_EQ(insights[0].analysis, "Risk {high} for now}");
+}
+
+TEST(ParseLLMResponseTest, SkipsMalformedEntries) {
+    std::string response = R"({
+        "alice": {"risk_level": "low", "patterns": [1, 2]},
+        "bob": "not an object",
+        "carol": {"risk_level": "high", "confidence_score": "very"},
+        "dave": {"risk_level": "medium"}
+    })";
+    auto insights = LLMBehaviorAnalyzer::parseLLMResponse(response, {"alice", "bob", "carol", "dave"});
+    ASSERT_EQ(insights.size(), 1u);
+    EXPECT_EQ(insights[0].user, "dave");
+}
+
+TEST(ParseLLMResponseTest, EmptyInputs) {
+    EXPECT_TRUE(LLMBehaviorAnalyzer::parseLLMResponse("{}", {}).empty());
+    EXPECT_TRUE(LLMBehaviorAnalyzer::parseLLMResponse(R"({"alice": {}})", {}).empty());
+
+    auto insights = LLMBehaviorAnalyzer::parseLLMResponse("", {"alice"});
+    ASSERT_EQ(insights.size(), 1u);
+    EXPECT_EQ(insights[0].analysis, "");
+}
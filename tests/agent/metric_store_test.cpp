@@ -0,0 +1,191 @@
+#include "metric_store.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+    uint64_t bitsOf(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    double fromBits(uint64_t bits) {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Encodes the points into one chunk and checks that decoding returns them
+    // unchanged, comparing values bit for bit so NaN payloads and the sign of
+    // zero count
+    void expectRoundTrip(const std::vector<MetricPoint>& points) {
+        MetricChunk chunk;
+        for (const auto& point : points) {
+            chunk.append(point.timestamp, point.value);
+        }
+        chunk.seal();
+        ASSERT_EQ(chunk.points(), points.size());
+
+        std::vector<MetricPoint> decoded;
+        chunk.decode(decoded, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max());
+        ASSERT_EQ(decoded.size(), points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            EXPECT_EQ(decoded[i].timestamp, points[i].timestamp) << "point " << i;
+            EXPECT_EQ(bitsOf(decoded[i].value), bitsOf(points[i].value)) << "point " << i;
+        }
+    }
+}
+
+TEST(MetricChunkTest, RegularSeries) {
+    std::vector<MetricPoint> points;
+    for (int i = 0; i < 120; ++i) {
+        points.push_back({1700000000 + i * 60, 42.0});
+    }
+    expectRoundTrip(points);
+}
+
+TEST(MetricChunkTest, SinglePoint) {
+    expectRoundTrip({{1700000000, 3.5}});
+}
+
+TEST(MetricChunkTest, IrregularTimestamps) {
+    // Deltas that land in every delta-of-delta bucket, both signs, plus the
+    // 64-bit escape for jumps outside the largest bucket
+    std::vector<int64_t> deltas = {60, 60, 61, 59, 1, 124, 60, 300, 3, 2100, 60, 4000,
+                                   5, 86400 * 30, 1, 60, 1000000000, 1, 1, 7};
+    std::vector<MetricPoint> points;
+    int64_t timestamp = 1700000000;
+    points.push_back({timestamp, 0.0});
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        timestamp += deltas[i];
+        points.push_back({timestamp, static_cast<double>(i)});
+    }
+    expectRoundTrip(points);
+}
+
+TEST(MetricChunkTest, BucketBoundaries) {
+    // Delta-of-deltas at the edges of each bucket's range
+    std::vector<int64_t> changes = {-63, 64, 65, -255, 256, 257, -2047, 2048, 2049, -2048};
+    std::vector<MetricPoint> points;
+    int64_t timestamp = 0;
+    int64_t delta = 100000;
+    points.push_back({timestamp, 1.0});
+    for (int64_t change : changes) {
+        delta += change;
+        timestamp += delta;
+        points.push_back({timestamp, 1.0});
+    }
+    expectRoundTrip(points);
+}
+
+TEST(MetricChunkTest, NegativeAndZeroTimestamps) {
+    expectRoundTrip({{-1000, 1.0}, {-1, 2.0}, {0, 3.0}, {1, 4.0}});
+}
+
+TEST(MetricChunkTest, SpecialValues) {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> values = {
+        0.0, -0.0, 0.0, -0.0, -0.0,
+        nan, nan, -nan, fromBits(0x7FF0000000000001ULL), fromBits(0xFFF8DEADBEEF0001ULL),
+        inf, -inf, inf,
+        std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::min(), std::numeric_limits<double>::denorm_min(),
+        -std::numeric_limits<double>::denorm_min(),
+        1e308, 1e-308, -1e300, 1e-300, 1.0, 1.0000000000000002, 0.1, -0.1,
+        std::numeric_limits<double>::lowest(), std::numeric_limits<double>::epsilon(),
+    };
+    std::vector<MetricPoint> points;
+    for (size_t i = 0; i < values.size(); ++i) {
+        points.push_back({1700000000 + static_cast<int64_t>(i) * 60, values[i]});
+    }
+    expectRoundTrip(points);
+}
+
+TEST(MetricChunkTest, ValueWindowReuse) {
+    // Small changes reuse the previous window of meaningful bits; a change in
+    // the top bits forces a new window, and a full 64-bit XOR is the widest case
+    std::vector<double> values = {1.0, 1.5, 1.25, 1.75, -1.75, fromBits(0), fromBits(~0ULL),
+                                  fromBits(0x8000000000000001ULL), fromBits(1), fromBits(0x8000000000000000ULL)};
+    std::vector<MetricPoint> points;
+    for (size_t i = 0; i < values.size(); ++i) {
+        points.push_back({static_cast<int64_t>(i), values[i]});
+    }
+    expectRoundTrip(points);
+}
+
+TEST(MetricChunkTest, PseudoRandomSeries) {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+
+    std::vector<MetricPoint> points;
+    int64_t timestamp = 1600000000;
+    for (int i = 0; i < 2000; ++i) {
+        timestamp += 1 + static_cast<int64_t>(next() % 5000);
+        points.push_back({timestamp, fromBits(next())});
+    }
+    expectRoundTrip(points);
+}
+
+TEST(MetricChunkTest, DecodeRange) {
+    MetricChunk chunk;
+    for (int i = 0; i < 10; ++i) {
+        chunk.append(100 + i * 10, i);
+    }
+
+    std::vector<MetricPoint> decoded;
+    chunk.decode(decoded, 120, 150);
+    ASSERT_EQ(decoded.size(), 4u);
+    EXPECT_EQ(decoded.front().timestamp, 120);
+    EXPECT_EQ(decoded.back().timestamp, 150);
+    EXPECT_EQ(decoded.front().value, 2.0);
+
+    decoded.clear();
+    chunk.decode(decoded, 0, 99);
+    chunk.decode(decoded, 191, 1000);
+    EXPECT_TRUE(decoded.empty());
+}
+
+TEST(MetricStoreTest, QueryAcrossChunks) {
+    MetricStore store(std::chrono::hours(24 * 7), 1 << 20);
+    auto start = std::chrono::system_clock::time_point(std::chrono::seconds(1700000000));
+    size_t total = MetricStore::CHUNK_POINTS * 3 + 7;
+    for (size_t i = 0; i < total; ++i) {
+        store.append("alice", "keys", start + std::chrono::minutes(i), static_cast<double>(i));
+    }
+    store.append("alice", "keys", start, -1.0);  // Out of order, ignored
+
+    auto points = store.query("alice", "keys", start, start + std::chrono::minutes(total));
+    ASSERT_EQ(points.size(), total);
+    for (size_t i = 0; i < total; ++i) {
+        EXPECT_EQ(points[i].value, static_cast<double>(i));
+    }
+    EXPECT_TRUE(store.query("bob", "keys", start, start + std::chrono::hours(1)).empty());
+    EXPECT_EQ(store.metrics("alice"), std::vector<std::string>{"keys"});
+}
+
+TEST(MetricStoreTest, RetentionDropsOldChunks) {
+    MetricStore store(std::chrono::hours(1), 1 << 20);
+    auto start = std::chrono::system_clock::time_point(std::chrono::seconds(1700000000));
+    for (size_t i = 0; i < MetricStore::CHUNK_POINTS * 2; ++i) {
+        store.append("alice", "keys", start + std::chrono::minutes(i), 1.0);
+    }
+
+    // The first chunk ends two hours in, well past the one-hour retention
+    auto now = start + std::chrono::minutes(MetricStore::CHUNK_POINTS * 2);
+    store.enforceRetention(now);
+    auto points = store.query("alice", "keys", start, now);
+    ASSERT_FALSE(points.empty());
+    EXPECT_GE(points.front().timestamp, 1700000000 + static_cast<int64_t>(MetricStore::CHUNK_POINTS) * 60);
+
+    store.enforceRetention(now + std::chrono::hours(2));
+    EXPECT_TRUE(store.metrics("alice").empty());
+}
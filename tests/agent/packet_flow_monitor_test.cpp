@@ -0,0 +1,95 @@
+#include "packet_flow_monitor.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+
+namespace {
+    FlowKey flow(uint32_t daddr, uint16_t dport, uint8_t protocol = 6) {
+        return FlowKey{0x0100000A, daddr, 40000, dport, protocol};
+    }
+
+    const FlowRecord* findFlow(const std::vector<FlowRecord>& flows, const FlowKey& key) {
+        auto it = std::find_if(flows.begin(), flows.end(),
+                               [&key](const FlowRecord& record) { return record.key == key; });
+        return it == flows.end() ? nullptr : &*it;
+    }
+}
+
+TEST(FlowTableTest, AccumulatesPerFlow) {
+    FlowTable table(64);
+    FlowKey https = flow(0x01020304, 443);
+    FlowKey dns = flow(0x08080808, 53, 17);
+
+    EXPECT_TRUE(table.account(https, 1500));
+    EXPECT_TRUE(table.account(https, 40));
+    EXPECT_TRUE(table.account(dns, 60));
+
+    std::vector<FlowRecord> flows;
+    table.drain(flows);
+    ASSERT_EQ(flows.size(), 2u);
+    const FlowRecord* record = findFlow(flows, https);
+    ASSERT_NE(record, nullptr);
+    EXPECT_EQ(record->bytes, 1540u);
+    EXPECT_EQ(record->packets, 2u);
+    record = findFlow(flows, dns);
+    ASSERT_NE(record, nullptr);
+    EXPECT_EQ(record->bytes, 60u);
+    EXPECT_EQ(record->packets, 1u);
+}
+
+TEST(FlowTableTest, EveryTupleFieldSeparatesFlows) {
+    FlowTable table(64);
+    FlowKey base = flow(0x01020304, 443);
+    std::vector<FlowKey> keys(6, base);
+    keys[1].saddr++;
+    keys[2].daddr++;
+    keys[3].sport++;
+    keys[4].dport++;
+    keys[5].protocol = 17;
+    for (const auto& key : keys) {
+        table.account(key, 100);
+    }
+
+    std::vector<FlowRecord> flows;
+    table.drain(flows);
+    ASSERT_EQ(flows.size(), keys.size());
+    for (const auto& key : keys) {
+        const FlowRecord* record = findFlow(flows, key);
+        ASSERT_NE(record, nullptr);
+        EXPECT_EQ(record->packets, 1u);
+    }
+}
+
+TEST(FlowTableTest, DrainEmptiesTheTable) {
+    FlowTable table(16);
+    table.account(flow(1, 80), 10);
+
+    std::vector<FlowRecord> flows;
+    table.drain(flows);
+    EXPECT_EQ(flows.size(), 1u);
+    table.drain(flows);
+    EXPECT_TRUE(flows.empty());
+
+    table.account(flow(1, 80), 5);
+    table.drain(flows);
+    ASSERT_EQ(flows.size(), 1u);
+    EXPECT_EQ(flows[0].bytes, 5u);
+}
+
+TEST(FlowTableTest, CountsDropsWhenFull) {
+    FlowTable table(3);  // Rounded up to four slots
+    for (uint16_t port = 1; port <= 4; ++port) {
+        EXPECT_TRUE(table.account(flow(1, port), 10));
+    }
+    EXPECT_FALSE(table.account(flow(1, 5), 10));
+    EXPECT_FALSE(table.account(flow(1, 6), 10));
+    EXPECT_EQ(table.droppedPackets(), 2u);
+
+    // Known flows keep counting while the table is full
+    EXPECT_TRUE(table.account(flow(1, 1), 10));
+
+    std::vector<FlowRecord> flows;
+    table.drain(flows);
+    EXPECT_EQ(flows.size(), 4u);
+    EXPECT_TRUE(table.account(flow(1, 5), 10));
+}
@@ -0,0 +1,95 @@
+#include "rate_budget.h"
+#include <gtest/gtest.h>
+
+namespace {
+    using std::chrono::milliseconds;
+    using std::chrono::seconds;
+
+    int acquireAll(RateBudget& budget, double tokens, std::chrono::steady_clock::time_point now) {
+        int acquired = 0;
+        while (acquired < 100000 && budget.tryAcquire(tokens, now)) {
+            acquired++;
+        }
+        return acquired;
+    }
+}
+
+TEST(RateBudgetTest, StartsFullAndRefillsContinuously) {
+    RateBudget budget(60.0, 1e9);
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_EQ(acquireAll(budget, 1.0, now), 60);
+
+    EXPECT_EQ(acquireAll(budget, 1.0, now + milliseconds(500)), 0);
+    EXPECT_EQ(acquireAll(budget, 1.0, now + seconds(10)), 10);
+
+    // Refill stops at one minute's quota
+    EXPECT_EQ(acquireAll(budget, 1.0, now + seconds(3600)), 60);
+}
+
+TEST(RateBudgetTest, TokensLimitRequests) {
+    RateBudget budget(1000.0, 1000.0);
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_TRUE(budget.tryAcquire(600.0, now));
+    EXPECT_FALSE(budget.covers(600.0, now));
+    EXPECT_FALSE(budget.tryAcquire(600.0, now));
+    EXPECT_TRUE(budget.tryAcquire(400.0, now));
+
+    // 600 tokens take 36 seconds to come back
+    EXPECT_FALSE(budget.tryAcquire(600.0, now + seconds(35)));
+    EXPECT_TRUE(budget.tryAcquire(600.0, now + seconds(37)));
+}
+
+TEST(RateBudgetTest, CoversDoesNotConsume) {
+    RateBudget budget(1.0, 100.0);
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(budget.covers(100.0, now));
+    }
+    EXPECT_TRUE(budget.tryAcquire(100.0, now));
+    EXPECT_FALSE(budget.covers(1.0, now));
+}
+
+TEST(RateBudgetTest, OversizedRequestsWaitForAFullBucket) {
+    RateBudget budget(100.0, 1000.0);
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_TRUE(budget.tryAcquire(5000.0, now));
+    EXPECT_FALSE(budget.tryAcquire(5000.0, now + seconds(30)));
+    EXPECT_TRUE(budget.tryAcquire(5000.0, now + seconds(61)));
+}
+
+TEST(RateBudgetTest, ExhaustEmptiesBothBuckets) {
+    RateBudget budget(60.0, 6000.0);
+    auto now = std::chrono::steady_clock::now();
+    budget.exhaust(now);
+    EXPECT_FALSE(budget.covers(1.0, now));
+    EXPECT_FALSE(budget.tryAcquire(1.0, now + milliseconds(900)));
+    EXPECT_TRUE(budget.tryAcquire(1.0, now + milliseconds(1100)));
+}
+
+TEST(RateBudgetTest, SetLimitsKeepsTheFilledFraction) {
+    RateBudget budget;
+    RateBudget half(20.0, 1e9);
+    budget.setLimits(10.0, 1e9);
+    auto now = std::chrono::steady_clock::now() + milliseconds(1);
+    EXPECT_EQ(acquireAll(budget, 1.0, now), 10);
+
+    // Emptied, then half refilled; doubling the limit keeps it half full
+    half.exhaust(now);
+    EXPECT_TRUE(half.covers(1.0, now + seconds(30)));
+    half.setLimits(40.0, 1e9);
+    EXPECT_EQ(acquireAll(half, 1.0, now + seconds(30)), 20);
+}
+
+TEST(RateBudgetTest, IgnoresTimeGoingBackwards) {
+    RateBudget budget(60.0, 1e9);
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_EQ(acquireAll(budget, 1.0, now + seconds(10)), 60);
+    EXPECT_EQ(acquireAll(budget, 1.0, now), 0);
+    EXPECT_EQ(acquireAll(budget, 1.0, now + seconds(11)), 1);
+}
+
+TEST(RateBudgetTest, LimitsHaveAFloor) {
+    RateBudget budget(0.0, -5.0);
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_EQ(acquireAll(budget, 0.5, now), 1);
+}
@@ -0,0 +1,166 @@
+#include "hyperloglog.h"
+#include "space_saving.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace {
+    using std::chrono::seconds;
+
+    const std::chrono::system_clock::time_point START(std::chrono::hours(24 * 365 * 50));
+
+    uint64_t keyHash(const std::string& key) {
+        return std::hash<std::string>{}(key);
+    }
+
+    uint64_t keyHash(int key) {
+        return keyHash("key-" + std::to_string(key));
+    }
+}
+
+TEST(HyperLogLogTest, EmptyAndSmallCountsAreNearExact) {
+    HyperLogLog sketch(12);
+    EXPECT_DOUBLE_EQ(sketch.estimate(), 0.0);
+
+    for (int i = 0; i < 10; ++i) {
+        for (int repeat = 0; repeat < 5; ++repeat) {
+            sketch.add(keyHash(i));
+        }
+    }
+    EXPECT_NEAR(sketch.estimate(), 10.0, 0.5);
+
+    sketch.clear();
+    EXPECT_DOUBLE_EQ(sketch.estimate(), 0.0);
+}
+
+TEST(HyperLogLogTest, LargeCountsWithinErrorBound) {
+    HyperLogLog sketch(14);  // About 0.8% standard error
+    const int distinct = 200000;
+    for (int i = 0; i < distinct; ++i) {
+        sketch.add(keyHash(i));
+    }
+    EXPECT_NEAR(sketch.estimate(), distinct, distinct * 0.04);
+
+    // Sequential integers hash poorly with std::hash; the sketch mixes them itself
+    HyperLogLog integers(14);
+    for (uint64_t i = 0; i < static_cast<uint64_t>(distinct); ++i) {
+        integers.add(i);
+    }
+    EXPECT_NEAR(integers.estimate(), distinct, distinct * 0.04);
+}
+
+TEST(HyperLogLogTest, MergeEstimatesTheUnion) {
+    HyperLogLog first(12);
+    HyperLogLog second(12);
+    for (int i = 0; i < 30000; ++i) first.add(keyHash(i));
+    for (int i = 20000; i < 50000; ++i) second.add(keyHash(i));
+
+    first.merge(second);
+    EXPECT_NEAR(first.estimate(), 50000.0, 50000.0 * 0.06);
+
+    // Sketches of different precision are not merged
+    HyperLogLog other(10);
+    other.add(keyHash(-1));
+    double before = first.estimate();
+    first.merge(other);
+    EXPECT_DOUBLE_EQ(first.estimate(), before);
+}
+
+TEST(HyperLogLogTest, PrecisionIsClamped) {
+    EXPECT_EQ(HyperLogLog(0).registers().size(), 16u);
+    EXPECT_EQ(HyperLogLog(40).registers().size(), 65536u);
+}
+
+TEST(SlidingHyperLogLogTest, ForgetsBucketsOutsideTheWindow) {
+    SlidingHyperLogLog sketch(seconds(60), 6, 12);
+    EXPECT_DOUBLE_EQ(sketch.count(START), 0.0);
+
+    for (int i = 0; i < 100; ++i) sketch.add(START, keyHash(i));
+    for (int i = 100; i < 150; ++i) sketch.add(START + seconds(30), keyHash(i));
+    EXPECT_NEAR(sketch.count(START + seconds(30)), 150.0, 5.0);
+
+    // The first bucket has slid out, the second has not
+    EXPECT_NEAR(sketch.count(START + seconds(65)), 50.0, 3.0);
+    EXPECT_DOUBLE_EQ(sketch.count(START + seconds(200)), 0.0);
+}
+
+TEST(SlidingHyperLogLogTest, IgnoresLateKeysForReusedBuckets) {
+    SlidingHyperLogLog sketch(seconds(60), 6, 12);
+    sketch.add(START + seconds(120), keyHash(1));
+    // Same slot, one full window earlier
+    sketch.add(START + seconds(60), keyHash(2));
+    EXPECT_NEAR(sketch.count(START + seconds(120)), 1.0, 0.1);
+}
+
+TEST(SpaceSavingTest, ExactWhileKeysFit) {
+    SpaceSaving summary(4);
+    summary.add("a", 3.0);
+    summary.add("b");
+    summary.add("a");
+    summary.add("c", 0.5);
+
+    EXPECT_DOUBLE_EQ(summary.total(), 5.5);
+    ASSERT_EQ(summary.entries().size(), 3u);
+    for (const auto& entry : summary.entries()) {
+        EXPECT_DOUBLE_EQ(entry.error, 0.0);
+        if (entry.key == "a") EXPECT_DOUBLE_EQ(entry.weight, 4.0);
+    }
+
+    summary.clear();
+    EXPECT_TRUE(summary.entries().empty());
+    EXPECT_DOUBLE_EQ(summary.total(), 0.0);
+}
+
+TEST(SpaceSavingTest, TracksHeavyHittersWithBoundedError) {
+    SpaceSaving summary(8);
+    std::unordered_map<std::string, double> truth;
+    auto add = [&](const std::string& key, double weight) {
+        summary.add(key, weight);
+        truth[key] += weight;
+    };
+
+    // Two heavy keys buried in a long tail of one-off keys
+    for (int i = 0; i < 2000; ++i) {
+        add("tail-" + std::to_string(i), 1.0);
+        if (i % 4 == 0) add("heavy", 2.0);
+        if (i % 10 == 0) add("medium", 3.0);
+    }
+
+    EXPECT_EQ(summary.entries().size(), 8u);
+    for (const std::string key : {"heavy", "medium"}) {
+        ASSERT_GT(truth[key], summary.total() / 8);
+        auto it = std::find_if(summary.entries().begin(), summary.entries().end(),
+                               [&key](const SpaceSaving::Entry& entry) { return entry.key == key; });
+        ASSERT_NE(it, summary.entries().end()) << key;
+        EXPECT_GE(it->weight, truth[key]);
+        EXPECT_LE(it->weight - it->error, truth[key]);
+    }
+}
+
+TEST(SlidingHeavyHittersTest, CombinesCurrentAndPreviousWindow) {
+    SlidingHeavyHitters hitters(seconds(60), 16);
+    hitters.add(START, "dropbox.com", 100.0);
+    hitters.add(START, "github.com", 10.0);
+    hitters.add(START + seconds(60), "github.com", 50.0);
+    hitters.add(START + seconds(61), "example.com", 1.0);
+
+    auto top = hitters.top(START + seconds(90), 2);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].first, "dropbox.com");
+    EXPECT_EQ(top[1].first, "github.com");
+    EXPECT_DOUBLE_EQ(top[1].second, 60.0);
+    EXPECT_DOUBLE_EQ(hitters.total(START + seconds(90)), 161.0);
+
+    // One window later the first window has rotated out
+    top = hitters.top(START + seconds(125), 10);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].first, "github.com");
+    EXPECT_DOUBLE_EQ(top[0].second, 50.0);
+
+    // After a long gap both windows are empty
+    EXPECT_TRUE(hitters.top(START + seconds(600), 10).empty());
+    EXPECT_DOUBLE_EQ(hitters.total(START + seconds(600)), 0.0);
+}
@@ -0,0 +1,174 @@
+#include "user_profile_store.h"
+#include "ring_buffer.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    BehaviorPattern pattern(const std::string& user, const std::string& type, const std::string& description = "") {
+        return BehaviorPattern{user, type, 0.5, description, std::chrono::system_clock::now()};
+    }
+
+    std::vector<std::string> recentDescriptions(const UserProfileStore& store, const std::string& user,
+                                                size_t limit) {
+        std::vector<std::string> descriptions;
+        store.visitRecentPatterns(user, limit, [&descriptions](const BehaviorPattern& pattern) {
+            descriptions.push_back(pattern.description);
+        });
+        return descriptions;
+    }
+}
+
+TEST(RingBufferTest, OverwritesOldestWhenFull) {
+    RingBuffer<std::string, 3> ring;
+    EXPECT_TRUE(ring.empty());
+    EXPECT_FALSE(ring.push("a"));
+    EXPECT_FALSE(ring.push("b"));
+    EXPECT_FALSE(ring.push("c"));
+    EXPECT_TRUE(ring.full());
+    EXPECT_EQ(ring.oldest(), "a");
+
+    EXPECT_TRUE(ring.push("d"));
+    EXPECT_EQ(ring.size(), 3u);
+    EXPECT_EQ(ring[0], "b");
+    EXPECT_EQ(ring[2], "d");
+    EXPECT_EQ(ring.fromNewest(0), "d");
+    EXPECT_EQ(ring.fromNewest(2), "b");
+}
+
+TEST(RingBufferTest, IteratesOldestToNewest) {
+    RingBuffer<int, 4> ring;
+    for (int i = 0; i < 10; ++i) {
+        ring.push(i);
+        std::vector<int> seen;
+        for (int value : ring) seen.push_back(value);
+        std::vector<int> expected;
+        for (int j = std::max(0, i - 3); j <= i; ++j) expected.push_back(j);
+        EXPECT_EQ(seen, expected);
+    }
+
+    ring.clear();
+    EXPECT_TRUE(ring.empty());
+    EXPECT_TRUE(ring.begin() == ring.end());
+    ring.push(42);
+    EXPECT_EQ(ring.oldest(), 42);
+    EXPECT_EQ(ring.fromNewest(0), 42);
+}
+
+TEST(UserProfileStoreTest, AddPatternCreatesProfiles) {
+    UserProfileStore store(1024);
+    store.addPattern(pattern("alice", "normal"));
+    store.addPattern(pattern("bob", "suspicious"), [](UserProfile& profile) { profile.risk_score = 0.7; });
+
+    EXPECT_TRUE(store.contains("alice"));
+    EXPECT_FALSE(store.contains("carol"));
+    EXPECT_EQ(store.size(), 2u);
+
+    double risk = 0.0;
+    EXPECT_TRUE(store.visitProfile("bob", [&risk](const UserProfile& profile) { risk = profile.risk_score; }));
+    EXPECT_DOUBLE_EQ(risk, 0.7);
+    EXPECT_FALSE(store.visitProfile("carol", [](const UserProfile&) {}));
+}
+
+TEST(UserProfileStoreTest, RiskWindowCountsSlide) {
+    UserProfileStore store(4096);
+    const char* types[] = {"suspicious", "anomalous", "normal", "suspicious", "other"};
+
+    std::vector<PatternKind> kinds;
+    for (size_t i = 0; i < 200; ++i) {
+        const char* type = types[(i * 7 + i / 3) % 5];
+        store.addPattern(pattern("alice", type));
+        kinds.push_back(type == std::string("suspicious") ? PatternKind::Suspicious
+                        : type == std::string("anomalous") ? PatternKind::Anomalous
+                                                           : PatternKind::Normal);
+
+        int suspicious = 0;
+        int anomalous = 0;
+        size_t window = std::min(kinds.size(), UserProfile::RISK_WINDOW);
+        for (size_t j = kinds.size() - window; j < kinds.size(); ++j) {
+            suspicious += kinds[j] == PatternKind::Suspicious;
+            anomalous += kinds[j] == PatternKind::Anomalous;
+        }
+        store.visitProfile("alice", [&](const UserProfile& profile) {
+            EXPECT_EQ(profile.window_suspicious, suspicious) << "after " << i;
+            EXPECT_EQ(profile.window_anomalous, anomalous) << "after " << i;
+            EXPECT_EQ(profile.recent_patterns.size(), std::min(kinds.size(), UserProfile::MAX_RECENT_PATTERNS));
+        });
+    }
+}
+
+TEST(UserProfileStoreTest, RecentPatternsNewestFirst) {
+    UserProfileStore store(4096);
+    for (int i = 0; i < 5; ++i) {
+        store.addPattern(pattern("alice", "normal", std::to_string(i)));
+    }
+    EXPECT_EQ(recentDescriptions(store, "alice", 3), (std::vector<std::string>{"4", "3", "2"}));
+    EXPECT_EQ(recentDescriptions(store, "alice", 100).size(), 5u);
+    EXPECT_TRUE(recentDescriptions(store, "nobody", 10).empty());
+}
+
+TEST(UserProfileStoreTest, SkipsPatternsTheArenaReused) {
+    UserProfileStore store(UserProfileStore::SHARDS * 4);  // Four arena slots per shard
+    for (int i = 0; i < 10; ++i) {
+        store.addPattern(pattern("alice", i == 0 ? "suspicious" : "normal", std::to_string(i)));
+    }
+
+    EXPECT_EQ(recentDescriptions(store, "alice", 10), (std::vector<std::string>{"9", "8", "7", "6"}));
+    store.visitProfile("alice", [](const UserProfile& profile) {
+        // References outlive their arena slots, so risk counts still see them
+        EXPECT_EQ(profile.recent_patterns.size(), 10u);
+        EXPECT_EQ(profile.window_suspicious, 1);
+    });
+}
+
+TEST(UserProfileStoreTest, PutRecountsTheWindow) {
+    UserProfileStore store(1024);
+    UserProfile profile{"alice", {{"typing", 1.0}}, {}, 0.4};
+    for (int i = 0; i < 12; ++i) {
+        profile.recent_patterns.push(PatternRef{static_cast<uint64_t>(i),
+                                                i < 4 ? PatternKind::Anomalous : PatternKind::Suspicious});
+    }
+    profile.window_suspicious = 99;
+    store.put(profile);
+
+    store.visitProfile("alice", [](const UserProfile& stored) {
+        EXPECT_EQ(stored.window_suspicious, 8);
+        EXPECT_EQ(stored.window_anomalous, 2);
+        EXPECT_TRUE(stored.baseline_metrics.empty());
+        EXPECT_DOUBLE_EQ(stored.risk_score, 0.4);
+    });
+
+    store.updateProfile("bob", [](UserProfile& created) { created.risk_score = 0.2; });
+    EXPECT_TRUE(store.contains("bob"));
+}
+
+TEST(UserProfileStoreTest, ConcurrentWriters) {
+    UserProfileStore store(UserProfileStore::SHARDS * 256);
+    const int threads = 8;
+    const int per_thread = 2000;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&store, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                std::string user = "user" + std::to_string((t * per_thread + i) % 50);
+                store.addPattern(pattern(user, i % 2 ? "anomalous" : "normal"));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    EXPECT_EQ(store.size(), 50u);
+    EXPECT_EQ(store.users().size(), 50u);
+    for (const auto& user : store.users()) {
+        store.visitProfile(user, [](const UserProfile& profile) {
+            EXPECT_EQ(profile.recent_patterns.size(), UserProfile::MAX_RECENT_PATTERNS);
+            EXPECT_LE(profile.window_anomalous, static_cast<int>(UserProfile::RISK_WINDOW));
+            EXPECT_GE(profile.window_anomalous, 0);
+        });
+    }
+}